@@ -0,0 +1,97 @@
+/* ICMP checksum cost: nanoseconds per packet and GB/s for every checksum
+ * kernel this CPU supports, against the scalar per-word loop.  Sizes are
+ * the default echo, a full 1500-MTU echo, a jumbo frame and the largest
+ * --payload-size.  Buffers start one byte off alignment, as a payload
+ * behind an odd header would.
+ *
+ * Usage: checksum_bench [packet bytes...]   (default: 64 1480 9000 65515)
+ * Env:   BENCH_BYTES (bytes checksummed per kernel and size, default 1 GiB) */
+
+#include "openups.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static volatile uint64_t bench_sink; /* keeps the loops observable */
+
+static uint64_t bench_time_kernel(checksum_kernel_t kernel,
+                                  const uint8_t *data, size_t len,
+                                  uint64_t iterations) {
+  uint64_t start_us = get_monotonic_us();
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < iterations; i++) {
+    sum += checksum_compute(kernel, data, len);
+    bench_sink = sum; /* one store per call, so calls are not merged */
+  }
+  return get_monotonic_us() - start_us;
+}
+
+static bool bench_run(size_t len, uint64_t total_bytes) {
+  uint8_t *buffer = malloc(len + 1);
+  if (buffer == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i <= len; i++) {
+    buffer[i] = (uint8_t)(i * 131U + 7U);
+  }
+  const uint8_t *data = buffer + 1;
+  uint64_t iterations = total_bytes / len;
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  uint16_t expected = checksum_compute(CHECKSUM_KERNEL_SCALAR, data, len);
+  double scalar_ns = 0.0;
+  bool ok = true;
+  for (int k = 0; k < CHECKSUM_KERNEL_COUNT; k++) {
+    checksum_kernel_t kernel = (checksum_kernel_t)k;
+    if (!checksum_kernel_supported(kernel)) {
+      continue;
+    }
+    if (checksum_compute(kernel, data, len) != expected) {
+      fprintf(stderr, "checksum_bench: %s disagrees with scalar at %zu\n",
+              checksum_kernel_name(kernel), len);
+      ok = false;
+      break;
+    }
+    uint64_t elapsed_us = bench_time_kernel(kernel, data, len, iterations);
+    double ns = (double)elapsed_us * 1000.0 / (double)iterations;
+    if (kernel == CHECKSUM_KERNEL_SCALAR) {
+      scalar_ns = ns;
+    }
+    double gbps = ns > 0 ? (double)len / ns : 0.0;
+    printf("%8zu %8s %12.1f %8.2f %9.1fx%s\n", len,
+           checksum_kernel_name(kernel), ns, gbps,
+           ns > 0 ? scalar_ns / ns : 0.0,
+           kernel == checksum_kernel_select() ? "  (selected)" : "");
+  }
+  free(buffer);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  static const size_t default_sizes[] = {64, 1480, 9000,
+                                         OPENUPS_PROBE_HEADER_LEN +
+                                             OPENUPS_MAX_PAYLOAD_SIZE};
+  const char *bytes_env = getenv("BENCH_BYTES");
+  uint64_t total_bytes = bytes_env != NULL && strtoull(bytes_env, NULL, 10) > 0
+                             ? strtoull(bytes_env, NULL, 10)
+                             : UINT64_C(1) << 30;
+
+  printf("checksum_bench: %" PRIu64 " MiB per kernel and size\n",
+         total_bytes >> 20);
+  printf("%8s %8s %12s %8s %10s\n", "bytes", "kernel", "ns/packet", "GB/s",
+         "speedup");
+  size_t runs = argc > 1 ? (size_t)(argc - 1)
+                         : sizeof(default_sizes) / sizeof(default_sizes[0]);
+  for (size_t i = 0; i < runs; i++) {
+    size_t len = argc > 1 ? (size_t)strtoul(argv[i + 1], NULL, 10)
+                          : default_sizes[i];
+    if (len == 0 || len > OPENUPS_PROBE_HEADER_LEN + OPENUPS_MAX_PAYLOAD_SIZE ||
+        !bench_run(len, total_bytes)) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
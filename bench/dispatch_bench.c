@@ -0,0 +1,169 @@
+/* Reply dispatch cost: nanoseconds to map one echo reply to its in-flight
+ * target slot.  Compares the fleet reply map (open addressing on source,
+ * identifier, sequence) with a linear scan that checks every target's
+ * source address the way the single-target receive path used to.
+ *
+ * Usage: dispatch_bench [targets...]   (default: 1000 10000)
+ * Env:   BENCH_ROUNDS (replies dispatched per target, default 200) */
+
+#include "fleet.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_IDENTIFIER 0x4242U
+
+static volatile uint64_t bench_sink; /* keeps the loops observable */
+static uint64_t bench_rng_state = UINT64_C(0x9E3779B97F4A7C15);
+
+static uint64_t bench_rand(void) {
+  /* xorshift64: reproducible addresses and reply order across runs */
+  bench_rng_state ^= bench_rng_state << 13;
+  bench_rng_state ^= bench_rng_state >> 7;
+  bench_rng_state ^= bench_rng_state << 17;
+  return bench_rng_state;
+}
+
+/* Every fourth target is IPv6, the rest IPv4, all distinct. */
+static void bench_fill_replies(icmp_echo_reply_t *replies, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    icmp_echo_reply_t *reply = &replies[i];
+    memset(reply, 0, sizeof(*reply));
+    if (i % 4 == 3) {
+      struct sockaddr_in6 *addr = (struct sockaddr_in6 *)&reply->source;
+      addr->sin6_family = AF_INET6;
+      addr->sin6_addr.s6_addr[0] = 0x20;
+      addr->sin6_addr.s6_addr[1] = 0x01;
+      uint64_t low = bench_rand();
+      memcpy(&addr->sin6_addr.s6_addr[8], &low, sizeof(low));
+      memcpy(&addr->sin6_addr.s6_addr[4], &i, sizeof(i));
+    } else {
+      struct sockaddr_in *addr = (struct sockaddr_in *)&reply->source;
+      addr->sin_family = AF_INET;
+      addr->sin_addr.s_addr = htonl(UINT32_C(0x0A000000) + i);
+    }
+    reply->identifier = BENCH_IDENTIFIER;
+    reply->sequence = (uint16_t)(i % UINT16_MAX + 1U);
+  }
+}
+
+static bool bench_source_matches(const struct sockaddr_storage *lhs,
+                                 const struct sockaddr_storage *rhs) {
+  if (lhs->ss_family != rhs->ss_family) {
+    return false;
+  }
+  if (lhs->ss_family == AF_INET) {
+    return ((const struct sockaddr_in *)lhs)->sin_addr.s_addr ==
+           ((const struct sockaddr_in *)rhs)->sin_addr.s_addr;
+  }
+  return memcmp(&((const struct sockaddr_in6 *)lhs)->sin6_addr,
+                &((const struct sockaddr_in6 *)rhs)->sin6_addr,
+                sizeof(struct in6_addr)) == 0;
+}
+
+static bool bench_run(uint32_t count, unsigned rounds) {
+  icmp_echo_reply_t *replies = calloc(count, sizeof(*replies));
+  uint32_t *order = calloc(count, sizeof(*order));
+  fleet_reply_map_t map;
+  arena_t arena = {0};
+  size_t arena_size = 0;
+  char error_msg[128] = "out of memory";
+  if (replies == NULL || order == NULL ||
+      !fleet_reply_map_layout(&arena_size, count) ||
+      !arena_init(&arena, arena_size, error_msg, sizeof(error_msg)) ||
+      !fleet_reply_map_init(&map, &arena, count)) {
+    arena_destroy(&arena);
+    free(replies);
+    free(order);
+    fprintf(stderr, "dispatch_bench: %s\n", error_msg);
+    return false;
+  }
+  bench_fill_replies(replies, count);
+  for (uint32_t i = 0; i < count; i++) {
+    order[i] = i;
+  }
+  for (uint32_t i = count - 1; i > 0; i--) {
+    uint32_t j = (uint32_t)(bench_rand() % (i + 1U));
+    uint32_t swap = order[i];
+    order[i] = order[j];
+    order[j] = swap;
+  }
+
+  /* Hash: every reply is taken and its slot re-armed, the steady state of
+   * a worker where each target has one probe in flight. */
+  icmp_reply_key_t key;
+  for (uint32_t i = 0; i < count; i++) {
+    icmp_reply_key_init(&key, &replies[i].source, replies[i].identifier,
+                        replies[i].sequence);
+    (void)fleet_reply_map_insert(&map, &key, i);
+  }
+  uint64_t checksum = 0;
+  uint64_t start_us = get_monotonic_us();
+  for (unsigned round = 0; round < rounds; round++) {
+    for (uint32_t i = 0; i < count; i++) {
+      const icmp_echo_reply_t *reply = &replies[order[i]];
+      uint32_t slot = 0;
+      icmp_reply_key_init(&key, &reply->source, reply->identifier,
+                          reply->sequence);
+      if (fleet_reply_map_take(&map, &key, &slot)) {
+        checksum += slot;
+        (void)fleet_reply_map_insert(&map, &key, slot);
+      }
+    }
+  }
+  uint64_t hash_us = get_monotonic_us() - start_us;
+
+  /* Linear scan over far fewer rounds: it is O(targets) per reply. */
+  unsigned scan_rounds = rounds * 1000U / count > 0 ? rounds * 1000U / count
+                                                    : 1U;
+  start_us = get_monotonic_us();
+  for (unsigned round = 0; round < scan_rounds; round++) {
+    for (uint32_t i = 0; i < count; i++) {
+      const icmp_echo_reply_t *reply = &replies[order[i]];
+      for (uint32_t slot = 0; slot < count; slot++) {
+        if (replies[slot].sequence == reply->sequence &&
+            bench_source_matches(&replies[slot].source, &reply->source)) {
+          checksum -= slot;
+          break;
+        }
+      }
+    }
+  }
+  uint64_t scan_us = get_monotonic_us() - start_us;
+
+  double hash_ns = (double)hash_us * 1000.0 / ((double)rounds * count);
+  double scan_ns = (double)scan_us * 1000.0 / ((double)scan_rounds * count);
+  bench_sink = checksum;
+  printf("%8" PRIu32 " %14.1f %14.1f %10.1fx\n", count, hash_ns, scan_ns,
+         hash_ns > 0 ? scan_ns / hash_ns : 0.0);
+
+  arena_destroy(&arena);
+  free(replies);
+  free(order);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  static const uint32_t default_counts[] = {1000, 10000};
+  const char *rounds_env = getenv("BENCH_ROUNDS");
+  unsigned rounds = rounds_env != NULL && atoi(rounds_env) > 0
+                        ? (unsigned)atoi(rounds_env)
+                        : 200U;
+
+  printf("dispatch_bench: %u replies per target, 1/4 IPv6\n", rounds);
+  printf("%8s %14s %14s %11s\n", "targets", "hash_ns/reply", "scan_ns/reply",
+         "speedup");
+  size_t runs = argc > 1 ? (size_t)(argc - 1)
+                         : sizeof(default_counts) / sizeof(default_counts[0]);
+  for (size_t i = 0; i < runs; i++) {
+    uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[i + 1], NULL, 10)
+                              : default_counts[i];
+    if (count == 0 || count > OPENUPS_FLEET_MAX_TARGETS ||
+        !bench_run(count, rounds)) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
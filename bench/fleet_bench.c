@@ -0,0 +1,110 @@
+/* Fleet mode throughput: sustained probes/sec and p99 scheduling error as
+ * the target count grows.  Every target is a loopback address
+ * (127.0.0.0/8 answers on lo), so the kernel echo path is the only peer.
+ *
+ * Usage: fleet_bench [targets...]   (default: 1000 2000 5000 10000)
+ * Env:   BENCH_SECONDS (measurement window, default 3), BENCH_WORKERS */
+
+#include "fleet.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static fleet_target_t *bench_loopback_targets(uint32_t count) {
+  fleet_target_t *targets = calloc(count, sizeof(*targets));
+  if (targets == NULL) {
+    return NULL;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    struct sockaddr_in *addr = (struct sockaddr_in *)&targets[i].addr;
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(UINT32_C(0x7F000001) + i);
+    targets[i].addr_len = sizeof(*addr);
+    inet_ntop(AF_INET, &addr->sin_addr, targets[i].name,
+              sizeof(targets[i].name));
+  }
+  return targets;
+}
+
+static int bench_env_int(const char *name, int fallback) {
+  const char *value = getenv(name);
+  return value != NULL && atoi(value) > 0 ? atoi(value) : fallback;
+}
+
+static bool bench_run(uint32_t count, unsigned seconds, int workers) {
+  config_t config;
+  config_init_default(&config);
+  config.interval_sec = 1;
+  config.timeout_ms = 500;
+  config.fail_threshold = 3;
+  config.workers = workers;
+  config.log_level = LOG_LEVEL_WARN;
+
+  fleet_target_t *targets = bench_loopback_targets(count);
+  fleet_t fleet;
+  char error_msg[256];
+  if (targets == NULL ||
+      !fleet_init(&fleet, &config, targets, count, error_msg,
+                  sizeof(error_msg)) ||
+      !fleet_start(&fleet, error_msg, sizeof(error_msg))) {
+    if (targets != NULL) {
+      fleet_destroy(&fleet);
+    }
+    fprintf(stderr, "fleet_bench: %s\n",
+            targets == NULL ? "out of memory" : error_msg);
+    return false;
+  }
+
+  /* One full interval of warm-up so every target is on its steady cadence. */
+  sleep(1);
+  fleet_stats_t before;
+  fleet_stats_t after;
+  fleet_stats_t window;
+  fleet_stats_collect(&fleet, &before);
+  sleep(seconds);
+  fleet_stats_collect(&fleet, &after);
+  fleet_stop(&fleet);
+  fleet_stats_delta(&after, &before, &window);
+
+  double probes_per_sec = (double)window.sent / (double)seconds;
+  double reply_ratio =
+      window.sent > 0 ? (double)window.received / (double)window.sent : 0.0;
+  printf("%8" PRIu32 " %8u %12.0f %12.0f %10.4f %12" PRIu64 " %12" PRIu64
+         "\n",
+         count, fleet.worker_count, (double)count / config.interval_sec,
+         probes_per_sec, reply_ratio, fleet_stats_percentile(&window, 50.0),
+         fleet_stats_percentile(&window, 99.0));
+  fleet_destroy(&fleet);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  static const uint32_t default_counts[] = {1000, 2000, 5000, 10000};
+  unsigned seconds = (unsigned)bench_env_int("BENCH_SECONDS", 3);
+  int workers = bench_env_int("BENCH_WORKERS", 0);
+
+  int probe = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+  if (probe < 0) {
+    printf("fleet_bench: skipped (raw sockets need root or CAP_NET_RAW)\n");
+    return EXIT_SUCCESS;
+  }
+  close(probe);
+
+  printf("fleet_bench: %us window, interval 1s\n", seconds);
+  printf("%8s %8s %12s %12s %10s %12s %12s\n", "targets", "workers",
+         "wanted/s", "probes/s", "replies", "p50_sched_us", "p99_sched_us");
+  size_t runs = argc > 1 ? (size_t)(argc - 1)
+                         : sizeof(default_counts) / sizeof(default_counts[0]);
+  for (size_t i = 0; i < runs; i++) {
+    uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[i + 1], NULL, 10)
+                              : default_counts[i];
+    if (count == 0 || count > OPENUPS_FLEET_MAX_TARGETS ||
+        !bench_run(count, seconds, workers)) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
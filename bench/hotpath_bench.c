@@ -0,0 +1,377 @@
+/* Single-target hot paths: nanoseconds and TSC cycles per call for the work
+ * the reactor does on every probe.  Each figure is the fastest of several
+ * timed batches, so a preempted batch does not skew it.
+ *
+ *   icmp_checksum_64        checksum of a default 64-byte echo
+ *   parse_ipv4_reply        icmp_parse_echo_packet() on an IPv4 frame
+ *   parse_ipv6_reply        ... and on an IPv6 frame
+ *   reply_source_match      reply key build + compare, as in receive
+ *   logger_filtered         logger_debug() below the configured level
+ *   logger_unfiltered       logger_info() written to /dev/null
+ *   systemd_status_dedup    systemd_notifier_status() repeating a status
+ *   reactor_tick            one reactor iteration under openups-sim
+ *
+ * Usage: hotpath_bench
+ * Env:   BENCH_JSON (write results here as JSON), BENCH_BASELINE (compare
+ *        against an earlier BENCH_JSON; exit 1 on a regression),
+ *        BENCH_TOLERANCE (allowed slowdown in percent, default 15) */
+
+#include "sim.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netinet/ip6.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_REPEATS 7
+#define BENCH_MIN_BATCH_US UINT64_C(20000)
+#define BENCH_MAX_RESULTS 16
+
+static volatile uint64_t bench_sink; /* keeps the loops observable */
+
+typedef struct {
+  const char *name;
+  double ns;
+  double cycles; /* 0 where there is no cycle counter */
+} bench_result_t;
+
+typedef struct {
+  uint8_t echo[64];
+  uint8_t ipv4[84];
+  uint8_t ipv6[104];
+  struct sockaddr_storage target;
+  logger_t logger;
+  systemd_notifier_t notifier;
+} bench_fixture_t;
+
+static uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/* ---- Operations: each runs ops calls ---- */
+
+static void bench_checksum(bench_fixture_t *fixture, uint64_t ops) {
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < ops; i++) {
+    fixture->echo[6] = (uint8_t)i; /* a new sequence, as each probe has */
+    sum += icmp_checksum(fixture->echo, sizeof(fixture->echo));
+  }
+  bench_sink = sum;
+}
+
+static void bench_parse(const uint8_t *packet, size_t len, uint64_t ops) {
+  uint64_t sum = 0;
+  icmp_reply_key_t key;
+  for (uint64_t i = 0; i < ops; i++) {
+    sum += icmp_parse_echo_packet(packet, len, &key) ? key.sequence : 0;
+    bench_sink = sum;
+  }
+}
+
+static void bench_parse_ipv4(bench_fixture_t *fixture, uint64_t ops) {
+  bench_parse(fixture->ipv4, sizeof(fixture->ipv4), ops);
+}
+
+static void bench_parse_ipv6(bench_fixture_t *fixture, uint64_t ops) {
+  bench_parse(fixture->ipv6, sizeof(fixture->ipv6), ops);
+}
+
+static void bench_source_match(bench_fixture_t *fixture, uint64_t ops) {
+  uint64_t sum = 0;
+  icmp_reply_key_t expected;
+  icmp_reply_key_t actual;
+  for (uint64_t i = 0; i < ops; i++) {
+    icmp_reply_key_init(&expected, &fixture->target, 0x4242U, (uint16_t)i);
+    icmp_reply_key_init(&actual, &fixture->target, 0x4242U, (uint16_t)i);
+    sum += icmp_reply_key_equal(&expected, &actual);
+    bench_sink = sum;
+  }
+}
+
+static void bench_logger_filtered(bench_fixture_t *fixture, uint64_t ops) {
+  for (uint64_t i = 0; i < ops; i++) {
+    logger_debug(&fixture->logger, "Ping successful to %s, latency: %.2fms",
+                 "192.0.2.1", (double)i);
+  }
+}
+
+static void bench_logger_unfiltered(bench_fixture_t *fixture, uint64_t ops) {
+  for (uint64_t i = 0; i < ops; i++) {
+    logger_info(&fixture->logger, "Ping successful to %s, latency: %.2fms",
+                "192.0.2.1", (double)i);
+  }
+}
+
+static void bench_status_dedup(bench_fixture_t *fixture, uint64_t ops) {
+  /* Inside the dedup window nothing is sent; re-arm it per batch. */
+  fixture->notifier.last_status_ms = get_monotonic_ms();
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < ops; i++) {
+    sum += systemd_notifier_status(&fixture->notifier,
+                                   "OK: 100/100 pings (100.0%), latency 1.00ms");
+  }
+  bench_sink = sum;
+}
+
+/* ---- Measurement ---- */
+
+/* Doubles the batch until one takes BENCH_MIN_BATCH_US, then keeps the
+ * fastest of BENCH_REPEATS batches. */
+static bench_result_t bench_measure(const char *name,
+                                    void (*op)(bench_fixture_t *, uint64_t),
+                                    bench_fixture_t *fixture) {
+  uint64_t ops = 64;
+  for (;;) {
+    uint64_t start_us = get_monotonic_us();
+    op(fixture, ops);
+    if (get_monotonic_us() - start_us >= BENCH_MIN_BATCH_US ||
+        ops >= UINT64_C(1) << 32) {
+      break;
+    }
+    ops *= 2;
+  }
+  bench_result_t result = {name, 0.0, 0.0};
+  for (int r = 0; r < BENCH_REPEATS; r++) {
+    uint64_t start_cycles = bench_cycles();
+    uint64_t start_us = get_monotonic_us();
+    op(fixture, ops);
+    uint64_t elapsed_us = get_monotonic_us() - start_us;
+    uint64_t elapsed_cycles = bench_cycles() - start_cycles;
+    double ns = (double)elapsed_us * 1000.0 / (double)ops;
+    if (r == 0 || ns < result.ns) {
+      result.ns = ns;
+      result.cycles = (double)elapsed_cycles / (double)ops;
+    }
+  }
+  return result;
+}
+
+/* A simulated day of 1 s probes through the real reactor, logging off:
+ * the cost of openups_reactor_run() per loop iteration. */
+static bool bench_reactor_tick(bench_result_t *restrict result) {
+  config_t config;
+  config_init_default(&config);
+  snprintf(config.target, sizeof(config.target), "192.0.2.1");
+  config.interval_sec = 1;
+  config.shutdown_mode = SHUTDOWN_MODE_LOG_ONLY;
+  config.log_level = LOG_LEVEL_SILENT;
+  sim_options_t options = {
+      .seed = 1,
+      .duration_ms = UINT64_C(86400) * OPENUPS_MS_PER_SEC,
+  };
+  netem_impair_init(&options.impair);
+  char error_msg[256];
+  if (!netem_impair_set(&options.impair, "delay=normal:20,5", error_msg,
+                        sizeof(error_msg)) ||
+      !netem_impair_set(&options.impair, "loss=1", error_msg,
+                        sizeof(error_msg))) {
+    fprintf(stderr, "hotpath_bench: %s\n", error_msg);
+    return false;
+  }
+
+  *result = (bench_result_t){"reactor_tick", 0.0, 0.0};
+  for (int r = 0; r < 3; r++) {
+    sim_stats_t stats;
+    uint64_t start_cycles = bench_cycles();
+    int exit_code = sim_run(&options, &config, &stats, error_msg,
+                            sizeof(error_msg));
+    uint64_t elapsed_cycles = bench_cycles() - start_cycles;
+    if (exit_code != OPENUPS_EXIT_SUCCESS || stats.ticks == 0) {
+      fprintf(stderr, "hotpath_bench: reactor simulation failed: %s\n",
+              exit_code == OPENUPS_SIM_EXIT_SETUP ? error_msg : "exit code");
+      return false;
+    }
+    double ns = (double)stats.wall_us * 1000.0 / (double)stats.ticks;
+    if (r == 0 || ns < result->ns) {
+      result->ns = ns;
+      result->cycles = (double)elapsed_cycles / (double)stats.ticks;
+    }
+  }
+  return true;
+}
+
+static void bench_fixture_init(bench_fixture_t *fixture) {
+  memset(fixture, 0, sizeof(*fixture));
+  for (size_t i = 0; i < sizeof(fixture->echo); i++) {
+    fixture->echo[i] = (uint8_t)(i * 131U + 7U);
+  }
+  fixture->echo[0] = ICMP_ECHO;
+
+  struct ip *ip = (struct ip *)fixture->ipv4;
+  ip->ip_v = 4;
+  ip->ip_hl = 5;
+  ip->ip_p = IPPROTO_ICMP;
+  inet_pton(AF_INET, "192.0.2.1", &ip->ip_src);
+  struct icmphdr *icmp = (struct icmphdr *)(fixture->ipv4 + sizeof(*ip));
+  icmp->type = ICMP_ECHOREPLY;
+  icmp->un.echo.id = htons(0x4242U);
+  icmp->un.echo.sequence = htons(7);
+
+  struct ip6_hdr *ip6 = (struct ip6_hdr *)fixture->ipv6;
+  ip6->ip6_vfc = 6 << 4;
+  ip6->ip6_nxt = IPPROTO_ICMPV6;
+  inet_pton(AF_INET6, "2001:db8::1", &ip6->ip6_src);
+  struct icmp6_hdr *icmp6 =
+      (struct icmp6_hdr *)(fixture->ipv6 + sizeof(*ip6));
+  icmp6->icmp6_type = ICMP6_ECHO_REPLY;
+  icmp6->icmp6_id = htons(0x4242U);
+  icmp6->icmp6_seq = htons(7);
+
+  struct sockaddr_in *target = (struct sockaddr_in *)&fixture->target;
+  target->sin_family = AF_INET;
+  inet_pton(AF_INET, "192.0.2.1", &target->sin_addr);
+
+  logger_init(&fixture->logger, LOG_LEVEL_INFO, false);
+  /* Enabled without a socket: only the dedup path is exercised. */
+  fixture->notifier.enabled = true;
+  fixture->notifier.sockfd = -1;
+  snprintf(fixture->notifier.last_status,
+           sizeof(fixture->notifier.last_status), "%s",
+           "OK: 100/100 pings (100.0%), latency 1.00ms");
+}
+
+/* ---- Output ---- */
+
+static bool bench_write_json(const char *restrict path,
+                             const bench_result_t *restrict results,
+                             size_t count) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    return false;
+  }
+  fprintf(file, "{\n  \"bench\": \"hotpath\",\n  \"results\": [\n");
+  for (size_t i = 0; i < count; i++) {
+    fprintf(file,
+            "    {\"name\": \"%s\", \"ns_per_op\": %.3f, "
+            "\"cycles_per_op\": %.1f}%s\n",
+            results[i].name, results[i].ns, results[i].cycles,
+            i + 1 < count ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  return fclose(file) == 0;
+}
+
+/* Reads ns_per_op for name from a file bench_write_json() produced: one
+ * result object per line. */
+static bool bench_baseline_ns(const char *restrict text,
+                              const char *restrict name,
+                              double *restrict out_ns) {
+  char needle[96];
+  snprintf(needle, sizeof(needle), "\"name\": \"%s\"", name);
+  const char *line = strstr(text, needle);
+  if (line == NULL) {
+    return false;
+  }
+  const char *field = strstr(line, "\"ns_per_op\": ");
+  const char *end = strchr(line, '\n');
+  if (field == NULL || (end != NULL && field > end)) {
+    return false;
+  }
+  *out_ns = strtod(field + strlen("\"ns_per_op\": "), NULL);
+  return *out_ns > 0.0;
+}
+
+/* Returns false when any result is more than tolerance percent slower. */
+static bool bench_compare(const char *restrict path,
+                          const bench_result_t *restrict results, size_t count,
+                          double tolerance) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "hotpath_bench: cannot read baseline %s\n", path);
+    return false;
+  }
+  static char text[16384];
+  size_t len = fread(text, 1, sizeof(text) - 1, file);
+  text[len] = '\0';
+  fclose(file);
+
+  bool ok = true;
+  printf("\nagainst %s (tolerance %.0f%%):\n", path, tolerance);
+  printf("%-22s %12s %12s %9s\n", "benchmark", "baseline ns", "ns", "change");
+  for (size_t i = 0; i < count; i++) {
+    double baseline = 0.0;
+    if (!bench_baseline_ns(text, results[i].name, &baseline)) {
+      printf("%-22s %12s %12.2f %9s\n", results[i].name, "-", results[i].ns,
+             "new");
+      continue;
+    }
+    double change = (results[i].ns - baseline) / baseline * 100.0;
+    bool regressed = change > tolerance;
+    printf("%-22s %12.2f %12.2f %+8.1f%%%s\n", results[i].name, baseline,
+           results[i].ns, change, regressed ? "  REGRESSION" : "");
+    ok = ok && !regressed;
+  }
+  return ok;
+}
+
+int main(void) {
+  static bench_fixture_t fixture;
+  bench_fixture_init(&fixture);
+  bench_result_t results[BENCH_MAX_RESULTS];
+  size_t count = 0;
+
+  results[count++] =
+      bench_measure("icmp_checksum_64", bench_checksum, &fixture);
+  results[count++] =
+      bench_measure("parse_ipv4_reply", bench_parse_ipv4, &fixture);
+  results[count++] =
+      bench_measure("parse_ipv6_reply", bench_parse_ipv6, &fixture);
+  results[count++] =
+      bench_measure("reply_source_match", bench_source_match, &fixture);
+  results[count++] =
+      bench_measure("logger_filtered", bench_logger_filtered, &fixture);
+
+  /* Unfiltered lines go to stderr: point it at /dev/null meanwhile. */
+  fflush(stderr);
+  int saved_stderr = dup(STDERR_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  if (saved_stderr < 0 || null_fd < 0 ||
+      dup2(null_fd, STDERR_FILENO) < 0) {
+    perror("hotpath_bench: /dev/null");
+    return EXIT_FAILURE;
+  }
+  results[count++] =
+      bench_measure("logger_unfiltered", bench_logger_unfiltered, &fixture);
+  dup2(saved_stderr, STDERR_FILENO);
+  close(saved_stderr);
+  close(null_fd);
+
+  results[count++] =
+      bench_measure("systemd_status_dedup", bench_status_dedup, &fixture);
+  if (!bench_reactor_tick(&results[count])) {
+    return EXIT_FAILURE;
+  }
+  count++;
+
+  printf("hotpath_bench: fastest of %d batches\n", BENCH_REPEATS);
+  printf("%-22s %12s %12s\n", "benchmark", "ns/op", "cycles/op");
+  for (size_t i = 0; i < count; i++) {
+    printf("%-22s %12.2f %12.1f\n", results[i].name, results[i].ns,
+           results[i].cycles);
+  }
+
+  const char *json_path = getenv("BENCH_JSON");
+  if (json_path != NULL && json_path[0] != '\0' &&
+      !bench_write_json(json_path, results, count)) {
+    perror("hotpath_bench: BENCH_JSON");
+    return EXIT_FAILURE;
+  }
+  const char *baseline_path = getenv("BENCH_BASELINE");
+  if (baseline_path != NULL && baseline_path[0] != '\0') {
+    const char *tolerance_env = getenv("BENCH_TOLERANCE");
+    double tolerance = tolerance_env != NULL && atof(tolerance_env) > 0.0
+                           ? atof(tolerance_env)
+                           : 15.0;
+    if (!bench_compare(baseline_path, results, count, tolerance)) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
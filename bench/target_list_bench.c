@@ -0,0 +1,194 @@
+/* Target list ingestion: milliseconds to turn a list file into a sorted,
+ * de-duplicated address array.  Compares target_list_load() (mmap, vector
+ * newline scan, hand-written parser, radix sort) with the stdio path the
+ * loaders used before: fgets, strcspn and inet_pton per line, then qsort.
+ *
+ * Usage: target_list_bench [lines...]   (default: 1000000)
+ * Env:   BENCH_ROUNDS (loads timed per size, best is reported, default 5) */
+
+#include "openups.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static volatile uint64_t bench_sink; /* keeps the loops observable */
+static uint64_t bench_rng_state = UINT64_C(0x9E3779B97F4A7C15);
+
+static uint64_t bench_rand(void) {
+  /* xorshift64: the same file contents across runs */
+  bench_rng_state ^= bench_rng_state << 13;
+  bench_rng_state ^= bench_rng_state >> 7;
+  bench_rng_state ^= bench_rng_state << 17;
+  return bench_rng_state;
+}
+
+/* Inventory-shaped list: 7/8 IPv4 inside 10/8, 1/8 IPv6, about 1% repeats
+ * and a comment line every thousand. */
+static bool bench_write_list(char *path, uint32_t lines) {
+  int fd = mkstemp(path);
+  FILE *file = fd >= 0 ? fdopen(fd, "w") : NULL;
+  if (file == NULL) {
+    return false;
+  }
+  uint64_t previous = 0;
+  for (uint32_t i = 0; i < lines; i++) {
+    uint64_t value = bench_rand();
+    if (i % 100 == 99) {
+      value = previous;
+    }
+    previous = value;
+    if (i % 1000 == 0) {
+      fprintf(file, "# rack %" PRIu32 "\n", i / 1000);
+    } else if (value % 8 == 7) {
+      fprintf(file, "2001:db8:%x::%x\n", (unsigned)(value >> 48) & 0xffffU,
+              (unsigned)(value >> 16) & 0xffffU);
+    } else {
+      fprintf(file, "10.%u.%u.%u\n", (unsigned)(value >> 40) & 0xffU,
+              (unsigned)(value >> 32) & 0xffU, (unsigned)(value >> 24) & 0xffU);
+    }
+  }
+  return fclose(file) == 0;
+}
+
+static int bench_entry_compare(const void *lhs, const void *rhs) {
+  const target_entry_t *a = lhs;
+  const target_entry_t *b = rhs;
+  if (a->family != b->family) {
+    return a->family < b->family ? -1 : 1;
+  }
+  int order = memcmp(a->bytes, b->bytes, sizeof(a->bytes));
+  return order != 0 ? order : (a->line_no > b->line_no) - (a->line_no < b->line_no);
+}
+
+/* The per-line libc path, with the same result as target_list_load(). */
+static bool bench_load_libc(const char *path, uint32_t *out_count) {
+  FILE *file = fopen(path, "re");
+  if (file == NULL) {
+    return false;
+  }
+  target_entry_t *entries = NULL;
+  uint32_t count = 0;
+  uint32_t capacity = 0;
+  char line[256];
+  uint32_t line_no = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file) != NULL) {
+    line_no++;
+    char *text = line + strspn(line, " \t");
+    size_t len = strcspn(text, " \t\r\n#");
+    if (len == 0) {
+      continue;
+    }
+    text[len] = '\0';
+    if (count == capacity) {
+      capacity = capacity == 0 ? 256U : capacity * 2U;
+      target_entry_t *grown = realloc(entries, capacity * sizeof(*grown));
+      if (grown == NULL) {
+        ok = false;
+        break;
+      }
+      entries = grown;
+    }
+    target_entry_t *entry = &entries[count];
+    memset(entry, 0, sizeof(*entry));
+    entry->line_no = line_no;
+    if (inet_pton(AF_INET, text, entry->bytes) == 1) {
+      entry->family = AF_INET;
+    } else if (inet_pton(AF_INET6, text, entry->bytes) == 1) {
+      entry->family = AF_INET6;
+    } else {
+      ok = false;
+      break;
+    }
+    count++;
+  }
+  fclose(file);
+
+  if (ok && count > 0) {
+    qsort(entries, count, sizeof(*entries), bench_entry_compare);
+    uint32_t kept = 1;
+    for (uint32_t i = 1; i < count; i++) {
+      if (entries[i].family != entries[kept - 1].family ||
+          memcmp(entries[i].bytes, entries[kept - 1].bytes,
+                 sizeof(entries[i].bytes)) != 0) {
+        entries[kept++] = entries[i];
+      }
+    }
+    count = kept;
+  }
+  free(entries);
+  *out_count = count;
+  return ok;
+}
+
+static bool bench_run(uint32_t lines, unsigned rounds) {
+  char path[] = "/tmp/openups-target-bench-XXXXXX";
+  if (!bench_write_list(path, lines)) {
+    fprintf(stderr, "target_list_bench: cannot write %s\n", path);
+    return false;
+  }
+
+  uint64_t best_libc_us = UINT64_MAX;
+  uint64_t best_fast_us = UINT64_MAX;
+  uint32_t libc_count = 0;
+  uint32_t fast_count = 0;
+  char error_msg[256] = "";
+  bool ok = true;
+  for (unsigned round = 0; ok && round < rounds; round++) {
+    uint64_t start_us = get_monotonic_us();
+    ok = bench_load_libc(path, &libc_count);
+    uint64_t elapsed_us = get_monotonic_us() - start_us;
+    best_libc_us = elapsed_us < best_libc_us ? elapsed_us : best_libc_us;
+
+    target_list_t list;
+    start_us = get_monotonic_us();
+    ok = ok && target_list_load(&list, path, UINT32_MAX, error_msg,
+                                sizeof(error_msg));
+    elapsed_us = get_monotonic_us() - start_us;
+    best_fast_us = elapsed_us < best_fast_us ? elapsed_us : best_fast_us;
+    if (ok) {
+      fast_count = list.count;
+      bench_sink += list.entries[list.count / 2].bytes[3];
+      target_list_free(&list);
+    }
+  }
+  unlink(path);
+  if (!ok || libc_count != fast_count) {
+    fprintf(stderr, "target_list_bench: %s (libc %" PRIu32 ", fast %" PRIu32
+                    " unique)\n",
+            error_msg, libc_count, fast_count);
+    return false;
+  }
+
+  double libc_ms = (double)best_libc_us / 1000.0;
+  double fast_ms = (double)best_fast_us / 1000.0;
+  printf("%9" PRIu32 " %9" PRIu32 " %10.1f %10.1f %9.1fx\n", lines, fast_count,
+         libc_ms, fast_ms, fast_ms > 0 ? libc_ms / fast_ms : 0.0);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  static const uint32_t default_lines[] = {1000000};
+  const char *rounds_env = getenv("BENCH_ROUNDS");
+  unsigned rounds = rounds_env != NULL && atoi(rounds_env) > 0
+                        ? (unsigned)atoi(rounds_env)
+                        : 5U;
+
+  printf("target_list_bench: best of %u loads, 1/8 IPv6, ~1%% repeats\n",
+         rounds);
+  printf("%9s %9s %10s %10s %10s\n", "lines", "unique", "libc_ms", "fast_ms",
+         "speedup");
+  size_t runs = argc > 1 ? (size_t)(argc - 1)
+                         : sizeof(default_lines) / sizeof(default_lines[0]);
+  for (size_t i = 0; i < runs; i++) {
+    uint32_t lines = argc > 1 ? (uint32_t)strtoul(argv[i + 1], NULL, 10)
+                              : default_lines[i];
+    if (lines == 0 || !bench_run(lines, rounds)) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include "openups.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+bool arena_init(arena_t *restrict arena, size_t capacity,
+                char *restrict error_msg, size_t error_size) {
+  if (arena == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+
+  arena->base = NULL;
+  arena->capacity = 0;
+  arena->used = 0;
+  if (capacity == 0) {
+    snprintf(error_msg, error_size, "Arena size must be positive");
+    return false;
+  }
+
+  /* MAP_POPULATE charges the whole region against MemoryMax now, so an
+   * undersized limit fails at startup instead of on a later page fault. */
+  void *base = mmap(NULL, capacity, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (base == MAP_FAILED) {
+    snprintf(error_msg, error_size, "Failed to reserve %zu byte arena: %s",
+             capacity, strerror(errno));
+    return false;
+  }
+  arena->base = base;
+  arena->capacity = capacity;
+  return true;
+}
+
+/* Returns zeroed memory (fresh anonymous pages are never reused), or NULL
+ * when the request overflows or the arena is exhausted.  align must be a
+ * power of two. */
+void *arena_alloc(arena_t *restrict arena, size_t count, size_t size,
+                  size_t align) {
+  if (arena == NULL || arena->base == NULL || align == 0 ||
+      (align & (align - 1)) != 0) {
+    return NULL;
+  }
+
+  size_t bytes;
+  size_t offset;
+  size_t end;
+  uintptr_t address = (uintptr_t)arena->base + arena->used;
+  size_t padding = (size_t)(-address & (uintptr_t)(align - 1));
+  if (ckd_mul(&bytes, count, size) ||
+      ckd_add(&offset, arena->used, padding) ||
+      ckd_add(&end, offset, bytes) || end > arena->capacity) {
+    return NULL;
+  }
+  arena->used = end;
+  return arena->base + offset;
+}
+
+void arena_destroy(arena_t *restrict arena) {
+  if (arena == NULL) {
+    return;
+  }
+
+  if (arena->base != NULL) {
+    munmap(arena->base, arena->capacity);
+  }
+  arena->base = NULL;
+  arena->capacity = 0;
+  arena->used = 0;
+}
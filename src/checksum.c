@@ -0,0 +1,250 @@
+#include "openups.h"
+
+#include <stdatomic.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CHECKSUM_HAVE_X86 1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CHECKSUM_HAVE_NEON 1
+#endif
+
+/* The vector kernels add 16-bit words into 32-bit lanes; each lane takes at
+ * most two words per block, so the lanes are widened to 64 bits at least
+ * every CHECKSUM_FLUSH_BLOCKS blocks, before they could wrap. */
+#define CHECKSUM_FLUSH_BLOCKS 32768U
+/* Below this many bytes the vector setup and reduction cost more than the
+ * scalar loop saves (see bench/checksum_bench.c). */
+#define CHECKSUM_VECTOR_MIN_LEN 256U
+
+typedef uint64_t (*checksum_sum_fn)(const uint8_t *data, size_t blocks);
+
+/* One's-complement addition is independent of byte order and word width,
+ * so any wide sum of native 16-bit words folds to the RFC 1071 result. */
+static uint16_t checksum_fold(uint64_t sum) {
+  sum = (sum & UINT64_C(0xFFFFFFFF)) + (sum >> 32);
+  sum = (sum & UINT64_C(0xFFFFFFFF)) + (sum >> 32);
+  sum = (sum & 0xFFFFU) + (sum >> 16);
+  sum = (sum & 0xFFFFU) + (sum >> 16);
+  return (uint16_t)~sum;
+}
+
+/* Native-order words, as the kernel verifies them; an odd trailing byte is
+ * padded with zero on the right. */
+static uint64_t checksum_sum_scalar(const uint8_t *data, size_t len) {
+  uint64_t sum = 0;
+  size_t i = 0;
+  for (; i + 1 < len; i += 2) {
+    uint16_t word;
+    memcpy(&word, data + i, sizeof(word));
+    sum += word;
+  }
+  if (i < len) {
+    uint16_t word = 0;
+    memcpy(&word, data + i, 1);
+    sum += word;
+  }
+  return sum;
+}
+
+#ifdef CHECKSUM_HAVE_X86
+/* 16-byte blocks viewed as 32-bit lanes: the low and the high word of each
+ * lane go to separate accumulators (AND and shift are cheaper than
+ * unpacks), two blocks per iteration for independent add chains. */
+__attribute__((target("sse2"))) static uint64_t
+checksum_sum_sse2(const uint8_t *data, size_t blocks) {
+  const __m128i low_words = _mm_set1_epi32(0xFFFF);
+  const __m128i low_dwords = _mm_set_epi32(0, -1, 0, -1);
+  uint64_t total = 0;
+  while (blocks > 0) {
+    size_t run =
+        blocks < CHECKSUM_FLUSH_BLOCKS ? blocks : CHECKSUM_FLUSH_BLOCKS;
+    blocks -= run;
+    __m128i lo0 = _mm_setzero_si128();
+    __m128i hi0 = _mm_setzero_si128();
+    __m128i lo1 = _mm_setzero_si128();
+    __m128i hi1 = _mm_setzero_si128();
+    for (; run >= 2; run -= 2, data += 32) {
+      __m128i v0 = _mm_loadu_si128((const __m128i *)data);
+      __m128i v1 = _mm_loadu_si128((const __m128i *)(data + 16));
+      lo0 = _mm_add_epi32(lo0, _mm_and_si128(v0, low_words));
+      hi0 = _mm_add_epi32(hi0, _mm_srli_epi32(v0, 16));
+      lo1 = _mm_add_epi32(lo1, _mm_and_si128(v1, low_words));
+      hi1 = _mm_add_epi32(hi1, _mm_srli_epi32(v1, 16));
+    }
+    if (run > 0) {
+      __m128i v0 = _mm_loadu_si128((const __m128i *)data);
+      lo0 = _mm_add_epi32(lo0, _mm_and_si128(v0, low_words));
+      hi0 = _mm_add_epi32(hi0, _mm_srli_epi32(v0, 16));
+      data += 16;
+    }
+    /* Each lane holds at most 2 * CHECKSUM_FLUSH_BLOCKS words after the
+     * pairwise adds; widen to 64 bits before the final reduction. */
+    __m128i acc0 = _mm_add_epi32(lo0, hi0);
+    __m128i acc1 = _mm_add_epi32(lo1, hi1);
+    __m128i wide = _mm_add_epi64(_mm_add_epi64(_mm_and_si128(acc0, low_dwords),
+                                               _mm_srli_epi64(acc0, 32)),
+                                 _mm_add_epi64(_mm_and_si128(acc1, low_dwords),
+                                               _mm_srli_epi64(acc1, 32)));
+    total += (uint64_t)_mm_cvtsi128_si64(wide) +
+             (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(wide, wide));
+  }
+  return total;
+}
+
+/* The same scheme on 32-byte blocks. */
+__attribute__((target("avx2"))) static uint64_t
+checksum_sum_avx2(const uint8_t *data, size_t blocks) {
+  const __m256i low_words = _mm256_set1_epi32(0xFFFF);
+  const __m256i low_dwords = _mm256_set1_epi64x(0xFFFFFFFF);
+  uint64_t total = 0;
+  while (blocks > 0) {
+    size_t run =
+        blocks < CHECKSUM_FLUSH_BLOCKS ? blocks : CHECKSUM_FLUSH_BLOCKS;
+    blocks -= run;
+    __m256i lo0 = _mm256_setzero_si256();
+    __m256i hi0 = _mm256_setzero_si256();
+    __m256i lo1 = _mm256_setzero_si256();
+    __m256i hi1 = _mm256_setzero_si256();
+    for (; run >= 2; run -= 2, data += 64) {
+      __m256i v0 = _mm256_loadu_si256((const __m256i *)data);
+      __m256i v1 = _mm256_loadu_si256((const __m256i *)(data + 32));
+      lo0 = _mm256_add_epi32(lo0, _mm256_and_si256(v0, low_words));
+      hi0 = _mm256_add_epi32(hi0, _mm256_srli_epi32(v0, 16));
+      lo1 = _mm256_add_epi32(lo1, _mm256_and_si256(v1, low_words));
+      hi1 = _mm256_add_epi32(hi1, _mm256_srli_epi32(v1, 16));
+    }
+    if (run > 0) {
+      __m256i v0 = _mm256_loadu_si256((const __m256i *)data);
+      lo0 = _mm256_add_epi32(lo0, _mm256_and_si256(v0, low_words));
+      hi0 = _mm256_add_epi32(hi0, _mm256_srli_epi32(v0, 16));
+      data += 32;
+    }
+    __m256i acc0 = _mm256_add_epi32(lo0, hi0);
+    __m256i acc1 = _mm256_add_epi32(lo1, hi1);
+    __m256i wide = _mm256_add_epi64(
+        _mm256_add_epi64(_mm256_and_si256(acc0, low_dwords),
+                         _mm256_srli_epi64(acc0, 32)),
+        _mm256_add_epi64(_mm256_and_si256(acc1, low_dwords),
+                         _mm256_srli_epi64(acc1, 32)));
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(wide),
+                                 _mm256_extracti128_si256(wide, 1));
+    total += (uint64_t)_mm_cvtsi128_si64(half) +
+             (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half));
+  }
+  return total;
+}
+#endif
+
+#ifdef CHECKSUM_HAVE_NEON
+/* 16-byte blocks: pairwise add-accumulate words into 32-bit lanes. */
+static uint64_t checksum_sum_neon(const uint8_t *data, size_t blocks) {
+  uint64_t total = 0;
+  while (blocks > 0) {
+    size_t run =
+        blocks < CHECKSUM_FLUSH_BLOCKS ? blocks : CHECKSUM_FLUSH_BLOCKS;
+    blocks -= run;
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; run > 0; run--, data += 16) {
+      acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(data)));
+    }
+    total += vaddlvq_u32(acc);
+  }
+  return total;
+}
+#endif
+
+typedef struct {
+  const char *name;
+  checksum_sum_fn sum; /* NULL for the scalar loop */
+  size_t block;
+} checksum_kernel_info_t;
+
+static const checksum_kernel_info_t CHECKSUM_KERNELS[CHECKSUM_KERNEL_COUNT] = {
+    [CHECKSUM_KERNEL_SCALAR] = {"scalar", NULL, 0},
+#ifdef CHECKSUM_HAVE_X86
+    [CHECKSUM_KERNEL_SSE2] = {"sse2", checksum_sum_sse2, 16},
+    [CHECKSUM_KERNEL_AVX2] = {"avx2", checksum_sum_avx2, 32},
+#else
+    [CHECKSUM_KERNEL_SSE2] = {"sse2", NULL, 0},
+    [CHECKSUM_KERNEL_AVX2] = {"avx2", NULL, 0},
+#endif
+#ifdef CHECKSUM_HAVE_NEON
+    [CHECKSUM_KERNEL_NEON] = {"neon", checksum_sum_neon, 16},
+#else
+    [CHECKSUM_KERNEL_NEON] = {"neon", NULL, 0},
+#endif
+};
+
+bool checksum_kernel_supported(checksum_kernel_t kernel) {
+  switch (kernel) {
+  case CHECKSUM_KERNEL_SCALAR:
+    return true;
+#ifdef CHECKSUM_HAVE_X86
+  case CHECKSUM_KERNEL_SSE2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+  case CHECKSUM_KERNEL_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+#ifdef CHECKSUM_HAVE_NEON
+  case CHECKSUM_KERNEL_NEON:
+    return true; /* mandatory on AArch64 */
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *checksum_kernel_name(checksum_kernel_t kernel) {
+  return (unsigned)kernel < CHECKSUM_KERNEL_COUNT
+             ? CHECKSUM_KERNELS[kernel].name
+             : "unknown";
+}
+
+checksum_kernel_t checksum_kernel_select(void) {
+  static const checksum_kernel_t preference[] = {
+      CHECKSUM_KERNEL_AVX2, CHECKSUM_KERNEL_NEON, CHECKSUM_KERNEL_SSE2};
+  for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+    if (checksum_kernel_supported(preference[i])) {
+      return preference[i];
+    }
+  }
+  return CHECKSUM_KERNEL_SCALAR;
+}
+
+/* Whole blocks go through the vector kernel, the tail (always starting at
+ * an even offset, so word pairing is kept) through the scalar loop. */
+uint16_t checksum_compute(checksum_kernel_t kernel, const void *data,
+                          size_t len) {
+  const uint8_t *bytes = data;
+  const checksum_kernel_info_t *info =
+      (unsigned)kernel < CHECKSUM_KERNEL_COUNT ? &CHECKSUM_KERNELS[kernel]
+                                               : &CHECKSUM_KERNELS[0];
+  uint64_t sum = 0;
+  if (info->sum != NULL && len >= info->block) {
+    size_t blocks = len / info->block;
+    sum = info->sum(bytes, blocks);
+    bytes += blocks * info->block;
+    len -= blocks * info->block;
+  }
+  return checksum_fold(sum + checksum_sum_scalar(bytes, len));
+}
+
+/* -1 until the first checksum; every thread resolves to the same value. */
+static atomic_int checksum_active = -1;
+
+uint16_t icmp_checksum(const void *data, size_t len) {
+  int kernel = atomic_load_explicit(&checksum_active, memory_order_relaxed);
+  if (OPENUPS_UNLIKELY(kernel < 0)) {
+    kernel = (int)checksum_kernel_select();
+    atomic_store_explicit(&checksum_active, kernel, memory_order_relaxed);
+  }
+  if (len < CHECKSUM_VECTOR_MIN_LEN) {
+    kernel = CHECKSUM_KERNEL_SCALAR;
+  }
+  return checksum_compute((checksum_kernel_t)kernel, data, len);
+}
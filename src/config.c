@@ -18,6 +18,19 @@
 #define OPENUPS_DEFAULT_DELAY_MINUTES  0
 #define OPENUPS_MAX_DELAY_MINUTES      (365 * 24 * 60)
 #define OPENUPS_DEFAULT_SYSTEMD        true
+#define OPENUPS_DEFAULT_NETLINK        true
+#define OPENUPS_DEFAULT_PMTU           false
+#define OPENUPS_DEFAULT_HOPS           true
+#define OPENUPS_MAX_PORT               65535
+#define OPENUPS_CONFIG_FILE_MAX_ENTRIES 32U
+#define OPENUPS_CONFIG_VALUE_MAX       256U
+#define OPENUPS_MAX_FLEET_WORKERS      8 /* TasksMax=10: workers + main + shutdown */
+#define OPENUPS_DEFAULT_SWEEP_RATE     1000
+#define OPENUPS_MAX_SWEEP_RATE         100000
+#define OPENUPS_MAX_TIMER_SLACK_MS     60000
+#define OPENUPS_DEFAULT_LOW_LATENCY    false
+#define OPENUPS_MAX_CPU                1023 /* CPU_SETSIZE - 1 */
+#define OPENUPS_MAX_RT_PRIORITY        99
 
 /* ---- Option tables ---- */
 
@@ -31,21 +44,44 @@ typedef struct {
   shutdown_mode_t mode;
 } config_shutdown_mode_option_t;
 
+typedef struct {
+  const char *name;
+  probe_kind_t kind;
+} config_probe_kind_option_t;
+
 static const struct option CONFIG_LONG_OPTIONS[] = {
     {"target",        required_argument, 0, 't'},
     {"interval",      required_argument, 0, 'i'},
     {"threshold",     required_argument, 0, 'n'},
     {"timeout",       required_argument, 0, 'w'},
+    {"probe",         required_argument, 0, 'P'},
+    {"port",          required_argument, 0, 'p'},
+    {"payload-size",  required_argument, 0, 'z'},
     {"shutdown-mode", required_argument, 0, 'S'},
     {"delay",         required_argument, 0, 'D'},
     {"log-level",     required_argument, 0, 'L'},
     {"systemd",       optional_argument, 0, 'M'},
+    {"netlink",       optional_argument, 0, 'N'},
+    {"pmtu",          optional_argument, 0, 'm'},
+    {"hops",          optional_argument, 0, 'H'},
+    {"config",        required_argument, 0, 'c'},
+    {"state-file",    required_argument, 0, 'F'},
+    {"targets",       required_argument, 0, 'T'},
+    {"workers",       required_argument, 0, 'W'},
+    {"packet-ring",   optional_argument, 0, 'R'},
+    {"sweep",         required_argument, 0, 's'},
+    {"rate",          required_argument, 0, 'r'},
+    {"shadow",        required_argument, 0, 'X'},
+    {"timer-slack",   required_argument, 0, 'k'},
+    {"low-latency",   optional_argument, 0, 'l'},
+    {"cpu",           required_argument, 0, 'C'},
+    {"rt-priority",   required_argument, 0, 'Y'},
     {"version",       no_argument,       0, 'v'},
     {"help",          no_argument,       0, 'h'},
     {0, 0, 0, 0},
 };
 
-static const char *const CONFIG_OPTSTRING = "t:i:n:w:S:D:L:M::vh";
+static const char *const CONFIG_OPTSTRING = "t:i:n:w:P:p:z:S:D:L:M::N::m::H::c:F:T:W:R::s:r:X:k:l::C:Y:vh";
 
 static const config_log_level_option_t CONFIG_LOG_LEVEL_OPTIONS[] = {
   {"silent", LOG_LEVEL_SILENT},
@@ -62,6 +98,12 @@ static const config_shutdown_mode_option_t CONFIG_SHUTDOWN_MODE_OPTIONS[] = {
   {"log-only", SHUTDOWN_MODE_LOG_ONLY},
 };
 
+static const config_probe_kind_option_t CONFIG_PROBE_KIND_OPTIONS[] = {
+  {"icmp", PROBE_KIND_ICMP},
+  {"tcp",  PROBE_KIND_TCP},
+  {"udp",  PROBE_KIND_UDP},
+};
+
 /* ---- Shared helpers ---- */
 
 static bool set_error(char *restrict error_msg, size_t error_size,
@@ -85,6 +127,18 @@ static bool string_equals_ignore_case(const char *restrict lhs,
   return lhs != NULL && rhs != NULL && strcasecmp(lhs, rhs) == 0;
 }
 
+static char *config_trim(char *restrict text) {
+  while (*text == ' ' || *text == '\t') {
+    text++;
+  }
+  size_t len = strlen(text);
+  while (len > 0 && (text[len - 1] == ' ' || text[len - 1] == '\t' ||
+                     text[len - 1] == '\n' || text[len - 1] == '\r')) {
+    text[--len] = '\0';
+  }
+  return text;
+}
+
 static bool copy_string_value(char *restrict dest, size_t dest_size,
                               const char *restrict src,
                               const char *restrict name,
@@ -247,14 +301,179 @@ static bool parse_cmdline_shutdown_mode_option(
   return true;
 }
 
-static bool load_env_int(const char *restrict env_name,
+static bool probe_kind_parse_internal(const char *restrict str,
+                                      probe_kind_t *restrict out_kind) {
+  if (str == NULL || out_kind == NULL) {
+    return false;
+  }
+  for (size_t i = 0;
+       i < sizeof(CONFIG_PROBE_KIND_OPTIONS) /
+               sizeof(CONFIG_PROBE_KIND_OPTIONS[0]);
+       i++) {
+    if (string_equals_ignore_case(str, CONFIG_PROBE_KIND_OPTIONS[i].name)) {
+      *out_kind = CONFIG_PROBE_KIND_OPTIONS[i].kind;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool parse_cmdline_probe_kind_option(const char *restrict option_name,
+                                            const char *restrict arg,
+                                            probe_kind_t *restrict out_kind,
+                                            char *restrict error_msg,
+                                            size_t error_size) {
+  if (option_name == NULL || out_kind == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return false;
+  }
+  if (!probe_kind_parse_internal(arg, out_kind)) {
+    return set_error(error_msg, error_size,
+                     "Invalid value for %s: %s (use icmp|tcp|udp)",
+                     option_name, optarg_or_empty(arg));
+  }
+  return true;
+}
+
+/* One shadow policy: "threshold=5,window=8,delay=2,mode=true-off".
+ * threshold is required; window defaults to it (consecutive failures),
+ * delay to 0 and mode to dry-run.  Ranges are left to config_validate(). */
+static bool parse_shadow_policy(const char *restrict spec,
+                                shadow_policy_t *restrict out,
+                                char *restrict error_msg, size_t error_size) {
+  char buffer[OPENUPS_CONFIG_VALUE_MAX];
+  if (!copy_string_value(buffer, sizeof(buffer), spec, "Shadow policy",
+                         error_msg, error_size)) {
+    return false;
+  }
+  *out = (shadow_policy_t){.mode = SHUTDOWN_MODE_DRY_RUN};
+  char *field = buffer;
+  while (field != NULL) {
+    char *next = strchr(field, ',');
+    if (next != NULL) {
+      *next++ = '\0';
+    }
+    char *equals = strchr(field, '=');
+    if (equals == NULL) {
+      return set_error(error_msg, error_size,
+                       "Invalid shadow policy '%s': expected key=value", spec);
+    }
+    *equals = '\0';
+    const char *key = config_trim(field);
+    const char *value = config_trim(equals + 1);
+    bool ok = true;
+    if (strcmp(key, "threshold") == 0) {
+      ok = parse_int_value(value, 1, INT_MAX, &out->threshold);
+    } else if (strcmp(key, "window") == 0) {
+      ok = parse_int_value(value, 1, INT_MAX, &out->window);
+    } else if (strcmp(key, "delay") == 0) {
+      ok = parse_int_value(value, 0, INT_MAX, &out->delay_minutes);
+    } else if (strcmp(key, "mode") == 0) {
+      ok = shutdown_mode_parse_internal(value, &out->mode);
+    } else {
+      return set_error(error_msg, error_size,
+                       "Invalid shadow policy '%s': unknown key %s "
+                       "(use threshold|window|delay|mode)",
+                       spec, key);
+    }
+    if (!ok) {
+      return set_error(error_msg, error_size,
+                       "Invalid shadow policy '%s': bad %s", spec, key);
+    }
+    field = next;
+  }
+  if (out->threshold == 0) {
+    return set_error(error_msg, error_size,
+                     "Invalid shadow policy '%s': threshold is required", spec);
+  }
+  if (out->window == 0) {
+    out->window = out->threshold;
+  }
+  return true;
+}
+
+/* Appends the ';'-separated policies in text. */
+static bool parse_shadow_policies(config_t *restrict config,
+                                  const char *restrict text,
+                                  char *restrict error_msg,
+                                  size_t error_size) {
+  char buffer[OPENUPS_CONFIG_VALUE_MAX];
+  if (!copy_string_value(buffer, sizeof(buffer), text, "Shadow policies",
+                         error_msg, error_size)) {
+    return false;
+  }
+  char *spec = buffer;
+  while (spec != NULL) {
+    char *next = strchr(spec, ';');
+    if (next != NULL) {
+      *next++ = '\0';
+    }
+    if (config->shadow_count >= OPENUPS_MAX_SHADOW_POLICIES) {
+      return set_error(error_msg, error_size,
+                       "Too many shadow policies (max %d)",
+                       OPENUPS_MAX_SHADOW_POLICIES);
+    }
+    if (!parse_shadow_policy(spec, &config->shadows[config->shadow_count],
+                             error_msg, error_size)) {
+      return false;
+    }
+    config->shadow_count++;
+    spec = next;
+  }
+  return true;
+}
+
+/* ---- Value sources: process environment or a KEY=VALUE config file ---- */
+
+static const char *const CONFIG_SOURCE_KEYS[] = {
+    "OPENUPS_TARGET",        "OPENUPS_INTERVAL",  "OPENUPS_THRESHOLD",
+    "OPENUPS_TIMEOUT",       "OPENUPS_PROBE",     "OPENUPS_PORT",
+    "OPENUPS_SHUTDOWN_MODE", "OPENUPS_DELAY_MINUTES", "OPENUPS_LOG_LEVEL",
+    "OPENUPS_SYSTEMD",       "OPENUPS_NETLINK",   "OPENUPS_STATE_FILE",
+    "OPENUPS_TARGETS",       "OPENUPS_WORKERS",   "OPENUPS_PACKET_RING",
+    "OPENUPS_PAYLOAD_SIZE",  "OPENUPS_PMTU",      "OPENUPS_HOPS",
+    "OPENUPS_SHADOW",        "OPENUPS_TIMER_SLACK", "OPENUPS_LOW_LATENCY",
+    "OPENUPS_CPU",           "OPENUPS_RT_PRIORITY",
+};
+
+typedef struct {
+  char name[32];
+  char value[OPENUPS_CONFIG_VALUE_MAX];
+} config_file_entry_t;
+
+typedef struct {
+  config_file_entry_t entries[OPENUPS_CONFIG_FILE_MAX_ENTRIES];
+  size_t count;
+} config_file_t;
+
+/* file == NULL reads the process environment. */
+typedef struct {
+  const config_file_t *file;
+} config_source_t;
+
+static const char *config_source_get(const config_source_t *restrict source,
+                                     const char *restrict name) {
+  if (source == NULL || source->file == NULL) {
+    return getenv(name);
+  }
+  /* Later assignments override earlier ones, as in a shell. */
+  for (size_t i = source->file->count; i > 0; i--) {
+    if (strcmp(source->file->entries[i - 1].name, name) == 0) {
+      return source->file->entries[i - 1].value;
+    }
+  }
+  return NULL;
+}
+
+static bool load_env_int(const config_source_t *restrict source,
+                         const char *restrict env_name,
                          const char *restrict label, int min_value,
                          int max_value, int *restrict out_value,
                          char *restrict error_msg, size_t error_size) {
   if (env_name == NULL || label == NULL || out_value == NULL) {
     return false;
   }
-  const char *value = getenv(env_name);
+  const char *value = config_source_get(source, env_name);
   if (value == NULL) {
     return true;
   }
@@ -268,14 +487,15 @@ static bool load_env_int(const char *restrict env_name,
   return true;
 }
 
-static bool load_env_bool(const char *restrict env_name,
+static bool load_env_bool(const config_source_t *restrict source,
+                          const char *restrict env_name,
                           const char *restrict label,
                           bool *restrict out_value,
                           char *restrict error_msg, size_t error_size) {
   if (env_name == NULL || label == NULL || out_value == NULL) {
     return false;
   }
-  const char *value = getenv(env_name);
+  const char *value = config_source_get(source, env_name);
   if (value == NULL) {
     return true;
   }
@@ -288,14 +508,15 @@ static bool load_env_bool(const char *restrict env_name,
   return true;
 }
 
-static bool load_env_shutdown_mode(const char *restrict env_name,
+static bool load_env_shutdown_mode(const config_source_t *restrict source,
+                                   const char *restrict env_name,
                                    shutdown_mode_t *restrict out_value,
                                    char *restrict error_msg,
                                    size_t error_size) {
   if (env_name == NULL || out_value == NULL) {
     return false;
   }
-  const char *value = getenv(env_name);
+  const char *value = config_source_get(source, env_name);
   if (value == NULL) {
     return true;
   }
@@ -307,13 +528,33 @@ static bool load_env_shutdown_mode(const char *restrict env_name,
   return true;
 }
 
-static bool load_env_log_level(const char *restrict env_name,
+static bool load_env_probe_kind(const config_source_t *restrict source,
+                                const char *restrict env_name,
+                                probe_kind_t *restrict out_value,
+                                char *restrict error_msg, size_t error_size) {
+  if (env_name == NULL || out_value == NULL) {
+    return false;
+  }
+  const char *value = config_source_get(source, env_name);
+  if (value == NULL) {
+    return true;
+  }
+  if (!probe_kind_parse_internal(value, out_value)) {
+    return set_error(error_msg, error_size,
+                     "Invalid value for %s: %s (use icmp|tcp|udp)",
+                     env_name, value);
+  }
+  return true;
+}
+
+static bool load_env_log_level(const config_source_t *restrict source,
+                               const char *restrict env_name,
                                log_level_t *restrict out_value,
                                char *restrict error_msg, size_t error_size) {
   if (env_name == NULL || out_value == NULL) {
     return false;
   }
-  const char *value = getenv(env_name);
+  const char *value = config_source_get(source, env_name);
   if (value == NULL) {
     return true;
   }
@@ -325,24 +566,42 @@ static bool load_env_log_level(const char *restrict env_name,
   return true;
 }
 
-static bool load_env_int_options(config_t *restrict config,
+static bool load_env_int_options(const config_source_t *restrict source,
+                                 config_t *restrict config,
                                  char *restrict error_msg, size_t error_size) {
   if (config == NULL || error_msg == NULL || error_size == 0) {
     return false;
   }
-  return load_env_int("OPENUPS_INTERVAL",      "OPENUPS_INTERVAL",      1, INT_MAX, &config->interval_sec,   error_msg, error_size) &&
-         load_env_int("OPENUPS_THRESHOLD",     "OPENUPS_THRESHOLD",     1, INT_MAX, &config->fail_threshold, error_msg, error_size) &&
-         load_env_int("OPENUPS_TIMEOUT",       "OPENUPS_TIMEOUT",       1, INT_MAX, &config->timeout_ms,     error_msg, error_size) &&
-         load_env_int("OPENUPS_DELAY_MINUTES", "OPENUPS_DELAY_MINUTES", 0, INT_MAX, &config->delay_minutes,  error_msg, error_size);
+  return load_env_int(source, "OPENUPS_INTERVAL",      "OPENUPS_INTERVAL",      1, INT_MAX, &config->interval_sec,   error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_THRESHOLD",     "OPENUPS_THRESHOLD",     1, INT_MAX, &config->fail_threshold, error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_TIMEOUT",       "OPENUPS_TIMEOUT",       1, INT_MAX, &config->timeout_ms,     error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_PORT",          "OPENUPS_PORT",          1, OPENUPS_MAX_PORT, &config->probe_port, error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_PAYLOAD_SIZE",  "OPENUPS_PAYLOAD_SIZE",  0, OPENUPS_MAX_PAYLOAD_SIZE, &config->payload_size, error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_DELAY_MINUTES", "OPENUPS_DELAY_MINUTES", 0, INT_MAX, &config->delay_minutes,  error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_WORKERS",       "OPENUPS_WORKERS",       0, OPENUPS_MAX_FLEET_WORKERS, &config->workers, error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_TIMER_SLACK",   "OPENUPS_TIMER_SLACK",   0, OPENUPS_MAX_TIMER_SLACK_MS, &config->timer_slack_ms, error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_CPU",           "OPENUPS_CPU",           -1, OPENUPS_MAX_CPU, &config->cpu, error_msg, error_size) &&
+         load_env_int(source, "OPENUPS_RT_PRIORITY",   "OPENUPS_RT_PRIORITY",   0, OPENUPS_MAX_RT_PRIORITY, &config->rt_priority, error_msg, error_size);
 }
 
-static bool load_env_bool_options(config_t *restrict config,
+static bool load_env_bool_options(const config_source_t *restrict source,
+                                  config_t *restrict config,
                                   char *restrict error_msg, size_t error_size) {
   if (config == NULL || error_msg == NULL || error_size == 0) {
     return false;
   }
-  return load_env_bool("OPENUPS_SYSTEMD", "OPENUPS_SYSTEMD",
-                       &config->enable_systemd, error_msg, error_size);
+  return load_env_bool(source, "OPENUPS_SYSTEMD", "OPENUPS_SYSTEMD",
+                       &config->enable_systemd, error_msg, error_size) &&
+         load_env_bool(source, "OPENUPS_NETLINK", "OPENUPS_NETLINK",
+                       &config->enable_netlink, error_msg, error_size) &&
+         load_env_bool(source, "OPENUPS_PMTU", "OPENUPS_PMTU",
+                       &config->enable_pmtu, error_msg, error_size) &&
+         load_env_bool(source, "OPENUPS_HOPS", "OPENUPS_HOPS",
+                       &config->enable_hops, error_msg, error_size) &&
+         load_env_bool(source, "OPENUPS_PACKET_RING", "OPENUPS_PACKET_RING",
+                       &config->packet_ring, error_msg, error_size) &&
+         load_env_bool(source, "OPENUPS_LOW_LATENCY", "OPENUPS_LOW_LATENCY",
+                       &config->low_latency, error_msg, error_size);
 }
 
 /* ---- Public API: init / env / cmdline ---- */
@@ -357,36 +616,180 @@ void config_init_default(config_t *restrict config) {
   config->interval_sec   = OPENUPS_DEFAULT_INTERVAL_SEC;
   config->fail_threshold = OPENUPS_DEFAULT_FAIL_THRESHOLD;
   config->timeout_ms     = OPENUPS_DEFAULT_TIMEOUT_MS;
+  config->probe_kind     = PROBE_KIND_ICMP;
+  config->probe_port     = 0;
+  config->payload_size   = OPENUPS_DEFAULT_PAYLOAD_SIZE;
   config->shutdown_mode  = SHUTDOWN_MODE_DRY_RUN;
   config->delay_minutes  = OPENUPS_DEFAULT_DELAY_MINUTES;
   config->log_level      = LOG_LEVEL_INFO;
   config->enable_systemd = OPENUPS_DEFAULT_SYSTEMD;
+  config->enable_netlink = OPENUPS_DEFAULT_NETLINK;
+  config->enable_pmtu    = OPENUPS_DEFAULT_PMTU;
+  config->enable_hops    = OPENUPS_DEFAULT_HOPS;
+  config->sweep_rate     = OPENUPS_DEFAULT_SWEEP_RATE;
+  config->low_latency    = OPENUPS_DEFAULT_LOW_LATENCY;
+  config->cpu            = -1;
 }
 
-bool config_load_from_env(config_t *restrict config, char *restrict error_msg,
-                          size_t error_size) {
+static bool config_load_from_source(config_t *restrict config,
+                                    const config_source_t *restrict source,
+                                    char *restrict error_msg,
+                                    size_t error_size) {
   if (config == NULL || error_msg == NULL || error_size == 0) {
     return false;
   }
   error_msg[0] = '\0';
-  const char *value = getenv("OPENUPS_TARGET");
+  const char *value = config_source_get(source, "OPENUPS_TARGET");
   if (value != NULL &&
       !copy_string_value(config->target, sizeof(config->target), value,
                          "OPENUPS_TARGET", error_msg, error_size)) {
     return false;
   }
-  if (!load_env_int_options(config, error_msg, error_size) ||
-      !load_env_bool_options(config, error_msg, error_size)) {
+  value = config_source_get(source, "OPENUPS_STATE_FILE");
+  if (value != NULL &&
+      !copy_string_value(config->state_file, sizeof(config->state_file), value,
+                         "OPENUPS_STATE_FILE", error_msg, error_size)) {
+    return false;
+  }
+  value = config_source_get(source, "OPENUPS_TARGETS");
+  if (value != NULL &&
+      !copy_string_value(config->targets_file, sizeof(config->targets_file),
+                         value, "OPENUPS_TARGETS", error_msg, error_size)) {
+    return false;
+  }
+  if (!load_env_int_options(source, config, error_msg, error_size) ||
+      !load_env_bool_options(source, config, error_msg, error_size)) {
     return false;
   }
-  if (!load_env_shutdown_mode("OPENUPS_SHUTDOWN_MODE", &config->shutdown_mode,
-                              error_msg, error_size)) {
+  if (!load_env_probe_kind(source, "OPENUPS_PROBE", &config->probe_kind,
+                           error_msg, error_size)) {
     return false;
   }
-  if (!load_env_log_level("OPENUPS_LOG_LEVEL", &config->log_level,
+  if (!load_env_shutdown_mode(source, "OPENUPS_SHUTDOWN_MODE",
+                              &config->shutdown_mode, error_msg, error_size)) {
+    return false;
+  }
+  if (!load_env_log_level(source, "OPENUPS_LOG_LEVEL", &config->log_level,
                           error_msg, error_size)) {
     return false;
   }
+  value = config_source_get(source, "OPENUPS_SHADOW");
+  if (value != NULL) {
+    config->shadow_count = 0;
+    if (!parse_shadow_policies(config, value, error_msg, error_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool config_load_from_env(config_t *restrict config, char *restrict error_msg,
+                          size_t error_size) {
+  const config_source_t source = {.file = NULL};
+  return config_load_from_source(config, &source, error_msg, error_size);
+}
+
+static bool config_source_key_known(const char *restrict name) {
+  for (size_t i = 0; i < sizeof(CONFIG_SOURCE_KEYS) / sizeof(CONFIG_SOURCE_KEYS[0]);
+       i++) {
+    if (strcmp(name, CONFIG_SOURCE_KEYS[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Parses one KEY=VALUE line (systemd EnvironmentFile syntax subset). */
+static bool config_file_parse_line(config_file_t *restrict file,
+                                   char *restrict line, const char *restrict path,
+                                   int line_no, char *restrict error_msg,
+                                   size_t error_size) {
+  char *text = config_trim(line);
+  if (text[0] == '\0' || text[0] == '#' || text[0] == ';') {
+    return true;
+  }
+  char *equals = strchr(text, '=');
+  if (equals == NULL) {
+    return set_error(error_msg, error_size, "%s:%d: expected KEY=VALUE", path,
+                     line_no);
+  }
+  *equals = '\0';
+  char *name = config_trim(text);
+  char *value = config_trim(equals + 1);
+  size_t value_len = strlen(value);
+  if (value_len >= 2 && (value[0] == '"' || value[0] == '\'') &&
+      value[value_len - 1] == value[0]) {
+    value[value_len - 1] = '\0';
+    value++;
+  }
+  if (!config_source_key_known(name)) {
+    return set_error(error_msg, error_size, "%s:%d: unknown key %s", path,
+                     line_no, name);
+  }
+  if (file->count >= OPENUPS_CONFIG_FILE_MAX_ENTRIES) {
+    return set_error(error_msg, error_size, "%s:%d: too many entries (max %u)",
+                     path, line_no, OPENUPS_CONFIG_FILE_MAX_ENTRIES);
+  }
+  config_file_entry_t *entry = &file->entries[file->count];
+  if (!copy_string_value(entry->name, sizeof(entry->name), name, name,
+                         error_msg, error_size) ||
+      !copy_string_value(entry->value, sizeof(entry->value), value, name,
+                         error_msg, error_size)) {
+    return false;
+  }
+  file->count++;
+  return true;
+}
+
+bool config_load_from_file(config_t *restrict config, const char *restrict path,
+                           char *restrict error_msg, size_t error_size) {
+  if (config == NULL || path == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  /* "-path" is optional, as with systemd's EnvironmentFile=-path. */
+  bool optional = path[0] == '-';
+  if (optional) {
+    path++;
+  }
+  FILE *stream = fopen(path, "re");
+  if (stream == NULL) {
+    if (optional && errno == ENOENT) {
+      return true;
+    }
+    return set_error(error_msg, error_size, "Cannot open config file %s: %s",
+                     path, strerror(errno));
+  }
+
+  config_file_t file;
+  file.count = 0;
+  char line[OPENUPS_CONFIG_VALUE_MAX + 64];
+  int line_no = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), stream) != NULL) {
+    line_no++;
+    if (strchr(line, '\n') == NULL && !feof(stream)) {
+      ok = set_error(error_msg, error_size, "%s:%d: line too long", path,
+                     line_no);
+      break;
+    }
+    ok = config_file_parse_line(&file, line, path, line_no, error_msg,
+                                error_size);
+  }
+  if (ok && ferror(stream)) {
+    ok = set_error(error_msg, error_size, "Failed to read config file %s",
+                   path);
+  }
+  fclose(stream);
+  if (!ok) {
+    return false;
+  }
+
+  const config_source_t source = {.file = &file};
+  if (!config_load_from_source(config, &source, error_msg, error_size)) {
+    char detail[256];
+    snprintf(detail, sizeof(detail), "%s", error_msg);
+    return set_error(error_msg, error_size, "%s: %s", path, detail);
+  }
   return true;
 }
 
@@ -403,6 +806,7 @@ bool config_load_from_cmdline(config_t *restrict config, int argc,
   optind = 1;
   opterr = 0;
   int requested_exit_option = 0;
+  bool shadows_from_cmdline = false;
   int option_index = 0;
   int option = 0;
   while ((option = getopt_long(argc, argv, CONFIG_OPTSTRING,
@@ -435,6 +839,28 @@ bool config_load_from_cmdline(config_t *restrict config, int argc,
         return false;
       }
       break;
+    case 'P':
+      if (!parse_cmdline_probe_kind_option("--probe", optarg,
+                                           &config->probe_kind, error_msg,
+                                           error_size)) {
+        return false;
+      }
+      break;
+    case 'p':
+      if (!parse_cmdline_int_option("--port", optarg, 1, OPENUPS_MAX_PORT,
+                                    &config->probe_port, error_msg,
+                                    error_size)) {
+        return false;
+      }
+      break;
+    case 'z':
+      if (!parse_cmdline_int_option("--payload-size", optarg, 0,
+                                    OPENUPS_MAX_PAYLOAD_SIZE,
+                                    &config->payload_size, error_msg,
+                                    error_size)) {
+        return false;
+      }
+      break;
     case 'S':
       if (!parse_cmdline_shutdown_mode_option("--shutdown-mode", optarg,
                                               &config->shutdown_mode,
@@ -463,6 +889,114 @@ bool config_load_from_cmdline(config_t *restrict config, int argc,
         return false;
       }
       break;
+    case 'N':
+      if (!parse_cmdline_bool_option("--netlink", optarg, true,
+                                     &config->enable_netlink, error_msg,
+                                     error_size)) {
+        return false;
+      }
+      break;
+    case 'm':
+      if (!parse_cmdline_bool_option("--pmtu", optarg, true,
+                                     &config->enable_pmtu, error_msg,
+                                     error_size)) {
+        return false;
+      }
+      break;
+    case 'H':
+      if (!parse_cmdline_bool_option("--hops", optarg, true,
+                                     &config->enable_hops, error_msg,
+                                     error_size)) {
+        return false;
+      }
+      break;
+    case 'c':
+      if (!copy_string_value(config->config_path, sizeof(config->config_path),
+                             optarg, "--config", error_msg, error_size)) {
+        return false;
+      }
+      break;
+    case 'F':
+      if (!copy_string_value(config->state_file, sizeof(config->state_file),
+                             optarg, "--state-file", error_msg, error_size)) {
+        return false;
+      }
+      break;
+    case 'T':
+      if (!copy_string_value(config->targets_file,
+                             sizeof(config->targets_file), optarg,
+                             "--targets", error_msg, error_size)) {
+        return false;
+      }
+      break;
+    case 'W':
+      if (!parse_cmdline_int_option("--workers", optarg, 0,
+                                    OPENUPS_MAX_FLEET_WORKERS,
+                                    &config->workers, error_msg,
+                                    error_size)) {
+        return false;
+      }
+      break;
+    case 'R':
+      if (!parse_cmdline_bool_option("--packet-ring", optarg, true,
+                                     &config->packet_ring, error_msg,
+                                     error_size)) {
+        return false;
+      }
+      break;
+    case 's':
+      if (!copy_string_value(config->sweep_file, sizeof(config->sweep_file),
+                             optarg, "--sweep", error_msg, error_size)) {
+        return false;
+      }
+      break;
+    case 'r':
+      if (!parse_cmdline_int_option("--rate", optarg, 1,
+                                    OPENUPS_MAX_SWEEP_RATE,
+                                    &config->sweep_rate, error_msg,
+                                    error_size)) {
+        return false;
+      }
+      break;
+    case 'X':
+      /* Command-line policies replace those from the environment or file. */
+      if (!shadows_from_cmdline) {
+        config->shadow_count = 0;
+        shadows_from_cmdline = true;
+      }
+      if (!parse_shadow_policies(config, optarg, error_msg, error_size)) {
+        return false;
+      }
+      break;
+    case 'k':
+      if (!parse_cmdline_int_option("--timer-slack", optarg, 0,
+                                    OPENUPS_MAX_TIMER_SLACK_MS,
+                                    &config->timer_slack_ms, error_msg,
+                                    error_size)) {
+        return false;
+      }
+      break;
+    case 'l':
+      if (!parse_cmdline_bool_option("--low-latency", optarg, true,
+                                     &config->low_latency, error_msg,
+                                     error_size)) {
+        return false;
+      }
+      break;
+    case 'C':
+      if (!parse_cmdline_int_option("--cpu", optarg, -1, OPENUPS_MAX_CPU,
+                                    &config->cpu, error_msg, error_size)) {
+        return false;
+      }
+      break;
+    case 'Y':
+      if (!parse_cmdline_int_option("--rt-priority", optarg, 0,
+                                    OPENUPS_MAX_RT_PRIORITY,
+                                    &config->rt_priority, error_msg,
+                                    error_size)) {
+        return false;
+      }
+      break;
     case 'v':
       requested_exit_option = 'v';
       break;
@@ -545,6 +1079,26 @@ bool config_validate(const config_t *restrict config, char *restrict error_msg,
   if (config->timeout_ms <= 0) {
     return set_error(error_msg, error_size, "Timeout must be positive");
   }
+  if (config->probe_kind != PROBE_KIND_ICMP &&
+      (config->probe_port <= 0 || config->probe_port > OPENUPS_MAX_PORT)) {
+    return set_error(error_msg, error_size,
+                     "Port is required for tcp and udp probes (1..65535)");
+  }
+  if (config->probe_kind == PROBE_KIND_ICMP && config->probe_port != 0) {
+    return set_error(error_msg, error_size,
+                     "Port is only valid with tcp or udp probes");
+  }
+  if (config->payload_size < 0 ||
+      config->payload_size > OPENUPS_MAX_PAYLOAD_SIZE) {
+    return set_error(error_msg, error_size, "Payload size must be 0..%d",
+                     OPENUPS_MAX_PAYLOAD_SIZE);
+  }
+  if (config->probe_kind == PROBE_KIND_UDP &&
+      config->payload_size < (int)OPENUPS_UDP_PROBE_HEADER_LEN) {
+    return set_error(error_msg, error_size,
+                     "UDP probes need a payload of at least %u bytes",
+                     OPENUPS_UDP_PROBE_HEADER_LEN);
+  }
   if (config->delay_minutes < 0) {
     return set_error(error_msg, error_size, "Delay minutes cannot be negative");
   }
@@ -560,6 +1114,115 @@ bool config_validate(const config_t *restrict config, char *restrict error_msg,
     return set_error(error_msg, error_size,
                      "Delay is only valid with dry-run or true-off shutdown modes");
   }
+  if (config->workers < 0 || config->workers > OPENUPS_MAX_FLEET_WORKERS) {
+    return set_error(error_msg, error_size, "Workers must be 0..%d",
+                     OPENUPS_MAX_FLEET_WORKERS);
+  }
+  if (config->targets_file[0] != '\0' &&
+      config->probe_kind != PROBE_KIND_ICMP) {
+    return set_error(error_msg, error_size,
+                     "Fleet mode (--targets) only supports icmp probes");
+  }
+  if (config->packet_ring && config->targets_file[0] == '\0') {
+    return set_error(error_msg, error_size,
+                     "--packet-ring requires fleet mode (--targets)");
+  }
+  if (config->sweep_rate <= 0 || config->sweep_rate > OPENUPS_MAX_SWEEP_RATE) {
+    return set_error(error_msg, error_size, "Rate must be 1..%d",
+                     OPENUPS_MAX_SWEEP_RATE);
+  }
+  if (config->sweep_file[0] != '\0' && config->targets_file[0] != '\0') {
+    return set_error(error_msg, error_size,
+                     "--sweep and --targets are mutually exclusive");
+  }
+  if (config->sweep_file[0] != '\0' &&
+      config->probe_kind != PROBE_KIND_ICMP) {
+    return set_error(error_msg, error_size,
+                     "Sweep mode (--sweep) only supports icmp probes");
+  }
+  if (config->enable_pmtu && config->probe_kind != PROBE_KIND_ICMP) {
+    return set_error(error_msg, error_size,
+                     "--pmtu only supports icmp probes");
+  }
+  if (config->enable_pmtu &&
+      (config->targets_file[0] != '\0' || config->sweep_file[0] != '\0')) {
+    return set_error(error_msg, error_size,
+                     "--pmtu is only available for a single target");
+  }
+  if (config->shadow_count < 0 ||
+      config->shadow_count > OPENUPS_MAX_SHADOW_POLICIES) {
+    return set_error(error_msg, error_size, "Shadow policies must be 0..%d",
+                     OPENUPS_MAX_SHADOW_POLICIES);
+  }
+  if (config->shadow_count > 0 &&
+      (config->targets_file[0] != '\0' || config->sweep_file[0] != '\0')) {
+    return set_error(error_msg, error_size,
+                     "--shadow is only available for a single target");
+  }
+  if (config->timer_slack_ms < 0 ||
+      config->timer_slack_ms > OPENUPS_MAX_TIMER_SLACK_MS) {
+    return set_error(error_msg, error_size, "Timer slack must be 0..%d ms",
+                     OPENUPS_MAX_TIMER_SLACK_MS);
+  }
+  if (config->timer_slack_ms > 0 &&
+      (uint64_t)config->timer_slack_ms >=
+          (uint64_t)config->interval_sec * OPENUPS_MS_PER_SEC) {
+    return set_error(error_msg, error_size,
+                     "Timer slack must be smaller than interval");
+  }
+  if (config->timer_slack_ms > 0 &&
+      (config->targets_file[0] != '\0' || config->sweep_file[0] != '\0')) {
+    return set_error(error_msg, error_size,
+                     "--timer-slack is only available for a single target");
+  }
+  if (config->cpu < -1 || config->cpu > OPENUPS_MAX_CPU) {
+    return set_error(error_msg, error_size, "CPU must be -1..%d",
+                     OPENUPS_MAX_CPU);
+  }
+  if (config->rt_priority < 0 ||
+      config->rt_priority > OPENUPS_MAX_RT_PRIORITY) {
+    return set_error(error_msg, error_size,
+                     "Real-time priority must be 0..%d",
+                     OPENUPS_MAX_RT_PRIORITY);
+  }
+  if (!config->low_latency && (config->cpu >= 0 || config->rt_priority > 0)) {
+    return set_error(error_msg, error_size,
+                     "--cpu and --rt-priority require --low-latency");
+  }
+  if (config->low_latency &&
+      (config->targets_file[0] != '\0' || config->sweep_file[0] != '\0')) {
+    return set_error(error_msg, error_size,
+                     "--low-latency is only available for a single target");
+  }
+  if (config->low_latency && config->probe_kind != PROBE_KIND_ICMP) {
+    return set_error(error_msg, error_size,
+                     "--low-latency only supports icmp probes");
+  }
+  if (config->low_latency && config->timer_slack_ms > 0) {
+    return set_error(error_msg, error_size,
+                     "--low-latency and --timer-slack are mutually exclusive");
+  }
+  for (int i = 0; i < config->shadow_count; i++) {
+    const shadow_policy_t *policy = &config->shadows[i];
+    if (policy->threshold <= 0 || policy->window < policy->threshold ||
+        policy->window > OPENUPS_SHADOW_MAX_WINDOW) {
+      return set_error(error_msg, error_size,
+                       "Shadow policy %d: need 1 <= threshold <= window <= %d",
+                       i + 1, OPENUPS_SHADOW_MAX_WINDOW);
+    }
+    if (policy->delay_minutes < 0 ||
+        policy->delay_minutes > OPENUPS_MAX_DELAY_MINUTES) {
+      return set_error(error_msg, error_size,
+                       "Shadow policy %d: delay must be 0..%d minutes", i + 1,
+                       OPENUPS_MAX_DELAY_MINUTES);
+    }
+    if (policy->mode == SHUTDOWN_MODE_LOG_ONLY && policy->delay_minutes != 0) {
+      return set_error(error_msg, error_size,
+                       "Shadow policy %d: delay is only valid with dry-run or "
+                       "true-off",
+                       i + 1);
+    }
+  }
   return true;
 }
 
@@ -585,6 +1248,19 @@ const char *shutdown_mode_to_string(shutdown_mode_t mode) {
   }
 }
 
+const char *probe_kind_to_string(probe_kind_t kind) {
+  switch (kind) {
+  case PROBE_KIND_ICMP:
+    return "icmp";
+  case PROBE_KIND_TCP:
+    return "tcp";
+  case PROBE_KIND_UDP:
+    return "udp";
+  default:
+    return "unknown";
+  }
+}
+
 void config_print(const config_t *restrict config,
                   const logger_t *restrict logger) {
   if (config == NULL || logger == NULL) {
@@ -595,6 +1271,11 @@ void config_print(const config_t *restrict config,
   logger_debug(logger, "  Interval: %d seconds", config->interval_sec);
   logger_debug(logger, "  Threshold: %d", config->fail_threshold);
   logger_debug(logger, "  Timeout: %d ms", config->timeout_ms);
+  logger_debug(logger, "  Probe: %s", probe_kind_to_string(config->probe_kind));
+  if (config->probe_kind != PROBE_KIND_ICMP) {
+    logger_debug(logger, "  Port: %d", config->probe_port);
+  }
+  logger_debug(logger, "  Payload: %d bytes", config->payload_size);
   logger_debug(logger, "  Shutdown Mode: %s",
                shutdown_mode_to_string(config->shutdown_mode));
   logger_debug(logger, "  Delay: %d minutes", config->delay_minutes);
@@ -604,6 +1285,39 @@ void config_print(const config_t *restrict config,
                config_log_timestamps_enabled(config) ? "true" : "false");
   logger_debug(logger, "  Systemd: %s",
                config->enable_systemd ? "true" : "false");
+  logger_debug(logger, "  Netlink: %s",
+               config->enable_netlink ? "true" : "false");
+  logger_debug(logger, "  Path MTU: %s",
+               config->enable_pmtu ? "true" : "false");
+  logger_debug(logger, "  Hop Sweep: %s",
+               config->enable_hops ? "true" : "false");
+  logger_debug(logger, "  Timer Slack: %d ms", config->timer_slack_ms);
+  logger_debug(logger, "  Low Latency: %s (cpu %d, rt priority %d)",
+               config->low_latency ? "true" : "false", config->cpu,
+               config->rt_priority);
+  if (config->config_path[0] != '\0') {
+    logger_debug(logger, "  Config File: %s", config->config_path);
+  }
+  if (config->state_file[0] != '\0') {
+    logger_debug(logger, "  State File: %s", config->state_file);
+  }
+  if (config->targets_file[0] != '\0') {
+    logger_debug(logger, "  Targets File: %s", config->targets_file);
+    logger_debug(logger, "  Workers: %d", config->workers);
+    logger_debug(logger, "  Packet Ring: %s",
+                 config->packet_ring ? "true" : "false");
+  }
+  if (config->sweep_file[0] != '\0') {
+    logger_debug(logger, "  Sweep: %s", config->sweep_file);
+    logger_debug(logger, "  Rate: %d pps", config->sweep_rate);
+  }
+  for (int i = 0; i < config->shadow_count; i++) {
+    const shadow_policy_t *policy = &config->shadows[i];
+    logger_debug(logger, "  Shadow %d: %d of %d failed, delay %d minutes, %s",
+                 i + 1, policy->threshold, policy->window,
+                 policy->delay_minutes,
+                 shutdown_mode_to_string(policy->mode));
+  }
 }
 
 void config_print_usage(void) {
@@ -616,14 +1330,32 @@ void config_print_usage(void) {
   printf("  -n, --threshold <num>       Consecutive failures threshold "
          "(default: %d)\n", OPENUPS_DEFAULT_FAIL_THRESHOLD);
   printf("  -w, --timeout <ms>          Ping timeout in milliseconds (default: "
-         "%d)\n\n", OPENUPS_DEFAULT_TIMEOUT_MS);
+         "%d)\n", OPENUPS_DEFAULT_TIMEOUT_MS);
+  printf("  -P, --probe <kind>          Probe backend: icmp|tcp|udp "
+         "(default: icmp)\n");
+  printf("                              tcp: connect handshake, RST counts "
+         "as reachable\n");
+  printf("                              udp: any reply or port-unreachable "
+         "counts as reachable\n");
+  printf("  -p, --port <num>            Destination port for tcp/udp probes "
+         "(required)\n");
+  printf("  -z, --payload-size <bytes>  ICMP echo / UDP probe data bytes, up "
+         "to %d\n", OPENUPS_MAX_PAYLOAD_SIZE);
+  printf("                              (default: %d; near-MTU sizes catch "
+         "MTU faults)\n\n", OPENUPS_DEFAULT_PAYLOAD_SIZE);
   printf("Shutdown Options:\n");
   printf("  -S, --shutdown-mode <mode>  Shutdown mode: "
          "dry-run|true-off|log-only\n");
   printf("                              (default: dry-run)\n");
   printf("  -D, --delay <min>           Shutdown countdown in minutes for dry-run/true-off "
          "mode (default: %d)\n", OPENUPS_DEFAULT_DELAY_MINUTES);
-  printf("                              0 means immediate execution without countdown\n\n");
+  printf("                              0 means immediate execution without countdown\n");
+  printf("  -X, --shadow <policy>       Also evaluate a policy without acting "
+         "on it and log\n");
+  printf("                              when it would have fired, e.g. "
+         "threshold=5,\n");
+  printf("                              window=8,delay=2,mode=true-off "
+         "(repeatable, max %d)\n\n", OPENUPS_MAX_SHADOW_POLICIES);
   printf("Logging Options:\n");
   printf("  -L, --log-level <level>     Log level: "
          "silent|error|warn|info|debug\n");
@@ -635,16 +1367,85 @@ void config_print_usage(void) {
   printf("                              Log timestamps are auto-disabled when "
          "systemd is enabled\n");
   printf("                              Otherwise timestamps stay enabled\n");
-  printf("                              ARG format: true|false\n\n");
+  printf("                              ARG format: true|false\n");
+  printf("  -N[ARG], --netlink[=ARG]    Watch rtnetlink link/route events "
+         "(default: %s)\n", OPENUPS_DEFAULT_NETLINK ? "true" : "false");
+  printf("                              Route loss or egress carrier loss "
+         "counts as\n");
+  printf("                              an immediate failure\n");
+  printf("  -m[ARG], --pmtu[=ARG]       Track the path MTU with DF-set probes "
+         "(default: %s)\n", OPENUPS_DEFAULT_PMTU ? "true" : "false");
+  printf("                              A drop (e.g. a PMTU black hole) "
+         "counts as a failure\n");
+  printf("  -H[ARG], --hops[=ARG]       TTL-sweep the path when failures start "
+         "(default: %s)\n", OPENUPS_DEFAULT_HOPS ? "true" : "false");
+  printf("                              Logs the last hop that still "
+         "answers\n");
+  printf("  -k, --timer-slack <ms>      Low-wakeup mode: watchdog kicks and "
+         "status updates\n");
+  printf("                              ride on a wakeup up to ms early; "
+         "also sets the\n");
+  printf("                              kernel timer slack (default: 0, "
+         "exact timers)\n");
+  printf("  -l[ARG], --low-latency[=ARG]\n");
+  printf("                              Busy-poll the probe socket, lock and "
+         "pre-fault\n");
+  printf("                              memory (default: %s)\n",
+         OPENUPS_DEFAULT_LOW_LATENCY ? "true" : "false");
+  printf("  -C, --cpu <n>               Low-latency: pin the reactor to CPU "
+         "n\n");
+  printf("                              (default: -1, not pinned)\n");
+  printf("  -Y, --rt-priority <1-99>    Low-latency: run the reactor "
+         "SCHED_FIFO at this\n");
+  printf("                              priority (default: 0, normal "
+         "scheduling)\n");
+  printf("  -F, --state-file <path>     Checkpoint failure streak, countdown "
+         "and metrics\n");
+  printf("                              to an mmap'd file; restored after a "
+         "restart\n");
+  printf("                              (e.g. /run/openups/state, default: "
+         "disabled)\n\n");
+  printf("Fleet Options:\n");
+  printf("  -T, --targets <file>        Monitor every IP literal in file (one "
+         "per line)\n");
+  printf("                              with sharded per-core reactors; "
+         "reports only\n");
+  printf("  -W, --workers <num>         Fleet reactor threads, 0 = one per "
+         "CPU (max %d)\n", OPENUPS_MAX_FLEET_WORKERS);
+  printf("  -R, --packet-ring[=bool]    Capture replies through a TPACKET_V3 "
+         "mmap ring\n");
+  printf("                              (AF_PACKET) instead of recvmmsg "
+         "(default: false)\n\n");
+  printf("Sweep Options:\n");
+  printf("  -s, --sweep <file|->        Ping every IP literal or CIDR block "
+         "once and exit\n");
+  printf("                              Prints \"<ip> is alive|unreachable\""
+         " per target\n");
+  printf("  -r, --rate <pps>            Sweep send rate in probes per second "
+         "(default: %d)\n\n", OPENUPS_DEFAULT_SWEEP_RATE);
   printf("General Options:\n");
+  printf("  -c, --config <file>         Load OPENUPS_* KEY=VALUE settings from "
+         "file\n");
+  printf("                              Priority: CLI > file > environment; "
+         "re-read on SIGHUP\n");
+  printf("                              A leading '-' skips the file while it "
+         "does not exist\n");
   printf("  -v, --version               Show version information\n");
   printf("  -h, --help                  Show this help message\n\n");
   printf("Environment Variables (lower priority than CLI args):\n");
   printf("  Network:      OPENUPS_TARGET, OPENUPS_INTERVAL, OPENUPS_THRESHOLD,\n");
-  printf("                OPENUPS_TIMEOUT\n");
+  printf("                OPENUPS_TIMEOUT, OPENUPS_PROBE, OPENUPS_PORT,\n");
+  printf("                OPENUPS_PAYLOAD_SIZE, OPENUPS_PMTU, OPENUPS_HOPS\n");
   printf("  Shutdown:     OPENUPS_SHUTDOWN_MODE, OPENUPS_DELAY_MINUTES,\n");
+  printf("                OPENUPS_SHADOW (policies separated by ';')\n");
   printf("  Logging:      OPENUPS_LOG_LEVEL\n");
-  printf("  Integration:  OPENUPS_SYSTEMD\n");
+  printf("  Integration:  OPENUPS_SYSTEMD, OPENUPS_NETLINK, "
+         "OPENUPS_STATE_FILE,\n");
+  printf("                OPENUPS_TIMER_SLACK, OPENUPS_LOW_LATENCY, "
+         "OPENUPS_CPU,\n");
+  printf("                OPENUPS_RT_PRIORITY\n");
+  printf("  Fleet:        OPENUPS_TARGETS, OPENUPS_WORKERS, "
+         "OPENUPS_PACKET_RING\n");
   printf("\n");
   printf("Examples:\n");
   printf("  # Basic monitoring with dry-run mode\n");
@@ -652,11 +1453,17 @@ void config_print_usage(void) {
   printf("  # Production mode (actual shutdown)\n");
   printf("  %s -t 192.168.1.1 -i 5 -n 3 --shutdown-mode true-off\n\n",
          OPENUPS_PROGRAM_NAME);
+  printf("  # TCP handshake probe for networks that drop ICMP\n");
+  printf("  %s -t 192.168.1.1 --probe tcp --port 443\n\n",
+         OPENUPS_PROGRAM_NAME);
   printf("  # Delayed countdown before shutdown\n");
   printf("  %s -t 192.168.1.1 -i 5 -n 3 --shutdown-mode true-off --delay 3\n\n",
          OPENUPS_PROGRAM_NAME);
   printf("  # Foreground debug mode with local timestamps\n");
   printf("  %s -t 8.8.8.8 -L debug --systemd=false\n\n", OPENUPS_PROGRAM_NAME);
+  printf("  # One-shot sweep of a /16 at 20k probes per second\n");
+  printf("  echo 10.20.0.0/16 | %s --sweep - --rate 20000 --timeout 500\n\n",
+         OPENUPS_PROGRAM_NAME);
   printf("  # Short options (values must connect directly, no space)\n");
   printf("  %s -t 8.8.8.8 -i5 -n3 -Strue-off -D0 -Mfalse -Ldebug\n\n",
          OPENUPS_PROGRAM_NAME);
@@ -688,5 +1495,18 @@ bool config_resolve(config_t *restrict config, int argc, char **restrict argv,
   if (*exit_requested) {
     return true;
   }
+  /* The file path comes from the command line, yet CLI values must still
+   * win over file values: layer defaults < env < file < CLI. */
+  if (config->config_path[0] != '\0') {
+    char path[sizeof(config->config_path)];
+    memcpy(path, config->config_path, sizeof(path));
+    config_init_default(config);
+    if (!config_load_from_env(config, error_msg, error_size) ||
+        !config_load_from_file(config, path, error_msg, error_size) ||
+        !config_load_from_cmdline(config, argc, argv, exit_requested,
+                                  error_msg, error_size)) {
+      return false;
+    }
+  }
   return config_validate(config, error_msg, error_size);
 }
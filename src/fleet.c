@@ -0,0 +1,1114 @@
+#define _GNU_SOURCE /* pthread_attr_setaffinity_np, sched_getaffinity, ppoll */
+#include "fleet.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+/* Due timers handled per reactor turn before draining replies, so a burst
+ * of sends cannot overflow the receive queue it is about to fill. */
+#define FLEET_SEND_BATCH 64U
+#define FLEET_RING_MIN_CAPACITY 1024U
+#define FLEET_RECV_BUFFER_BYTES (4 * 1024 * 1024)
+#define FLEET_STATUS_INTERVAL_MS (10 * OPENUPS_MS_PER_SEC)
+#define FLEET_US_PER_MS UINT64_C(1000)
+/* Per-worker send ceiling as a multiple of the average rate, and the burst
+ * it tolerates: enough slack for phase clusters, never a thundering herd. */
+#define FLEET_PACER_HEADROOM 2U
+#define FLEET_PACER_BURST 8U
+
+/* ---- Target list ---- */
+
+static int fleet_entry_line_compare(const void *lhs, const void *rhs) {
+  uint32_t a = ((const target_entry_t *)lhs)->line_no;
+  uint32_t b = ((const target_entry_t *)rhs)->line_no;
+  return (a > b) - (a < b);
+}
+
+/* Repeated addresses are dropped (the first line wins); the rest keep file
+ * order so sharding and status output follow the file. */
+bool fleet_targets_load(const char *restrict path,
+                        fleet_target_t **restrict out_targets,
+                        uint32_t *restrict out_count, char *restrict error_msg,
+                        size_t error_size) {
+  if (path == NULL || out_targets == NULL || out_count == NULL ||
+      error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  *out_targets = NULL;
+  *out_count = 0;
+
+  target_list_t list;
+  if (!target_list_load(&list, path, OPENUPS_FLEET_MAX_TARGETS, error_msg,
+                        error_size)) {
+    return false;
+  }
+  if (list.count == 0) {
+    snprintf(error_msg, error_size, "%s: no targets", path);
+    target_list_free(&list);
+    return false;
+  }
+  fleet_target_t *targets = calloc(list.count, sizeof(*targets));
+  if (targets == NULL) {
+    snprintf(error_msg, error_size, "Out of memory loading %s", path);
+    target_list_free(&list);
+    return false;
+  }
+
+  qsort(list.entries, list.count, sizeof(*list.entries),
+        fleet_entry_line_compare);
+  for (uint32_t i = 0; i < list.count; i++) {
+    const target_entry_t *entry = &list.entries[i];
+    fleet_target_t *target = &targets[i];
+    target_entry_address(entry, &target->addr, &target->addr_len);
+    (void)inet_ntop(entry->family, entry->bytes, target->name,
+                    sizeof(target->name));
+  }
+  *out_targets = targets;
+  *out_count = list.count;
+  target_list_free(&list);
+  return true;
+}
+
+/* ---- Reply map ---- */
+
+static uint32_t fleet_pow2_at_least(uint32_t value) {
+  uint32_t capacity = 16;
+  while (capacity < value) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+bool fleet_reply_map_layout(size_t *restrict total, uint32_t max_entries) {
+  return total != NULL && max_entries <= OPENUPS_FLEET_MAX_TARGETS &&
+         arena_layout_add(total, fleet_pow2_at_least(max_entries * 2U),
+                          sizeof(fleet_reply_entry_t),
+                          alignof(fleet_reply_entry_t));
+}
+
+bool fleet_reply_map_init(fleet_reply_map_t *restrict map,
+                          arena_t *restrict arena, uint32_t max_entries) {
+  if (map == NULL || arena == NULL ||
+      max_entries > OPENUPS_FLEET_MAX_TARGETS) {
+    return false;
+  }
+  uint32_t capacity = fleet_pow2_at_least(max_entries * 2U);
+  map->entries = arena_alloc(arena, capacity, sizeof(*map->entries),
+                             alignof(fleet_reply_entry_t));
+  map->mask = capacity - 1;
+  map->used = 0;
+  return map->entries != NULL;
+}
+
+bool fleet_reply_map_insert(fleet_reply_map_t *restrict map,
+                            const icmp_reply_key_t *restrict key,
+                            uint32_t slot) {
+  uint32_t position = icmp_reply_key_hash(key) & map->mask;
+  for (;;) {
+    fleet_reply_entry_t *entry = &map->entries[position];
+    if (entry->slot == 0) {
+      if (map->used >= map->mask) {
+        return false; /* keep one empty bucket so probes terminate */
+      }
+      entry->key = *key;
+      entry->slot = slot + 1U;
+      map->used++;
+      return true;
+    }
+    if (icmp_reply_key_equal(&entry->key, key)) {
+      entry->slot = slot + 1U;
+      return true;
+    }
+    position = (position + 1) & map->mask;
+  }
+}
+
+/* Looks the key up and removes it in one probe sequence; the run after the
+ * hole is shifted back so later lookups never stop early. */
+bool fleet_reply_map_take(fleet_reply_map_t *restrict map,
+                          const icmp_reply_key_t *restrict key,
+                          uint32_t *restrict out_slot) {
+  uint32_t position = icmp_reply_key_hash(key) & map->mask;
+  for (;;) {
+    fleet_reply_entry_t *entry = &map->entries[position];
+    if (entry->slot == 0) {
+      return false;
+    }
+    if (icmp_reply_key_equal(&entry->key, key)) {
+      break;
+    }
+    position = (position + 1) & map->mask;
+  }
+  if (out_slot != NULL) {
+    *out_slot = map->entries[position].slot - 1U;
+  }
+
+  uint32_t hole = position;
+  uint32_t next = (hole + 1) & map->mask;
+  while (map->entries[next].slot != 0) {
+    uint32_t home = icmp_reply_key_hash(&map->entries[next].key) & map->mask;
+    /* Move next into the hole unless its home lies cyclically in
+     * (hole, next], where it would become unreachable. */
+    if (((next - home) & map->mask) >= ((next - hole) & map->mask)) {
+      map->entries[hole] = map->entries[next];
+      hole = next;
+    }
+    next = (next + 1) & map->mask;
+  }
+  map->entries[hole].slot = 0;
+  map->used--;
+  return true;
+}
+
+/* ---- Timer heap (min-heap of slot indices keyed by due_us) ---- */
+
+static void fleet_heap_swap(fleet_worker_t *restrict worker, uint32_t a,
+                            uint32_t b) {
+  uint32_t slot_a = worker->heap[a];
+  uint32_t slot_b = worker->heap[b];
+  worker->heap[a] = slot_b;
+  worker->heap[b] = slot_a;
+  worker->table.heap_index[slot_b] = a;
+  worker->table.heap_index[slot_a] = b;
+}
+
+static uint64_t fleet_heap_key(const fleet_worker_t *restrict worker,
+                               uint32_t position) {
+  return worker->table.due_us[worker->heap[position]];
+}
+
+static void fleet_heap_sift_down(fleet_worker_t *restrict worker,
+                                 uint32_t position) {
+  for (;;) {
+    uint32_t left = position * 2 + 1;
+    if (left >= worker->table.count) {
+      break;
+    }
+    uint32_t smallest = left;
+    if (left + 1 < worker->table.count &&
+        fleet_heap_key(worker, left + 1) < fleet_heap_key(worker, left)) {
+      smallest = left + 1;
+    }
+    if (fleet_heap_key(worker, position) <= fleet_heap_key(worker, smallest)) {
+      break;
+    }
+    fleet_heap_swap(worker, position, smallest);
+    position = smallest;
+  }
+}
+
+/* Restores heap order after due_us[slot] changed in either direction. */
+static void fleet_heap_fix(fleet_worker_t *restrict worker, uint32_t slot) {
+  uint32_t position = worker->table.heap_index[slot];
+  while (position > 0) {
+    uint32_t parent = (position - 1) / 2;
+    if (fleet_heap_key(worker, parent) <= fleet_heap_key(worker, position)) {
+      break;
+    }
+    fleet_heap_swap(worker, parent, position);
+    position = parent;
+  }
+  fleet_heap_sift_down(worker, position);
+}
+
+/* ---- Worker reactor ---- */
+
+static void fleet_counter_add(_Atomic uint64_t *restrict counter,
+                              uint64_t delta) {
+  atomic_store_explicit(
+      counter, atomic_load_explicit(counter, memory_order_relaxed) + delta,
+      memory_order_relaxed);
+}
+
+static bool fleet_worker_emit(fleet_worker_t *restrict worker, uint32_t slot,
+                              fleet_event_kind_t kind) {
+  const fleet_table_t *table = &worker->table;
+  fleet_event_t event = {
+      .target = table->target[slot],
+      .kind = (uint16_t)kind,
+      .worker = (uint16_t)worker->index,
+      .streak = table->streak[slot],
+      .rtt_us = table->last_rtt_us[slot],
+  };
+  if (!fleet_ring_push(&worker->ring, &event)) {
+    fleet_counter_add(&worker->stats.dropped_events, 1);
+    return false;
+  }
+  return true;
+}
+
+static void fleet_slot_reply_key(const fleet_worker_t *restrict worker,
+                                 uint32_t slot,
+                                 icmp_reply_key_t *restrict key) {
+  const fleet_target_t *target =
+      &worker->fleet->targets[worker->table.target[slot]];
+  icmp_reply_key_init(key, &target->addr, worker->identifier,
+                      worker->table.sequence[slot]);
+}
+
+static uint64_t fleet_interval_us(const fleet_t *restrict fleet) {
+  return (uint64_t)fleet->config.interval_sec * OPENUPS_MS_PER_SEC *
+         FLEET_US_PER_MS;
+}
+
+static void fleet_slot_schedule_next(fleet_worker_t *restrict worker,
+                                     uint32_t slot) {
+  worker->table.scheduled_us[slot] += fleet_interval_us(worker->fleet);
+  worker->table.due_us[slot] = worker->table.scheduled_us[slot];
+}
+
+static bool fleet_slot_fail(fleet_worker_t *restrict worker, uint32_t slot) {
+  fleet_table_t *table = &worker->table;
+  if (table->streak[slot] < UINT32_MAX) {
+    table->streak[slot]++;
+  }
+  if (!table->down[slot] &&
+      table->streak[slot] >= (uint32_t)worker->fleet->config.fail_threshold) {
+    table->down[slot] = true;
+    return fleet_worker_emit(worker, slot, FLEET_EVENT_DOWN);
+  }
+  return false;
+}
+
+/* A full socket buffer defers the send: the slot is retried one pacer
+ * period later, keeping its scheduled time, so a send backlog shows up as
+ * schedule error instead of probe failures. */
+static bool fleet_slot_send(fleet_worker_t *restrict worker, uint32_t slot,
+                            uint64_t now_us) {
+  fleet_table_t *table = &worker->table;
+  const fleet_target_t *target = &worker->fleet->targets[table->target[slot]];
+  icmp_pinger_t *pinger = target->addr.ss_family == AF_INET6
+                              ? &worker->pinger6
+                              : &worker->pinger4;
+
+  char error_msg[128];
+  /* Only sendto() sets errno; a stale EAGAIN from the last receive must not
+   * turn a validation failure into an endless deferral. */
+  errno = 0;
+  bool sent = icmp_pinger_send_echo(pinger, &target->addr, target->addr_len,
+                                    worker->identifier, worker->send_capacity,
+                                    error_msg, sizeof(error_msg));
+  if (!sent && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+    uint64_t retry_us =
+        (worker->pacer.period_ns + UINT64_C(999)) / UINT64_C(1000);
+    table->due_us[slot] = now_us + (retry_us > 0 ? retry_us : 1);
+    return false;
+  }
+  fleet_histogram_record(&worker->stats.schedule_error,
+                         now_us - table->scheduled_us[slot]);
+  if (!sent) {
+    /* Unroutable targets fail the probe immediately, like a timeout. */
+    fleet_counter_add(&worker->stats.send_errors, 1);
+    fleet_slot_schedule_next(worker, slot);
+    return fleet_slot_fail(worker, slot);
+  }
+
+  fleet_counter_add(&worker->stats.sent, 1);
+  table->sequence[slot] = icmp_pinger_current_sequence(pinger);
+  table->sent_us[slot] = now_us;
+  icmp_reply_key_t key;
+  fleet_slot_reply_key(worker, slot, &key);
+  /* Cannot fail: at most one entry per slot in a map sized for 2x slots. */
+  (void)fleet_reply_map_insert(&worker->replies, &key, slot);
+  table->due_us[slot] =
+      now_us + (uint64_t)worker->fleet->config.timeout_ms * FLEET_US_PER_MS;
+  return false;
+}
+
+/* Handles at most FLEET_SEND_BATCH due timers; a send waits for a pacer
+ * token and stays due meanwhile, so throttling shows up as schedule error.
+ * A deferred send moves behind the timeouts that expired meanwhile, which
+ * keep failing probes while the socket buffer is full.  Returns true when
+ * events were queued for the aggregator. */
+static bool fleet_worker_run_due(fleet_worker_t *restrict worker,
+                                 uint64_t now_us) {
+  fleet_table_t *table = &worker->table;
+  bool emitted = false;
+  for (unsigned handled = 0; handled < FLEET_SEND_BATCH; handled++) {
+    uint32_t slot = worker->heap[0];
+    if (table->due_us[slot] > now_us) {
+      break;
+    }
+    if (table->sequence[slot] != 0) {
+      fleet_counter_add(&worker->stats.timeouts, 1);
+      icmp_reply_key_t key;
+      fleet_slot_reply_key(worker, slot, &key);
+      (void)fleet_reply_map_take(&worker->replies, &key, NULL);
+      table->sequence[slot] = 0;
+      fleet_slot_schedule_next(worker, slot);
+      emitted |= fleet_slot_fail(worker, slot);
+    } else if (pacer_take(&worker->pacer, now_us)) {
+      /* A deferred send still spends its token: the retry backs off by one
+       * period instead of spinning on a full socket buffer. */
+      emitted |= fleet_slot_send(worker, slot, now_us);
+    } else {
+      break;
+    }
+    fleet_heap_fix(worker, slot);
+  }
+  return emitted;
+}
+
+static bool fleet_worker_match_key(fleet_worker_t *restrict worker,
+                                   const icmp_reply_key_t *restrict key,
+                                   uint64_t now_us) {
+  uint32_t slot;
+  if (key->sequence == 0 ||
+      !fleet_reply_map_take(&worker->replies, key, &slot)) {
+    return false; /* late, duplicate or foreign */
+  }
+
+  fleet_table_t *table = &worker->table;
+  fleet_counter_add(&worker->stats.received, 1);
+  uint64_t rtt_us =
+      now_us > table->sent_us[slot] ? now_us - table->sent_us[slot] : 0;
+  table->last_rtt_us[slot] = rtt_us > UINT32_MAX ? UINT32_MAX : (uint32_t)rtt_us;
+  table->sequence[slot] = 0;
+  table->streak[slot] = 0;
+  fleet_slot_schedule_next(worker, slot);
+  fleet_heap_fix(worker, slot);
+  if (table->down[slot]) {
+    table->down[slot] = false;
+    return fleet_worker_emit(worker, slot, FLEET_EVENT_UP);
+  }
+  return false;
+}
+
+static bool fleet_worker_match(fleet_worker_t *restrict worker,
+                               const icmp_echo_reply_t *restrict reply,
+                               uint64_t now_us) {
+  icmp_reply_key_t key;
+  icmp_reply_key_init(&key, &reply->source, reply->identifier,
+                      reply->sequence);
+  return fleet_worker_match_key(worker, &key, now_us);
+}
+
+typedef struct {
+  fleet_worker_t *worker;
+  bool emitted;
+} fleet_capture_ctx_t;
+
+static void fleet_worker_on_capture(void *ctx,
+                                    const icmp_reply_key_t *restrict reply,
+                                    uint64_t rx_us) {
+  fleet_capture_ctx_t *capture = ctx;
+  capture->emitted |= fleet_worker_match_key(capture->worker, reply, rx_us);
+}
+
+static bool fleet_worker_receive(fleet_worker_t *restrict worker,
+                                 icmp_pinger_t *restrict pinger) {
+  if (pinger->sockfd < 0) {
+    return false;
+  }
+  bool emitted = false;
+  icmp_echo_reply_t replies[OPENUPS_ICMP_RECEIVE_BATCH];
+  char error_msg[128];
+  int count;
+  do {
+    count = icmp_pinger_receive_batch(pinger, replies,
+                                      OPENUPS_ICMP_RECEIVE_BATCH, error_msg,
+                                      sizeof(error_msg));
+    uint64_t now_us = get_monotonic_us();
+    for (int i = 0; i < count; i++) {
+      emitted |= fleet_worker_match(worker, &replies[i], now_us);
+    }
+  } while (count == (int)OPENUPS_ICMP_RECEIVE_BATCH);
+  if (count < 0) {
+    logger_warn(&worker->fleet->logger, "Fleet worker %u: %s", worker->index,
+                error_msg);
+  }
+  return emitted;
+}
+
+static void fleet_worker_wake_aggregator(const fleet_worker_t *restrict worker) {
+  uint64_t one = 1;
+  ssize_t written = write(worker->fleet->wake_fd, &one, sizeof(one));
+  (void)written; /* EAGAIN: counter saturated, aggregator is awake anyway */
+}
+
+static void *fleet_worker_main(void *arg) {
+  fleet_worker_t *worker = arg;
+  fleet_t *fleet = worker->fleet;
+
+  /* Each target starts at its own deterministic phase within the first
+   * interval instead of every target firing at once; the heap is built
+   * from scratch because the phases are unordered. */
+  uint64_t now_us = get_monotonic_us();
+  uint64_t interval_us = fleet_interval_us(fleet);
+  for (uint32_t i = 0; i < worker->table.count; i++) {
+    const fleet_target_t *target = &fleet->targets[worker->table.target[i]];
+    worker->table.due_us[i] =
+        now_us + pacer_phase_us(fleet->host_seed, &target->addr, interval_us);
+    worker->table.scheduled_us[i] = worker->table.due_us[i];
+    worker->table.heap_index[i] = i;
+    worker->heap[i] = i;
+  }
+  for (uint32_t i = worker->table.count / 2; i-- > 0;) {
+    fleet_heap_sift_down(worker, i);
+  }
+  uint64_t rate = ((uint64_t)worker->table.count * FLEET_PACER_HEADROOM +
+                   (uint64_t)fleet->config.interval_sec - 1U) /
+                  (uint64_t)fleet->config.interval_sec;
+  pacer_init(&worker->pacer, rate, FLEET_PACER_BURST, now_us);
+
+  /* With a capture ring the raw sockets only send; negative fds are
+   * skipped by ppoll. */
+  bool capture = worker->capture.fd >= 0;
+  struct pollfd fds[3] = {
+      {.fd = capture ? worker->capture.fd : worker->pinger4.sockfd,
+       .events = POLLIN},
+      {.fd = capture ? -1 : worker->pinger6.sockfd, .events = POLLIN},
+      {.fd = fleet->stop_fd, .events = POLLIN},
+  };
+  while (!atomic_load_explicit(&fleet->stop, memory_order_acquire)) {
+    now_us = get_monotonic_us();
+    bool emitted = fleet_worker_run_due(worker, now_us);
+    if (capture) {
+      fleet_capture_ctx_t ctx = {.worker = worker};
+      (void)packet_ring_drain(&worker->capture, fleet_worker_on_capture, &ctx);
+      emitted |= ctx.emitted;
+    } else {
+      emitted |= fleet_worker_receive(worker, &worker->pinger4);
+      emitted |= fleet_worker_receive(worker, &worker->pinger6);
+    }
+    if (emitted) {
+      fleet_worker_wake_aggregator(worker);
+    }
+
+    now_us = get_monotonic_us();
+    uint64_t due_us = worker->table.due_us[worker->heap[0]];
+    uint64_t wait_us = due_us > now_us ? due_us - now_us
+                                       : pacer_wait_us(&worker->pacer, now_us);
+    struct timespec timeout = {
+        .tv_sec = (time_t)(wait_us / (OPENUPS_MS_PER_SEC * FLEET_US_PER_MS)),
+        .tv_nsec = (long)(wait_us % (OPENUPS_MS_PER_SEC * FLEET_US_PER_MS)) *
+                   1000L,
+    };
+    if (ppoll(fds, 3, &timeout, NULL) < 0 && errno != EINTR) {
+      logger_error(&fleet->logger, "Fleet worker %u: ppoll failed: %s",
+                   worker->index, strerror(errno));
+      break;
+    }
+  }
+  return NULL;
+}
+
+/* ---- Setup / teardown ---- */
+
+static size_t fleet_round_up_pow2(size_t value) {
+  size_t capacity = FLEET_RING_MIN_CAPACITY;
+  while (capacity < value) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+static bool fleet_worker_open_pinger(fleet_worker_t *restrict worker,
+                                     icmp_pinger_t *restrict pinger,
+                                     int family, char *restrict error_msg,
+                                     size_t error_size) {
+  if (!icmp_pinger_init(pinger, family, error_msg, error_size)) {
+    return false;
+  }
+  icmp_pinger_set_send_buffer(pinger, worker->send_buf, worker->send_capacity);
+  if (worker->capture.fd >= 0) {
+    if (!icmp_pinger_discard_replies(pinger)) {
+      logger_warn(&worker->fleet->logger,
+                  "Fleet worker %u: raw socket still queues replies",
+                  worker->index);
+    }
+    return true;
+  }
+  if (!icmp_pinger_filter_identifier(pinger, worker->identifier)) {
+    logger_warn(&worker->fleet->logger,
+                "Fleet worker %u: identifier filter not attached",
+                worker->index);
+  }
+  int size = FLEET_RECV_BUFFER_BYTES;
+  if (setsockopt(pinger->sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+                 sizeof(size)) != 0) {
+    (void)setsockopt(pinger->sockfd, SOL_SOCKET, SO_RCVBUF, &size,
+                     sizeof(size));
+  }
+  return true;
+}
+
+/* Each column starts on its own cache line so sequential scans of one
+ * column never share lines with another. */
+#define FLEET_COLUMN(arena, count, field)                                     \
+  arena_alloc((arena), (count), sizeof(*(field)), OPENUPS_FLEET_CACHELINE)
+
+static bool fleet_table_init(fleet_table_t *restrict table,
+                             arena_t *restrict arena, uint32_t count) {
+  table->count = count;
+  table->due_us = FLEET_COLUMN(arena, count, table->due_us);
+  table->scheduled_us = FLEET_COLUMN(arena, count, table->scheduled_us);
+  table->sent_us = FLEET_COLUMN(arena, count, table->sent_us);
+  table->last_rtt_us = FLEET_COLUMN(arena, count, table->last_rtt_us);
+  table->streak = FLEET_COLUMN(arena, count, table->streak);
+  table->heap_index = FLEET_COLUMN(arena, count, table->heap_index);
+  table->target = FLEET_COLUMN(arena, count, table->target);
+  table->sequence = FLEET_COLUMN(arena, count, table->sequence);
+  table->down = FLEET_COLUMN(arena, count, table->down);
+  return table->due_us != NULL && table->scheduled_us != NULL &&
+         table->sent_us != NULL && table->last_rtt_us != NULL &&
+         table->streak != NULL && table->heap_index != NULL &&
+         table->target != NULL && table->sequence != NULL &&
+         table->down != NULL;
+}
+
+static size_t fleet_packet_size(const config_t *restrict config) {
+  return OPENUPS_PROBE_HEADER_LEN + (size_t)config->payload_size;
+}
+
+/* Mirrors fleet_worker_init(): table columns, heap, reply map, ring and the
+ * probe packet. */
+static bool fleet_worker_layout(size_t *restrict total, uint32_t slot_count,
+                                size_t packet_size) {
+  static const size_t column_sizes[] = {
+      sizeof(uint64_t), sizeof(uint64_t), sizeof(uint64_t),
+      sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t),
+      sizeof(uint32_t), sizeof(uint16_t), sizeof(bool),
+  };
+  for (size_t i = 0; i < sizeof(column_sizes) / sizeof(column_sizes[0]);
+       i++) {
+    if (!arena_layout_add(total, slot_count, column_sizes[i],
+                          OPENUPS_FLEET_CACHELINE)) {
+      return false;
+    }
+  }
+  return arena_layout_add(total, slot_count, sizeof(uint32_t),
+                          alignof(uint32_t)) &&
+         fleet_reply_map_layout(total, slot_count) &&
+         arena_layout_add(total,
+                          fleet_round_up_pow2((size_t)slot_count * 2U),
+                          sizeof(fleet_event_t), OPENUPS_FLEET_CACHELINE) &&
+         arena_layout_add(total, packet_size, 1, OPENUPS_FLEET_CACHELINE);
+}
+
+static bool fleet_worker_init(fleet_t *restrict fleet,
+                              fleet_worker_t *restrict worker, unsigned index,
+                              uint32_t slot_count, char *restrict error_msg,
+                              size_t error_size) {
+  worker->fleet = fleet;
+  worker->index = index;
+  worker->cpu = -1;
+  worker->pinger4.sockfd = -1;
+  worker->pinger6.sockfd = -1;
+  /* Distinct per worker so each BPF filter passes only its own replies. */
+  worker->identifier = (uint16_t)(((unsigned)getpid() << 3) | index);
+
+  arena_t *arena = &fleet->arena;
+  bool table_ok = fleet_table_init(&worker->table, arena, slot_count);
+  worker->heap =
+      arena_alloc(arena, slot_count, sizeof(*worker->heap), alignof(uint32_t));
+  bool replies_ok = fleet_reply_map_init(&worker->replies, arena, slot_count);
+  size_t capacity = fleet_round_up_pow2((size_t)slot_count * 2U);
+  worker->ring.slots = arena_alloc(arena, capacity,
+                                   sizeof(*worker->ring.slots),
+                                   OPENUPS_FLEET_CACHELINE);
+  worker->send_capacity = fleet_packet_size(&fleet->config);
+  worker->send_buf = arena_alloc(arena, worker->send_capacity, 1,
+                                 OPENUPS_FLEET_CACHELINE);
+  if (!table_ok || !replies_ok || worker->heap == NULL ||
+      worker->ring.slots == NULL || worker->send_buf == NULL) {
+    snprintf(error_msg, error_size, "Out of memory for fleet worker %u",
+             index);
+    return false;
+  }
+  worker->ring.mask = capacity - 1;
+  atomic_init(&worker->ring.head, 0);
+  atomic_init(&worker->ring.tail, 0);
+
+  if (fleet->config.packet_ring &&
+      !packet_ring_open(&worker->capture, worker->identifier, error_msg,
+                        error_size)) {
+    return false;
+  }
+
+  /* Round-robin sharding keeps neighbours in the file on different cores. */
+  for (uint32_t i = 0; i < slot_count; i++) {
+    uint32_t target = index + i * fleet->worker_count;
+    worker->table.target[i] = target;
+    int family = fleet->targets[target].addr.ss_family;
+    icmp_pinger_t *pinger =
+        family == AF_INET6 ? &worker->pinger6 : &worker->pinger4;
+    if (pinger->sockfd < 0 &&
+        !fleet_worker_open_pinger(worker, pinger, family, error_msg,
+                                  error_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void fleet_worker_destroy(fleet_worker_t *restrict worker) {
+  icmp_pinger_destroy(&worker->pinger4);
+  icmp_pinger_destroy(&worker->pinger6);
+  packet_ring_close(&worker->capture);
+  memset(worker, 0, sizeof(*worker));
+}
+
+/* One worker per allowed CPU (capped), never more workers than targets. */
+static unsigned fleet_worker_count(const config_t *restrict config,
+                                   uint32_t target_count) {
+  unsigned count = (unsigned)config->workers;
+  if (count == 0) {
+    cpu_set_t allowed;
+    count = sched_getaffinity(0, sizeof(allowed), &allowed) == 0
+                ? (unsigned)CPU_COUNT(&allowed)
+                : 1U;
+  }
+  if (count > OPENUPS_FLEET_MAX_WORKERS) {
+    count = OPENUPS_FLEET_MAX_WORKERS;
+  }
+  if (count > target_count) {
+    count = target_count;
+  }
+  return count == 0 ? 1U : count;
+}
+
+/* Maps worker index -> the index-th CPU of the allowed set. */
+static int fleet_worker_cpu(unsigned index) {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return -1;
+  }
+  int available = CPU_COUNT(&allowed);
+  if (available <= 0) {
+    return -1;
+  }
+  int wanted = (int)(index % (unsigned)available);
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed) && wanted-- == 0) {
+      return cpu;
+    }
+  }
+  return -1;
+}
+
+static uint32_t fleet_worker_slot_count(uint32_t target_count,
+                                        unsigned worker_count,
+                                        unsigned index) {
+  return target_count / worker_count +
+         (index < target_count % worker_count ? 1U : 0U);
+}
+
+/* Every byte the fleet needs after startup, so one arena covers it. */
+static bool fleet_layout(size_t *restrict total, uint32_t target_count,
+                         unsigned worker_count, size_t packet_size) {
+  if (!arena_layout_add(total, target_count, sizeof(fleet_target_t),
+                        alignof(fleet_target_t)) ||
+      !arena_layout_add(total, target_count, sizeof(bool), alignof(bool))) {
+    return false;
+  }
+  for (unsigned i = 0; i < worker_count; i++) {
+    if (!fleet_worker_layout(
+            total, fleet_worker_slot_count(target_count, worker_count, i),
+            packet_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Copies the loaded targets into the arena; the caller's array is freed on
+ * every path. */
+bool fleet_init(fleet_t *restrict fleet, const config_t *restrict config,
+                fleet_target_t *targets, uint32_t target_count,
+                char *restrict error_msg, size_t error_size) {
+  if (fleet == NULL || config == NULL || targets == NULL ||
+      target_count == 0 || error_msg == NULL || error_size == 0) {
+    free(targets);
+    return false;
+  }
+  memset(fleet, 0, sizeof(*fleet));
+  fleet->wake_fd = -1;
+  fleet->stop_fd = -1;
+  fleet->config = *config;
+  fleet->target_count = target_count;
+  atomic_init(&fleet->stop, false);
+  logger_init(&fleet->logger, config->log_level,
+              config_log_timestamps_enabled(config));
+  fleet->host_seed = pacer_host_seed();
+  fleet->worker_count = fleet_worker_count(config, target_count);
+  for (unsigned i = 0; i < fleet->worker_count; i++) {
+    /* fleet_destroy may run before every worker reached its init. */
+    fleet->workers[i].pinger4.sockfd = -1;
+    fleet->workers[i].pinger6.sockfd = -1;
+    fleet->workers[i].capture.fd = -1;
+  }
+
+  size_t arena_size = 0;
+  if (!fleet_layout(&arena_size, target_count, fleet->worker_count,
+                    fleet_packet_size(config))) {
+    snprintf(error_msg, error_size, "Fleet of %" PRIu32 " targets is too large",
+             target_count);
+    free(targets);
+    return false;
+  }
+  if (!arena_init(&fleet->arena, arena_size, error_msg, error_size)) {
+    free(targets);
+    return false;
+  }
+  fleet->targets = arena_alloc(&fleet->arena, target_count,
+                               sizeof(*fleet->targets),
+                               alignof(fleet_target_t));
+  fleet->target_down = arena_alloc(&fleet->arena, target_count,
+                                   sizeof(*fleet->target_down), alignof(bool));
+  if (fleet->targets != NULL) {
+    memcpy(fleet->targets, targets, (size_t)target_count * sizeof(*targets));
+  }
+  free(targets);
+  if (fleet->targets == NULL || fleet->target_down == NULL) {
+    snprintf(error_msg, error_size, "Fleet arena layout mismatch");
+    return false;
+  }
+
+  fleet->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  fleet->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fleet->wake_fd < 0 || fleet->stop_fd < 0) {
+    snprintf(error_msg, error_size, "Failed to set up fleet aggregator: %s",
+             strerror(errno));
+    return false;
+  }
+
+  for (unsigned i = 0; i < fleet->worker_count; i++) {
+    uint32_t slot_count =
+        fleet_worker_slot_count(target_count, fleet->worker_count, i);
+    if (!fleet_worker_init(fleet, &fleet->workers[i], i, slot_count,
+                           error_msg, error_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool fleet_start(fleet_t *restrict fleet, char *restrict error_msg,
+                 size_t error_size) {
+  if (fleet == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  for (unsigned i = 0; i < fleet->worker_count; i++) {
+    fleet_worker_t *worker = &fleet->workers[i];
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    worker->cpu = fleet_worker_cpu(i);
+    if (worker->cpu >= 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(worker->cpu, &cpus);
+      if (pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus) != 0) {
+        worker->cpu = -1;
+      }
+    }
+    int rc = pthread_create(&worker->thread, &attr, fleet_worker_main, worker);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+      snprintf(error_msg, error_size,
+               "Failed to start fleet worker %u: %s", i, strerror(rc));
+      fleet_stop(fleet);
+      return false;
+    }
+    worker->thread_started = true;
+  }
+  return true;
+}
+
+void fleet_stop(fleet_t *restrict fleet) {
+  if (fleet == NULL) {
+    return;
+  }
+  atomic_store_explicit(&fleet->stop, true, memory_order_release);
+  if (fleet->stop_fd >= 0) {
+    uint64_t one = 1;
+    ssize_t written = write(fleet->stop_fd, &one, sizeof(one));
+    (void)written;
+  }
+  for (unsigned i = 0; i < fleet->worker_count; i++) {
+    if (fleet->workers[i].thread_started) {
+      pthread_join(fleet->workers[i].thread, NULL);
+      fleet->workers[i].thread_started = false;
+    }
+  }
+}
+
+void fleet_destroy(fleet_t *restrict fleet) {
+  if (fleet == NULL) {
+    return;
+  }
+  fleet_stop(fleet);
+  for (unsigned i = 0; i < fleet->worker_count; i++) {
+    fleet_worker_destroy(&fleet->workers[i]);
+  }
+  if (fleet->wake_fd >= 0) {
+    close(fleet->wake_fd);
+  }
+  if (fleet->stop_fd >= 0) {
+    close(fleet->stop_fd);
+  }
+  arena_destroy(&fleet->arena);
+  memset(fleet, 0, sizeof(*fleet));
+  fleet->wake_fd = -1;
+  fleet->stop_fd = -1;
+}
+
+/* ---- Aggregator ---- */
+
+/* Folds every queued worker event into the global view.  Returns the
+ * number of events consumed. */
+size_t fleet_drain(fleet_t *restrict fleet) {
+  if (fleet == NULL) {
+    return 0;
+  }
+  uint64_t pending = 0;
+  ssize_t drained = read(fleet->wake_fd, &pending, sizeof(pending));
+  (void)drained;
+
+  size_t consumed = 0;
+  for (unsigned i = 0; i < fleet->worker_count; i++) {
+    fleet_event_t event;
+    while (fleet_ring_pop(&fleet->workers[i].ring, &event)) {
+      consumed++;
+      if (event.target >= fleet->target_count) {
+        continue;
+      }
+      const char *name = fleet->targets[event.target].name;
+      bool down = event.kind == FLEET_EVENT_DOWN;
+      if (fleet->target_down[event.target] != down) {
+        fleet->target_down[event.target] = down;
+        if (down) {
+          fleet->down_count++;
+        } else {
+          fleet->down_count--;
+        }
+      }
+      if (down) {
+        logger_warn(&fleet->logger,
+                    "Target %s down after %" PRIu32 " consecutive failures",
+                    name, event.streak);
+      } else {
+        logger_info(&fleet->logger, "Target %s up again (rtt %.2fms)", name,
+                    (double)event.rtt_us / (double)FLEET_US_PER_MS);
+      }
+    }
+  }
+  return consumed;
+}
+
+void fleet_stats_collect(const fleet_t *restrict fleet,
+                         fleet_stats_t *restrict out) {
+  if (fleet == NULL || out == NULL) {
+    return;
+  }
+  memset(out, 0, sizeof(*out));
+  for (unsigned i = 0; i < fleet->worker_count; i++) {
+    const fleet_worker_stats_t *stats = &fleet->workers[i].stats;
+    out->sent += atomic_load_explicit(&stats->sent, memory_order_relaxed);
+    out->received +=
+        atomic_load_explicit(&stats->received, memory_order_relaxed);
+    out->timeouts +=
+        atomic_load_explicit(&stats->timeouts, memory_order_relaxed);
+    out->send_errors +=
+        atomic_load_explicit(&stats->send_errors, memory_order_relaxed);
+    out->dropped_events +=
+        atomic_load_explicit(&stats->dropped_events, memory_order_relaxed);
+    for (unsigned b = 0; b < OPENUPS_FLEET_HIST_BUCKETS; b++) {
+      uint64_t count = atomic_load_explicit(&stats->schedule_error.buckets[b],
+                                            memory_order_relaxed);
+      out->schedule_buckets[b] += count;
+      out->schedule_samples += count;
+    }
+  }
+}
+
+void fleet_stats_delta(const fleet_stats_t *restrict after,
+                       const fleet_stats_t *restrict before,
+                       fleet_stats_t *restrict out) {
+  if (after == NULL || before == NULL || out == NULL) {
+    return;
+  }
+  out->sent = after->sent - before->sent;
+  out->received = after->received - before->received;
+  out->timeouts = after->timeouts - before->timeouts;
+  out->send_errors = after->send_errors - before->send_errors;
+  out->dropped_events = after->dropped_events - before->dropped_events;
+  out->schedule_samples = after->schedule_samples - before->schedule_samples;
+  for (unsigned b = 0; b < OPENUPS_FLEET_HIST_BUCKETS; b++) {
+    out->schedule_buckets[b] =
+        after->schedule_buckets[b] - before->schedule_buckets[b];
+  }
+}
+
+/* Upper bound of the bucket holding the requested percentile, in us. */
+uint64_t fleet_stats_percentile(const fleet_stats_t *restrict stats,
+                                double percentile) {
+  if (stats == NULL || stats->schedule_samples == 0) {
+    return 0;
+  }
+  uint64_t rank =
+      (uint64_t)((double)stats->schedule_samples * percentile / 100.0);
+  if (rank >= stats->schedule_samples) {
+    rank = stats->schedule_samples - 1;
+  }
+  uint64_t seen = 0;
+  for (unsigned b = 0; b < OPENUPS_FLEET_HIST_BUCKETS; b++) {
+    seen += stats->schedule_buckets[b];
+    if (seen > rank) {
+      return b + 1 < OPENUPS_FLEET_HIST_BUCKETS
+                 ? fleet_histogram_bucket_floor(b + 1) - 1
+                 : fleet_histogram_bucket_floor(b);
+    }
+  }
+  return fleet_histogram_bucket_floor(OPENUPS_FLEET_HIST_BUCKETS - 1);
+}
+
+static void fleet_log_stats(const fleet_t *restrict fleet) {
+  fleet_stats_t stats;
+  fleet_stats_collect(fleet, &stats);
+  logger_info(&fleet->logger,
+              "Fleet statistics: %" PRIu32 "/%" PRIu32 " targets up, %u "
+              "workers, %" PRIu64 " sent, %" PRIu64 " replies, %" PRIu64
+              " timeouts, %" PRIu64 " send errors, schedule error p50 %" PRIu64
+              "us / p99 %" PRIu64 "us",
+              fleet->target_count - fleet->down_count, fleet->target_count,
+              fleet->worker_count, stats.sent, stats.received, stats.timeouts,
+              stats.send_errors, fleet_stats_percentile(&stats, 50.0),
+              fleet_stats_percentile(&stats, 99.0));
+  if (stats.dropped_events > 0) {
+    logger_warn(&fleet->logger,
+                "Fleet aggregator fell behind: %" PRIu64 " events dropped",
+                stats.dropped_events);
+  }
+}
+
+/* Aggregator reactor: signals, worker wakeups, watchdog and status. */
+int openups_fleet_run(const config_t *restrict config) {
+  if (config == NULL) {
+    return OPENUPS_EXIT_FAILURE;
+  }
+  char error_msg[256];
+  logger_t logger;
+  logger_init(&logger, config->log_level,
+              config_log_timestamps_enabled(config));
+
+  fleet_target_t *targets = NULL;
+  uint32_t target_count = 0;
+  if (!fleet_targets_load(config->targets_file, &targets, &target_count,
+                          error_msg, sizeof(error_msg))) {
+    logger_error(&logger, "OpenUPS failed: %s", error_msg);
+    return OPENUPS_EXIT_FAILURE;
+  }
+
+  /* Block before any thread exists so workers inherit the mask and every
+   * signal is delivered through the signalfd below. */
+  sigset_t mask;
+  sigset_t previous_mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGUSR1);
+  sigaddset(&mask, SIGHUP);
+  if (pthread_sigmask(SIG_BLOCK, &mask, &previous_mask) != 0) {
+    free(targets);
+    logger_error(&logger, "pthread_sigmask failed");
+    return OPENUPS_EXIT_FAILURE;
+  }
+
+  fleet_t fleet;
+  int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signal_fd < 0) {
+    free(targets);
+    logger_error(&logger, "signalfd failed: %s", strerror(errno));
+    (void)pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+    return OPENUPS_EXIT_FAILURE;
+  }
+  if (!fleet_init(&fleet, config, targets, target_count, error_msg,
+                  sizeof(error_msg)) ||
+      !fleet_start(&fleet, error_msg, sizeof(error_msg))) {
+    logger_error(&logger, "OpenUPS failed: %s", error_msg);
+    fleet_destroy(&fleet);
+    close(signal_fd);
+    (void)pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+    return OPENUPS_EXIT_FAILURE;
+  }
+
+  systemd_notifier_t notifier;
+  runtime_services_t services;
+  runtime_services_init(&services, &notifier, config->enable_systemd);
+  logger_info(&logger,
+              "Starting OpenUPS fleet mode: %" PRIu32 " targets across %u "
+              "workers, every %ds",
+              fleet.target_count, fleet.worker_count, config->interval_sec);
+  (void)runtime_services_notify_ready(&services);
+
+  uint64_t watchdog_ms = runtime_services_watchdog_interval_ms(&services);
+  uint64_t now_ms = get_monotonic_ms();
+  uint64_t last_watchdog_ms = now_ms;
+  uint64_t last_status_ms = 0;
+  uint32_t reported_down = UINT32_MAX;
+  int exit_code = OPENUPS_EXIT_SUCCESS;
+  bool running = true;
+  while (running) {
+    (void)fleet_drain(&fleet);
+    now_ms = get_monotonic_ms();
+    if (fleet.down_count != reported_down ||
+        now_ms - last_status_ms >= FLEET_STATUS_INTERVAL_MS) {
+      (void)runtime_services_notify_statusf(
+          &services, "Fleet: %" PRIu32 "/%" PRIu32 " targets up",
+          fleet.target_count - fleet.down_count, fleet.target_count);
+      reported_down = fleet.down_count;
+      last_status_ms = now_ms;
+    }
+    if (watchdog_ms > 0 && now_ms - last_watchdog_ms >= watchdog_ms) {
+      (void)runtime_services_notify_watchdog(&services);
+      last_watchdog_ms = now_ms;
+    }
+
+    uint64_t wait_ms = FLEET_STATUS_INTERVAL_MS;
+    if (watchdog_ms > 0 && watchdog_ms < wait_ms) {
+      wait_ms = watchdog_ms;
+    }
+    struct pollfd fds[2] = {
+        {.fd = signal_fd, .events = POLLIN},
+        {.fd = fleet.wake_fd, .events = POLLIN},
+    };
+    if (poll(fds, 2, (int)wait_ms) < 0 && errno != EINTR) {
+      logger_error(&logger, "poll failed: %s", strerror(errno));
+      exit_code = OPENUPS_EXIT_FAILURE;
+      break;
+    }
+    if ((fds[0].revents & POLLIN) == 0) {
+      continue;
+    }
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+      if (info.ssi_signo == SIGINT || info.ssi_signo == SIGTERM) {
+        logger_info(&logger, "Received shutdown signal, stopping gracefully...");
+        running = false;
+      } else if (info.ssi_signo == SIGUSR1) {
+        fleet_log_stats(&fleet);
+      } else if (info.ssi_signo == SIGHUP) {
+        logger_warn(&logger,
+                    "SIGHUP ignored: reload is not supported in fleet mode");
+      }
+    }
+  }
+
+  (void)runtime_services_notify_stopping(&services);
+  fleet_stop(&fleet);
+  (void)fleet_drain(&fleet);
+  fleet_log_stats(&fleet);
+  fleet_destroy(&fleet);
+  runtime_services_destroy(&services);
+  close(signal_fd);
+  (void)pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+  return exit_code;
+}
@@ -0,0 +1,226 @@
+#ifndef OPENUPS_FLEET_H
+#define OPENUPS_FLEET_H
+
+#include "openups.h"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+
+/* TasksMax=10 in the shipped unit: workers + main thread + shutdown helper */
+#define OPENUPS_FLEET_MAX_WORKERS 8U
+#define OPENUPS_FLEET_MAX_TARGETS 65536U
+#define OPENUPS_FLEET_HIST_BUCKETS 256U
+#define OPENUPS_FLEET_CACHELINE 64
+
+/* Cold per-target data, shared read-only by all threads after init. */
+typedef struct {
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+  char name[64]; /* canonical text form of the address */
+} fleet_target_t;
+
+typedef enum {
+  FLEET_EVENT_DOWN = 1, /* failure streak reached the threshold */
+  FLEET_EVENT_UP = 2,   /* first reply after being down */
+} fleet_event_kind_t;
+
+typedef struct {
+  uint32_t target;
+  uint16_t kind;
+  uint16_t worker;
+  uint32_t streak;
+  uint32_t rtt_us;
+} fleet_event_t;
+
+/* Single-producer/single-consumer ring from one worker to the aggregator.
+ * The worker owns tail, the aggregator owns head; both indices grow
+ * monotonically and live on separate cache lines. */
+typedef struct {
+  alignas(OPENUPS_FLEET_CACHELINE) _Atomic size_t head;
+  alignas(OPENUPS_FLEET_CACHELINE) _Atomic size_t tail;
+  alignas(OPENUPS_FLEET_CACHELINE) size_t mask;
+  fleet_event_t *slots;
+} fleet_ring_t;
+
+static inline bool fleet_ring_push(fleet_ring_t *restrict ring,
+                                   const fleet_event_t *restrict event) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (tail - head > ring->mask) {
+    return false;
+  }
+  ring->slots[tail & ring->mask] = *event;
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+static inline bool fleet_ring_pop(fleet_ring_t *restrict ring,
+                                  fleet_event_t *restrict out) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+  *out = ring->slots[head & ring->mask];
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  return true;
+}
+
+/* Log-linear histogram in microseconds: exact below 8, then 8 sub-buckets
+ * per power of two (<= 12.5% relative error). */
+typedef struct {
+  _Atomic uint64_t buckets[OPENUPS_FLEET_HIST_BUCKETS];
+} fleet_histogram_t;
+
+static inline unsigned fleet_histogram_index(uint64_t value) {
+  if (value < 8) {
+    return (unsigned)value;
+  }
+  unsigned msb = 63U - (unsigned)__builtin_clzll(value);
+  unsigned index = (msb - 2U) * 8U + (unsigned)((value >> (msb - 3U)) & 7U);
+  return index < OPENUPS_FLEET_HIST_BUCKETS ? index
+                                            : OPENUPS_FLEET_HIST_BUCKETS - 1U;
+}
+
+static inline uint64_t fleet_histogram_bucket_floor(unsigned index) {
+  if (index < 8) {
+    return index;
+  }
+  unsigned msb = index / 8U + 2U;
+  return (UINT64_C(8) + (index & 7U)) << (msb - 3U);
+}
+
+/* Single writer per histogram: a relaxed load/store pair avoids a locked
+ * read-modify-write on the hot path. */
+static inline void fleet_histogram_record(fleet_histogram_t *restrict hist,
+                                          uint64_t value) {
+  _Atomic uint64_t *bucket = &hist->buckets[fleet_histogram_index(value)];
+  atomic_store_explicit(
+      bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1,
+      memory_order_relaxed);
+}
+
+/* Written by the owning worker only, read by the aggregator. */
+typedef struct {
+  _Atomic uint64_t sent;
+  _Atomic uint64_t received;
+  _Atomic uint64_t timeouts;
+  _Atomic uint64_t send_errors;
+  _Atomic uint64_t dropped_events;
+  fleet_histogram_t schedule_error; /* actual send time - due time */
+} fleet_worker_stats_t;
+
+/* Hot per-target state of one worker as struct-of-arrays columns, so the
+ * timer heap and the reply path each stream only the fields they touch.
+ * Cold data (address, name) stays in fleet_target_t. */
+typedef struct {
+  uint32_t count;
+  uint64_t *due_us;       /* next send, or reply deadline while in flight */
+  uint64_t *scheduled_us; /* nominal time of the next or in-flight send */
+  uint64_t *sent_us;
+  uint32_t *last_rtt_us;
+  uint32_t *streak;
+  uint32_t *heap_index;
+  uint32_t *target;   /* index into fleet_t.targets */
+  uint16_t *sequence; /* in flight, 0 = idle */
+  bool *down;
+} fleet_table_t;
+
+typedef struct {
+  icmp_reply_key_t key;
+  uint32_t slot; /* slot + 1, 0 = empty */
+} fleet_reply_entry_t;
+
+/* Open-addressing (linear probing) map from reply key to in-flight slot.
+ * Sized for one outstanding probe per slot at <= 50% load; deletion shifts
+ * entries back, so there are no tombstones to clean up. */
+typedef struct {
+  fleet_reply_entry_t *entries;
+  uint32_t mask;
+  uint32_t used;
+} fleet_reply_map_t;
+
+struct fleet;
+
+typedef struct {
+  struct fleet *fleet;
+  pthread_t thread;
+  bool thread_started;
+  unsigned index;
+  int cpu; /* pinned core, -1 = unpinned */
+  uint16_t identifier;
+  icmp_pinger_t pinger4;
+  icmp_pinger_t pinger6;
+  uint8_t *send_buf; /* probe packet shared by both pingers */
+  size_t send_capacity;
+  packet_ring_t capture; /* fd -1 unless config.packet_ring */
+  fleet_table_t table;
+  uint32_t *heap; /* min-heap of slots keyed by table.due_us */
+  fleet_reply_map_t replies;
+  pacer_t pacer; /* caps the send rate at FLEET_PACER_HEADROOM x average */
+  fleet_ring_t ring;
+  fleet_worker_stats_t stats;
+} fleet_worker_t;
+
+typedef struct fleet {
+  config_t config;
+  logger_t logger;
+  fleet_target_t *targets;
+  uint32_t target_count;
+  bool *target_down; /* global view, owned by the aggregator */
+  uint32_t down_count;
+  fleet_worker_t workers[OPENUPS_FLEET_MAX_WORKERS];
+  unsigned worker_count;
+  int wake_fd; /* eventfd: workers -> aggregator, "events pending" */
+  int stop_fd; /* eventfd: aggregator -> workers, level-triggered stop */
+  atomic_bool stop;
+  uint64_t host_seed; /* phase offsets, see pacer_phase_us() */
+  arena_t arena; /* targets, tables, heaps, reply maps and rings */
+} fleet_t;
+
+typedef struct {
+  uint64_t sent;
+  uint64_t received;
+  uint64_t timeouts;
+  uint64_t send_errors;
+  uint64_t dropped_events;
+  uint64_t schedule_samples;
+  uint64_t schedule_buckets[OPENUPS_FLEET_HIST_BUCKETS];
+} fleet_stats_t;
+
+[[nodiscard]] bool fleet_targets_load(const char *restrict path,
+                                      fleet_target_t **restrict out_targets,
+                                      uint32_t *restrict out_count,
+                                      char *restrict error_msg,
+                                      size_t error_size);
+[[nodiscard]] bool fleet_reply_map_layout(size_t *restrict total,
+                                          uint32_t max_entries);
+[[nodiscard]] bool fleet_reply_map_init(fleet_reply_map_t *restrict map,
+                                        arena_t *restrict arena,
+                                        uint32_t max_entries);
+[[nodiscard]] bool fleet_reply_map_insert(fleet_reply_map_t *restrict map,
+                                          const icmp_reply_key_t *restrict key,
+                                          uint32_t slot);
+[[nodiscard]] bool fleet_reply_map_take(fleet_reply_map_t *restrict map,
+                                        const icmp_reply_key_t *restrict key,
+                                        uint32_t *restrict out_slot);
+[[nodiscard]] bool fleet_init(fleet_t *restrict fleet,
+                              const config_t *restrict config,
+                              fleet_target_t *targets, uint32_t target_count,
+                              char *restrict error_msg, size_t error_size);
+[[nodiscard]] bool fleet_start(fleet_t *restrict fleet,
+                               char *restrict error_msg, size_t error_size);
+size_t fleet_drain(fleet_t *restrict fleet);
+void fleet_stop(fleet_t *restrict fleet);
+void fleet_destroy(fleet_t *restrict fleet);
+void fleet_stats_collect(const fleet_t *restrict fleet,
+                         fleet_stats_t *restrict out);
+void fleet_stats_delta(const fleet_stats_t *restrict after,
+                       const fleet_stats_t *restrict before,
+                       fleet_stats_t *restrict out);
+uint64_t fleet_stats_percentile(const fleet_stats_t *restrict stats,
+                                double percentile);
+int openups_fleet_run(const config_t *restrict config);
+
+#endif // OPENUPS_FLEET_H
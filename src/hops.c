@@ -0,0 +1,189 @@
+#include "openups.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+bool hop_sweep_init(hop_sweep_t *restrict sweep, int family,
+                    uint16_t identifier, char *restrict error_msg,
+                    size_t error_size) {
+  if (sweep == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  memset(sweep, 0, sizeof(*sweep));
+  sweep->pinger.sockfd = -1;
+  sweep->identifier = identifier;
+  if (!icmp_pinger_init(&sweep->pinger, family, error_msg, error_size)) {
+    return false;
+  }
+  /* Unconnected: the answers come from routers, not from the target. */
+  if (!icmp_pinger_filter_hops(&sweep->pinger, identifier)) {
+    snprintf(error_msg, error_size, "Failed to filter hop sweep socket: %s",
+             strerror(errno));
+    hop_sweep_destroy(sweep);
+    return false;
+  }
+  icmp_pinger_set_send_buffer(&sweep->pinger, sweep->send_buf,
+                              sizeof(sweep->send_buf));
+  return true;
+}
+
+void hop_sweep_destroy(hop_sweep_t *restrict sweep) {
+  if (sweep == NULL) {
+    return;
+  }
+  icmp_pinger_destroy(&sweep->pinger);
+  sweep->pinger.sockfd = -1;
+  sweep->active = false;
+}
+
+/* Sends TTL 1..max_ttl back to back; the sequence of each is kept, since
+ * the pinger's counter skips 0 on wrap. */
+bool hop_sweep_start(hop_sweep_t *restrict sweep,
+                     const struct sockaddr_storage *restrict dest_addr,
+                     socklen_t dest_addr_len, uint32_t max_ttl,
+                     char *restrict error_msg, size_t error_size) {
+  if (sweep == NULL || dest_addr == NULL || error_msg == NULL ||
+      error_size == 0 || sweep->pinger.sockfd < 0) {
+    return false;
+  }
+  if (max_ttl == 0 || max_ttl > OPENUPS_HOP_MAX) {
+    max_ttl = OPENUPS_HOP_MAX;
+  }
+  sweep->active = false;
+  sweep->answered = 0;
+  sweep->reached = 0;
+  sweep->unreachable = 0;
+  sweep->max_ttl = 0;
+  memset(sweep->hops, 0, sizeof(sweep->hops));
+  for (uint32_t ttl = 1; ttl <= max_ttl; ttl++) {
+    if (!icmp_pinger_set_ttl(&sweep->pinger, (int)ttl)) {
+      snprintf(error_msg, error_size, "Failed to set TTL %u: %s", ttl,
+               strerror(errno));
+      return false;
+    }
+    if (!icmp_pinger_send_echo(&sweep->pinger, dest_addr, dest_addr_len,
+                               sweep->identifier, sizeof(sweep->send_buf),
+                               error_msg, error_size)) {
+      /* Later hops may still have gone out; sweep what was sent. */
+      if (sweep->max_ttl > 0) {
+        break;
+      }
+      return false;
+    }
+    sweep->sequences[ttl - 1] = icmp_pinger_current_sequence(&sweep->pinger);
+    sweep->max_ttl = ttl;
+  }
+  sweep->active = true;
+  return true;
+}
+
+/* Files one answer under the TTL its sequence was sent with.  Returns true
+ * when it belonged to the current sweep. */
+bool hop_sweep_record(hop_sweep_t *restrict sweep,
+                      const icmp_hop_reply_t *restrict reply) {
+  if (sweep == NULL || reply == NULL || !sweep->active ||
+      reply->identifier != sweep->identifier) {
+    return false;
+  }
+  for (uint32_t i = 0; i < sweep->max_ttl; i++) {
+    if (sweep->sequences[i] != reply->sequence) {
+      continue;
+    }
+    uint32_t ttl = i + 1;
+    if ((sweep->answered & (UINT64_C(1) << i)) == 0) {
+      sweep->answered |= UINT64_C(1) << i;
+      sweep->hops[i] = reply->source;
+    }
+    if (reply->kind == ICMP_HOP_ECHO_REPLY &&
+        (sweep->reached == 0 || ttl < sweep->reached)) {
+      sweep->reached = ttl;
+    } else if (reply->kind == ICMP_HOP_UNREACHABLE &&
+               (sweep->unreachable == 0 || ttl < sweep->unreachable)) {
+      sweep->unreachable = ttl;
+    }
+    return true;
+  }
+  return false;
+}
+
+/* The target itself, or the router that reported it unreachable; 0 while
+ * neither has answered. */
+static uint32_t hop_sweep_path_end(const hop_sweep_t *restrict sweep) {
+  uint32_t end = sweep->reached;
+  if (sweep->unreachable != 0 && (end == 0 || sweep->unreachable < end)) {
+    end = sweep->unreachable;
+  }
+  return end;
+}
+
+/* Complete once every TTL up to the end of the path has answered.
+ * Otherwise the sweep runs until the caller's deadline. */
+bool hop_sweep_complete(const hop_sweep_t *restrict sweep) {
+  if (sweep == NULL || !sweep->active) {
+    return false;
+  }
+  uint32_t end = hop_sweep_path_end(sweep);
+  if (end == 0) {
+    return sweep->max_ttl > 0 &&
+           sweep->answered == (UINT64_C(1) << sweep->max_ttl) - 1;
+  }
+  uint64_t needed = (UINT64_C(1) << end) - 1;
+  return (sweep->answered & needed) == needed;
+}
+
+/* Highest TTL answered up to the end of the path, 0 if none. */
+uint32_t hop_sweep_last_hop(const hop_sweep_t *restrict sweep) {
+  if (sweep == NULL) {
+    return 0;
+  }
+  uint32_t limit = hop_sweep_path_end(sweep);
+  if (limit == 0) {
+    limit = sweep->max_ttl;
+  }
+  for (uint32_t ttl = limit; ttl > 0; ttl--) {
+    if ((sweep->answered & (UINT64_C(1) << (ttl - 1))) != 0) {
+      return ttl;
+    }
+  }
+  return 0;
+}
+
+static void hop_sweep_format_addr(const struct sockaddr_storage *restrict addr,
+                                  char *restrict buffer, size_t size) {
+  const void *bytes = addr->ss_family == AF_INET6
+                          ? (const void *)&((const struct sockaddr_in6 *)addr)
+                                ->sin6_addr
+                          : (const void *)&((const struct sockaddr_in *)addr)
+                                ->sin_addr;
+  if (inet_ntop(addr->ss_family, bytes, buffer, (socklen_t)size) == NULL) {
+    snprintf(buffer, size, "?");
+  }
+}
+
+/* "1 10.0.0.1, 2 *, 3 192.0.2.1" up to the last hop that answered. */
+void hop_sweep_describe(const hop_sweep_t *restrict sweep,
+                        char *restrict buffer, size_t size) {
+  if (buffer == NULL || size == 0) {
+    return;
+  }
+  buffer[0] = '\0';
+  if (sweep == NULL) {
+    return;
+  }
+  uint32_t last = hop_sweep_last_hop(sweep);
+  size_t used = 0;
+  for (uint32_t ttl = 1; ttl <= last && used < size; ttl++) {
+    char addr[INET6_ADDRSTRLEN] = "*";
+    if ((sweep->answered & (UINT64_C(1) << (ttl - 1))) != 0) {
+      hop_sweep_format_addr(&sweep->hops[ttl - 1], addr, sizeof(addr));
+    }
+    int written = snprintf(buffer + used, size - used, "%s%u %s",
+                           ttl > 1 ? ", " : "", ttl, addr);
+    if (written < 0) {
+      return;
+    }
+    used += (size_t)written;
+  }
+}
@@ -1,38 +1,18 @@
+#define _GNU_SOURCE /* recvmmsg */
 #include "openups.h"
+#include "usdt.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <linux/filter.h>
 
 #include <netinet/ip.h>
+#include <netinet/ip6.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
-/* ICMP checksum — RFC 1071 one's-complement sum.  Internal to icmp.c.
- * Reads 16-bit words in native byte order (matches how the kernel verifies),
- * stores the result as a native uint16_t — no htons() needed. */
-static uint16_t calculate_checksum(const void *data, size_t len) {
-  const uint8_t *bytes = (const uint8_t *)data;
-  uint32_t sum = 0;
-
-  for (size_t i = 0; i + 1 < len; i += 2) {
-    uint16_t word;
-    memcpy(&word, bytes + i, sizeof(word));
-    sum += word;
-  }
-
-  if (len % 2) {
-    sum += bytes[len - 1];
-  }
-
-  while (sum >> 16) {
-    sum = (sum & 0xFFFF) + (sum >> 16);
-  }
-
-  return (uint16_t)(~sum);
-}
-
 static bool icmp_validate_send_args(const icmp_pinger_t *restrict pinger,
                                     const struct sockaddr_storage *restrict
                                         dest_addr,
@@ -57,80 +37,171 @@ static bool icmp_validate_send_args(const icmp_pinger_t *restrict pinger,
   return true;
 }
 
-static bool icmp_receive_source_matches(
-    const struct sockaddr_storage *restrict dest_addr,
-    const struct sockaddr_storage *restrict recv_addr) {
-  if (dest_addr == NULL || recv_addr == NULL ||
-      recv_addr->ss_family != dest_addr->ss_family) {
-    return false;
-  }
-
-  if (dest_addr->ss_family == AF_INET) {
-    const struct sockaddr_in *dest4 = (const struct sockaddr_in *)dest_addr;
-    const struct sockaddr_in *recv4 = (const struct sockaddr_in *)recv_addr;
-    return dest4->sin_addr.s_addr == recv4->sin_addr.s_addr;
-  }
-
-  const struct sockaddr_in6 *dest6 = (const struct sockaddr_in6 *)dest_addr;
-  const struct sockaddr_in6 *recv6 = (const struct sockaddr_in6 *)recv_addr;
-  return memcmp(&dest6->sin6_addr, &recv6->sin6_addr,
-                sizeof(dest6->sin6_addr)) == 0;
-}
-
-static icmp_receive_status_t parse_ipv4_reply(const uint8_t *restrict recv_buf,
-                                              size_t received,
-                                              uint16_t identifier,
-                                              uint16_t expected_sequence) {
+/* Extracts identifier and sequence of an IPv4 echo reply (IP header
+ * included, as delivered on raw sockets). */
+static bool extract_ipv4_echo(const uint8_t *restrict recv_buf,
+                              size_t received, uint16_t *restrict identifier,
+                              uint16_t *restrict sequence) {
   if (recv_buf == NULL || received < sizeof(struct ip)) {
-    return ICMP_RECEIVE_IGNORED;
+    return false;
   }
 
   const struct ip *ip_hdr = (const struct ip *)recv_buf;
   if (ip_hdr->ip_p != IPPROTO_ICMP) {
-    return ICMP_RECEIVE_IGNORED;
+    return false;
   }
 
   size_t ip_hdr_len = (size_t)ip_hdr->ip_hl * 4;
   if (ip_hdr_len < sizeof(struct ip) || ip_hdr_len > received ||
       ip_hdr_len + sizeof(struct icmphdr) > received) {
-    return ICMP_RECEIVE_IGNORED;
+    return false;
   }
 
   const struct icmphdr *icmp_hdr =
       (const struct icmphdr *)(recv_buf + ip_hdr_len);
   if (icmp_hdr->type != ICMP_ECHOREPLY) {
-    return ICMP_RECEIVE_IGNORED;
-  }
-  if (ntohs(icmp_hdr->un.echo.id) != identifier) {
-    return ICMP_RECEIVE_IGNORED;
-  }
-  if (ntohs(icmp_hdr->un.echo.sequence) != expected_sequence) {
-    return ICMP_RECEIVE_IGNORED;
+    return false;
   }
-
-  return ICMP_RECEIVE_MATCHED;
+  *identifier = ntohs(icmp_hdr->un.echo.id);
+  *sequence = ntohs(icmp_hdr->un.echo.sequence);
+  return true;
 }
 
-static icmp_receive_status_t parse_ipv6_reply(const uint8_t *restrict recv_buf,
-                                              size_t received,
-                                              uint16_t identifier,
-                                              uint16_t expected_sequence) {
+/* ICMPv6 raw sockets deliver the message without the IPv6 header. */
+static bool extract_ipv6_echo(const uint8_t *restrict recv_buf,
+                              size_t received, uint16_t *restrict identifier,
+                              uint16_t *restrict sequence) {
   if (recv_buf == NULL || received < sizeof(struct icmp6_hdr)) {
-    return ICMP_RECEIVE_IGNORED;
+    return false;
   }
 
   const struct icmp6_hdr *icmp6_hdr = (const struct icmp6_hdr *)recv_buf;
   if (icmp6_hdr->icmp6_type != ICMP6_ECHO_REPLY) {
-    return ICMP_RECEIVE_IGNORED;
+    return false;
   }
-  if (ntohs(icmp6_hdr->icmp6_id) != identifier) {
-    return ICMP_RECEIVE_IGNORED;
+  *identifier = ntohs(icmp6_hdr->icmp6_id);
+  *sequence = ntohs(icmp6_hdr->icmp6_seq);
+  return true;
+}
+
+/* Extracts identifier and sequence of the echo request an ICMPv4 Time
+ * Exceeded or Destination Unreachable quotes (RFC 792: IP header plus the
+ * first 8 bytes of the datagram). */
+static bool extract_ipv4_quoted_echo(const uint8_t *restrict recv_buf,
+                                     size_t received,
+                                     uint16_t *restrict identifier,
+                                     uint16_t *restrict sequence,
+                                     icmp_hop_kind_t *restrict kind) {
+  if (received < sizeof(struct ip)) {
+    return false;
   }
-  if (ntohs(icmp6_hdr->icmp6_seq) != expected_sequence) {
-    return ICMP_RECEIVE_IGNORED;
+  const struct ip *ip_hdr = (const struct ip *)recv_buf;
+  size_t ip_hdr_len = (size_t)ip_hdr->ip_hl * 4;
+  if (ip_hdr->ip_p != IPPROTO_ICMP || ip_hdr_len < sizeof(struct ip) ||
+      ip_hdr_len + sizeof(struct icmphdr) + sizeof(struct ip) > received) {
+    return false;
+  }
+  const struct icmphdr *icmp_hdr =
+      (const struct icmphdr *)(recv_buf + ip_hdr_len);
+  if (icmp_hdr->type == ICMP_TIME_EXCEEDED) {
+    *kind = ICMP_HOP_TIME_EXCEEDED;
+  } else if (icmp_hdr->type == ICMP_DEST_UNREACH) {
+    *kind = ICMP_HOP_UNREACHABLE;
+  } else {
+    return false;
   }
 
-  return ICMP_RECEIVE_MATCHED;
+  const uint8_t *quoted = recv_buf + ip_hdr_len + sizeof(struct icmphdr);
+  size_t quoted_len = received - ip_hdr_len - sizeof(struct icmphdr);
+  const struct ip *inner = (const struct ip *)quoted;
+  size_t inner_len = (size_t)inner->ip_hl * 4;
+  if (inner->ip_p != IPPROTO_ICMP || inner_len < sizeof(struct ip) ||
+      inner_len + sizeof(struct icmphdr) > quoted_len) {
+    return false;
+  }
+  const struct icmphdr *echo = (const struct icmphdr *)(quoted + inner_len);
+  if (echo->type != ICMP_ECHO) {
+    return false;
+  }
+  *identifier = ntohs(echo->un.echo.id);
+  *sequence = ntohs(echo->un.echo.sequence);
+  return true;
+}
+
+/* The ICMPv6 counterpart (RFC 4443); the quoted request is assumed to
+ * carry no extension headers, as ours never do. */
+static bool extract_ipv6_quoted_echo(const uint8_t *restrict recv_buf,
+                                     size_t received,
+                                     uint16_t *restrict identifier,
+                                     uint16_t *restrict sequence,
+                                     icmp_hop_kind_t *restrict kind) {
+  size_t quoted = sizeof(struct icmp6_hdr) + sizeof(struct ip6_hdr);
+  if (received < quoted + sizeof(struct icmp6_hdr)) {
+    return false;
+  }
+  const struct icmp6_hdr *icmp6_hdr = (const struct icmp6_hdr *)recv_buf;
+  if (icmp6_hdr->icmp6_type == ICMP6_TIME_EXCEEDED) {
+    *kind = ICMP_HOP_TIME_EXCEEDED;
+  } else if (icmp6_hdr->icmp6_type == ICMP6_DST_UNREACH) {
+    *kind = ICMP_HOP_UNREACHABLE;
+  } else {
+    return false;
+  }
+  const struct ip6_hdr *inner =
+      (const struct ip6_hdr *)(recv_buf + sizeof(struct icmp6_hdr));
+  const struct icmp6_hdr *echo = (const struct icmp6_hdr *)(recv_buf + quoted);
+  if (inner->ip6_nxt != IPPROTO_ICMPV6 ||
+      echo->icmp6_type != ICMP6_ECHO_REQUEST) {
+    return false;
+  }
+  *identifier = ntohs(echo->icmp6_id);
+  *sequence = ntohs(echo->icmp6_seq);
+  return true;
+}
+
+/* IPv6 raw sockets strip the header, so the hop limit only arrives as
+ * ancillary data. */
+static void icmp_enable_hop_limit(int sockfd, int family) {
+  if (family != AF_INET6) {
+    return;
+  }
+  int on = 1;
+  /* Non-fatal: without it the reply TTL is simply unknown */
+  (void)setsockopt(sockfd, IPPROTO_IPV6, IPV6_RECVHOPLIMIT, &on, sizeof(on));
+}
+
+/* TTL the reply arrived with, from the IPv4 header or the IPV6_HOPLIMIT
+ * control message; 0 when neither is present. */
+static uint8_t icmp_reply_ttl(const uint8_t *restrict recv_buf, int family,
+                              struct msghdr *restrict msg) {
+  if (family == AF_INET) {
+    return ((const struct ip *)recv_buf)->ip_ttl;
+  }
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    if (cmsg->cmsg_level == IPPROTO_IPV6 &&
+        cmsg->cmsg_type == IPV6_HOPLIMIT) {
+      int hop_limit = 0;
+      memcpy(&hop_limit, CMSG_DATA(cmsg), sizeof(hop_limit));
+      return hop_limit > 0 && hop_limit <= 255 ? (uint8_t)hop_limit : 0;
+    }
+  }
+  return 0;
+}
+
+/* Kernel receive time from the SCM_TIMESTAMPNS control message, in
+ * CLOCK_REALTIME nanoseconds; 0 when the socket does not request it. */
+static uint64_t icmp_receive_time_ns(struct msghdr *restrict msg) {
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      struct timespec stamp;
+      memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+      return (uint64_t)stamp.tv_sec * UINT64_C(1000000000) +
+             (uint64_t)stamp.tv_nsec;
+    }
+  }
+  return 0;
 }
 
 bool icmp_pinger_init(icmp_pinger_t *restrict pinger, int family,
@@ -142,6 +213,8 @@ bool icmp_pinger_init(icmp_pinger_t *restrict pinger, int family,
   pinger->sockfd = -1;
   pinger->family = family;
   pinger->sequence = 0;
+  pinger->send_buf = NULL;
+  pinger->send_capacity = 0;
 
   int proto = (family == AF_INET6) ? IPPROTO_ICMPV6 : IPPROTO_ICMP;
 
@@ -156,6 +229,8 @@ bool icmp_pinger_init(icmp_pinger_t *restrict pinger, int family,
     return false;
   }
 
+  icmp_enable_hop_limit(pinger->sockfd, family);
+
   /* Attach kernel BPF filter to drop irrelevant ICMP packets (Phase 2
    * optimization) */
   if (family == AF_INET) {
@@ -232,7 +307,8 @@ bool icmp_pinger_send_echo(icmp_pinger_t *restrict pinger,
     return false;
   }
 
-  if (packet_len == 0 || packet_len > sizeof(pinger->send_buf)) {
+  if (packet_len < OPENUPS_PROBE_HEADER_LEN ||
+      packet_len > pinger->send_capacity) {
     snprintf(error_msg, error_size, "Invalid ICMP packet size: %zu",
              packet_len);
     return false;
@@ -254,22 +330,28 @@ bool icmp_pinger_send_echo(icmp_pinger_t *restrict pinger,
     icmp_hdr->code = 0;
     icmp_hdr->un.echo.id = htons(identifier);
     icmp_hdr->un.echo.sequence = htons(pinger->sequence);
-    icmp_hdr->checksum = calculate_checksum(pinger->send_buf, packet_len);
+    icmp_hdr->checksum = icmp_checksum(pinger->send_buf, packet_len);
   }
 
   ssize_t sent = sendto(pinger->sockfd, pinger->send_buf, packet_len,
                         MSG_NOSIGNAL, (const struct sockaddr *)dest_addr,
                         dest_addr_len);
   if (sent < 0) {
+    /* errno survives for callers that act on it (EMSGSIZE: path MTU) */
+    int send_errno = errno;
+    OPENUPS_USDT(echo_send, (uintptr_t)dest_addr, identifier,
+                 pinger->sequence, packet_len, send_errno);
     snprintf(error_msg, error_size, "Failed to send packet: %s",
-             strerror(errno));
+             strerror(send_errno));
+    errno = send_errno;
     return false;
   }
   if ((size_t)sent != packet_len) {
     snprintf(error_msg, error_size, "Short ICMP send: %zd", sent);
     return false;
   }
-
+  OPENUPS_USDT(echo_send, (uintptr_t)dest_addr, identifier, pinger->sequence,
+               packet_len, 0);
   return true;
 }
 
@@ -282,14 +364,26 @@ icmp_receive_status_t icmp_pinger_receive_reply(
     return ICMP_RECEIVE_ERROR;
   }
 
-  /* 1500 bytes covers the largest standard Ethernet-MTU ICMP reply we expect.
-   * Align to 16 so IP/ICMP header accesses are naturally aligned. */
+  /* 1500 bytes covers the largest standard Ethernet-MTU ICMP reply we expect;
+   * larger echoes (--payload-size) arrive truncated, which is harmless since
+   * only the headers are read.  Align to 16 so IP/ICMP header accesses are
+   * naturally aligned. */
   uint8_t recv_buf[1500] __attribute__((aligned(16)));
   struct sockaddr_storage recv_addr;
-  socklen_t recv_addr_len = sizeof(recv_addr);
-
-  ssize_t received = recvfrom(pinger->sockfd, recv_buf, sizeof(recv_buf), 0,
-                              (struct sockaddr *)&recv_addr, &recv_addr_len);
+  uint8_t control[CMSG_SPACE(sizeof(int)) +
+                  CMSG_SPACE(sizeof(struct timespec))]
+      __attribute__((aligned(8)));
+  struct iovec iov = {.iov_base = recv_buf, .iov_len = sizeof(recv_buf)};
+  struct msghdr msg = {
+      .msg_name = &recv_addr,
+      .msg_namelen = sizeof(recv_addr),
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control,
+      .msg_controllen = sizeof(control),
+  };
+
+  ssize_t received = recvmsg(pinger->sockfd, &msg, 0);
   if (received < 0) {
     if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
       return ICMP_RECEIVE_NO_MORE;
@@ -302,29 +396,334 @@ icmp_receive_status_t icmp_pinger_receive_reply(
     return ICMP_RECEIVE_ERROR;
   }
 
-  if (received == 0 || !icmp_receive_source_matches(dest_addr, &recv_addr)) {
+  uint16_t reply_id = 0;
+  uint16_t reply_seq = 0;
+  bool echo = false;
+  if (received > 0 && recv_addr.ss_family == AF_INET) {
+    echo = extract_ipv4_echo(recv_buf, (size_t)received, &reply_id,
+                             &reply_seq);
+  } else if (received > 0 && recv_addr.ss_family == AF_INET6) {
+    echo = extract_ipv6_echo(recv_buf, (size_t)received, &reply_id,
+                             &reply_seq);
+  }
+  if (!echo) {
+    return ICMP_RECEIVE_IGNORED;
+  }
+
+  /* Same key the fleet reply table hashes: source, identifier, sequence. */
+  icmp_reply_key_t expected;
+  icmp_reply_key_t actual;
+  icmp_reply_key_init(&expected, dest_addr, identifier, expected_sequence);
+  icmp_reply_key_init(&actual, &recv_addr, reply_id, reply_seq);
+  if (!icmp_reply_key_equal(&expected, &actual)) {
     return ICMP_RECEIVE_IGNORED;
   }
 
-  icmp_receive_status_t status = ICMP_RECEIVE_IGNORED;
-  if (dest_addr->ss_family == AF_INET) {
-    status = parse_ipv4_reply(recv_buf, (size_t)received, identifier,
-                              expected_sequence);
-  } else if (dest_addr->ss_family == AF_INET6) {
-    status = parse_ipv6_reply(recv_buf, (size_t)received, identifier,
-                              expected_sequence);
+  out_result->success = true;
+  /* Guard against impossible clock skew before recording latency. */
+  out_result->latency_ms =
+      (now_ms >= send_time_ms) ? (double)(now_ms - send_time_ms) : 0.0;
+  out_result->error_msg[0] = '\0';
+  out_result->reply_ttl = icmp_reply_ttl(recv_buf, recv_addr.ss_family, &msg);
+  out_result->receive_ns = icmp_receive_time_ns(&msg);
+  OPENUPS_USDT(echo_reply, (uintptr_t)dest_addr, identifier, reply_seq,
+               (now_ms - send_time_ms) * UINT64_C(1000000),
+               out_result->reply_ttl);
+  return ICMP_RECEIVE_MATCHED;
+}
+
+static void icmp_reply_key_set(icmp_reply_key_t *restrict key, int family,
+                               const void *restrict addr, uint16_t identifier,
+                               uint16_t sequence) {
+  memset(key, 0, sizeof(*key));
+  key->family = (uint16_t)family;
+  key->identifier = identifier;
+  key->sequence = sequence;
+  if (family == AF_INET) {
+    key->addr[10] = 0xFF;
+    key->addr[11] = 0xFF;
+    memcpy(&key->addr[12], addr, 4);
+  } else if (family == AF_INET6) {
+    memcpy(key->addr, addr, 16);
+  }
+}
+
+void icmp_reply_key_init(icmp_reply_key_t *restrict key,
+                         const struct sockaddr_storage *restrict addr,
+                         uint16_t identifier, uint16_t sequence) {
+  /* Never NULL, even for a family the key leaves zeroed: LTO cannot always
+   * see that icmp_reply_key_set() only copies for known families. */
+  const void *bytes = &((const struct sockaddr_in *)addr)->sin_addr;
+  if (addr->ss_family == AF_INET6) {
+    bytes = &((const struct sockaddr_in6 *)addr)->sin6_addr;
+  }
+  icmp_reply_key_set(key, addr->ss_family, bytes, identifier, sequence);
+}
+
+/* Parses an echo reply that starts at its IPv4 or IPv6 header (as captured
+ * on packet sockets) straight into a reply key.  IPv6 extension headers
+ * are not followed: echo replies do not carry them in practice. */
+bool icmp_parse_echo_packet(const uint8_t *restrict packet, size_t length,
+                            icmp_reply_key_t *restrict key) {
+  if (packet == NULL || key == NULL || length == 0) {
+    return false;
+  }
+
+  uint16_t identifier = 0;
+  uint16_t sequence = 0;
+  unsigned version = packet[0] >> 4;
+  if (version == 4) {
+    if (!extract_ipv4_echo(packet, length, &identifier, &sequence)) {
+      return false;
+    }
+    icmp_reply_key_set(key, AF_INET, packet + offsetof(struct ip, ip_src),
+                       identifier, sequence);
+    return true;
+  }
+  if (version == 6 && length >= sizeof(struct ip6_hdr) &&
+      packet[offsetof(struct ip6_hdr, ip6_nxt)] == IPPROTO_ICMPV6 &&
+      extract_ipv6_echo(packet + sizeof(struct ip6_hdr),
+                        length - sizeof(struct ip6_hdr), &identifier,
+                        &sequence)) {
+    icmp_reply_key_set(key, AF_INET6,
+                       packet + offsetof(struct ip6_hdr, ip6_src),
+                       identifier, sequence);
+    return true;
+  }
+  return false;
+}
+
+/* Drains up to max_replies datagrams with one recvmmsg() call and keeps
+ * the echo replies.  Returns how many were stored (0 also when the batch
+ * held only foreign traffic; level-triggered poll re-reports the rest), or
+ * -1 on socket error. */
+int icmp_pinger_receive_batch(const icmp_pinger_t *restrict pinger,
+                              icmp_echo_reply_t *restrict replies,
+                              size_t max_replies, char *restrict error_msg,
+                              size_t error_size) {
+  if (pinger == NULL || replies == NULL || error_msg == NULL ||
+      error_size == 0 || pinger->sockfd < 0) {
+    return -1;
+  }
+  if (max_replies > OPENUPS_ICMP_RECEIVE_BATCH) {
+    max_replies = OPENUPS_ICMP_RECEIVE_BATCH;
+  }
+
+  uint8_t recv_bufs[OPENUPS_ICMP_RECEIVE_BATCH][1500]
+      __attribute__((aligned(16)));
+  struct iovec iovs[OPENUPS_ICMP_RECEIVE_BATCH];
+  struct mmsghdr msgs[OPENUPS_ICMP_RECEIVE_BATCH];
+  for (size_t i = 0; i < max_replies; i++) {
+    iovs[i].iov_base = recv_bufs[i];
+    iovs[i].iov_len = sizeof(recv_bufs[i]);
+    memset(&msgs[i], 0, sizeof(msgs[i]));
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = &replies[i].source;
+    msgs[i].msg_hdr.msg_namelen = sizeof(replies[i].source);
+  }
+
+  int received = recvmmsg(pinger->sockfd, msgs, (unsigned int)max_replies,
+                          MSG_DONTWAIT, NULL);
+  if (received < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return 0;
+    }
+    snprintf(error_msg, error_size, "recvmmsg failed: %s", strerror(errno));
+    return -1;
+  }
+
+  /* Compact in place: non-echo traffic is dropped from the batch. */
+  int stored = 0;
+  for (int i = 0; i < received; i++) {
+    icmp_echo_reply_t *reply = &replies[stored];
+    bool ok = pinger->family == AF_INET6
+                  ? extract_ipv6_echo(recv_bufs[i], msgs[i].msg_len,
+                                      &reply->identifier, &reply->sequence)
+                  : extract_ipv4_echo(recv_bufs[i], msgs[i].msg_len,
+                                      &reply->identifier, &reply->sequence);
+    if (!ok || replies[i].source.ss_family != pinger->family) {
+      continue;
+    }
+    if (stored != i) {
+      reply->source = replies[i].source;
+    }
+    stored++;
+  }
+  return stored;
+}
+
+/* Narrows the echo-reply filter to one identifier, so threads sharing the
+ * host's ICMP traffic each wake only for their own replies. */
+bool icmp_pinger_filter_identifier(icmp_pinger_t *restrict pinger,
+                                   uint16_t identifier) {
+  if (pinger == NULL || pinger->sockfd < 0) {
+    return false;
+  }
+
+  struct sock_fprog fprog;
+  if (pinger->family == AF_INET) {
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),   /* X = IP header length */
+        BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),    /* A = ICMP type        */
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_ECHOREPLY, 0, 3),
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, 4),    /* A = echo identifier  */
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, identifier, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xffff),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    fprog.len = (unsigned short)(sizeof(filter) / sizeof(filter[0]));
+    fprog.filter = filter;
+    return setsockopt(pinger->sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+                      sizeof(fprog)) == 0;
+  }
+
+  struct sock_filter filter[] = {
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),      /* A = ICMPv6 type      */
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_ECHO_REPLY, 0, 3),
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),      /* A = echo identifier  */
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, identifier, 0, 1),
+      BPF_STMT(BPF_RET | BPF_K, 0xffff),
+      BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+  fprog.len = (unsigned short)(sizeof(filter) / sizeof(filter[0]));
+  fprog.filter = filter;
+  return setsockopt(pinger->sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+                    sizeof(fprog)) == 0;
+}
+
+/* For sockets that only send because a packet ring captures the replies:
+ * drop everything in the kernel instead of queueing copies nobody reads. */
+bool icmp_pinger_discard_replies(icmp_pinger_t *restrict pinger) {
+  if (pinger == NULL || pinger->sockfd < 0) {
+    return false;
   }
 
-  if (status == ICMP_RECEIVE_MATCHED) {
-    out_result->success = true;
-    /* Guard against impossible clock skew before recording latency. */
-    out_result->latency_ms = (now_ms >= send_time_ms)
-                                 ? (double)(now_ms - send_time_ms)
-                                 : 0.0;
-    out_result->error_msg[0] = '\0';
+  struct sock_filter filter[] = {
+      BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+  struct sock_fprog fprog = {
+      .len = (unsigned short)(sizeof(filter) / sizeof(filter[0])),
+      .filter = filter,
+  };
+  return setsockopt(pinger->sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+                    sizeof(fprog)) == 0;
+}
+
+/* For the hop sweep socket: our echo replies, and Time Exceeded or
+ * Destination Unreachable messages quoting one of our echo requests. */
+bool icmp_pinger_filter_hops(icmp_pinger_t *restrict pinger,
+                             uint16_t identifier) {
+  if (pinger == NULL || pinger->sockfd < 0) {
+    return false;
   }
 
-  return status;
+  struct sock_fprog fprog;
+  if (pinger->family == AF_INET) {
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),   /* X = IP header length */
+        BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),    /* A = ICMP type        */
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_ECHOREPLY, 8, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_TIME_EXCEEDED, 1, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_DEST_UNREACH, 0, 9),
+        BPF_STMT(BPF_LD | BPF_B | BPF_IND, 8),    /* quoted IP header     */
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x0f),
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 4),
+        BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+        BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 8),
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),          /* X = quoted echo      */
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, 4),    /* A = echo identifier  */
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, identifier, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xffff),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    fprog.len = (unsigned short)(sizeof(filter) / sizeof(filter[0]));
+    fprog.filter = filter;
+    return setsockopt(pinger->sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+                      sizeof(fprog)) == 0;
+  }
+
+  struct sock_filter filter[] = {
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),      /* A = ICMPv6 type      */
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_ECHO_REPLY, 4, 0),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_TIME_EXCEEDED, 1, 0),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_DST_UNREACH, 0, 5),
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 52),     /* quoted identifier:
+                                                     8 + 40 + 4          */
+      BPF_STMT(BPF_JMP | BPF_JA, 1),
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),      /* A = echo identifier  */
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, identifier, 0, 1),
+      BPF_STMT(BPF_RET | BPF_K, 0xffff),
+      BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+  fprog.len = (unsigned short)(sizeof(filter) / sizeof(filter[0]));
+  fprog.filter = filter;
+  return setsockopt(pinger->sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+                    sizeof(fprog)) == 0;
+}
+
+/* TTL (hop limit) of the echoes sent next. */
+bool icmp_pinger_set_ttl(icmp_pinger_t *restrict pinger, int ttl) {
+  if (pinger == NULL || pinger->sockfd < 0) {
+    return false;
+  }
+  if (pinger->family == AF_INET6) {
+    return setsockopt(pinger->sockfd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &ttl,
+                      sizeof(ttl)) == 0;
+  }
+  return setsockopt(pinger->sockfd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl)) ==
+         0;
+}
+
+/* Reads one datagram from a hop sweep socket: MATCHED with *reply filled
+ * for an echo reply or an error quoting an echo request, IGNORED for
+ * anything else. */
+icmp_receive_status_t icmp_pinger_receive_hop(
+    const icmp_pinger_t *restrict pinger, icmp_hop_reply_t *restrict reply,
+    char *restrict error_msg, size_t error_size) {
+  if (pinger == NULL || reply == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return ICMP_RECEIVE_ERROR;
+  }
+
+  /* Errors quote at most 576 (IPv4) or 1280 (IPv6) bytes in total. */
+  uint8_t recv_buf[1500] __attribute__((aligned(16)));
+  socklen_t source_len = sizeof(reply->source);
+  ssize_t received =
+      recvfrom(pinger->sockfd, recv_buf, sizeof(recv_buf), 0,
+               (struct sockaddr *)&reply->source, &source_len);
+  if (received < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return ICMP_RECEIVE_NO_MORE;
+    }
+    snprintf(error_msg, error_size, "recvfrom failed: %s", strerror(errno));
+    return ICMP_RECEIVE_ERROR;
+  }
+
+  size_t len = (size_t)received;
+  if (reply->source.ss_family == AF_INET) {
+    if (extract_ipv4_echo(recv_buf, len, &reply->identifier,
+                          &reply->sequence)) {
+      reply->kind = ICMP_HOP_ECHO_REPLY;
+      return ICMP_RECEIVE_MATCHED;
+    }
+    return extract_ipv4_quoted_echo(recv_buf, len, &reply->identifier,
+                                    &reply->sequence, &reply->kind)
+               ? ICMP_RECEIVE_MATCHED
+               : ICMP_RECEIVE_IGNORED;
+  }
+  if (reply->source.ss_family == AF_INET6) {
+    if (extract_ipv6_echo(recv_buf, len, &reply->identifier,
+                          &reply->sequence)) {
+      reply->kind = ICMP_HOP_ECHO_REPLY;
+      return ICMP_RECEIVE_MATCHED;
+    }
+    return extract_ipv6_quoted_echo(recv_buf, len, &reply->identifier,
+                                    &reply->sequence, &reply->kind)
+               ? ICMP_RECEIVE_MATCHED
+               : ICMP_RECEIVE_IGNORED;
+  }
+  return ICMP_RECEIVE_IGNORED;
 }
 
 bool resolve_target(const char *restrict target,
@@ -356,3 +755,61 @@ bool resolve_target(const char *restrict target,
            "Invalid IPv4/IPv6 address (DNS disabled): %s", target);
   return false;
 }
+
+/* Stamps every received datagram with the kernel's receive time, so a
+ * matched reply tells how long it waited for the reactor (receive_ns). */
+bool icmp_pinger_enable_timestamps(icmp_pinger_t *restrict pinger) {
+  if (pinger == NULL || pinger->sockfd < 0) {
+    return false;
+  }
+  int on = 1;
+  return setsockopt(pinger->sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &on,
+                    sizeof(on)) == 0;
+}
+
+/* Takes over a socket configured by a previous process (systemd fd store):
+ * the BPF filter and options travel with the socket, so only its identity
+ * is checked.  On failure the caller still owns fd. */
+bool icmp_pinger_adopt(icmp_pinger_t *restrict pinger, int fd, int family,
+                       char *restrict error_msg, size_t error_size) {
+  if (pinger == NULL || error_msg == NULL || error_size == 0 || fd < 0) {
+    return false;
+  }
+
+  int domain = -1;
+  int type = -1;
+  int protocol = -1;
+  socklen_t len = sizeof(int);
+  int expected_proto = (family == AF_INET6) ? IPPROTO_ICMPV6 : IPPROTO_ICMP;
+  if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &len) != 0 ||
+      (len = sizeof(int),
+       getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) != 0) ||
+      (len = sizeof(int),
+       getsockopt(fd, SOL_SOCKET, SO_PROTOCOL, &protocol, &len) != 0)) {
+    snprintf(error_msg, error_size, "Inherited fd %d is not a socket: %s", fd,
+             strerror(errno));
+    return false;
+  }
+  if (domain != family || type != SOCK_RAW || protocol != expected_proto) {
+    snprintf(error_msg, error_size,
+             "Inherited fd %d is not a raw ICMP socket for family %d", fd,
+             family);
+    return false;
+  }
+
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+    snprintf(error_msg, error_size, "Failed to set O_NONBLOCK on fd %d: %s",
+             fd, strerror(errno));
+    return false;
+  }
+
+  /* Sockets handed over by older builds lack the hop-limit option. */
+  icmp_enable_hop_limit(fd, family);
+  pinger->sockfd = fd;
+  pinger->family = family;
+  pinger->sequence = 0;
+  pinger->send_buf = NULL;
+  pinger->send_capacity = 0;
+  return true;
+}
@@ -1,5 +1,6 @@
 #include "openups.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 
 /* ---- Timing utilities ---- */
@@ -30,6 +31,41 @@ uint64_t get_monotonic_ms(void) {
   return timestamp;
 }
 
+/* Precise (non-coarse) clock for per-probe scheduling in fleet workers,
+ * where a 4ms coarse tick would dominate the measured scheduling error. */
+uint64_t get_monotonic_us(void) {
+  struct timespec ts;
+  if (OPENUPS_UNLIKELY(clock_gettime(CLOCK_MONOTONIC, &ts) != 0 ||
+                       ts.tv_sec < 0)) {
+    return UINT64_MAX;
+  }
+  uint64_t timestamp = 0;
+  if (OPENUPS_UNLIKELY(
+          ckd_mul(&timestamp, (uint64_t)ts.tv_sec, UINT64_C(1000000)) ||
+          ckd_add(&timestamp, timestamp,
+                  (uint64_t)ts.tv_nsec / UINT64_C(1000)))) {
+    return UINT64_MAX;
+  }
+  return timestamp;
+}
+
+/* Wall-clock milliseconds, for values that must outlive the process. */
+uint64_t get_realtime_ms(void) {
+  struct timespec ts;
+  if (OPENUPS_UNLIKELY(clock_gettime(CLOCK_REALTIME, &ts) != 0 ||
+                       ts.tv_sec < 0)) {
+    return UINT64_MAX;
+  }
+  uint64_t timestamp = 0;
+  if (OPENUPS_UNLIKELY(
+          ckd_mul(&timestamp, (uint64_t)ts.tv_sec, OPENUPS_MS_PER_SEC) ||
+          ckd_add(&timestamp, timestamp,
+                  (uint64_t)ts.tv_nsec / UINT64_C(1000000)))) {
+    return UINT64_MAX;
+  }
+  return timestamp;
+}
+
 char *get_timestamp_str(char *restrict buffer, size_t size) {
   if (OPENUPS_UNLIKELY(buffer == NULL || size == 0)) {
     return NULL;
@@ -60,6 +96,7 @@ void logger_init(logger_t *restrict logger, log_level_t level,
   }
   logger->level = level;
   logger->enable_timestamp = enable_timestamp;
+  logger->clock = NULL;
 }
 
 const char *log_level_to_string(log_level_t level) {
@@ -93,13 +130,17 @@ static void log_message(const logger_t *restrict logger, log_level_t level,
     return;
   }
   char timestamp[64];
-  if (logger->enable_timestamp) {
+  if (logger->clock != NULL) {
+    uint64_t now_ms = logger->clock->now_ms(logger->clock->backend_ctx);
+    snprintf(timestamp, sizeof(timestamp), "%10" PRIu64 ".%03" PRIu64,
+             now_ms / OPENUPS_MS_PER_SEC, now_ms % OPENUPS_MS_PER_SEC);
+  } else if (logger->enable_timestamp) {
     if (get_timestamp_str(timestamp, sizeof(timestamp)) == NULL) {
       timestamp[0] = '\0';
     }
   }
   const char *level_str = log_level_to_string(level);
-  if (logger->enable_timestamp) {
+  if (logger->clock != NULL || logger->enable_timestamp) {
     fprintf(stderr, "[%s] [%s] %s\n", timestamp, level_str, msg);
   } else {
     fprintf(stderr, "[%s] %s\n", level_str, msg);
@@ -1,5 +1,7 @@
 #include "openups.h"
+#include "fleet.h"
 #include "monitor.h"
+#include "sweep.h"
 
 int main(int argc, char **argv) {
   char error_msg[256];
@@ -16,6 +18,13 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  if (config.targets_file[0] != '\0') {
+    return openups_fleet_run(&config);
+  }
+  if (config.sweep_file[0] != '\0') {
+    return openups_sweep_run(&config);
+  }
+
   openups_ctx_t ctx;
   if (!openups_ctx_init(&ctx, &config, error_msg, sizeof(error_msg))) {
     logger_write(LOG_LEVEL_ERROR, config_log_timestamps_enabled(&config),
@@ -23,6 +32,7 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  openups_ctx_set_cmdline(&ctx, argc, argv);
   int rc = openups_reactor_run(&ctx);
   if (rc != 0) {
     logger_error(&ctx.logger, "OpenUPS exited with code %d", rc);
@@ -1,12 +1,18 @@
 #include "monitor.h"
+#include "usdt.h"
 
+#include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <poll.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
 #include <sys/signalfd.h>
 #include <unistd.h>
 
@@ -27,6 +33,8 @@ typedef struct {
 typedef struct {
   uint64_t next_ping_ms;
   uint64_t interval_ms;
+  /* --timer-slack: how early deferrable timers may fire to share a wakeup */
+  uint64_t slack_ms;
 } monitor_scheduler_state_t;
 
 typedef struct {
@@ -34,11 +42,39 @@ typedef struct {
   uint64_t interval_ms;
 } monitor_watchdog_state_t;
 
+/* A routine "OK" status held back in low-wakeup mode until the next
+ * watchdog kick (or the status interval without a watchdog). */
+typedef struct {
+  double latency_ms;
+  uint64_t sent_ms;
+  bool pending;
+} monitor_status_state_t;
+
+/* The path MTU probe in flight, tracked apart from the regular probe. */
+typedef struct {
+  uint64_t next_probe_ms;
+  uint64_t deadline_ms;
+  uint64_t send_time_ms;
+  uint16_t expected_sequence;
+  bool waiting;
+  bool enabled;
+} monitor_pmtu_state_t;
+
+/* The hop sweep in flight, started by the first failure of a streak. */
+typedef struct {
+  uint64_t deadline_ms;
+  uint64_t send_time_ms;
+  bool waiting;
+} monitor_hops_state_t;
+
 typedef struct {
   monitor_ping_state_t ping;
+  monitor_pmtu_state_t pmtu;
+  monitor_hops_state_t hops;
   monitor_shutdown_state_t shutdown;
   monitor_scheduler_state_t scheduler;
   monitor_watchdog_state_t watchdog;
+  monitor_status_state_t status;
 } monitor_state_t;
 
 typedef enum {
@@ -47,12 +83,14 @@ typedef enum {
   MONITOR_STEP_ERROR = 2,
 } monitor_step_result_t;
 
-#define OPENUPS_PACKET_SIZE 64U
 #define OPENUPS_MAX_REPLY_DRAIN_PER_TICK 32U
+/* Low-wakeup mode: routine status at least this often between kicks. */
+#define OPENUPS_COALESCED_STATUS_INTERVAL_MS (UINT64_C(60) * OPENUPS_MS_PER_SEC)
+#define OPENUPS_MS_PER_HOUR (UINT64_C(60) * OPENUPS_MS_PER_MINUTE)
 
 /* ---- Metrics (was metrics.c) — static ---- */
 
-static void metrics_init(metrics_t *metrics) {
+static void metrics_init(metrics_t *metrics, uint64_t now_ms) {
   if (metrics == NULL) {
     return;
   }
@@ -62,7 +100,10 @@ static void metrics_init(metrics_t *metrics) {
   metrics->total_latency = 0.0;
   metrics->min_latency = -1.0;
   metrics->max_latency = -1.0;
-  metrics->start_time_ms = get_monotonic_ms();
+  metrics->start_time_ms = now_ms;
+  metrics->send_lag_samples = 0;
+  metrics->send_lag_total_ms = 0;
+  metrics->send_lag_max_ms = 0;
 }
 
 static void metrics_record_success(metrics_t *metrics, double latency_ms) {
@@ -93,6 +134,17 @@ static void metrics_record_failure(metrics_t *metrics) {
   metrics->failed_pings++;
 }
 
+static void metrics_record_send_lag(metrics_t *metrics, uint64_t lag_ms) {
+  if (OPENUPS_UNLIKELY(metrics == NULL)) {
+    return;
+  }
+  metrics->send_lag_samples++;
+  metrics->send_lag_total_ms += lag_ms;
+  if (lag_ms > metrics->send_lag_max_ms) {
+    metrics->send_lag_max_ms = lag_ms;
+  }
+}
+
 static double metrics_success_rate(const metrics_t *metrics) {
   if (metrics == NULL || metrics->total_pings == 0) {
     return 0.0;
@@ -108,11 +160,19 @@ static double metrics_avg_latency(const metrics_t *metrics) {
   return metrics->total_latency / (double)metrics->successful_pings;
 }
 
-static uint64_t metrics_uptime_seconds(const metrics_t *metrics) {
+static double metrics_avg_send_lag(const metrics_t *metrics) {
+  if (metrics == NULL || metrics->send_lag_samples == 0) {
+    return 0.0;
+  }
+  return (double)metrics->send_lag_total_ms /
+         (double)metrics->send_lag_samples;
+}
+
+static uint64_t metrics_uptime_seconds(const metrics_t *metrics,
+                                       uint64_t now_ms) {
   if (metrics == NULL) {
     return 0;
   }
-  uint64_t now_ms = get_monotonic_ms();
   if (now_ms == UINT64_MAX || metrics->start_time_ms == UINT64_MAX ||
       now_ms < metrics->start_time_ms) {
     return 0;
@@ -120,6 +180,119 @@ static uint64_t metrics_uptime_seconds(const metrics_t *metrics) {
   return (now_ms - metrics->start_time_ms) / OPENUPS_MS_PER_SEC;
 }
 
+/* ---- Reactor self-instrumentation — static ---- */
+
+static const char *const reactor_wake_names[REACTOR_WAKE_COUNT] = {
+    "signal", "probe", "netlink", "pmtu", "hops", "timer",
+};
+
+static const char *const reactor_handler_names[REACTOR_HANDLER_COUNT] = {
+    "due-work", "signal", "reload", "netlink",
+    "probe",    "pmtu",   "hops",   "checkpoint",
+};
+
+static uint64_t reactor_timeval_us(struct timeval value) {
+  return (uint64_t)value.tv_sec * UINT64_C(1000000) + (uint64_t)value.tv_usec;
+}
+
+/* The daemon is single-threaded, so the process's usage is the reactor's. */
+static void reactor_usage_sample(reactor_usage_t *usage, long *max_rss_kb) {
+  struct rusage rusage;
+  if (getrusage(RUSAGE_SELF, &rusage) != 0) {
+    memset(&rusage, 0, sizeof(rusage));
+  }
+  *usage = (reactor_usage_t){
+      .user_us = reactor_timeval_us(rusage.ru_utime),
+      .system_us = reactor_timeval_us(rusage.ru_stime),
+      .voluntary_switches = (uint64_t)rusage.ru_nvcsw,
+      .involuntary_switches = (uint64_t)rusage.ru_nivcsw,
+      .minor_faults = (uint64_t)rusage.ru_minflt,
+      .major_faults = (uint64_t)rusage.ru_majflt,
+  };
+  if (max_rss_kb != NULL) {
+    *max_rss_kb = rusage.ru_maxrss;
+  }
+}
+
+static void reactor_stats_init(reactor_stats_t *stats, uint64_t now_ms) {
+  if (stats == NULL) {
+    return;
+  }
+  memset(stats, 0, sizeof(*stats));
+  stats->start_ms = now_ms;
+  stats->period_start_ms = now_ms;
+  reactor_usage_sample(&stats->usage, NULL);
+}
+
+/* Charges the time since start_us to handler; one clock read per call. */
+static void reactor_stats_charge(reactor_stats_t *stats,
+                                 reactor_handler_t handler,
+                                 uint64_t start_us) {
+  stats->handler_runs[handler]++;
+  stats->handler_us[handler] += get_monotonic_us() - start_us;
+}
+
+/* Counts what woke poll.  A timeout is a timer wakeup, binned by how long
+ * after before_ms + timeout_ms the reactor's clock read after_ms. */
+static void reactor_stats_record_poll(reactor_stats_t *stats, int poll_result,
+                                      int timeout_ms, uint64_t before_ms,
+                                      uint64_t after_ms,
+                                      const struct pollfd fds[static 5]) {
+  if (poll_result > 0) {
+    for (size_t i = 0; i < REACTOR_WAKE_TIMER; i++) {
+      if (fds[i].revents != 0) {
+        stats->wakeups[i]++;
+      }
+    }
+    return;
+  }
+  if (poll_result < 0 || timeout_ms < 0) {
+    return;
+  }
+  stats->wakeups[REACTOR_WAKE_TIMER]++;
+  uint64_t deadline_ms = before_ms + (uint64_t)timeout_ms;
+  uint64_t late_ms = after_ms > deadline_ms ? after_ms - deadline_ms : 0;
+  size_t bucket = 0;
+  while (bucket + 1 < OPENUPS_REACTOR_LATE_BUCKETS &&
+         (late_ms >> bucket) != 0) {
+    bucket++;
+  }
+  stats->late[bucket]++;
+  if (late_ms > stats->late_max_ms) {
+    stats->late_max_ms = late_ms;
+  }
+}
+
+/* Charges a matched reply's wait from the kernel's receive stamp to now.
+ * Replies without a stamp (other backends, simulation) are skipped, as is
+ * a stamp ahead of the clock after a step. */
+static void reactor_stats_record_detection(reactor_stats_t *stats,
+                                           uint64_t receive_ns) {
+  struct timespec now;
+  if (receive_ns == 0 || clock_gettime(CLOCK_REALTIME, &now) != 0) {
+    return;
+  }
+  uint64_t now_ns =
+      (uint64_t)now.tv_sec * UINT64_C(1000000000) + (uint64_t)now.tv_nsec;
+  if (now_ns < receive_ns) {
+    return;
+  }
+  uint64_t wait_us = (now_ns - receive_ns) / UINT64_C(1000);
+  if (stats->detections > 0) {
+    uint64_t delta_us = wait_us > stats->detect_last_us
+                            ? wait_us - stats->detect_last_us
+                            : stats->detect_last_us - wait_us;
+    stats->detect_jitter_us +=
+        ((double)delta_us - stats->detect_jitter_us) / 16.0;
+  }
+  stats->detections++;
+  stats->detect_sum_us += wait_us;
+  stats->detect_last_us = wait_us;
+  if (wait_us > stats->detect_max_us) {
+    stats->detect_max_us = wait_us;
+  }
+}
+
 /* ---- Monitor state (was monitor_state.c) — static ---- */
 
 static uint64_t monitor_deadline_add_ms(uint64_t base_ms, uint64_t delta_ms) {
@@ -256,10 +429,49 @@ static bool monitor_scheduler_advance(monitor_state_t *restrict state,
   return true;
 }
 
+/* Delays the first probe phase_ms into the first interval, so instances
+ * started together (e.g. every host after a power cut) do not probe a
+ * shared target in lockstep. */
+static void monitor_scheduler_set_phase(monitor_state_t *restrict state,
+                                        uint64_t phase_ms) {
+  if (state == NULL || phase_ms >= state->scheduler.interval_ms) {
+    return;
+  }
+  state->scheduler.next_ping_ms += phase_ms;
+}
+
+/* Restarts the cadence at now_ms + interval, or at now_ms when immediate. */
+static bool monitor_scheduler_rebase(monitor_state_t *restrict state,
+                                     uint64_t now_ms, bool immediate) {
+  if (state == NULL) {
+    return false;
+  }
+  uint64_t candidate_ms =
+      immediate ? now_ms
+                : monitor_deadline_add_ms(now_ms, state->scheduler.interval_ms);
+  if (candidate_ms == UINT64_MAX) {
+    return false;
+  }
+  state->scheduler.next_ping_ms = candidate_ms;
+  return true;
+}
+
+/* Timer slack applied to the watchdog, at most half its period so early
+ * kicks never come more than twice as often. */
+static uint64_t monitor_watchdog_slack_ms(const monitor_state_t *state) {
+  uint64_t limit_ms = state->watchdog.interval_ms / 2;
+  return state->scheduler.slack_ms < limit_ms ? state->scheduler.slack_ms
+                                              : limit_ms;
+}
+
+/* Kicking early is always safe, so with slack any wakeup that close to the
+ * deadline kicks and the deadline's own wakeup never happens. */
 static bool monitor_watchdog_due(const monitor_state_t *restrict state,
                                  uint64_t now_ms) {
   return state != NULL && state->watchdog.interval_ms > 0 &&
-         now_ms - state->watchdog.last_sent_ms >= state->watchdog.interval_ms;
+         now_ms - state->watchdog.last_sent_ms +
+                 monitor_watchdog_slack_ms(state) >=
+             state->watchdog.interval_ms;
 }
 
 static void monitor_watchdog_mark_sent(monitor_state_t *restrict state,
@@ -293,6 +505,17 @@ static int monitor_state_wait_timeout(const monitor_state_t *restrict state,
             : monitor_deadline_timeout_ms(now_ms, watchdog_deadline_ms);
     timeout_ms = monitor_timeout_min(timeout_ms, watchdog_timeout_ms);
   }
+  if (state->pmtu.enabled) {
+    timeout_ms = monitor_timeout_min(
+        timeout_ms,
+        monitor_deadline_timeout_ms(now_ms, state->pmtu.waiting
+                                                ? state->pmtu.deadline_ms
+                                                : state->pmtu.next_probe_ms));
+  }
+  if (state->hops.waiting) {
+    timeout_ms = monitor_timeout_min(
+        timeout_ms, monitor_deadline_timeout_ms(now_ms, state->hops.deadline_ms));
+  }
   return timeout_ms;
 }
 
@@ -324,6 +547,8 @@ static bool shutdown_fsm_execute(openups_ctx_t *restrict ctx) {
   shutdown_result_t result =
       shutdown_trigger(&ctx->config, &ctx->logger,
                        runtime_services_is_enabled(&ctx->services));
+  OPENUPS_USDT(shutdown, (uintptr_t)ctx->config.target,
+               (int32_t)ctx->config.shutdown_mode, (int32_t)result);
   if (ctx->config.shutdown_mode == SHUTDOWN_MODE_DRY_RUN) {
     logger_info(&ctx->logger, "Shutdown triggered, exiting monitor loop");
     return true;
@@ -357,6 +582,12 @@ static bool shutdown_fsm_handle_threshold(openups_ctx_t *restrict ctx,
       ctx->consecutive_fails < ctx->config.fail_threshold) {
     return false;
   }
+  /* FSM state: 0 monitoring, 1 countdown already running. */
+  OPENUPS_USDT(threshold, (uintptr_t)ctx->config.target,
+               (int32_t)ctx->consecutive_fails,
+               (int32_t)ctx->config.fail_threshold,
+               (int32_t)ctx->config.shutdown_mode,
+               (int32_t)monitor_shutdown_pending(state));
   if (ctx->config.shutdown_mode == SHUTDOWN_MODE_LOG_ONLY) {
     logger_warn(&ctx->logger,
                 "Log-only mode: failure threshold reached, continuing monitoring without shutdown");
@@ -408,31 +639,147 @@ static bool shutdown_fsm_handle_tick(openups_ctx_t *restrict ctx,
   return shutdown_fsm_execute(ctx);
 }
 
+/* ---- Shadow policies — static ---- */
+
+static double monitor_uptime_s(const openups_ctx_t *restrict ctx,
+                               uint64_t at_ms) {
+  uint64_t start_ms = ctx->metrics.start_time_ms;
+  return at_ms != UINT64_MAX && start_ms != UINT64_MAX && at_ms >= start_ms
+             ? (double)(at_ms - start_ms) / (double)OPENUPS_MS_PER_SEC
+             : 0.0;
+}
+
+static void monitor_shadow_describe(const shadow_policy_t *restrict policy,
+                                    char *restrict buffer, size_t size) {
+  snprintf(buffer, size, "%d of %d failed, delay %dm, %s", policy->threshold,
+           policy->window, policy->delay_minutes,
+           shutdown_mode_to_string(policy->mode));
+}
+
+/* Feeds one probe result to every shadow policy after the active policy
+ * has seen it.  Nothing here sends, schedules or acts; a countdown that
+ * elapsed since the previous result is reported as of its deadline. */
+static void monitor_shadow_observe(openups_ctx_t *restrict ctx, bool failed,
+                                   uint64_t now_ms) {
+  for (int i = 0; i < ctx->config.shadow_count; i++) {
+    const shadow_policy_t *policy = &ctx->config.shadows[i];
+    shadow_state_t *shadow = &ctx->shadows[i];
+    char description[96];
+    if (shadow_expire(shadow, now_ms)) {
+      monitor_shadow_describe(policy, description, sizeof(description));
+      logger_info(&ctx->logger,
+                  "Shadow policy %d (%s) would have fired at uptime %.3fs",
+                  i + 1, description,
+                  monitor_uptime_s(ctx, shadow->last_fired_ms));
+    }
+    shadow_event_t event = shadow_observe(policy, shadow, failed, now_ms);
+    if (event == SHADOW_EVENT_NONE) {
+      continue;
+    }
+    monitor_shadow_describe(policy, description, sizeof(description));
+    if (event == SHADOW_EVENT_FIRED) {
+      logger_info(&ctx->logger,
+                  "Shadow policy %d (%s) would have fired at uptime %.3fs",
+                  i + 1, description, monitor_uptime_s(ctx, now_ms));
+    } else if (event == SHADOW_EVENT_ARMED) {
+      logger_info(&ctx->logger,
+                  "Shadow policy %d (%s) would have started its countdown at "
+                  "uptime %.3fs",
+                  i + 1, description, monitor_uptime_s(ctx, now_ms));
+    } else {
+      logger_info(&ctx->logger,
+                  "Shadow policy %d (%s) would have cancelled its countdown "
+                  "at uptime %.3fs",
+                  i + 1, description, monitor_uptime_s(ctx, now_ms));
+    }
+  }
+}
+
+static void monitor_shadow_log_stats(const openups_ctx_t *restrict ctx) {
+  for (int i = 0; i < ctx->config.shadow_count; i++) {
+    const shadow_state_t *shadow = &ctx->shadows[i];
+    char description[96];
+    monitor_shadow_describe(&ctx->config.shadows[i], description,
+                            sizeof(description));
+    if (shadow->fired == 0) {
+      logger_info(&ctx->logger, "Shadow policy %d (%s): never fired%s", i + 1,
+                  description,
+                  shadow->deadline_ms != 0 ? ", countdown running" : "");
+      continue;
+    }
+    logger_info(&ctx->logger,
+                "Shadow policy %d (%s): fired %" PRIu64
+                " times, last at uptime %.3fs%s",
+                i + 1, description, shadow->fired,
+                monitor_uptime_s(ctx, shadow->last_fired_ms),
+                shadow->deadline_ms != 0 ? ", countdown running" : "");
+  }
+}
+
 /* ---- Runtime helpers (was monitor_runtime.c) — static ---- */
 
+/* Sends the held "OK" status, unless a failure has since replaced it. */
+static void monitor_status_flush(openups_ctx_t *restrict ctx,
+                                 monitor_state_t *restrict state,
+                                 uint64_t now_ms) {
+  if (!state->status.pending) {
+    return;
+  }
+  state->status.pending = false;
+  if (ctx->consecutive_fails != 0) {
+    return;
+  }
+  state->status.sent_ms = now_ms;
+  (void)runtime_services_notify_statusf(
+      &ctx->services, "OK: %" PRIu64 "/%" PRIu64 " pings (%.1f%%), latency %.2fms",
+      ctx->metrics.successful_pings, ctx->metrics.total_pings,
+      metrics_success_rate(&ctx->metrics), state->status.latency_ms);
+}
+
 static void handle_ping_success(openups_ctx_t *restrict ctx,
                                 monitor_state_t *restrict state,
-                                const ping_result_t *restrict result) {
+                                const ping_result_t *restrict result,
+                                uint64_t now_ms) {
   if (ctx == NULL || state == NULL || result == NULL) {
     return;
   }
+  /* With the sender's initial TTL fixed, a different reply TTL means the
+   * reply took a path of different length. */
+  if (result->reply_ttl != 0) {
+    if (ctx->consecutive_fails == 0 && ctx->reply_ttl != 0 &&
+        result->reply_ttl != ctx->reply_ttl) {
+      ctx->route_changes++;
+      logger_info(&ctx->logger,
+                  "Route to %s changed: reply TTL %u -> %u (%+d hops)",
+                  ctx->config.target, ctx->reply_ttl, result->reply_ttl,
+                  (int)ctx->reply_ttl - (int)result->reply_ttl);
+    }
+    ctx->reply_ttl = result->reply_ttl;
+  }
+  bool routine = ctx->consecutive_fails == 0;
   ctx->consecutive_fails = 0;
   (void)shutdown_fsm_cancel(ctx, state);
+  monitor_shadow_observe(ctx, false, now_ms);
   metrics_record_success(&ctx->metrics, result->latency_ms);
   logger_debug(&ctx->logger, "Ping successful to %s, latency: %.2fms",
                ctx->config.target, result->latency_ms);
-  (void)runtime_services_notify_statusf(
-      &ctx->services, "OK: %" PRIu64 "/%" PRIu64 " pings (%.1f%%), latency %.2fms",
-      ctx->metrics.successful_pings, ctx->metrics.total_pings,
-      metrics_success_rate(&ctx->metrics), result->latency_ms);
+  state->status.latency_ms = result->latency_ms;
+  state->status.pending = true;
+  /* A recovery is news; a routine success can wait for the next kick. */
+  if (!routine || state->scheduler.slack_ms == 0 ||
+      now_ms - state->status.sent_ms >= OPENUPS_COALESCED_STATUS_INTERVAL_MS) {
+    monitor_status_flush(ctx, state, now_ms);
+  }
 }
 
 static void handle_ping_failure(openups_ctx_t *restrict ctx,
-                                const ping_result_t *restrict result) {
+                                const ping_result_t *restrict result,
+                                uint64_t now_ms) {
   if (ctx == NULL || result == NULL) {
     return;
   }
   ctx->consecutive_fails++;
+  monitor_shadow_observe(ctx, true, now_ms);
   metrics_record_failure(&ctx->metrics);
   logger_warn(&ctx->logger,
               "Ping failed to %s: %s (consecutive failures: %d)",
@@ -459,51 +806,186 @@ static monitor_step_result_t monitor_runtime_error(
   return MONITOR_STEP_ERROR;
 }
 
+/* Sizes the probe buffer for the configured payload (grown, never shrunk,
+ * across reloads) and hands it to the active backend. */
 static bool monitor_prepare_packet(openups_ctx_t *restrict ctx,
                                    size_t *restrict packet_len) {
-  if (ctx == NULL || packet_len == NULL) {
-    return false;
-  }
-  size_t header_len = (ctx->pinger.family == AF_INET6)
-                          ? sizeof(struct icmp6_hdr)
-                          : sizeof(struct icmphdr);
-  *packet_len = OPENUPS_PACKET_SIZE;
-  if (*packet_len > sizeof(ctx->pinger.send_buf) || header_len > *packet_len) {
+  if (ctx == NULL || packet_len == NULL || ctx->config.payload_size < 0) {
     return false;
   }
-  uint8_t *payload = ctx->pinger.send_buf + header_len;
-  size_t payload_len = *packet_len - header_len;
-  for (size_t i = 0; i < payload_len; i++) {
-    payload[i] = (uint8_t)(i & 0xFFU);
+  *packet_len = OPENUPS_PROBE_HEADER_LEN + (size_t)ctx->config.payload_size;
+  if (ctx->send_buf_size < *packet_len) {
+    uint8_t *grown = realloc(ctx->send_buf, *packet_len);
+    if (grown == NULL) {
+      return false;
+    }
+    ctx->send_buf = grown;
+    ctx->send_buf_size = *packet_len;
+  }
+  switch (ctx->config.probe_kind) {
+  case PROBE_KIND_UDP:
+    udp_prober_set_send_buffer(&ctx->udp_prober, ctx->send_buf,
+                               ctx->send_buf_size);
+    break;
+  case PROBE_KIND_TCP:
+    break;
+  case PROBE_KIND_ICMP:
+  default:
+    icmp_pinger_set_send_buffer(&ctx->pinger, ctx->send_buf,
+                                ctx->send_buf_size);
+    break;
   }
   return true;
 }
 
+/* Appends with snprintf, stopping once buffer is full. */
+static void monitor_append(char *restrict buffer, size_t size,
+                           size_t *restrict used, const char *restrict format,
+                           ...) {
+  if (*used >= size) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(buffer + *used, size - *used, format, args);
+  va_end(args);
+  if (written > 0) {
+    *used += (size_t)written;
+  }
+}
+
+/* Reports the reactor counters and starts a new resource usage period.
+ * Handler times and resource usage are wall-clock measurements, left out
+ * of simulated runs (a virtual log clock) whose logs must reproduce. */
+static void monitor_reactor_log_stats(openups_ctx_t *restrict ctx,
+                                      uint64_t now_ms) {
+  static const char *const late_labels[OPENUPS_REACTOR_LATE_BUCKETS] = {
+      "0ms", "1ms", "2-3ms", "4-7ms", "8-15ms", "16-31ms", "32-63ms", "64ms+",
+  };
+  reactor_stats_t *stats = &ctx->reactor;
+  bool wall_clock = ctx->logger.clock == NULL;
+  char line[256];
+  size_t used = 0;
+  for (size_t i = 0; i < REACTOR_WAKE_COUNT; i++) {
+    monitor_append(line, sizeof(line), &used, "%s%s %" PRIu64,
+                   i > 0 ? ", " : "", reactor_wake_names[i],
+                   stats->wakeups[i]);
+  }
+  uint64_t elapsed_ms =
+      now_ms > stats->start_ms ? now_ms - stats->start_ms : 0;
+  logger_info(&ctx->logger,
+              "Reactor: %" PRIu64 " iterations (%.1f wakeups/hour), wakeups %s",
+              stats->iterations,
+              elapsed_ms > 0 ? (double)stats->iterations *
+                                   (double)OPENUPS_MS_PER_HOUR /
+                                   (double)elapsed_ms
+                             : 0.0,
+              line);
+
+  used = 0;
+  line[0] = '\0';
+  for (size_t i = 0; i < REACTOR_HANDLER_COUNT; i++) {
+    if (stats->handler_runs[i] == 0) {
+      continue;
+    }
+    monitor_append(line, sizeof(line), &used, "%s%s %" PRIu64 "x",
+                   used > 0 ? ", " : "", reactor_handler_names[i],
+                   stats->handler_runs[i]);
+    if (wall_clock) {
+      monitor_append(line, sizeof(line), &used, " %.3fms",
+                     (double)stats->handler_us[i] /
+                         (double)OPENUPS_US_PER_MS);
+    }
+  }
+  logger_info(&ctx->logger, "Reactor handlers: %s",
+              used > 0 ? line : "none run");
+
+  used = 0;
+  for (size_t i = 0; i < OPENUPS_REACTOR_LATE_BUCKETS; i++) {
+    monitor_append(line, sizeof(line), &used, "%s%s %" PRIu64,
+                   i > 0 ? ", " : "", late_labels[i], stats->late[i]);
+  }
+  logger_info(&ctx->logger, "Reactor timer lateness: %s (max %" PRIu64 "ms)",
+              line, stats->late_max_ms);
+  if (stats->detections > 0) {
+    logger_info(&ctx->logger,
+                "Reply detection: %" PRIu64 " replies waited %.1fus on "
+                "average after kernel receive, jitter %.1fus, max %" PRIu64
+                "us",
+                stats->detections,
+                (double)stats->detect_sum_us / (double)stats->detections,
+                stats->detect_jitter_us, stats->detect_max_us);
+  }
+
+  if (!wall_clock) {
+    return;
+  }
+  reactor_usage_t usage;
+  long max_rss_kb = 0;
+  reactor_usage_sample(&usage, &max_rss_kb);
+  const reactor_usage_t *last = &stats->usage;
+  uint64_t period_ms =
+      now_ms > stats->period_start_ms ? now_ms - stats->period_start_ms : 0;
+  logger_info(&ctx->logger,
+              "Resource usage over the last %.3fs: user %.3fs, system %.3fs, "
+              "%" PRIu64 " voluntary / %" PRIu64
+              " involuntary context switches, %" PRIu64 " minor / %" PRIu64
+              " major faults, max RSS %ld KiB",
+              (double)period_ms / (double)OPENUPS_MS_PER_SEC,
+              (double)(usage.user_us - last->user_us) / 1e6,
+              (double)(usage.system_us - last->system_us) / 1e6,
+              usage.voluntary_switches - last->voluntary_switches,
+              usage.involuntary_switches - last->involuntary_switches,
+              usage.minor_faults - last->minor_faults,
+              usage.major_faults - last->major_faults, max_rss_kb);
+  stats->usage = usage;
+  stats->period_start_ms = now_ms;
+}
+
 static void monitor_log_stats(openups_ctx_t *restrict ctx) {
   if (ctx == NULL) {
     return;
   }
   const metrics_t *metrics = &ctx->metrics;
+  uint64_t now_ms = ctx->io.now_ms(ctx->io.backend_ctx);
   if (metrics->successful_pings > 0) {
     logger_info(&ctx->logger,
                 "Statistics: %" PRIu64 " total pings, %" PRIu64
                 " successful, %" PRIu64
                 " failed (%.2f%% success rate), latency min %.2fms / max "
-                "%.2fms / avg %.2fms, uptime %" PRIu64 " seconds",
+                "%.2fms / avg %.2fms, send-time error avg %.2fms / max %" PRIu64
+                "ms, uptime %" PRIu64 " seconds",
                 metrics->total_pings, metrics->successful_pings,
                 metrics->failed_pings, metrics_success_rate(metrics),
                 metrics->min_latency, metrics->max_latency,
-                metrics_avg_latency(metrics), metrics_uptime_seconds(metrics));
-    return;
-  }
-  logger_info(&ctx->logger,
-              "Statistics: %" PRIu64 " total pings, 0 successful, %" PRIu64
-              " failed (0.00%% success rate), latency N/A, uptime %" PRIu64
-              " seconds",
-              metrics->total_pings, metrics->failed_pings,
-              metrics_uptime_seconds(metrics));
+                metrics_avg_latency(metrics), metrics_avg_send_lag(metrics),
+                metrics->send_lag_max_ms,
+                metrics_uptime_seconds(metrics, now_ms));
+  } else {
+    logger_info(&ctx->logger,
+                "Statistics: %" PRIu64 " total pings, 0 successful, %" PRIu64
+                " failed (0.00%% success rate), latency N/A, send-time error "
+                "avg %.2fms / max %" PRIu64 "ms, uptime %" PRIu64 " seconds",
+                metrics->total_pings, metrics->failed_pings,
+                metrics_avg_send_lag(metrics), metrics->send_lag_max_ms,
+                metrics_uptime_seconds(metrics, now_ms));
+  }
+  if (ctx->pmtu.send_buf != NULL && ctx->pmtu.mtu > 0) {
+    logger_info(&ctx->logger, "Path MTU: %u bytes, %u drops", ctx->pmtu.mtu,
+                ctx->pmtu.drops);
+  }
+  if (ctx->reply_ttl != 0) {
+    logger_info(&ctx->logger, "Route: reply TTL %u, %u changes",
+                ctx->reply_ttl, ctx->route_changes);
+  }
+  monitor_shadow_log_stats(ctx);
+  monitor_reactor_log_stats(ctx, now_ms);
 }
 
+static void monitor_hops_on_failure(openups_ctx_t *restrict ctx,
+                                    monitor_state_t *restrict state,
+                                    uint64_t now_ms);
+
 static monitor_step_result_t monitor_handle_ping_timeout(
     openups_ctx_t *restrict ctx, monitor_state_t *restrict state,
     uint64_t now_ms) {
@@ -511,9 +993,40 @@ static monitor_step_result_t monitor_handle_ping_timeout(
       !monitor_ping_deadline_elapsed(state, now_ms)) {
     return MONITOR_STEP_CONTINUE;
   }
-  ping_result_t timeout_result = {false, 0.0, "ICMP reply deadline exceeded"};
-  handle_ping_failure(ctx, &timeout_result);
+  ping_result_t timeout_result = {false, 0.0, {0}, 0, 0};
+  snprintf(timeout_result.error_msg, sizeof(timeout_result.error_msg),
+           "%s reply deadline exceeded", ctx->probe.label);
+  probe_backend_cancel(&ctx->probe);
+  handle_ping_failure(ctx, &timeout_result, now_ms);
+  OPENUPS_USDT(probe_timeout, (uintptr_t)ctx->config.target,
+               monitor_ping_expected_sequence(state),
+               (uint64_t)ctx->config.timeout_ms * UINT64_C(1000000),
+               (int32_t)ctx->consecutive_fails);
   monitor_ping_clear(state);
+  monitor_hops_on_failure(ctx, state, now_ms);
+  return shutdown_fsm_handle_threshold(ctx, state, now_ms)
+             ? MONITOR_STEP_STOP
+             : MONITOR_STEP_CONTINUE;
+}
+
+static bool monitor_local_path_down(const openups_ctx_t *restrict ctx) {
+  return ctx->netlink.sockfd >= 0 && !ctx->netlink.target_reachable;
+}
+
+/* No probe can leave while the route or egress carrier is gone: account the
+ * failure directly instead of sending into ENETUNREACH. */
+static monitor_step_result_t monitor_record_local_failure(
+    openups_ctx_t *restrict ctx, monitor_state_t *restrict state,
+    uint64_t now_ms) {
+  if (ctx == NULL || state == NULL) {
+    return MONITOR_STEP_ERROR;
+  }
+  char reason[128];
+  netlink_monitor_describe(&ctx->netlink, reason, sizeof(reason));
+  ping_result_t local_result = {false, 0.0, {0}, 0, 0};
+  snprintf(local_result.error_msg, sizeof(local_result.error_msg),
+           "local path down: %s", reason);
+  handle_ping_failure(ctx, &local_result, now_ms);
   return shutdown_fsm_handle_threshold(ctx, state, now_ms)
              ? MONITOR_STEP_STOP
              : MONITOR_STEP_CONTINUE;
@@ -526,16 +1039,16 @@ static monitor_step_result_t monitor_send_ping(openups_ctx_t *restrict ctx,
   if (ctx == NULL || state == NULL) {
     return MONITOR_STEP_ERROR;
   }
-  ping_result_t error_result = {false, -1.0, {0}};
-  if (!icmp_pinger_send_echo(&ctx->pinger, &ctx->dest_addr, ctx->dest_addr_len,
-                             ctx->cached_pid, packet_len,
-                             error_result.error_msg,
-                             sizeof(error_result.error_msg))) {
-    return monitor_runtime_error(ctx, "Failed to send ICMP echo: %s",
+  ping_result_t error_result = {false, -1.0, {0}, 0, 0};
+  if (!probe_backend_send(&ctx->probe, &ctx->dest_addr, ctx->dest_addr_len,
+                          ctx->cached_pid, packet_len, error_result.error_msg,
+                          sizeof(error_result.error_msg))) {
+    return monitor_runtime_error(ctx, "Failed to send %s: %s",
+                                 ctx->probe.description,
                                  error_result.error_msg);
   }
   if (!monitor_ping_arm(state, now_ms, (uint64_t)ctx->config.timeout_ms,
-                        ctx->pinger.sequence)) {
+                        probe_backend_sequence(&ctx->probe))) {
     return monitor_runtime_error(ctx, "Failed to compute reply deadline");
   }
   return MONITOR_STEP_CONTINUE;
@@ -550,8 +1063,8 @@ static monitor_step_result_t monitor_drain_icmp_replies(
   ping_result_t reply = {0};
   for (size_t processed = 0; processed < OPENUPS_MAX_REPLY_DRAIN_PER_TICK;
        processed++) {
-    icmp_receive_status_t status = icmp_pinger_receive_reply(
-        &ctx->pinger, &ctx->dest_addr, ctx->cached_pid,
+    icmp_receive_status_t status = probe_backend_receive(
+        &ctx->probe, &ctx->dest_addr, ctx->cached_pid,
         monitor_ping_expected_sequence(state), monitor_ping_send_time_ms(state),
         now_ms, &reply);
     if (status == ICMP_RECEIVE_NO_MORE) {
@@ -559,18 +1072,433 @@ static monitor_step_result_t monitor_drain_icmp_replies(
     }
     if (status == ICMP_RECEIVE_ERROR) {
       monitor_ping_clear(state);
-      return monitor_runtime_error(ctx, "ICMP receive failed: %s",
-                                   reply.error_msg);
+      return monitor_runtime_error(ctx, "%s receive failed: %s",
+                                   ctx->probe.label, reply.error_msg);
     }
     if (status == ICMP_RECEIVE_MATCHED && monitor_ping_waiting(state)) {
-      handle_ping_success(ctx, state, &reply);
+      reactor_stats_record_detection(&ctx->reactor, reply.receive_ns);
+      handle_ping_success(ctx, state, &reply, now_ms);
       monitor_ping_clear(state);
       return MONITOR_STEP_CONTINUE;
     }
+    if (status == ICMP_RECEIVE_UNREACHABLE && monitor_ping_waiting(state)) {
+      handle_ping_failure(ctx, &reply, now_ms);
+      monitor_ping_clear(state);
+      monitor_hops_on_failure(ctx, state, now_ms);
+      return shutdown_fsm_handle_threshold(ctx, state, now_ms)
+                 ? MONITOR_STEP_STOP
+                 : MONITOR_STEP_CONTINUE;
+    }
   }
   return MONITOR_STEP_CONTINUE;
 }
 
+/* ---- Path MTU search ---- */
+
+static bool monitor_pmtu_active(const openups_ctx_t *restrict ctx) {
+  return ctx->pmtu.send_buf != NULL;
+}
+
+/* The regular identifier with the top bit flipped: both raw sockets see
+ * every echo reply, and each must ignore the other's. */
+static uint16_t monitor_pmtu_identifier(const openups_ctx_t *restrict ctx) {
+  return (uint16_t)(ctx->cached_pid ^ 0x8000U);
+}
+
+/* Large probes only say something about the MTU while small ones get
+ * through; during an outage the search would just walk down to the
+ * floor. */
+static bool monitor_pmtu_path_up(const openups_ctx_t *restrict ctx) {
+  return ctx->metrics.successful_pings > 0 && ctx->consecutive_fails == 0 &&
+         !monitor_local_path_down(ctx);
+}
+
+/* (Re)opens the DF socket for the current target; failure only disables
+ * the search. */
+static void monitor_pmtu_open(openups_ctx_t *restrict ctx) {
+  pmtu_prober_destroy(&ctx->pmtu);
+  if (!ctx->config.enable_pmtu) {
+    return;
+  }
+  char error_msg[OPENUPS_LOG_BUFFER_SIZE];
+  if (!pmtu_prober_init(&ctx->pmtu, &ctx->dest_addr, ctx->dest_addr_len,
+                        error_msg, sizeof(error_msg))) {
+    logger_warn(&ctx->logger, "%s; path MTU probing disabled", error_msg);
+    return;
+  }
+  logger_debug(&ctx->logger, "Path MTU search to %s between %u and %u bytes",
+               ctx->config.target, ctx->pmtu.floor, ctx->pmtu.ceiling);
+}
+
+static void monitor_pmtu_start(const openups_ctx_t *restrict ctx,
+                               monitor_state_t *restrict state,
+                               uint64_t now_ms) {
+  memset(&state->pmtu, 0, sizeof(state->pmtu));
+  state->pmtu.enabled = monitor_pmtu_active(ctx);
+  state->pmtu.next_probe_ms = now_ms;
+}
+
+static void monitor_pmtu_disable(openups_ctx_t *restrict ctx,
+                                 monitor_state_t *restrict state) {
+  pmtu_prober_destroy(&ctx->pmtu);
+  memset(&state->pmtu, 0, sizeof(state->pmtu));
+}
+
+/* Search steps follow each other as answers arrive; a converged MTU is
+ * re-verified once per interval, half an interval away from the regular
+ * probe. */
+static void monitor_pmtu_rearm(const openups_ctx_t *restrict ctx,
+                               monitor_state_t *restrict state,
+                               uint64_t now_ms) {
+  state->pmtu.waiting = false;
+  state->pmtu.expected_sequence = 0;
+  if (ctx->pmtu.searching) {
+    state->pmtu.next_probe_ms = now_ms;
+    return;
+  }
+  uint64_t half_ms = state->scheduler.interval_ms / 2;
+  uint64_t next_ping_ms = state->scheduler.next_ping_ms;
+  state->pmtu.next_probe_ms =
+      next_ping_ms > now_ms + half_ms
+          ? next_ping_ms - half_ms
+          : monitor_deadline_add_ms(next_ping_ms, half_ms);
+}
+
+static monitor_step_result_t monitor_pmtu_result(
+    openups_ctx_t *restrict ctx, monitor_state_t *restrict state,
+    uint64_t now_ms, pmtu_probe_result_t result) {
+  if (result == PMTU_PROBE_LOST && !monitor_pmtu_path_up(ctx)) {
+    /* Lost with everything else, not for its size. */
+    monitor_pmtu_rearm(ctx, state, now_ms);
+    return MONITOR_STEP_CONTINUE;
+  }
+  uint32_t previous_mtu = 0;
+  pmtu_event_t event = pmtu_prober_record(&ctx->pmtu, result, &previous_mtu);
+  monitor_pmtu_rearm(ctx, state, now_ms);
+  switch (event) {
+  case PMTU_EVENT_DISCOVERED:
+    logger_info(&ctx->logger, "Path MTU to %s: %u bytes", ctx->config.target,
+                ctx->pmtu.mtu);
+    return MONITOR_STEP_CONTINUE;
+  case PMTU_EVENT_RAISED:
+    logger_info(&ctx->logger, "Path MTU to %s rose from %u to %u bytes",
+                ctx->config.target, previous_mtu, ctx->pmtu.mtu);
+    return MONITOR_STEP_CONTINUE;
+  case PMTU_EVENT_DROPPED: {
+    ping_result_t drop_result = {false, 0.0, {0}, 0, 0};
+    snprintf(drop_result.error_msg, sizeof(drop_result.error_msg),
+             "path MTU dropped from %u to %u bytes", previous_mtu,
+             ctx->pmtu.mtu);
+    handle_ping_failure(ctx, &drop_result, now_ms);
+    return shutdown_fsm_handle_threshold(ctx, state, now_ms)
+               ? MONITOR_STEP_STOP
+               : MONITOR_STEP_CONTINUE;
+  }
+  case PMTU_EVENT_NONE:
+  default:
+    return MONITOR_STEP_CONTINUE;
+  }
+}
+
+static monitor_step_result_t monitor_handle_pmtu(
+    openups_ctx_t *restrict ctx, monitor_state_t *restrict state,
+    uint64_t now_ms) {
+  if (ctx == NULL || state == NULL || !state->pmtu.enabled) {
+    return MONITOR_STEP_CONTINUE;
+  }
+  if (state->pmtu.waiting) {
+    return now_ms >= state->pmtu.deadline_ms
+               ? monitor_pmtu_result(ctx, state, now_ms, PMTU_PROBE_LOST)
+               : MONITOR_STEP_CONTINUE;
+  }
+  if (now_ms + state->scheduler.slack_ms < state->pmtu.next_probe_ms) {
+    return MONITOR_STEP_CONTINUE;
+  }
+  if (!monitor_pmtu_path_up(ctx)) {
+    state->pmtu.next_probe_ms =
+        monitor_deadline_add_ms(now_ms, state->scheduler.interval_ms);
+    return MONITOR_STEP_CONTINUE;
+  }
+  char error_msg[256];
+  bool too_big = false;
+  if (!pmtu_prober_send(&ctx->pmtu, &ctx->dest_addr, ctx->dest_addr_len,
+                        monitor_pmtu_identifier(ctx), &too_big, error_msg,
+                        sizeof(error_msg))) {
+    logger_warn(&ctx->logger, "Path MTU probe failed: %s", error_msg);
+    state->pmtu.next_probe_ms =
+        monitor_deadline_add_ms(now_ms, state->scheduler.interval_ms);
+    return MONITOR_STEP_CONTINUE;
+  }
+  if (too_big) {
+    return monitor_pmtu_result(ctx, state, now_ms, PMTU_PROBE_TOO_BIG);
+  }
+  state->pmtu.waiting = true;
+  state->pmtu.send_time_ms = now_ms;
+  state->pmtu.deadline_ms =
+      monitor_deadline_add_ms(now_ms, (uint64_t)ctx->config.timeout_ms);
+  state->pmtu.expected_sequence =
+      icmp_pinger_current_sequence(&ctx->pmtu.pinger);
+  return MONITOR_STEP_CONTINUE;
+}
+
+static monitor_step_result_t monitor_drain_pmtu_replies(
+    openups_ctx_t *restrict ctx, monitor_state_t *restrict state,
+    uint64_t now_ms) {
+  ping_result_t reply = {0};
+  for (size_t processed = 0; processed < OPENUPS_MAX_REPLY_DRAIN_PER_TICK;
+       processed++) {
+    icmp_receive_status_t status = icmp_pinger_receive_reply(
+        &ctx->pmtu.pinger, &ctx->dest_addr, monitor_pmtu_identifier(ctx),
+        state->pmtu.expected_sequence, state->pmtu.send_time_ms, now_ms,
+        &reply);
+    if (status == ICMP_RECEIVE_NO_MORE) {
+      return MONITOR_STEP_CONTINUE;
+    }
+    if (status == ICMP_RECEIVE_ERROR) {
+      logger_warn(&ctx->logger, "Path MTU socket failed: %s; probing disabled",
+                  reply.error_msg);
+      monitor_pmtu_disable(ctx, state);
+      return MONITOR_STEP_CONTINUE;
+    }
+    if (status == ICMP_RECEIVE_MATCHED && state->pmtu.waiting) {
+      return monitor_pmtu_result(ctx, state, now_ms, PMTU_PROBE_PASSED);
+    }
+  }
+  return MONITOR_STEP_CONTINUE;
+}
+
+/* ---- Hop sweep ---- */
+
+static bool monitor_hops_active(const openups_ctx_t *restrict ctx) {
+  return ctx->hops.pinger.sockfd >= 0;
+}
+
+/* Distinct from the regular and the path MTU identifiers (0x8000). */
+static uint16_t monitor_hops_identifier(const openups_ctx_t *restrict ctx) {
+  return (uint16_t)(ctx->cached_pid ^ 0x4000U);
+}
+
+/* (Re)opens the sweep socket for the current target's family; failure
+ * only disables the sweep. */
+static void monitor_hops_open(openups_ctx_t *restrict ctx) {
+  if (monitor_hops_active(ctx)) {
+    hop_sweep_destroy(&ctx->hops);
+  }
+  if (!ctx->config.enable_hops) {
+    return;
+  }
+  char error_msg[OPENUPS_LOG_BUFFER_SIZE];
+  if (!hop_sweep_init(&ctx->hops, ctx->dest_addr.ss_family,
+                      monitor_hops_identifier(ctx), error_msg,
+                      sizeof(error_msg))) {
+    logger_warn(&ctx->logger, "%s; hop sweep disabled", error_msg);
+  }
+}
+
+static void monitor_hops_finish(openups_ctx_t *restrict ctx,
+                                monitor_state_t *restrict state,
+                                uint64_t now_ms) {
+  const hop_sweep_t *sweep = &ctx->hops;
+  char path[OPENUPS_LOG_BUFFER_SIZE / 2];
+  hop_sweep_describe(sweep, path, sizeof(path));
+  uint64_t elapsed_ms = now_ms - state->hops.send_time_ms;
+  uint32_t last_hop = hop_sweep_last_hop(sweep);
+  if (sweep->reached != 0) {
+    logger_info(&ctx->logger,
+                "Hop sweep to %s: target answers at hop %u, path intact "
+                "(%" PRIu64 "ms): %s",
+                ctx->config.target, sweep->reached, elapsed_ms, path);
+  } else if (sweep->unreachable != 0) {
+    logger_warn(&ctx->logger,
+                "Hop sweep to %s: hop %u reports the target unreachable "
+                "(%" PRIu64 "ms): %s",
+                ctx->config.target, sweep->unreachable, elapsed_ms, path);
+  } else if (last_hop > 0) {
+    logger_warn(&ctx->logger,
+                "Hop sweep to %s: path breaks after hop %u of %u probed "
+                "(%" PRIu64 "ms): %s",
+                ctx->config.target, last_hop, sweep->max_ttl, elapsed_ms,
+                path);
+  } else {
+    logger_warn(&ctx->logger,
+                "Hop sweep to %s: no hop answered within %dms, the first "
+                "hop is down",
+                ctx->config.target, ctx->config.timeout_ms);
+  }
+  ctx->hops.active = false;
+  state->hops.waiting = false;
+}
+
+/* Only the first failure of a streak sweeps: later ones would map the same
+ * break again.  With the local path down there is nothing to send on. */
+static void monitor_hops_on_failure(openups_ctx_t *restrict ctx,
+                                    monitor_state_t *restrict state,
+                                    uint64_t now_ms) {
+  if (!monitor_hops_active(ctx) || state->hops.waiting ||
+      ctx->consecutive_fails != 1 || monitor_local_path_down(ctx)) {
+    return;
+  }
+  char error_msg[256];
+  if (!hop_sweep_start(&ctx->hops, &ctx->dest_addr, ctx->dest_addr_len,
+                       OPENUPS_HOP_MAX, error_msg, sizeof(error_msg))) {
+    logger_warn(&ctx->logger, "Hop sweep to %s failed: %s",
+                ctx->config.target, error_msg);
+    return;
+  }
+  state->hops.waiting = true;
+  state->hops.send_time_ms = now_ms;
+  state->hops.deadline_ms =
+      monitor_deadline_add_ms(now_ms, (uint64_t)ctx->config.timeout_ms);
+}
+
+static void monitor_handle_hops(openups_ctx_t *restrict ctx,
+                                monitor_state_t *restrict state,
+                                uint64_t now_ms) {
+  if (ctx == NULL || state == NULL || !state->hops.waiting) {
+    return;
+  }
+  if (now_ms >= state->hops.deadline_ms || hop_sweep_complete(&ctx->hops)) {
+    monitor_hops_finish(ctx, state, now_ms);
+  }
+}
+
+static void monitor_drain_hop_replies(openups_ctx_t *restrict ctx,
+                                      monitor_state_t *restrict state,
+                                      uint64_t now_ms) {
+  char error_msg[256];
+  icmp_hop_reply_t reply;
+  for (size_t processed = 0; processed < OPENUPS_MAX_REPLY_DRAIN_PER_TICK;
+       processed++) {
+    icmp_receive_status_t status = icmp_pinger_receive_hop(
+        &ctx->hops.pinger, &reply, error_msg, sizeof(error_msg));
+    if (status == ICMP_RECEIVE_NO_MORE) {
+      break;
+    }
+    if (status == ICMP_RECEIVE_ERROR) {
+      logger_warn(&ctx->logger, "Hop sweep socket failed: %s; sweep disabled",
+                  error_msg);
+      hop_sweep_destroy(&ctx->hops);
+      state->hops.waiting = false;
+      return;
+    }
+    if (status == ICMP_RECEIVE_MATCHED) {
+      (void)hop_sweep_record(&ctx->hops, &reply);
+    }
+  }
+  monitor_handle_hops(ctx, state, now_ms);
+}
+
+/* ---- Crash-recovery checkpoint ---- */
+
+static void monitor_checkpoint_save(openups_ctx_t *restrict ctx,
+                                    const monitor_state_t *restrict state,
+                                    uint64_t now_ms) {
+  if (ctx == NULL || state == NULL || ctx->state_store.record == NULL) {
+    return;
+  }
+  uint64_t now_real_ms = get_realtime_ms();
+  if (now_real_ms == UINT64_MAX) {
+    return;
+  }
+
+  state_checkpoint_t checkpoint;
+  memset(&checkpoint, 0, sizeof(checkpoint));
+  memcpy(checkpoint.target, ctx->config.target, sizeof(checkpoint.target));
+  checkpoint.probe_kind = (int32_t)ctx->config.probe_kind;
+  checkpoint.probe_port = ctx->config.probe_port;
+  checkpoint.consecutive_fails = ctx->consecutive_fails;
+  checkpoint.saved_realtime_ms = now_real_ms;
+  if (monitor_shutdown_pending(state)) {
+    uint64_t remaining_ms = state->shutdown.deadline_ms > now_ms
+                                ? state->shutdown.deadline_ms - now_ms
+                                : 0;
+    checkpoint.shutdown_deadline_realtime_ms =
+        monitor_deadline_add_ms(now_real_ms, remaining_ms);
+  }
+  uint64_t uptime_ms = now_ms - ctx->metrics.start_time_ms;
+  checkpoint.metrics_start_realtime_ms =
+      uptime_ms < now_real_ms ? now_real_ms - uptime_ms : 0;
+  checkpoint.total_pings = ctx->metrics.total_pings;
+  checkpoint.successful_pings = ctx->metrics.successful_pings;
+  checkpoint.failed_pings = ctx->metrics.failed_pings;
+  checkpoint.total_latency = ctx->metrics.total_latency;
+  checkpoint.min_latency = ctx->metrics.min_latency;
+  checkpoint.max_latency = ctx->metrics.max_latency;
+  state_store_write(&ctx->state_store, &checkpoint);
+}
+
+/* A checkpoint is trusted only for the same probe target and only while it
+ * is younger than one full detection window (threshold x interval): older
+ * streaks could not have been continued without a gap. */
+static void monitor_checkpoint_restore(openups_ctx_t *restrict ctx,
+                                       monitor_state_t *restrict state,
+                                       uint64_t now_ms) {
+  if (ctx == NULL || state == NULL || ctx->state_store.record == NULL) {
+    return;
+  }
+  state_checkpoint_t checkpoint;
+  if (!state_store_read(&ctx->state_store, &checkpoint)) {
+    logger_debug(&ctx->logger, "No usable checkpoint in %s",
+                 ctx->config.state_file);
+    return;
+  }
+  if (strcmp(checkpoint.target, ctx->config.target) != 0 ||
+      checkpoint.probe_kind != (int32_t)ctx->config.probe_kind ||
+      checkpoint.probe_port != ctx->config.probe_port) {
+    logger_info(&ctx->logger,
+                "Checkpoint is for target %s, not restoring state",
+                checkpoint.target);
+    return;
+  }
+
+  uint64_t now_real_ms = get_realtime_ms();
+  uint64_t window_ms = 0;
+  if (now_real_ms == UINT64_MAX ||
+      checkpoint.saved_realtime_ms > now_real_ms ||
+      ckd_mul(&window_ms, (uint64_t)ctx->config.fail_threshold,
+              state->scheduler.interval_ms) ||
+      now_real_ms - checkpoint.saved_realtime_ms > window_ms) {
+    logger_info(&ctx->logger, "Checkpoint is stale, starting fresh");
+    return;
+  }
+
+  ctx->consecutive_fails =
+      checkpoint.consecutive_fails > 0 ? checkpoint.consecutive_fails : 0;
+  ctx->metrics.total_pings = checkpoint.total_pings;
+  ctx->metrics.successful_pings = checkpoint.successful_pings;
+  ctx->metrics.failed_pings = checkpoint.failed_pings;
+  ctx->metrics.total_latency = checkpoint.total_latency;
+  ctx->metrics.min_latency = checkpoint.min_latency;
+  ctx->metrics.max_latency = checkpoint.max_latency;
+  if (checkpoint.metrics_start_realtime_ms <= now_real_ms) {
+    uint64_t uptime_ms = now_real_ms - checkpoint.metrics_start_realtime_ms;
+    ctx->metrics.start_time_ms = uptime_ms < now_ms ? now_ms - uptime_ms : 0;
+  }
+
+  uint64_t age_ms = now_real_ms - checkpoint.saved_realtime_ms;
+  if (checkpoint.shutdown_deadline_realtime_ms == 0) {
+    logger_info(&ctx->logger,
+                "Restored checkpoint from %" PRIu64
+                "ms ago: %d consecutive failures",
+                age_ms, ctx->consecutive_fails);
+    return;
+  }
+  /* An already-elapsed deadline fires on the first reactor tick. */
+  uint64_t remaining_ms =
+      checkpoint.shutdown_deadline_realtime_ms > now_real_ms
+          ? checkpoint.shutdown_deadline_realtime_ms - now_real_ms
+          : 0;
+  if (!monitor_shutdown_arm(state, now_ms, remaining_ms)) {
+    return;
+  }
+  logger_warn(&ctx->logger,
+              "Restored checkpoint from %" PRIu64
+              "ms ago: %d consecutive failures, shutdown countdown resumes "
+              "with %" PRIu64 "s left",
+              age_ms, ctx->consecutive_fails,
+              remaining_ms / OPENUPS_MS_PER_SEC);
+}
+
 /* ---- Reactor (was original monitor.c) ---- */
 
 typedef struct {
@@ -583,7 +1511,7 @@ typedef struct {
 typedef struct {
   signal_channel_t signals;
   monitor_state_t state;
-  struct pollfd fds[2];
+  struct pollfd fds[5];
   size_t packet_len;
   uint64_t now_ms;
 } monitor_loop_t;
@@ -614,11 +1542,24 @@ static bool pollfd_has_error(short revents) {
   return (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
 }
 
-static bool monitor_refresh_time(uint64_t *restrict now_ms) {
-  if (now_ms == NULL) {
+/* The system reactor backend: the monotonic clock and poll(2). */
+static uint64_t reactor_io_system_now_ms(void *backend_ctx) {
+  (void)backend_ctx;
+  return get_monotonic_ms();
+}
+
+static int reactor_io_system_poll(void *backend_ctx, struct pollfd *fds,
+                                  nfds_t nfds, int timeout_ms) {
+  (void)backend_ctx;
+  return poll(fds, nfds, timeout_ms);
+}
+
+static bool monitor_refresh_time(const openups_ctx_t *restrict ctx,
+                                 uint64_t *restrict now_ms) {
+  if (ctx == NULL || now_ms == NULL) {
     return false;
   }
-  uint64_t refreshed_now_ms = get_monotonic_ms();
+  uint64_t refreshed_now_ms = ctx->io.now_ms(ctx->io.backend_ctx);
   if (refreshed_now_ms == UINT64_MAX) {
     return false;
   }
@@ -626,8 +1567,15 @@ static bool monitor_refresh_time(uint64_t *restrict now_ms) {
   return true;
 }
 
+/* Names under which fds are kept in the systemd fd store. */
+#define OPENUPS_FDNAME_ICMP "openups-icmp"
+#define OPENUPS_FDNAME_SIGNALFD "openups-signalfd"
+
+/* inherited_fd, when valid, is a signalfd from a previous incarnation: it is
+ * re-armed with the current mask instead of creating a new one. */
 static bool signal_channel_init(signal_channel_t *restrict channel,
-                                const logger_t *restrict logger) {
+                                const logger_t *restrict logger,
+                                int inherited_fd) {
   if (channel == NULL || logger == NULL) {
     return false;
   }
@@ -638,11 +1586,23 @@ static bool signal_channel_init(signal_channel_t *restrict channel,
   sigaddset(&mask, SIGINT);
   sigaddset(&mask, SIGTERM);
   sigaddset(&mask, SIGUSR1);
+  sigaddset(&mask, SIGHUP);
   if (sigprocmask(SIG_BLOCK, &mask, &channel->previous_mask) < 0) {
     logger_error(logger, "sigprocmask failed: %s", strerror(errno));
     return false;
   }
   channel->previous_mask_valid = true;
+  if (inherited_fd >= 0) {
+    int flags = fcntl(inherited_fd, F_GETFL);
+    if (signalfd(inherited_fd, &mask, 0) == inherited_fd && flags >= 0 &&
+        fcntl(inherited_fd, F_SETFL, flags | O_NONBLOCK) == 0) {
+      channel->fd = inherited_fd;
+      return true;
+    }
+    logger_warn(logger, "Inherited signalfd %d unusable: %s", inherited_fd,
+                strerror(errno));
+    close(inherited_fd);
+  }
   channel->fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
   if (channel->fd < 0) {
     logger_error(logger, "signalfd failed: %s", strerror(errno));
@@ -686,6 +1646,28 @@ static void monitor_handle_signal(openups_ctx_t *restrict ctx,
   }
   if (signal_info.ssi_signo == SIGUSR1) {
     monitor_log_stats(ctx);
+    return;
+  }
+  if (signal_info.ssi_signo == SIGHUP) {
+    ctx->reload_flag = 1;
+  }
+}
+
+/* Hands the raw socket and signalfd to systemd so a restarted instance
+ * skips socket setup.  Re-storing after a rebuild replaces the old entry. */
+static void monitor_store_fds(openups_ctx_t *restrict ctx,
+                              const monitor_loop_t *restrict loop) {
+  if (ctx == NULL || loop == NULL ||
+      !runtime_services_is_enabled(&ctx->services)) {
+    return;
+  }
+  if (ctx->config.probe_kind == PROBE_KIND_ICMP && ctx->pinger.sockfd >= 0) {
+    (void)runtime_services_store_fd(&ctx->services, ctx->pinger.sockfd,
+                                    OPENUPS_FDNAME_ICMP);
+  }
+  if (loop->signals.fd >= 0) {
+    (void)runtime_services_store_fd(&ctx->services, loop->signals.fd,
+                                    OPENUPS_FDNAME_SIGNALFD);
   }
 }
 
@@ -708,6 +1690,7 @@ static monitor_step_result_t monitor_handle_watchdog(
   }
   if (runtime_services_notify_watchdog(&ctx->services)) {
     monitor_watchdog_mark_sent(state, now_ms);
+    monitor_status_flush(ctx, state, now_ms);
     return MONITOR_STEP_CONTINUE;
   }
   logger_warn(&ctx->logger, "Failed to send systemd WATCHDOG notification");
@@ -723,8 +1706,13 @@ static monitor_step_result_t monitor_handle_scheduler(
   if (monitor_ping_waiting(state) || !monitor_scheduler_due(state, now_ms)) {
     return MONITOR_STEP_CONTINUE;
   }
+  metrics_record_send_lag(&ctx->metrics,
+                          now_ms - state->scheduler.next_ping_ms);
+  netlink_monitor_refresh(&ctx->netlink, &ctx->dest_addr);
   monitor_step_result_t send_result =
-      monitor_send_ping(ctx, state, now_ms, packet_len);
+      monitor_local_path_down(ctx)
+          ? monitor_record_local_failure(ctx, state, now_ms)
+          : monitor_send_ping(ctx, state, now_ms, packet_len);
   if (send_result != MONITOR_STEP_CONTINUE) {
     return send_result;
   }
@@ -735,43 +1723,251 @@ static monitor_step_result_t monitor_handle_scheduler(
   return MONITOR_STEP_CONTINUE;
 }
 
+static monitor_step_result_t monitor_handle_netlink(
+    openups_ctx_t *restrict ctx, monitor_state_t *restrict state,
+    uint64_t now_ms) {
+  if (ctx == NULL || state == NULL) {
+    return MONITOR_STEP_ERROR;
+  }
+  char reason[128];
+  netlink_event_t event = netlink_monitor_process(
+      &ctx->netlink, &ctx->dest_addr, &ctx->logger, reason, sizeof(reason));
+  if (event == NETLINK_EVENT_REACHABLE) {
+    logger_info(&ctx->logger, "Local path to %s restored (%s), probing now",
+                ctx->config.target, reason);
+    (void)monitor_scheduler_rebase(state, now_ms, true);
+    return MONITOR_STEP_CONTINUE;
+  }
+  if (event != NETLINK_EVENT_UNREACHABLE) {
+    return MONITOR_STEP_CONTINUE;
+  }
+  logger_warn(&ctx->logger, "Local path to %s lost: %s", ctx->config.target,
+              reason);
+  if (monitor_ping_waiting(state)) {
+    probe_backend_cancel(&ctx->probe);
+    monitor_ping_clear(state);
+  }
+  (void)monitor_scheduler_rebase(state, now_ms, false);
+  return monitor_record_local_failure(ctx, state, now_ms);
+}
+
 static monitor_step_result_t monitor_handle_poll_events(
     openups_ctx_t *restrict ctx, signal_channel_t *restrict signals,
-    monitor_state_t *restrict state, struct pollfd fds[static 2],
+    monitor_state_t *restrict state, struct pollfd fds[static 5],
     uint64_t *restrict now_ms) {
   if (ctx == NULL || signals == NULL || state == NULL || now_ms == NULL) {
     return MONITOR_STEP_ERROR;
   }
   int wait_timeout_ms = monitor_state_wait_timeout(state, *now_ms);
-  int poll_result = poll(fds, 2, wait_timeout_ms);
+  /* Connection-oriented backends swap sockets per probe; reloads may swap
+   * the backend or the netlink watch. */
+  fds[1].fd = probe_backend_poll_fd(&ctx->probe);
+  fds[1].events = probe_backend_poll_events(&ctx->probe);
+  fds[2].fd = ctx->netlink.sockfd;
+  fds[3].fd = state->pmtu.enabled ? ctx->pmtu.pinger.sockfd : -1;
+  /* Polled only while a sweep waits; the filter keeps the queue short. */
+  fds[4].fd = state->hops.waiting ? ctx->hops.pinger.sockfd : -1;
+  uint64_t before_ms = *now_ms;
+  int poll_result =
+      ctx->io.poll(ctx->io.backend_ctx, fds, 5, wait_timeout_ms);
   if (poll_result < 0 && errno != EINTR) {
     logger_error(&ctx->logger, "poll error: %s", strerror(errno));
     return MONITOR_STEP_ERROR;
   }
-  (void)monitor_refresh_time(now_ms);
+  (void)monitor_refresh_time(ctx, now_ms);
+  reactor_stats_record_poll(&ctx->reactor, poll_result, wait_timeout_ms,
+                            before_ms, *now_ms, fds);
   if (pollfd_has_error(fds[0].revents)) {
     logger_error(&ctx->logger, "Signal fd entered error state");
     return MONITOR_STEP_ERROR;
   }
-  if (pollfd_has_error(fds[1].revents)) {
-    logger_error(&ctx->logger, "ICMP socket entered error state");
+  if ((fds[1].revents & POLLNVAL) != 0 ||
+      (pollfd_has_error(fds[1].revents) &&
+       !ctx->probe.socket_errors_are_results)) {
+    logger_error(&ctx->logger, "%s socket entered error state",
+                 ctx->probe.label);
     return MONITOR_STEP_ERROR;
   }
+  if (pollfd_has_error(fds[2].revents)) {
+    logger_warn(&ctx->logger,
+                "Netlink socket entered error state, route watch disabled");
+    netlink_monitor_destroy(&ctx->netlink);
+    fds[2].fd = -1;
+  }
+  if (pollfd_has_error(fds[3].revents)) {
+    logger_warn(&ctx->logger,
+                "Path MTU socket entered error state, probing disabled");
+    monitor_pmtu_disable(ctx, state);
+    fds[3].fd = -1;
+  }
+  if (pollfd_has_error(fds[4].revents)) {
+    logger_warn(&ctx->logger,
+                "Hop sweep socket entered error state, sweep disabled");
+    hop_sweep_destroy(&ctx->hops);
+    state->hops.waiting = false;
+    fds[4].fd = -1;
+  }
   if ((fds[0].revents & POLLIN) != 0) {
+    uint64_t start_us = get_monotonic_us();
     monitor_handle_signal(ctx, signals);
+    reactor_stats_charge(&ctx->reactor, REACTOR_HANDLER_SIGNAL, start_us);
+  }
+  if ((fds[2].revents & POLLIN) != 0) {
+    uint64_t start_us = get_monotonic_us();
+    monitor_step_result_t netlink_result =
+        monitor_handle_netlink(ctx, state, *now_ms);
+    reactor_stats_charge(&ctx->reactor, REACTOR_HANDLER_NETLINK, start_us);
+    if (netlink_result != MONITOR_STEP_CONTINUE) {
+      return netlink_result;
+    }
   }
-  if ((fds[1].revents & POLLIN) != 0) {
+  if ((fds[1].revents & (POLLIN | POLLOUT | POLLERR | POLLHUP)) != 0) {
+    uint64_t start_us = get_monotonic_us();
     monitor_step_result_t receive_result =
         monitor_drain_icmp_replies(ctx, *now_ms, state);
+    reactor_stats_charge(&ctx->reactor, REACTOR_HANDLER_PROBE, start_us);
     if (receive_result != MONITOR_STEP_CONTINUE) {
       return receive_result;
     }
   }
+  if ((fds[3].revents & POLLIN) != 0 && state->pmtu.enabled) {
+    uint64_t start_us = get_monotonic_us();
+    monitor_step_result_t pmtu_result =
+        monitor_drain_pmtu_replies(ctx, state, *now_ms);
+    reactor_stats_charge(&ctx->reactor, REACTOR_HANDLER_PMTU, start_us);
+    if (pmtu_result != MONITOR_STEP_CONTINUE) {
+      return pmtu_result;
+    }
+  }
+  if ((fds[4].revents & POLLIN) != 0 && state->hops.waiting) {
+    uint64_t start_us = get_monotonic_us();
+    monitor_drain_hop_replies(ctx, state, *now_ms);
+    reactor_stats_charge(&ctx->reactor, REACTOR_HANDLER_HOPS, start_us);
+  }
   fds[0].revents = 0;
   fds[1].revents = 0;
+  fds[2].revents = 0;
+  fds[3].revents = 0;
+  fds[4].revents = 0;
   return MONITOR_STEP_CONTINUE;
 }
 
+/* Kernel timer slack for poll(2): timeouts may then expire up to the slack
+ * late, batched with other timers.  Every probe send and reply deadline
+ * takes that delay, so it is held to a twentieth of the interval, and to
+ * the watchdog's slack so a kick on its own deadline still lands well
+ * inside WatchdogSec. */
+static uint64_t monitor_kernel_slack_ms(const monitor_state_t *state) {
+  uint64_t slack_ms = state->scheduler.slack_ms;
+  uint64_t limit_ms = state->scheduler.interval_ms / 20;
+  if (state->watchdog.interval_ms > 0 &&
+      monitor_watchdog_slack_ms(state) < limit_ms) {
+    limit_ms = monitor_watchdog_slack_ms(state);
+  }
+  return slack_ms < limit_ms ? slack_ms : limit_ms;
+}
+
+/* 0 restores the thread's default slack. */
+static void monitor_set_timer_slack(openups_ctx_t *restrict ctx,
+                                    monitor_state_t *restrict state) {
+  bool was_set = state->scheduler.slack_ms > 0;
+  state->scheduler.slack_ms = (uint64_t)ctx->config.timer_slack_ms;
+  if (!was_set && state->scheduler.slack_ms == 0) {
+    return;
+  }
+  unsigned long slack_ns =
+      (unsigned long)(monitor_kernel_slack_ms(state) * UINT64_C(1000000));
+  if (prctl(PR_SET_TIMERSLACK, slack_ns, 0UL, 0UL, 0UL) != 0) {
+    logger_warn(&ctx->logger, "Failed to set timer slack: %s",
+                strerror(errno));
+  }
+}
+
+/* Steady-state timer wakeups per hour: one per probe, plus the watchdog's
+ * unless every kick finds a probe wakeup within the slack before its
+ * deadline, i.e. the kick period is a probe period or more and exceeds a
+ * multiple of it by no more than the slack. */
+static void monitor_log_coalescing(openups_ctx_t *restrict ctx,
+                                   const monitor_state_t *restrict state) {
+  if (state->scheduler.slack_ms == 0) {
+    logger_info(&ctx->logger, "Timer coalescing off");
+    return;
+  }
+  uint64_t probe_ms = state->scheduler.interval_ms;
+  uint64_t watchdog_ms = state->watchdog.interval_ms;
+  double probes = (double)OPENUPS_MS_PER_HOUR / (double)probe_ms;
+  double kicks = watchdog_ms > 0
+                     ? (double)OPENUPS_MS_PER_HOUR / (double)watchdog_ms
+                     : 0.0;
+  bool absorbed = watchdog_ms >= probe_ms &&
+                  watchdog_ms % probe_ms <= monitor_watchdog_slack_ms(state);
+  logger_info(&ctx->logger,
+              "Timer coalescing: %" PRIu64 "ms slack (kernel %" PRIu64
+              "ms), ~%.0f timer wakeups/hour instead of %.0f",
+              state->scheduler.slack_ms, monitor_kernel_slack_ms(state),
+              probes + (absorbed ? 0.0 : kicks), probes + kicks);
+}
+
+/* ---- Low-latency mode ---- */
+
+/* Spin budget per socket read (and per poll() when net.core.busy_poll is
+ * set): enough to pick a reply off the device queue without waiting for
+ * its interrupt, at most this much CPU per wakeup. */
+#define OPENUPS_BUSY_POLL_US 50
+
+static bool monitor_busy_poll(openups_ctx_t *restrict ctx) {
+  char error_msg[OPENUPS_LOG_BUFFER_SIZE];
+  if (!realtime_busy_poll(probe_backend_poll_fd(&ctx->probe),
+                          OPENUPS_BUSY_POLL_US, error_msg,
+                          sizeof(error_msg))) {
+    logger_warn(&ctx->logger, "Low-latency mode: %s", error_msg);
+    return false;
+  }
+  return true;
+}
+
+/* Pins first so the pages locked next are faulted in from the reactor's
+ * NUMA node, and switches to SCHED_FIFO last, once nothing left can
+ * page-fault.  A step that fails is logged and skipped. */
+static void monitor_low_latency_enter(openups_ctx_t *restrict ctx) {
+  const config_t *config = &ctx->config;
+  char error_msg[OPENUPS_LOG_BUFFER_SIZE];
+  char line[256] = "";
+  size_t used = 0;
+  if (config->cpu >= 0) {
+    if (realtime_pin_cpu(config->cpu, error_msg, sizeof(error_msg))) {
+      monitor_append(line, sizeof(line), &used, "CPU %d", config->cpu);
+    } else {
+      logger_warn(&ctx->logger, "Low-latency mode: %s", error_msg);
+    }
+  }
+  long locked_kb = -1;
+  if (realtime_lock_memory(&locked_kb, error_msg, sizeof(error_msg))) {
+    monitor_append(line, sizeof(line), &used, "%s%ld KiB locked",
+                   used > 0 ? ", " : "", locked_kb);
+  } else {
+    logger_warn(&ctx->logger, "Low-latency mode: %s", error_msg);
+  }
+  if (monitor_busy_poll(ctx)) {
+    int poll_us = realtime_busy_poll_sysctl();
+    monitor_append(line, sizeof(line), &used, "%sbusy-poll %dus%s",
+                   used > 0 ? ", " : "", OPENUPS_BUSY_POLL_US,
+                   poll_us == 0 ? " on reads only (net.core.busy_poll=0)"
+                                : "");
+  }
+  if (config->rt_priority > 0) {
+    if (realtime_set_fifo(config->rt_priority, error_msg,
+                          sizeof(error_msg))) {
+      monitor_append(line, sizeof(line), &used, "%sSCHED_FIFO %d",
+                     used > 0 ? ", " : "", config->rt_priority);
+    } else {
+      logger_warn(&ctx->logger, "Low-latency mode: %s", error_msg);
+    }
+  }
+  logger_info(&ctx->logger, "Low-latency mode: %s",
+              used > 0 ? line : "nothing applied");
+}
+
 static bool monitor_loop_init(openups_ctx_t *restrict ctx,
                               monitor_loop_t *restrict loop) {
   if (ctx == NULL || loop == NULL) {
@@ -779,7 +1975,10 @@ static bool monitor_loop_init(openups_ctx_t *restrict ctx,
   }
   memset(loop, 0, sizeof(*loop));
   loop->signals.fd = -1;
-  if (!signal_channel_init(&loop->signals, &ctx->logger)) {
+  int inherited_signal_fd = ctx->inherited_signal_fd;
+  ctx->inherited_signal_fd = -1;
+  if (!signal_channel_init(&loop->signals, &ctx->logger,
+                           inherited_signal_fd)) {
     return false;
   }
   if (!monitor_prepare_packet(ctx, &loop->packet_len)) {
@@ -788,7 +1987,7 @@ static bool monitor_loop_init(openups_ctx_t *restrict ctx,
     return false;
   }
   uint64_t interval_ms = config_interval_ms(&ctx->config);
-  if (!monitor_refresh_time(&loop->now_ms) || interval_ms == 0 ||
+  if (!monitor_refresh_time(ctx, &loop->now_ms) || interval_ms == 0 ||
       interval_ms == UINT64_MAX) {
     logger_error(&ctx->logger, "Failed to initialize monotonic timing state");
     signal_channel_destroy(&loop->signals, &ctx->logger);
@@ -796,13 +1995,35 @@ static bool monitor_loop_init(openups_ctx_t *restrict ctx,
   }
   monitor_state_init(&loop->state, loop->now_ms, interval_ms,
                      runtime_services_watchdog_interval_ms(&ctx->services));
+  monitor_set_timer_slack(ctx, &loop->state);
+  monitor_scheduler_set_phase(
+      &loop->state, pacer_phase_us(ctx->host_seed, &ctx->dest_addr,
+                                   interval_ms * OPENUPS_US_PER_MS) /
+                        OPENUPS_US_PER_MS);
+  monitor_checkpoint_restore(ctx, &loop->state, loop->now_ms);
+  monitor_pmtu_start(ctx, &loop->state, loop->now_ms);
   loop->fds[0] = (struct pollfd){
       .fd = loop->signals.fd,
       .events = POLLIN,
       .revents = 0,
   };
   loop->fds[1] = (struct pollfd){
-      .fd = ctx->pinger.sockfd,
+      .fd = probe_backend_poll_fd(&ctx->probe),
+      .events = probe_backend_poll_events(&ctx->probe),
+      .revents = 0,
+  };
+  loop->fds[2] = (struct pollfd){
+      .fd = ctx->netlink.sockfd,
+      .events = POLLIN,
+      .revents = 0,
+  };
+  loop->fds[3] = (struct pollfd){
+      .fd = loop->state.pmtu.enabled ? ctx->pmtu.pinger.sockfd : -1,
+      .events = POLLIN,
+      .revents = 0,
+  };
+  loop->fds[4] = (struct pollfd){
+      .fd = -1,
       .events = POLLIN,
       .revents = 0,
   };
@@ -835,16 +2056,41 @@ static monitor_step_result_t monitor_run_due_work(
   if (step_result != MONITOR_STEP_CONTINUE) {
     return step_result;
   }
-  return monitor_handle_scheduler(ctx, &loop->state, loop->now_ms,
-                                  loop->packet_len);
+  step_result = monitor_handle_scheduler(ctx, &loop->state, loop->now_ms,
+                                         loop->packet_len);
+  if (step_result != MONITOR_STEP_CONTINUE) {
+    return step_result;
+  }
+  monitor_handle_hops(ctx, &loop->state, loop->now_ms);
+  return monitor_handle_pmtu(ctx, &loop->state, loop->now_ms);
 }
 
 static void monitor_log_startup(openups_ctx_t *restrict ctx) {
   if (ctx == NULL) {
     return;
   }
-  logger_info(&ctx->logger, "Starting OpenUPS for target %s, every %ds",
-              ctx->config.target, ctx->config.interval_sec);
+  if (ctx->probe.kind == PROBE_KIND_ICMP) {
+    logger_info(&ctx->logger, "Starting OpenUPS for target %s, every %ds",
+                ctx->config.target, ctx->config.interval_sec);
+  } else {
+    logger_info(&ctx->logger,
+                "Starting OpenUPS for target %s port %d (%s probe), every %ds",
+                ctx->config.target, ctx->config.probe_port, ctx->probe.label,
+                ctx->config.interval_sec);
+  }
+  for (int i = 0; i < ctx->config.shadow_count; i++) {
+    char description[96];
+    monitor_shadow_describe(&ctx->config.shadows[i], description,
+                            sizeof(description));
+    logger_info(&ctx->logger, "Shadow policy %d: %s (logged only)", i + 1,
+                description);
+  }
+  if (monitor_local_path_down(ctx)) {
+    char reason[128];
+    netlink_monitor_describe(&ctx->netlink, reason, sizeof(reason));
+    logger_warn(&ctx->logger, "Local path to %s is down at startup: %s",
+                ctx->config.target, reason);
+  }
   (void)monitor_notify_ready(ctx);
   (void)runtime_services_notify_statusf(&ctx->services, "Monitoring %s",
                                         ctx->config.target);
@@ -867,22 +2113,321 @@ static void monitor_log_shutdown(openups_ctx_t *restrict ctx, int exit_code) {
   }
 }
 
+static void monitor_set_dest_port(struct sockaddr_storage *restrict addr,
+                                  uint16_t port) {
+  if (addr->ss_family == AF_INET6) {
+    ((struct sockaddr_in6 *)addr)->sin6_port = htons(port);
+  } else {
+    ((struct sockaddr_in *)addr)->sin_port = htons(port);
+  }
+}
+
+/* Receive stamps feed the reply detection statistics; a socket that
+ * refuses them only loses that line. */
+static void monitor_icmp_backend_init(openups_ctx_t *restrict ctx) {
+  (void)icmp_pinger_enable_timestamps(&ctx->pinger);
+  probe_backend_init_icmp(&ctx->probe, &ctx->pinger);
+}
+
+static bool monitor_probe_init(openups_ctx_t *restrict ctx, int family,
+                               char *restrict error_msg, size_t error_size) {
+  switch (ctx->config.probe_kind) {
+  case PROBE_KIND_TCP:
+    monitor_set_dest_port(&ctx->dest_addr, (uint16_t)ctx->config.probe_port);
+    if (!tcp_prober_init(&ctx->tcp_prober, family, error_msg, error_size)) {
+      return false;
+    }
+    probe_backend_init_tcp(&ctx->probe, &ctx->tcp_prober);
+    return true;
+  case PROBE_KIND_UDP:
+    monitor_set_dest_port(&ctx->dest_addr, (uint16_t)ctx->config.probe_port);
+    if (!udp_prober_init(&ctx->udp_prober, family, error_msg, error_size)) {
+      return false;
+    }
+    probe_backend_init_udp(&ctx->probe, &ctx->udp_prober);
+    return true;
+  case PROBE_KIND_ICMP:
+  default:
+    if (ctx->inherited_icmp_fd >= 0) {
+      int inherited_fd = ctx->inherited_icmp_fd;
+      ctx->inherited_icmp_fd = -1;
+      if (icmp_pinger_adopt(&ctx->pinger, inherited_fd, family, error_msg,
+                            error_size)) {
+        logger_info(&ctx->logger, "Reusing ICMP socket from systemd fd store");
+        monitor_icmp_backend_init(ctx);
+        return true;
+      }
+      logger_warn(&ctx->logger, "%s; opening a new socket", error_msg);
+      close(inherited_fd);
+    }
+    if (!icmp_pinger_init(&ctx->pinger, family, error_msg, error_size)) {
+      return false;
+    }
+    monitor_icmp_backend_init(ctx);
+    return true;
+  }
+}
+
+/* ---- Hot reload (SIGHUP) ---- */
+
+static bool monitor_target_changed(const config_t *restrict current,
+                                   const config_t *restrict next) {
+  return strcmp(current->target, next->target) != 0 ||
+         current->probe_kind != next->probe_kind ||
+         current->probe_port != next->probe_port;
+}
+
+/* Re-points the probe at a new target.  The current backend is reused when
+ * kind and address family are unchanged so the socket (and its BPF filter)
+ * survives; otherwise it is rebuilt, and the old one is only torn down once
+ * the replacement address resolved. */
+static bool monitor_reload_target(openups_ctx_t *restrict ctx,
+                                  monitor_loop_t *restrict loop,
+                                  const config_t *restrict next,
+                                  bool *restrict fatal,
+                                  char *restrict error_msg,
+                                  size_t error_size) {
+  *fatal = false;
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+  if (!resolve_target(next->target, &addr, &addr_len, error_msg,
+                      error_size)) {
+    return false;
+  }
+  if (monitor_ping_waiting(&loop->state)) {
+    probe_backend_cancel(&ctx->probe);
+    monitor_ping_clear(&loop->state);
+  }
+
+  bool rebuild = next->probe_kind != ctx->config.probe_kind ||
+                 addr.ss_family != ctx->dest_addr.ss_family;
+  ctx->dest_addr = addr;
+  ctx->dest_addr_len = addr_len;
+  ctx->config.probe_kind = next->probe_kind;
+  ctx->config.probe_port = next->probe_port;
+  if (!rebuild) {
+    if (next->probe_kind != PROBE_KIND_ICMP) {
+      monitor_set_dest_port(&ctx->dest_addr, (uint16_t)next->probe_port);
+    }
+  } else {
+    probe_backend_destroy(&ctx->probe);
+    if (!monitor_probe_init(ctx, addr.ss_family, error_msg, error_size) ||
+        !monitor_prepare_packet(ctx, &loop->packet_len)) {
+      *fatal = true;
+      return false;
+    }
+    if (ctx->config.low_latency && ctx->probe.kind == PROBE_KIND_ICMP) {
+      (void)monitor_busy_poll(ctx);
+    }
+  }
+
+  ctx->consecutive_fails = 0;
+  ctx->reply_ttl = 0;
+  (void)shutdown_fsm_cancel(ctx, &loop->state);
+  metrics_init(&ctx->metrics, loop->now_ms);
+  memset(ctx->shadows, 0, sizeof(ctx->shadows));
+  netlink_monitor_destroy(&ctx->netlink);
+  return true;
+}
+
+/* Applies a re-resolved configuration in place.  Returns STEP_ERROR only
+ * when a rebuilt probe backend could not be created (*fatal in
+ * monitor_reload_target); a rejected config leaves everything untouched. */
+static monitor_step_result_t monitor_apply_reload(
+    openups_ctx_t *restrict ctx, monitor_loop_t *restrict loop) {
+  char error_msg[256];
+  bool exit_requested = false;
+  config_t next;
+  if (!config_resolve(&next, ctx->argc, ctx->argv, &exit_requested, error_msg,
+                      sizeof(error_msg)) ||
+      exit_requested) {
+    logger_error(&ctx->logger,
+                 "Reload rejected, keeping current configuration: %s",
+                 exit_requested ? "help/version requested" : error_msg);
+    (void)runtime_services_notify_statusf(&ctx->services,
+                                          "Reload rejected: %s", error_msg);
+    return MONITOR_STEP_CONTINUE;
+  }
+  if (next.enable_systemd != ctx->config.enable_systemd) {
+    logger_warn(&ctx->logger,
+                "systemd integration cannot change on reload; restart required");
+    next.enable_systemd = ctx->config.enable_systemd;
+  }
+  if (strcmp(next.state_file, ctx->config.state_file) != 0) {
+    logger_warn(&ctx->logger,
+                "State file cannot change on reload; restart required");
+    memcpy(next.state_file, ctx->config.state_file, sizeof(next.state_file));
+  }
+  if (next.low_latency != ctx->config.low_latency ||
+      next.cpu != ctx->config.cpu ||
+      next.rt_priority != ctx->config.rt_priority) {
+    logger_warn(&ctx->logger,
+                "Low-latency mode cannot change on reload; restart required");
+    next.low_latency = ctx->config.low_latency;
+    next.cpu = ctx->config.cpu;
+    next.rt_priority = ctx->config.rt_priority;
+  }
+
+  bool pmtu_restart = next.enable_pmtu != ctx->config.enable_pmtu ||
+                      monitor_target_changed(&ctx->config, &next);
+  bool hops_restart = next.enable_hops != ctx->config.enable_hops ||
+                      monitor_target_changed(&ctx->config, &next);
+  if (monitor_target_changed(&ctx->config, &next)) {
+    bool fatal = false;
+    if (!monitor_reload_target(ctx, loop, &next, &fatal, error_msg,
+                               sizeof(error_msg))) {
+      if (fatal) {
+        return monitor_runtime_error(ctx, "Reload failed: %s", error_msg);
+      }
+      logger_error(&ctx->logger,
+                   "Reload rejected, keeping current target: %s", error_msg);
+      return MONITOR_STEP_CONTINUE;
+    }
+    logger_info(&ctx->logger, "Reload: target is now %s (%s)", next.target,
+                probe_kind_to_string(next.probe_kind));
+    (void)monitor_scheduler_rebase(&loop->state, loop->now_ms, true);
+  }
+
+  if (next.interval_sec != ctx->config.interval_sec) {
+    loop->state.scheduler.interval_ms = config_interval_ms(&next);
+    (void)monitor_scheduler_rebase(&loop->state, loop->now_ms, false);
+  }
+  /* The kernel slack is capped by the interval. */
+  bool slack_changed =
+      next.timer_slack_ms != ctx->config.timer_slack_ms ||
+      (next.timer_slack_ms > 0 && next.interval_sec != ctx->config.interval_sec);
+  bool netlink_restart = next.enable_netlink != ctx->config.enable_netlink ||
+                         (next.enable_netlink && ctx->netlink.sockfd < 0);
+  bool payload_changed = next.payload_size != ctx->config.payload_size;
+  /* Policy slots are compared whole: config_init_default() zeroes them. */
+  if (next.shadow_count != ctx->config.shadow_count ||
+      memcmp(next.shadows, ctx->config.shadows, sizeof(next.shadows)) != 0) {
+    memset(ctx->shadows, 0, sizeof(ctx->shadows));
+  }
+  ctx->config = next;
+  const reactor_io_t *log_clock = ctx->logger.clock;
+  logger_init(&ctx->logger, ctx->config.log_level,
+              config_log_timestamps_enabled(&ctx->config));
+  ctx->logger.clock = log_clock;
+
+  if (slack_changed) {
+    monitor_set_timer_slack(ctx, &loop->state);
+    monitor_log_coalescing(ctx, &loop->state);
+  }
+
+  if (payload_changed && !monitor_prepare_packet(ctx, &loop->packet_len)) {
+    return monitor_runtime_error(ctx, "Reload failed: no memory for a %d-byte "
+                                 "payload", ctx->config.payload_size);
+  }
+
+  if (pmtu_restart) {
+    monitor_pmtu_open(ctx);
+    monitor_pmtu_start(ctx, &loop->state, loop->now_ms);
+  }
+  if (hops_restart) {
+    monitor_hops_open(ctx);
+    loop->state.hops.waiting = false;
+  }
+
+  if (netlink_restart) {
+    netlink_monitor_destroy(&ctx->netlink);
+    if (ctx->config.enable_netlink &&
+        !netlink_monitor_init(&ctx->netlink, &ctx->dest_addr, error_msg,
+                              sizeof(error_msg))) {
+      logger_warn(&ctx->logger, "%s; route watch disabled", error_msg);
+    }
+  }
+
+  /* A lowered threshold may already be met; a raised one may no longer
+   * justify a running countdown. */
+  if (monitor_shutdown_pending(&loop->state) &&
+      ctx->consecutive_fails < ctx->config.fail_threshold) {
+    monitor_shutdown_clear(&loop->state);
+    logger_info(&ctx->logger,
+                "Failure threshold raised; cancelled pending shutdown countdown");
+  }
+  logger_info(&ctx->logger,
+              "Configuration reloaded: every %ds, threshold %d, timeout %dms, "
+              "%s mode",
+              ctx->config.interval_sec, ctx->config.fail_threshold,
+              ctx->config.timeout_ms,
+              shutdown_mode_to_string(ctx->config.shutdown_mode));
+  (void)runtime_services_notify_statusf(&ctx->services,
+                                        "Reloaded, monitoring %s",
+                                        ctx->config.target);
+  return shutdown_fsm_handle_threshold(ctx, &loop->state, loop->now_ms)
+             ? MONITOR_STEP_STOP
+             : MONITOR_STEP_CONTINUE;
+}
+
+static monitor_step_result_t monitor_reload_config(
+    openups_ctx_t *restrict ctx, monitor_loop_t *restrict loop) {
+  if (ctx == NULL || loop == NULL || ctx->argv == NULL) {
+    return MONITOR_STEP_CONTINUE;
+  }
+  logger_info(&ctx->logger, "SIGHUP received, reloading configuration");
+  (void)runtime_services_notify_reloading(&ctx->services);
+  monitor_step_result_t result = monitor_apply_reload(ctx, loop);
+  monitor_store_fds(ctx, loop);
+  (void)runtime_services_notify_ready(&ctx->services);
+  return result;
+}
+
 /* ---- Public API ---- */
 
+void openups_ctx_set_cmdline(openups_ctx_t *restrict ctx, int argc,
+                             char **argv) {
+  if (ctx == NULL) {
+    return;
+  }
+  ctx->argc = argc;
+  ctx->argv = argv;
+}
+
 bool openups_ctx_init(openups_ctx_t *restrict ctx,
                       const config_t *restrict config,
                       char *restrict error_msg, size_t error_size) {
+  return openups_ctx_init_io(ctx, config, NULL, NULL, error_msg, error_size);
+}
+
+/* io and probe, when given, replace the system clock/poll and the socket
+ * backend; the logger then stamps lines with io's clock. */
+bool openups_ctx_init_io(openups_ctx_t *restrict ctx,
+                         const config_t *restrict config,
+                         const reactor_io_t *restrict io,
+                         const probe_backend_t *restrict probe,
+                         char *restrict error_msg, size_t error_size) {
   if (ctx == NULL || config == NULL || error_msg == NULL || error_size == 0) {
     return false;
   }
   memset(ctx, 0, sizeof(*ctx));
+  ctx->io = io != NULL ? *io
+                       : (reactor_io_t){
+                             .backend_ctx = NULL,
+                             .now_ms = reactor_io_system_now_ms,
+                             .poll = reactor_io_system_poll,
+                         };
+  ctx->netlink.sockfd = -1;
+  ctx->state_store.fd = -1;
+  ctx->pmtu.pinger.sockfd = -1;
+  ctx->hops.pinger.sockfd = -1;
   ctx->config = *config;
+  static const char *const inherited_names[] = {OPENUPS_FDNAME_ICMP,
+                                                OPENUPS_FDNAME_SIGNALFD};
+  int inherited_fds[2];
+  (void)systemd_listen_fds_take(inherited_names, inherited_fds, 2);
+  ctx->inherited_icmp_fd = inherited_fds[0];
+  ctx->inherited_signal_fd = inherited_fds[1];
   ctx->cached_pid = (uint16_t)(getpid() & 0xFFFF);
   if (ctx->cached_pid == 0) {
     ctx->cached_pid = 1;
   }
+  ctx->host_seed = pacer_host_seed();
   logger_init(&ctx->logger, ctx->config.log_level,
               config_log_timestamps_enabled(&ctx->config));
+  if (io != NULL) {
+    ctx->logger.clock = &ctx->io;
+  }
   if (ctx->config.log_level == LOG_LEVEL_DEBUG) {
     config_print(&ctx->config, &ctx->logger);
   }
@@ -892,10 +2437,29 @@ bool openups_ctx_init(openups_ctx_t *restrict ctx,
     return false;
   }
   int family = ((const struct sockaddr *)&ctx->dest_addr)->sa_family;
-  if (!icmp_pinger_init(&ctx->pinger, family, error_msg, error_size)) {
+  if (probe != NULL) {
+    ctx->probe = *probe;
+  } else if (!monitor_probe_init(ctx, family, error_msg, error_size)) {
     return false;
   }
-  metrics_init(&ctx->metrics);
+  if (ctx->config.enable_netlink) {
+    char netlink_error[OPENUPS_LOG_BUFFER_SIZE];
+    if (!netlink_monitor_init(&ctx->netlink, &ctx->dest_addr, netlink_error,
+                              sizeof(netlink_error))) {
+      logger_warn(&ctx->logger, "%s; route watch disabled", netlink_error);
+    }
+  }
+  monitor_pmtu_open(ctx);
+  monitor_hops_open(ctx);
+  if (ctx->config.state_file[0] != '\0') {
+    char state_error[OPENUPS_LOG_BUFFER_SIZE];
+    if (!state_store_open(&ctx->state_store, ctx->config.state_file,
+                          state_error, sizeof(state_error))) {
+      logger_warn(&ctx->logger, "%s; checkpointing disabled", state_error);
+    }
+  }
+  metrics_init(&ctx->metrics, ctx->io.now_ms(ctx->io.backend_ctx));
+  reactor_stats_init(&ctx->reactor, ctx->io.now_ms(ctx->io.backend_ctx));
   runtime_services_init(&ctx->services, &ctx->systemd,
                         ctx->config.enable_systemd);
   if (!runtime_services_is_enabled(&ctx->services)) {
@@ -917,7 +2481,22 @@ void openups_ctx_destroy(openups_ctx_t *restrict ctx) {
     return;
   }
   runtime_services_destroy(&ctx->services);
-  icmp_pinger_destroy(&ctx->pinger);
+  if (ctx->inherited_icmp_fd >= 0) {
+    close(ctx->inherited_icmp_fd);
+  }
+  if (ctx->inherited_signal_fd >= 0) {
+    close(ctx->inherited_signal_fd);
+  }
+  netlink_monitor_destroy(&ctx->netlink);
+  state_store_close(&ctx->state_store);
+  probe_backend_destroy(&ctx->probe);
+  if (monitor_pmtu_active(ctx)) {
+    pmtu_prober_destroy(&ctx->pmtu);
+  }
+  if (monitor_hops_active(ctx)) {
+    hop_sweep_destroy(&ctx->hops);
+  }
+  free(ctx->send_buf);
   memset(ctx, 0, sizeof(*ctx));
 }
 
@@ -931,9 +2510,19 @@ int openups_reactor_run(openups_ctx_t *restrict ctx) {
   }
   int exit_code = OPENUPS_EXIT_SUCCESS;
   monitor_log_startup(ctx);
+  if (loop.state.scheduler.slack_ms > 0) {
+    monitor_log_coalescing(ctx, &loop.state);
+  }
+  if (ctx->config.low_latency) {
+    monitor_low_latency_enter(ctx);
+  }
+  monitor_store_fds(ctx, &loop);
   while (!ctx->stop_flag) {
-    (void)monitor_refresh_time(&loop.now_ms);
+    ctx->reactor.iterations++;
+    (void)monitor_refresh_time(ctx, &loop.now_ms);
+    uint64_t start_us = get_monotonic_us();
     monitor_step_result_t step_result = monitor_run_due_work(ctx, &loop);
+    reactor_stats_charge(&ctx->reactor, REACTOR_HANDLER_DUE_WORK, start_us);
     if (step_result == MONITOR_STEP_ERROR) {
       exit_code = monitor_failure_exit_code();
       break;
@@ -944,6 +2533,16 @@ int openups_reactor_run(openups_ctx_t *restrict ctx) {
     step_result = monitor_handle_poll_events(ctx, &loop.signals,
                                              &loop.state, loop.fds,
                                              &loop.now_ms);
+    if (step_result == MONITOR_STEP_CONTINUE && ctx->reload_flag) {
+      ctx->reload_flag = 0;
+      start_us = get_monotonic_us();
+      step_result = monitor_reload_config(ctx, &loop);
+      reactor_stats_charge(&ctx->reactor, REACTOR_HANDLER_RELOAD, start_us);
+    }
+    start_us = get_monotonic_us();
+    monitor_checkpoint_save(ctx, &loop.state, loop.now_ms);
+    reactor_stats_charge(&ctx->reactor, REACTOR_HANDLER_CHECKPOINT,
+                         start_us);
     if (step_result == MONITOR_STEP_ERROR) {
       exit_code = monitor_failure_exit_code();
       break;
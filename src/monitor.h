@@ -6,7 +6,14 @@
 bool openups_ctx_init(openups_ctx_t *restrict ctx,
                       const config_t *restrict config,
                       char *restrict error_msg, size_t error_size);
+bool openups_ctx_init_io(openups_ctx_t *restrict ctx,
+                         const config_t *restrict config,
+                         const reactor_io_t *restrict io,
+                         const probe_backend_t *restrict probe,
+                         char *restrict error_msg, size_t error_size);
 void openups_ctx_destroy(openups_ctx_t *restrict ctx);
+void openups_ctx_set_cmdline(openups_ctx_t *restrict ctx, int argc,
+                             char **argv);
 int openups_reactor_run(openups_ctx_t *restrict ctx);
 
 #endif // OPENUPS_MONITOR_H
\ No newline at end of file
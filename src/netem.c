@@ -0,0 +1,941 @@
+#define _GNU_SOURCE /* ppoll, unshare */
+#include "netem.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/if_tun.h>
+#include <linux/ipv6.h>
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Requests read per reactor turn before due replies are written again. */
+#define NETEM_READ_BURST 64U
+#define NETEM_MAX_DELAY_MS 60000.0
+#define NETEM_MAX_SCRIPT_SEC 1000000.0
+#define NETEM_REPLY_TTL 64U
+#define NETEM_NS_PER_US UINT64_C(1000)
+#define NETEM_US_PER_MS 1000.0
+#define NETEM_US_PER_SEC UINT64_C(1000000)
+
+/* ---- Settings ---- */
+
+void netem_impair_init(netem_impair_t *restrict impair) {
+  if (impair == NULL) {
+    return;
+  }
+  memset(impair, 0, sizeof(*impair));
+  impair->delay.kind = NETEM_DELAY_FIXED;
+  impair->loss.kind = NETEM_LOSS_NONE;
+}
+
+/* Exactly count non-negative numbers separated by commas, each at most
+ * limit. */
+static bool netem_parse_numbers(const char *restrict text,
+                                double *restrict values, size_t count,
+                                double limit) {
+  for (size_t i = 0; i < count; i++) {
+    char *end = NULL;
+    errno = 0;
+    double value = strtod(text, &end);
+    if (end == text || errno != 0 || !(value >= 0.0) || value > limit) {
+      return false;
+    }
+    values[i] = value;
+    text = end;
+    if (i + 1 < count) {
+      if (*text != ',') {
+        return false;
+      }
+      text++;
+    }
+  }
+  return *text == '\0';
+}
+
+static bool netem_has_prefix(const char *restrict text,
+                             const char *restrict prefix,
+                             const char **restrict rest) {
+  size_t len = strlen(prefix);
+  if (strncmp(text, prefix, len) != 0) {
+    return false;
+  }
+  *rest = text + len;
+  return true;
+}
+
+static bool netem_parse_delay(const char *restrict value,
+                              netem_delay_t *restrict delay) {
+  double numbers[2] = {0.0, 0.0};
+  const char *rest = NULL;
+  if (netem_has_prefix(value, "uniform:", &rest)) {
+    if (!netem_parse_numbers(rest, numbers, 2, NETEM_MAX_DELAY_MS) ||
+        numbers[1] < numbers[0]) {
+      return false;
+    }
+    delay->kind = NETEM_DELAY_UNIFORM;
+  } else if (netem_has_prefix(value, "normal:", &rest)) {
+    if (!netem_parse_numbers(rest, numbers, 2, NETEM_MAX_DELAY_MS)) {
+      return false;
+    }
+    delay->kind = NETEM_DELAY_NORMAL;
+  } else {
+    if (!netem_parse_numbers(value, numbers, 1, NETEM_MAX_DELAY_MS)) {
+      return false;
+    }
+    delay->kind = NETEM_DELAY_FIXED;
+  }
+  delay->a_ms = numbers[0];
+  delay->b_ms = numbers[1];
+  return true;
+}
+
+static bool netem_parse_loss(const char *restrict value,
+                             netem_loss_t *restrict loss) {
+  double percents[2] = {0.0, 0.0};
+  const char *rest = NULL;
+  if (strcmp(value, "none") == 0) {
+    loss->kind = NETEM_LOSS_NONE;
+  } else if (netem_has_prefix(value, "gilbert:", &rest)) {
+    /* A burst nobody can leave is a blackout: spell that loss=100. */
+    if (!netem_parse_numbers(rest, percents, 2, 100.0) || percents[1] <= 0.0) {
+      return false;
+    }
+    loss->kind = NETEM_LOSS_GILBERT;
+  } else {
+    if (!netem_parse_numbers(value, percents, 1, 100.0)) {
+      return false;
+    }
+    loss->kind = percents[0] > 0.0 ? NETEM_LOSS_BERNOULLI : NETEM_LOSS_NONE;
+  }
+  loss->p = percents[0] / 100.0;
+  loss->r = percents[1] / 100.0;
+  return true;
+}
+
+/* One key=value setting: delay=MS | uniform:MIN,MAX | normal:MEAN,SD,
+ * loss=none | PCT | gilbert:ENTER_PCT,LEAVE_PCT, duplicate=PCT,
+ * reorder=PCT,MS.  impair is only changed when the setting is valid. */
+bool netem_impair_set(netem_impair_t *restrict impair,
+                      const char *restrict setting, char *restrict error_msg,
+                      size_t error_size) {
+  if (impair == NULL || setting == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return false;
+  }
+  const char *equals = strchr(setting, '=');
+  if (equals == NULL) {
+    snprintf(error_msg, error_size,
+             "Invalid setting '%s': expected key=value", setting);
+    return false;
+  }
+  size_t key_len = (size_t)(equals - setting);
+  const char *value = equals + 1;
+  netem_impair_t next = *impair;
+  bool known = true;
+  bool valid = false;
+  double numbers[2] = {0.0, 0.0};
+  if (key_len == 5 && strncmp(setting, "delay", key_len) == 0) {
+    valid = netem_parse_delay(value, &next.delay);
+  } else if (key_len == 4 && strncmp(setting, "loss", key_len) == 0) {
+    valid = netem_parse_loss(value, &next.loss);
+  } else if (key_len == 9 && strncmp(setting, "duplicate", key_len) == 0) {
+    valid = netem_parse_numbers(value, numbers, 1, 100.0);
+    next.duplicate = numbers[0] / 100.0;
+  } else if (key_len == 7 && strncmp(setting, "reorder", key_len) == 0) {
+    valid = netem_parse_numbers(value, numbers, 2, NETEM_MAX_DELAY_MS) &&
+            numbers[0] <= 100.0;
+    next.reorder = numbers[0] / 100.0;
+    next.reorder_ms = numbers[1];
+  } else {
+    known = false;
+  }
+  if (!known) {
+    snprintf(error_msg, error_size,
+             "Unknown setting '%.*s' (expected delay, loss, duplicate or "
+             "reorder)",
+             (int)key_len, setting);
+    return false;
+  }
+  if (!valid) {
+    snprintf(error_msg, error_size, "Invalid %.*s value '%s'", (int)key_len,
+             setting, value);
+    return false;
+  }
+  *impair = next;
+  return true;
+}
+
+/* ---- Script ---- */
+
+/* One line: "SECONDS [key=value ...]".  Settings accumulate from line to
+ * line, starting from base; '#' starts a comment. */
+static bool netem_script_line(netem_script_t *restrict script,
+                              netem_impair_t *restrict current, char *line,
+                              int line_no, char *restrict error_msg,
+                              size_t error_size) {
+  char *comment = strchr(line, '#');
+  if (comment != NULL) {
+    *comment = '\0';
+  }
+  char *save = NULL;
+  char *token = strtok_r(line, " \t\r", &save);
+  if (token == NULL) {
+    return true;
+  }
+  double seconds = 0.0;
+  if (!netem_parse_numbers(token, &seconds, 1, NETEM_MAX_SCRIPT_SEC)) {
+    snprintf(error_msg, error_size, "Script line %d: invalid time '%s'",
+             line_no, token);
+    return false;
+  }
+  uint64_t at_us = (uint64_t)(seconds * (double)NETEM_US_PER_SEC + 0.5);
+  if (script->count > 0 && at_us < script->steps[script->count - 1].at_us) {
+    snprintf(error_msg, error_size,
+             "Script line %d: time %.3fs goes backwards", line_no, seconds);
+    return false;
+  }
+  if (script->count == OPENUPS_NETEM_MAX_STEPS) {
+    snprintf(error_msg, error_size, "Script line %d: more than %u steps",
+             line_no, OPENUPS_NETEM_MAX_STEPS);
+    return false;
+  }
+  char detail[192];
+  while ((token = strtok_r(NULL, " \t\r", &save)) != NULL) {
+    if (!netem_impair_set(current, token, detail, sizeof(detail))) {
+      snprintf(error_msg, error_size, "Script line %d: %s", line_no, detail);
+      return false;
+    }
+  }
+  script->steps[script->count].at_us = at_us;
+  script->steps[script->count].impair = *current;
+  script->count++;
+  return true;
+}
+
+bool netem_script_parse(netem_script_t *restrict script,
+                        const netem_impair_t *restrict base,
+                        const char *restrict text, size_t len,
+                        char *restrict error_msg, size_t error_size) {
+  if (script == NULL || base == NULL || (text == NULL && len > 0) ||
+      error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  script->count = 0;
+  netem_impair_t current = *base;
+  int line_no = 0;
+  size_t offset = 0;
+  while (offset < len) {
+    const char *newline = memchr(text + offset, '\n', len - offset);
+    size_t line_len =
+        newline != NULL ? (size_t)(newline - (text + offset)) : len - offset;
+    char line[512];
+    line_no++;
+    if (line_len >= sizeof(line)) {
+      snprintf(error_msg, error_size, "Script line %d: longer than %zu bytes",
+               line_no, sizeof(line) - 1);
+      return false;
+    }
+    memcpy(line, text + offset, line_len);
+    line[line_len] = '\0';
+    if (!netem_script_line(script, &current, line, line_no, error_msg,
+                           error_size)) {
+      return false;
+    }
+    offset += line_len + 1;
+  }
+  return true;
+}
+
+bool netem_script_load(netem_script_t *restrict script,
+                       const netem_impair_t *restrict base,
+                       const char *restrict path, char *restrict error_msg,
+                       size_t error_size) {
+  if (path == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    snprintf(error_msg, error_size, "Cannot open script %s: %s", path,
+             strerror(errno));
+    return false;
+  }
+  target_map_t map;
+  bool mapped = target_map_fd(&map, fd, path, error_msg, error_size);
+  close(fd);
+  if (!mapped) {
+    return false;
+  }
+  bool ok = netem_script_parse(script, base, map.data, map.size, error_msg,
+                               error_size);
+  target_map_close(&map);
+  return ok;
+}
+
+/* ---- Impairment model ---- */
+
+/* splitmix64: a seed reproduces the same fate for every request. */
+static double netem_uniform(netem_model_t *restrict model) {
+  uint64_t z = (model->rng += UINT64_C(0x9E3779B97F4A7C15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+  z ^= z >> 31;
+  return (double)(z >> 11) * 0x1.0p-53;
+}
+
+/* The normal draw sums twelve uniforms (Irwin-Hall): within 0.1% of a
+ * Gaussian inside 3 deviations, bounded at 6, and no libm. */
+static uint64_t netem_delay_us(netem_model_t *restrict model,
+                               const netem_delay_t *restrict delay) {
+  double ms = delay->a_ms;
+  if (delay->kind == NETEM_DELAY_UNIFORM) {
+    ms += (delay->b_ms - delay->a_ms) * netem_uniform(model);
+  } else if (delay->kind == NETEM_DELAY_NORMAL) {
+    double z = -6.0;
+    for (int i = 0; i < 12; i++) {
+      z += netem_uniform(model);
+    }
+    ms += delay->b_ms * z;
+  }
+  return ms > 0.0 ? (uint64_t)(ms * NETEM_US_PER_MS + 0.5) : 0;
+}
+
+void netem_model_init(netem_model_t *restrict model,
+                      const netem_impair_t *restrict impair, uint64_t seed) {
+  if (model == NULL || impair == NULL) {
+    return;
+  }
+  memset(model, 0, sizeof(*model));
+  model->impair = *impair;
+  model->rng = seed;
+}
+
+void netem_model_set(netem_model_t *restrict model,
+                     const netem_impair_t *restrict impair) {
+  if (model == NULL || impair == NULL) {
+    return;
+  }
+  model->impair = *impair;
+  if (impair->loss.kind != NETEM_LOSS_GILBERT) {
+    model->burst = false;
+  }
+}
+
+/* Gilbert loss has a lossless and a lossy state: a burst starts with
+ * probability p per request and ends with probability r, so bursts last
+ * 1/r requests on average and p / (p + r) of all requests are lost. */
+netem_fate_t netem_model_decide(netem_model_t *restrict model) {
+  netem_fate_t fate = {0};
+  if (model == NULL) {
+    return fate;
+  }
+  const netem_impair_t *impair = &model->impair;
+  model->stats.requests++;
+  bool lost = false;
+  if (impair->loss.kind == NETEM_LOSS_BERNOULLI) {
+    lost = netem_uniform(model) < impair->loss.p;
+  } else if (impair->loss.kind == NETEM_LOSS_GILBERT) {
+    double draw = netem_uniform(model);
+    model->burst = model->burst ? draw >= impair->loss.r
+                                : draw < impair->loss.p;
+    lost = model->burst;
+  }
+  if (lost) {
+    model->stats.dropped++;
+    return fate;
+  }
+  fate.copies = 1;
+  fate.delay_us[0] = netem_delay_us(model, &impair->delay);
+  if (impair->reorder > 0.0 && netem_uniform(model) < impair->reorder) {
+    fate.delay_us[0] +=
+        (uint64_t)(impair->reorder_ms * NETEM_US_PER_MS + 0.5);
+    model->stats.reordered++;
+  }
+  if (impair->duplicate > 0.0 && netem_uniform(model) < impair->duplicate) {
+    fate.copies = 2;
+    fate.delay_us[1] = netem_delay_us(model, &impair->delay);
+    model->stats.duplicated++;
+  }
+  return fate;
+}
+
+/* ---- Echo reflection ---- */
+
+/* RFC 1624 incremental update for one changed 16-bit word. */
+static uint16_t netem_checksum_adjust(uint16_t checksum, uint16_t old_word,
+                                      uint16_t new_word) {
+  uint32_t sum = (uint32_t)(uint16_t)~checksum + (uint16_t)~old_word +
+                 new_word;
+  sum = (sum & 0xFFFFU) + (sum >> 16);
+  sum = (sum & 0xFFFFU) + (sum >> 16);
+  return (uint16_t)~sum;
+}
+
+/* Turns the type byte at the start of an ICMP header into reply_type and
+ * patches the checksum that follows it.  Swapping the addresses leaves the
+ * IPv6 pseudo-header sum unchanged, so no full pass is needed. */
+static void netem_set_icmp_type(uint8_t *restrict icmp, uint8_t reply_type) {
+  uint16_t old_word = 0;
+  uint16_t new_word = 0;
+  uint16_t checksum = 0;
+  memcpy(&old_word, icmp, sizeof(old_word));
+  icmp[0] = reply_type;
+  memcpy(&new_word, icmp, sizeof(new_word));
+  memcpy(&checksum, icmp + 2, sizeof(checksum));
+  checksum = netem_checksum_adjust(checksum, old_word, new_word);
+  memcpy(icmp + 2, &checksum, sizeof(checksum));
+}
+
+static size_t netem_reflect_ipv4(uint8_t *restrict packet, size_t len) {
+  struct ip header;
+  if (len < sizeof(header)) {
+    return 0;
+  }
+  memcpy(&header, packet, sizeof(header));
+  size_t header_len = (size_t)header.ip_hl * 4U;
+  size_t total_len = ntohs(header.ip_len);
+  /* Fragments are not reassembled: only whole echoes are answered. */
+  if (header_len < sizeof(header) || header.ip_p != IPPROTO_ICMP ||
+      (ntohs(header.ip_off) & (IP_MF | IP_OFFMASK)) != 0 ||
+      total_len < header_len + ICMP_MINLEN || total_len > len) {
+    return 0;
+  }
+  uint8_t *icmp = packet + header_len;
+  if (icmp[0] != ICMP_ECHO || icmp[1] != 0) {
+    return 0;
+  }
+  netem_set_icmp_type(icmp, ICMP_ECHOREPLY);
+  struct in_addr source = header.ip_src;
+  header.ip_src = header.ip_dst;
+  header.ip_dst = source;
+  header.ip_ttl = NETEM_REPLY_TTL;
+  header.ip_sum = 0;
+  memcpy(packet, &header, sizeof(header));
+  header.ip_sum = icmp_checksum(packet, header_len);
+  memcpy(packet, &header, sizeof(header));
+  return total_len;
+}
+
+static size_t netem_reflect_ipv6(uint8_t *restrict packet, size_t len) {
+  struct ip6_hdr header;
+  if (len < sizeof(header) + sizeof(struct icmp6_hdr)) {
+    return 0;
+  }
+  memcpy(&header, packet, sizeof(header));
+  size_t total_len = sizeof(header) + ntohs(header.ip6_plen);
+  /* Extension headers are not walked: the echo must follow directly. */
+  if (header.ip6_nxt != IPPROTO_ICMPV6 ||
+      total_len < sizeof(header) + sizeof(struct icmp6_hdr) ||
+      total_len > len) {
+    return 0;
+  }
+  uint8_t *icmp = packet + sizeof(header);
+  if (icmp[0] != ICMP6_ECHO_REQUEST || icmp[1] != 0) {
+    return 0;
+  }
+  netem_set_icmp_type(icmp, ICMP6_ECHO_REPLY);
+  struct in6_addr source = header.ip6_src;
+  header.ip6_src = header.ip6_dst;
+  header.ip6_dst = source;
+  header.ip6_hlim = NETEM_REPLY_TTL;
+  memcpy(packet, &header, sizeof(header));
+  return total_len;
+}
+
+/* Rewrites an echo request into its reply in place; returns the reply
+ * length, or 0 when the packet is not an echo request. */
+size_t netem_reflect(uint8_t *restrict packet, size_t len) {
+  if (packet == NULL || len == 0) {
+    return 0;
+  }
+  switch (packet[0] >> 4) {
+  case 4:
+    return netem_reflect_ipv4(packet, len);
+  case 6:
+    return netem_reflect_ipv6(packet, len);
+  default:
+    return 0;
+  }
+}
+
+/* ---- Namespace and device ---- */
+
+static bool netem_write_file(const char *restrict path,
+                             const char *restrict text) {
+  int fd = open(path, O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  size_t len = strlen(text);
+  bool ok = write(fd, text, len) == (ssize_t)len;
+  close(fd);
+  return ok;
+}
+
+/* A private network namespace; without CAP_SYS_ADMIN, inside a user
+ * namespace that maps the caller to root, where the distribution allows
+ * unprivileged ones. */
+static bool netem_enter_namespace(char *restrict error_msg,
+                                  size_t error_size) {
+  if (unshare(CLONE_NEWNET) == 0) {
+    return true;
+  }
+  int net_error = errno;
+  uid_t uid = getuid();
+  gid_t gid = getgid();
+  if (unshare(CLONE_NEWUSER | CLONE_NEWNET) != 0) {
+    snprintf(error_msg, error_size,
+             "Cannot create a network namespace: %s (needs CAP_SYS_ADMIN or "
+             "unprivileged user namespaces)",
+             strerror(net_error));
+    return false;
+  }
+  char map[64];
+  bool mapped = netem_write_file("/proc/self/setgroups", "deny");
+  snprintf(map, sizeof(map), "0 %u 1", (unsigned)uid);
+  mapped = mapped && netem_write_file("/proc/self/uid_map", map);
+  snprintf(map, sizeof(map), "0 %u 1", (unsigned)gid);
+  mapped = mapped && netem_write_file("/proc/self/gid_map", map);
+  if (!mapped) {
+    snprintf(error_msg, error_size, "Cannot map user namespace ids: %s",
+             strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+static bool netem_link_up(int sockfd, const char *restrict name) {
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", name);
+  if (ioctl(sockfd, SIOCGIFFLAGS, &ifr) != 0) {
+    return false;
+  }
+  ifr.ifr_flags = (short)(ifr.ifr_flags | IFF_UP);
+  return ioctl(sockfd, SIOCSIFFLAGS, &ifr) == 0;
+}
+
+static int netem_open_tun(char *restrict error_msg, size_t error_size) {
+  int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    snprintf(error_msg, error_size, "Cannot open /dev/net/tun: %s",
+             strerror(errno));
+    return -1;
+  }
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", OPENUPS_NETEM_IFNAME);
+  if (ioctl(fd, TUNSETIFF, &ifr) != 0) {
+    snprintf(error_msg, error_size, "Cannot create %s: %s",
+             OPENUPS_NETEM_IFNAME, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Addresses the device so both benchmarking prefixes route through it.
+ * IPv6 is optional: a host may have it disabled. */
+static bool netem_configure(const logger_t *restrict logger,
+                            char *restrict error_msg, size_t error_size) {
+  int sock4 = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (sock4 < 0) {
+    snprintf(error_msg, error_size, "socket failed: %s", strerror(errno));
+    return false;
+  }
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", OPENUPS_NETEM_IFNAME);
+  struct sockaddr_in *addr = (struct sockaddr_in *)&ifr.ifr_addr;
+  addr->sin_family = AF_INET;
+  (void)inet_pton(AF_INET, OPENUPS_NETEM_ADDR4, &addr->sin_addr);
+  bool ok = ioctl(sock4, SIOCSIFADDR, &ifr) == 0;
+  struct sockaddr_in *mask = (struct sockaddr_in *)&ifr.ifr_netmask;
+  mask->sin_family = AF_INET;
+  mask->sin_addr.s_addr = htonl(UINT32_MAX << (32U - OPENUPS_NETEM_PREFIX4));
+  ok = ok && ioctl(sock4, SIOCSIFNETMASK, &ifr) == 0;
+  ok = ok && netem_link_up(sock4, "lo") &&
+       netem_link_up(sock4, OPENUPS_NETEM_IFNAME);
+  if (!ok) {
+    snprintf(error_msg, error_size, "Cannot configure %s: %s",
+             OPENUPS_NETEM_IFNAME, strerror(errno));
+  }
+  close(sock4);
+  if (!ok) {
+    return false;
+  }
+
+  int sock6 = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  struct in6_ifreq ifr6;
+  memset(&ifr6, 0, sizeof(ifr6));
+  (void)inet_pton(AF_INET6, OPENUPS_NETEM_ADDR6, &ifr6.ifr6_addr);
+  ifr6.ifr6_prefixlen = OPENUPS_NETEM_PREFIX6;
+  ifr6.ifr6_ifindex = (int)if_nametoindex(OPENUPS_NETEM_IFNAME);
+  if (sock6 < 0 || ioctl(sock6, SIOCSIFADDR, &ifr6) != 0) {
+    logger_warn(logger, "IPv6 unavailable on %s: %s", OPENUPS_NETEM_IFNAME,
+                strerror(errno));
+  }
+  if (sock6 >= 0) {
+    close(sock6);
+  }
+  return true;
+}
+
+/* ---- Reply queue (min-heap on due time, FIFO among equals) ---- */
+
+typedef struct {
+  uint64_t due_us;
+  uint64_t order;
+  uint32_t slot;
+} netem_timer_t;
+
+typedef struct {
+  uint8_t *slots; /* capacity packets of OPENUPS_NETEM_MTU bytes */
+  uint32_t *lengths;
+  uint32_t *free_slots;
+  netem_timer_t *heap;
+  uint32_t free_count;
+  uint32_t size;
+  uint32_t capacity;
+  uint64_t order;
+} netem_queue_t;
+
+static void netem_queue_destroy(netem_queue_t *restrict queue) {
+  free(queue->slots);
+  free(queue->lengths);
+  free(queue->free_slots);
+  free(queue->heap);
+  memset(queue, 0, sizeof(*queue));
+}
+
+static bool netem_queue_init(netem_queue_t *restrict queue,
+                             uint32_t capacity) {
+  memset(queue, 0, sizeof(*queue));
+  queue->slots = calloc(capacity, OPENUPS_NETEM_MTU);
+  queue->lengths = calloc(capacity, sizeof(*queue->lengths));
+  queue->free_slots = calloc(capacity, sizeof(*queue->free_slots));
+  queue->heap = calloc(capacity, sizeof(*queue->heap));
+  if (queue->slots == NULL || queue->lengths == NULL ||
+      queue->free_slots == NULL || queue->heap == NULL) {
+    netem_queue_destroy(queue);
+    return false;
+  }
+  queue->capacity = capacity;
+  for (uint32_t i = 0; i < capacity; i++) {
+    queue->free_slots[i] = capacity - 1 - i;
+  }
+  queue->free_count = capacity;
+  return true;
+}
+
+static bool netem_timer_before(const netem_timer_t *restrict a,
+                               const netem_timer_t *restrict b) {
+  return a->due_us < b->due_us ||
+         (a->due_us == b->due_us && a->order < b->order);
+}
+
+static bool netem_queue_push(netem_queue_t *restrict queue,
+                             const uint8_t *restrict packet, size_t len,
+                             uint64_t due_us) {
+  if (queue->free_count == 0 || len > OPENUPS_NETEM_MTU) {
+    return false;
+  }
+  uint32_t slot = queue->free_slots[--queue->free_count];
+  memcpy(queue->slots + (size_t)slot * OPENUPS_NETEM_MTU, packet, len);
+  queue->lengths[slot] = (uint32_t)len;
+  netem_timer_t timer = {.due_us = due_us, .order = queue->order++,
+                         .slot = slot};
+  uint32_t position = queue->size++;
+  while (position > 0) {
+    uint32_t parent = (position - 1) / 2;
+    if (!netem_timer_before(&timer, &queue->heap[parent])) {
+      break;
+    }
+    queue->heap[position] = queue->heap[parent];
+    position = parent;
+  }
+  queue->heap[position] = timer;
+  return true;
+}
+
+static void netem_queue_pop(netem_queue_t *restrict queue) {
+  queue->free_slots[queue->free_count++] = queue->heap[0].slot;
+  netem_timer_t last = queue->heap[--queue->size];
+  uint32_t position = 0;
+  for (;;) {
+    uint32_t child = position * 2 + 1;
+    if (child >= queue->size) {
+      break;
+    }
+    if (child + 1 < queue->size &&
+        netem_timer_before(&queue->heap[child + 1], &queue->heap[child])) {
+      child++;
+    }
+    if (!netem_timer_before(&queue->heap[child], &last)) {
+      break;
+    }
+    queue->heap[position] = queue->heap[child];
+    position = child;
+  }
+  if (queue->size > 0) {
+    queue->heap[position] = last;
+  }
+}
+
+/* ---- Reactor ---- */
+
+typedef struct {
+  int tun_fd;
+  int signal_fd;
+  pid_t child;
+  int exit_code;
+  bool stop;
+  netem_queue_t queue;
+  netem_model_t model;
+  const netem_script_t *script;
+  size_t next_step;
+  uint64_t start_us;
+  const logger_t *logger;
+} netem_t;
+
+static void netem_apply_script(netem_t *restrict netem, uint64_t now_us) {
+  const netem_script_t *script = netem->script;
+  while (script != NULL && netem->next_step < script->count &&
+         script->steps[netem->next_step].at_us <= now_us - netem->start_us) {
+    netem_model_set(&netem->model, &script->steps[netem->next_step].impair);
+    logger_debug(netem->logger, "Script step %zu at %.3fs",
+                 netem->next_step + 1,
+                 (double)script->steps[netem->next_step].at_us /
+                     (double)NETEM_US_PER_SEC);
+    netem->next_step++;
+  }
+}
+
+static bool netem_read_requests(netem_t *restrict netem, uint64_t now_us,
+                                char *restrict error_msg, size_t error_size) {
+  uint8_t packet[OPENUPS_NETEM_MTU] __attribute__((aligned(16)));
+  for (uint32_t i = 0; i < NETEM_READ_BURST; i++) {
+    ssize_t received = read(netem->tun_fd, packet, sizeof(packet));
+    if (received < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      snprintf(error_msg, error_size, "read from %s failed: %s",
+               OPENUPS_NETEM_IFNAME, strerror(errno));
+      return false;
+    }
+    size_t reply_len = netem_reflect(packet, (size_t)received);
+    if (reply_len == 0) {
+      netem->model.stats.ignored++;
+      continue;
+    }
+    netem_fate_t fate = netem_model_decide(&netem->model);
+    for (uint32_t copy = 0; copy < fate.copies; copy++) {
+      if (!netem_queue_push(&netem->queue, packet, reply_len,
+                            now_us + fate.delay_us[copy])) {
+        netem->model.stats.overflow++;
+      }
+    }
+  }
+  return true;
+}
+
+static void netem_write_due(netem_t *restrict netem, uint64_t now_us) {
+  netem_queue_t *queue = &netem->queue;
+  while (queue->size > 0 && queue->heap[0].due_us <= now_us) {
+    uint32_t slot = queue->heap[0].slot;
+    ssize_t written =
+        write(netem->tun_fd, queue->slots + (size_t)slot * OPENUPS_NETEM_MTU,
+              queue->lengths[slot]);
+    if (written == (ssize_t)queue->lengths[slot]) {
+      netem->model.stats.answered++;
+    } else {
+      netem->model.stats.overflow++;
+    }
+    netem_queue_pop(queue);
+  }
+}
+
+/* SIGINT/SIGTERM are passed on to the command, whose exit ends the run. */
+static void netem_handle_signals(netem_t *restrict netem) {
+  struct signalfd_siginfo info;
+  while (read(netem->signal_fd, &info, sizeof(info)) == sizeof(info)) {
+    if (info.ssi_signo != SIGCHLD) {
+      if (netem->child > 0) {
+        (void)kill(netem->child, (int)info.ssi_signo);
+      } else {
+        netem->stop = true;
+      }
+      continue;
+    }
+    int status = 0;
+    if (netem->child > 0 && waitpid(netem->child, &status, WNOHANG) ==
+                                netem->child) {
+      netem->child = -1;
+      netem->exit_code = WIFEXITED(status) ? WEXITSTATUS(status)
+                                           : 128 + WTERMSIG(status);
+      netem->stop = true;
+    }
+  }
+}
+
+static bool netem_loop(netem_t *restrict netem, char *restrict error_msg,
+                       size_t error_size) {
+  while (!netem->stop) {
+    uint64_t now_us = get_monotonic_us();
+    netem_apply_script(netem, now_us);
+    if (!netem_read_requests(netem, now_us, error_msg, error_size)) {
+      return false;
+    }
+    netem_write_due(netem, now_us);
+
+    struct timespec timeout = {0};
+    struct timespec *wait = NULL;
+    if (netem->queue.size > 0) {
+      uint64_t due_us = netem->queue.heap[0].due_us;
+      uint64_t wait_us = due_us > now_us ? due_us - now_us : 0;
+      timeout.tv_sec = (time_t)(wait_us / NETEM_US_PER_SEC);
+      timeout.tv_nsec = (long)(wait_us % NETEM_US_PER_SEC * NETEM_NS_PER_US);
+      wait = &timeout;
+    }
+    struct pollfd fds[2] = {
+        {.fd = netem->tun_fd, .events = POLLIN},
+        {.fd = netem->signal_fd, .events = POLLIN},
+    };
+    if (ppoll(fds, 2, wait, NULL) < 0 && errno != EINTR) {
+      snprintf(error_msg, error_size, "ppoll failed: %s", strerror(errno));
+      return false;
+    }
+    if ((fds[1].revents & POLLIN) != 0) {
+      netem_handle_signals(netem);
+    }
+  }
+  return true;
+}
+
+static pid_t netem_spawn(char *const *command, const sigset_t *restrict mask,
+                         char *restrict error_msg, size_t error_size) {
+  pid_t pid = fork();
+  if (pid < 0) {
+    snprintf(error_msg, error_size, "fork failed: %s", strerror(errno));
+    return -1;
+  }
+  if (pid == 0) {
+    (void)sigprocmask(SIG_SETMASK, mask, NULL);
+    execvp(command[0], command);
+    logger_write(LOG_LEVEL_ERROR, false, "Cannot run %s: %s", command[0],
+                 strerror(errno));
+    _exit(127);
+  }
+  return pid;
+}
+
+/* Exit status: the command's, or 0 when stopped by a signal; 125 when the
+ * emulator itself fails, as timeout(1) does. */
+int netem_run(const netem_options_t *restrict options) {
+  if (options == NULL) {
+    return 125;
+  }
+  logger_t logger;
+  logger_init(&logger, options->log_level, false);
+  char error_msg[256];
+  netem_t netem;
+  memset(&netem, 0, sizeof(netem));
+  netem.tun_fd = -1;
+  netem.signal_fd = -1;
+  netem.child = -1;
+  netem.script = options->script;
+  netem.logger = &logger;
+  uint32_t capacity = options->queue != 0 ? options->queue
+                                          : OPENUPS_NETEM_DEFAULT_QUEUE;
+
+  if (!netem_enter_namespace(error_msg, sizeof(error_msg)) ||
+      (netem.tun_fd = netem_open_tun(error_msg, sizeof(error_msg))) < 0 ||
+      !netem_configure(&logger, error_msg, sizeof(error_msg))) {
+    logger_error(&logger, "Netem failed: %s", error_msg);
+    if (netem.tun_fd >= 0) {
+      close(netem.tun_fd);
+    }
+    return 125;
+  }
+  if (!netem_queue_init(&netem.queue, capacity)) {
+    logger_error(&logger, "Netem failed: no memory for %u queued replies",
+                 capacity);
+    close(netem.tun_fd);
+    return 125;
+  }
+
+  sigset_t mask;
+  sigset_t previous_mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGCHLD);
+  bool masked = sigprocmask(SIG_BLOCK, &mask, &previous_mask) == 0;
+  bool ok = masked;
+  if (ok) {
+    netem.signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    ok = netem.signal_fd >= 0;
+  }
+  if (!ok) {
+    snprintf(error_msg, sizeof(error_msg), "signalfd failed: %s",
+             strerror(errno));
+  }
+
+  netem_model_init(&netem.model, &options->impair, options->seed);
+  netem.start_us = get_monotonic_us();
+  logger_info(&logger,
+              "Netem answering %s/%u and %s/%u on %s (seed %" PRIu64
+              ", queue %u)",
+              OPENUPS_NETEM_ADDR4, OPENUPS_NETEM_PREFIX4, OPENUPS_NETEM_ADDR6,
+              OPENUPS_NETEM_PREFIX6, OPENUPS_NETEM_IFNAME, options->seed,
+              capacity);
+  if (ok && options->command != NULL) {
+    netem.child = netem_spawn(options->command, &previous_mask, error_msg,
+                              sizeof(error_msg));
+    ok = netem.child > 0;
+  }
+  ok = ok && netem_loop(&netem, error_msg, sizeof(error_msg));
+  if (!ok) {
+    logger_error(&logger, "Netem failed: %s", error_msg);
+    if (netem.child > 0) {
+      (void)kill(netem.child, SIGTERM);
+      (void)waitpid(netem.child, NULL, 0);
+    }
+    netem.exit_code = 125;
+  }
+
+  const netem_stats_t *stats = &netem.model.stats;
+  double seconds = (double)(get_monotonic_us() - netem.start_us) /
+                   (double)NETEM_US_PER_SEC;
+  logger_info(&logger,
+              "Netem: %" PRIu64 " requests, %" PRIu64 " answered, %" PRIu64
+              " dropped, %" PRIu64 " duplicated, %" PRIu64
+              " reordered, %" PRIu64 " overflowed, %" PRIu64
+              " ignored in %.2fs",
+              stats->requests, stats->answered, stats->dropped,
+              stats->duplicated, stats->reordered, stats->overflow,
+              stats->ignored, seconds);
+
+  netem_queue_destroy(&netem.queue);
+  if (netem.signal_fd >= 0) {
+    close(netem.signal_fd);
+  }
+  close(netem.tun_fd);
+  if (masked) {
+    (void)sigprocmask(SIG_SETMASK, &previous_mask, NULL);
+  }
+  return netem.exit_code;
+}
@@ -0,0 +1,119 @@
+#ifndef OPENUPS_NETEM_H
+#define OPENUPS_NETEM_H
+
+#include "openups.h"
+
+/* Benchmarking ranges (RFC 2544, RFC 5180): every address in them except
+ * the interface's own is answered by the emulator. */
+#define OPENUPS_NETEM_IFNAME "netem0"
+#define OPENUPS_NETEM_ADDR4 "198.18.0.1"
+#define OPENUPS_NETEM_PREFIX4 15U
+#define OPENUPS_NETEM_ADDR6 "2001:2::1"
+#define OPENUPS_NETEM_PREFIX6 48U
+#define OPENUPS_NETEM_MTU 1500U
+/* Replies held back for delay or reordering; bounds memory at any rate. */
+#define OPENUPS_NETEM_DEFAULT_QUEUE 16384U
+#define OPENUPS_NETEM_MAX_QUEUE 1048576U
+#define OPENUPS_NETEM_MAX_STEPS 256U
+
+typedef enum {
+  NETEM_DELAY_FIXED = 0,   /* a */
+  NETEM_DELAY_UNIFORM = 1, /* between a and b */
+  NETEM_DELAY_NORMAL = 2,  /* mean a, standard deviation b, clamped at 0 */
+} netem_delay_kind_t;
+
+typedef struct {
+  netem_delay_kind_t kind;
+  double a_ms;
+  double b_ms;
+} netem_delay_t;
+
+typedef enum {
+  NETEM_LOSS_NONE = 0,
+  NETEM_LOSS_BERNOULLI = 1, /* each request lost with probability p */
+  NETEM_LOSS_GILBERT = 2,   /* bursty: see netem_model_decide */
+} netem_loss_kind_t;
+
+/* Probabilities as fractions; the text form takes percentages. */
+typedef struct {
+  netem_loss_kind_t kind;
+  double p;
+  double r;
+} netem_loss_t;
+
+typedef struct {
+  netem_delay_t delay;
+  netem_loss_t loss;
+  double duplicate;  /* probability a reply is sent twice */
+  double reorder;    /* probability a reply is held back ... */
+  double reorder_ms; /* ... this much longer, so later ones overtake it */
+} netem_impair_t;
+
+/* The impairment in force from at_us after start; each step holds the
+ * complete settings, later lines only naming what changes. */
+typedef struct {
+  uint64_t at_us;
+  netem_impair_t impair;
+} netem_step_t;
+
+typedef struct {
+  netem_step_t steps[OPENUPS_NETEM_MAX_STEPS];
+  size_t count;
+} netem_script_t;
+
+typedef struct {
+  uint64_t requests;   /* echo requests read from the device */
+  uint64_t answered;   /* replies written, duplicates included */
+  uint64_t dropped;    /* requests lost by the loss model */
+  uint64_t duplicated; /* extra copies scheduled */
+  uint64_t reordered;  /* replies held back */
+  uint64_t overflow;   /* replies lost to a full queue */
+  uint64_t ignored;    /* anything that is not an echo request */
+} netem_stats_t;
+
+typedef struct {
+  netem_impair_t impair;
+  uint64_t rng;
+  bool burst; /* Gilbert model in its lossy state */
+  netem_stats_t stats;
+} netem_model_t;
+
+/* What becomes of one request: copies is 0 (lost), 1 or 2. */
+typedef struct {
+  uint32_t copies;
+  uint64_t delay_us[2];
+} netem_fate_t;
+
+typedef struct {
+  netem_impair_t impair;
+  const netem_script_t *script; /* NULL: impair holds for the whole run */
+  uint64_t seed;
+  uint32_t queue;
+  log_level_t log_level;
+  char *const *command; /* run inside the namespace; NULL: until signalled */
+} netem_options_t;
+
+void netem_impair_init(netem_impair_t *restrict impair);
+[[nodiscard]] bool netem_impair_set(netem_impair_t *restrict impair,
+                                    const char *restrict setting,
+                                    char *restrict error_msg,
+                                    size_t error_size);
+[[nodiscard]] bool netem_script_parse(netem_script_t *restrict script,
+                                      const netem_impair_t *restrict base,
+                                      const char *restrict text, size_t len,
+                                      char *restrict error_msg,
+                                      size_t error_size);
+[[nodiscard]] bool netem_script_load(netem_script_t *restrict script,
+                                     const netem_impair_t *restrict base,
+                                     const char *restrict path,
+                                     char *restrict error_msg,
+                                     size_t error_size);
+void netem_model_init(netem_model_t *restrict model,
+                      const netem_impair_t *restrict impair, uint64_t seed);
+void netem_model_set(netem_model_t *restrict model,
+                     const netem_impair_t *restrict impair);
+netem_fate_t netem_model_decide(netem_model_t *restrict model);
+size_t netem_reflect(uint8_t *restrict packet, size_t len);
+int netem_run(const netem_options_t *restrict options);
+
+#endif // OPENUPS_NETEM_H
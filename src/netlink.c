@@ -0,0 +1,455 @@
+#include "openups.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OPENUPS_NETLINK_BUFFER_SIZE 8192U
+#define OPENUPS_NETLINK_MAX_REQUERIES 4
+
+/* <linux/if.h> clashes with <net/if.h>; only the carrier bit is needed. */
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP 0x10000
+#endif
+
+/* Lookups go out on the nonblocking event socket.  The kernel queues the
+ * answer before sendto() returns, so the reactor never waits on it and the
+ * reply is read like any other event. */
+typedef struct {
+  struct nlmsghdr header;
+  struct rtmsg route;
+  uint8_t attrs[64];
+} netlink_route_request_t;
+
+typedef struct {
+  struct nlmsghdr header;
+  struct ifinfomsg link;
+} netlink_link_request_t;
+
+static const char *netlink_ifname(int ifindex, char *restrict buffer,
+                                  size_t size) {
+  char name[IF_NAMESIZE];
+  if (ifindex > 0 && if_indextoname((unsigned int)ifindex, name) != NULL) {
+    snprintf(buffer, size, "%s", name);
+  } else {
+    snprintf(buffer, size, "if%d", ifindex);
+  }
+  return buffer;
+}
+
+static bool netlink_send_request(int sockfd, const void *request,
+                                 size_t request_len) {
+  struct sockaddr_nl kernel = {.nl_family = AF_NETLINK};
+  ssize_t sent;
+  do {
+    sent = sendto(sockfd, request, request_len, 0,
+                  (const struct sockaddr *)&kernel, sizeof(kernel));
+  } while (sent < 0 && errno == EINTR);
+  return sent == (ssize_t)request_len;
+}
+
+static bool netlink_dest_key(const struct sockaddr_storage *restrict dest_addr,
+                             const void **restrict key, size_t *restrict len,
+                             uint8_t *restrict family) {
+  if (dest_addr->ss_family == AF_INET6) {
+    *key = &((const struct sockaddr_in6 *)dest_addr)->sin6_addr;
+    *len = sizeof(struct in6_addr);
+    *family = AF_INET6;
+    return true;
+  }
+  if (dest_addr->ss_family == AF_INET) {
+    *key = &((const struct sockaddr_in *)dest_addr)->sin_addr;
+    *len = sizeof(struct in_addr);
+    *family = AF_INET;
+    return true;
+  }
+  return false;
+}
+
+/* RTM_GETROUTE for the target; the answer is handled by
+ * netlink_handle_route_reply().  A request that cannot be sent leaves the
+ * last known state in place and is retried by netlink_monitor_refresh(). */
+static bool netlink_request_route(netlink_monitor_t *restrict monitor,
+                                  const struct sockaddr_storage *restrict
+                                      dest_addr) {
+  const void *key = NULL;
+  size_t key_len = 0;
+  uint8_t family = 0;
+  if (!netlink_dest_key(dest_addr, &key, &key_len, &family)) {
+    return false;
+  }
+
+  netlink_route_request_t request;
+  memset(&request, 0, sizeof(request));
+  request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+  request.header.nlmsg_type = RTM_GETROUTE;
+  request.header.nlmsg_flags = NLM_F_REQUEST;
+  request.header.nlmsg_seq = ++monitor->query_seq;
+  request.route.rtm_family = family;
+  request.route.rtm_dst_len = (uint8_t)(key_len * 8);
+
+  struct rtattr *attr =
+      (struct rtattr *)((uint8_t *)&request +
+                        NLMSG_ALIGN(request.header.nlmsg_len));
+  attr->rta_type = RTA_DST;
+  attr->rta_len = (unsigned short)RTA_LENGTH(key_len);
+  memcpy(RTA_DATA(attr), key, key_len);
+  request.header.nlmsg_len =
+      NLMSG_ALIGN(request.header.nlmsg_len) + RTA_ALIGN(attr->rta_len);
+
+  if (!netlink_send_request(monitor->sockfd, &request,
+                            request.header.nlmsg_len)) {
+    monitor->requery_pending = true;
+    return false;
+  }
+  monitor->route_seq = request.header.nlmsg_seq;
+  monitor->requery_pending = false;
+  return true;
+}
+
+/* RTM_GETLINK for the egress interface.  The answer is an RTM_NEWLINK and
+ * updates the carrier state like a link event; until it arrives the link
+ * is assumed up. */
+static void netlink_request_link(netlink_monitor_t *restrict monitor) {
+  monitor->link_up = true;
+  if (monitor->route_oif <= 0) {
+    return;
+  }
+
+  netlink_link_request_t request;
+  memset(&request, 0, sizeof(request));
+  request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+  request.header.nlmsg_type = RTM_GETLINK;
+  request.header.nlmsg_flags = NLM_F_REQUEST;
+  request.header.nlmsg_seq = ++monitor->query_seq;
+  request.link.ifi_family = AF_UNSPEC;
+  request.link.ifi_index = monitor->route_oif;
+  (void)netlink_send_request(monitor->sockfd, &request,
+                             request.header.nlmsg_len);
+}
+
+/* The kernel's own verdict that the target has no usable route, as opposed
+ * to a lookup that merely failed. */
+static bool netlink_route_absent(int error) {
+  return error == ENETUNREACH || error == EHOSTUNREACH || error == ENETDOWN ||
+         error == EACCES;
+}
+
+/* Answer to the outstanding RTM_GETROUTE: records the egress interface, or
+ * marks the target locally unreachable when the kernel says there is no
+ * usable route.  Any other error keeps the last known state. */
+static void netlink_handle_route_reply(netlink_monitor_t *restrict monitor,
+                                       const struct nlmsghdr *restrict nh,
+                                       const logger_t *restrict logger) {
+  monitor->route_seq = 0;
+  if (nh->nlmsg_type == NLMSG_ERROR) {
+    if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+      return;
+    }
+    const struct nlmsgerr *err = (const struct nlmsgerr *)NLMSG_DATA(nh);
+    int error = -err->error;
+    if (netlink_route_absent(error)) {
+      monitor->route_known = false;
+      monitor->route_oif = 0;
+      monitor->route_error = error;
+    } else if (error != 0) {
+      logger_warn(logger, "Route lookup failed: %s; keeping last path state",
+                  strerror(error));
+    }
+    return;
+  }
+  if (nh->nlmsg_type != RTM_NEWROUTE) {
+    return;
+  }
+
+  const struct rtmsg *route = (const struct rtmsg *)NLMSG_DATA(nh);
+  if (route->rtm_type == RTN_UNREACHABLE || route->rtm_type == RTN_BLACKHOLE ||
+      route->rtm_type == RTN_PROHIBIT) {
+    monitor->route_known = false;
+    monitor->route_oif = 0;
+    monitor->route_error = ENETUNREACH;
+    return;
+  }
+
+  int oif = 0;
+  int attr_len = (int)RTM_PAYLOAD(nh);
+  for (const struct rtattr *rta = RTM_RTA(route); RTA_OK(rta, attr_len);
+       rta = RTA_NEXT(rta, attr_len)) {
+    if (rta->rta_type == RTA_OIF && RTA_PAYLOAD(rta) >= sizeof(int)) {
+      memcpy(&oif, RTA_DATA(rta), sizeof(int));
+    }
+  }
+  monitor->route_known = true;
+  monitor->route_error = 0;
+  if (oif != monitor->route_oif) {
+    monitor->route_oif = oif;
+    netlink_request_link(monitor);
+  }
+}
+
+static void netlink_handle_link(netlink_monitor_t *restrict monitor,
+                                const struct nlmsghdr *restrict nh,
+                                const logger_t *restrict logger,
+                                bool *restrict requery) {
+  const struct ifinfomsg *link = (const struct ifinfomsg *)NLMSG_DATA(nh);
+  if (link->ifi_index != monitor->route_oif) {
+    return;
+  }
+  bool up = nh->nlmsg_type == RTM_NEWLINK &&
+            (link->ifi_flags & IFF_UP) != 0 &&
+            (link->ifi_flags & IFF_LOWER_UP) != 0;
+  if (up != monitor->link_up) {
+    char ifname[IF_NAMESIZE + 8];
+    logger_info(logger, "Link %s %s",
+                netlink_ifname(link->ifi_index, ifname, sizeof(ifname)),
+                nh->nlmsg_type == RTM_DELLINK ? "removed"
+                : up                          ? "carrier up"
+                                              : "carrier down");
+  }
+  monitor->link_up = up;
+  if (nh->nlmsg_type == RTM_DELLINK) {
+    *requery = true;
+  }
+}
+
+static bool netlink_evaluate(const netlink_monitor_t *restrict monitor) {
+  return monitor->route_known && monitor->link_up;
+}
+
+static void netlink_describe(const netlink_monitor_t *restrict monitor,
+                             char *restrict reason, size_t reason_size) {
+  char ifname[IF_NAMESIZE + 8];
+  if (!monitor->route_known) {
+    snprintf(reason, reason_size, "no route to target (%s)",
+             strerror(monitor->route_error != 0 ? monitor->route_error
+                                                : ENETUNREACH));
+    return;
+  }
+  if (!monitor->link_up) {
+    snprintf(reason, reason_size, "egress link %s lost carrier",
+             netlink_ifname(monitor->route_oif, ifname, sizeof(ifname)));
+    return;
+  }
+  if (monitor->route_oif <= 0) {
+    snprintf(reason, reason_size, "route lookup pending");
+    return;
+  }
+  snprintf(reason, reason_size, "route via %s",
+           netlink_ifname(monitor->route_oif, ifname, sizeof(ifname)));
+}
+
+static void netlink_log_route(const logger_t *restrict logger,
+                              const struct nlmsghdr *restrict nh) {
+  const struct rtmsg *route = (const struct rtmsg *)NLMSG_DATA(nh);
+  if (route->rtm_table != RT_TABLE_MAIN ||
+      (route->rtm_family != AF_INET && route->rtm_family != AF_INET6)) {
+    return;
+  }
+
+  char dst[INET6_ADDRSTRLEN] = "default";
+  char gateway[INET6_ADDRSTRLEN] = "";
+  int oif = 0;
+  int attr_len = (int)RTM_PAYLOAD(nh);
+  for (const struct rtattr *rta = RTM_RTA(route); RTA_OK(rta, attr_len);
+       rta = RTA_NEXT(rta, attr_len)) {
+    if (rta->rta_type == RTA_DST) {
+      (void)inet_ntop(route->rtm_family, RTA_DATA(rta), dst, sizeof(dst));
+    } else if (rta->rta_type == RTA_GATEWAY) {
+      (void)inet_ntop(route->rtm_family, RTA_DATA(rta), gateway,
+                      sizeof(gateway));
+    } else if (rta->rta_type == RTA_OIF && RTA_PAYLOAD(rta) >= sizeof(int)) {
+      memcpy(&oif, RTA_DATA(rta), sizeof(int));
+    }
+  }
+
+  char ifname[IF_NAMESIZE + 8];
+  logger_info(logger, "Route %s: %s/%u%s%s dev %s",
+              nh->nlmsg_type == RTM_NEWROUTE ? "added" : "removed", dst,
+              route->rtm_dst_len, gateway[0] != '\0' ? " via " : "", gateway,
+              netlink_ifname(oif, ifname, sizeof(ifname)));
+}
+
+/* Reads every queued message: answers to our own lookups (matched by port
+ * id and sequence, since a route event can carry the sender's port id) and
+ * multicast events.  Sets *requery when the route must be looked up again. */
+static void netlink_drain(netlink_monitor_t *restrict monitor,
+                          const logger_t *restrict logger,
+                          bool *restrict requery) {
+  uint8_t buffer[OPENUPS_NETLINK_BUFFER_SIZE] __attribute__((aligned(4)));
+  while (true) {
+    ssize_t received = recv(monitor->sockfd, buffer, sizeof(buffer), 0);
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* Overrun: events, or the answer to a lookup, were lost, so re-derive
+       * state from scratch. */
+      if (errno == ENOBUFS) {
+        logger_warn(logger, "Netlink event queue overrun; re-checking route");
+        *requery = true;
+        continue;
+      }
+      break;
+    }
+
+    for (const struct nlmsghdr *nh = (const struct nlmsghdr *)buffer;
+         NLMSG_OK(nh, (size_t)received); nh = NLMSG_NEXT(nh, received)) {
+      if (monitor->route_seq != 0 && nh->nlmsg_seq == monitor->route_seq &&
+          nh->nlmsg_pid == monitor->portid) {
+        netlink_handle_route_reply(monitor, nh, logger);
+        continue;
+      }
+      if (nh->nlmsg_type == RTM_NEWROUTE || nh->nlmsg_type == RTM_DELROUTE) {
+        const struct rtmsg *route = (const struct rtmsg *)NLMSG_DATA(nh);
+        netlink_log_route(logger, nh);
+        if (route->rtm_family == monitor->family) {
+          *requery = true;
+        }
+        continue;
+      }
+      if (nh->nlmsg_type == RTM_NEWLINK || nh->nlmsg_type == RTM_DELLINK) {
+        netlink_handle_link(monitor, nh, logger, requery);
+      }
+    }
+  }
+}
+
+/* Sends a route lookup and reads what is already queued, answer included.
+ * A lookup the reply handling asked for is sent on the next round, bounded
+ * so a stream of route churn cannot hold the reactor. */
+static void netlink_resolve(netlink_monitor_t *restrict monitor,
+                            const struct sockaddr_storage *restrict dest_addr,
+                            const logger_t *restrict logger,
+                            bool requery) {
+  for (int round = 0; requery && round < OPENUPS_NETLINK_MAX_REQUERIES;
+       round++) {
+    requery = false;
+    if (!netlink_request_route(monitor, dest_addr)) {
+      logger_warn(logger,
+                  "Route lookup could not be sent: %s; keeping last path "
+                  "state",
+                  strerror(errno));
+      return;
+    }
+    netlink_drain(monitor, logger, &requery);
+  }
+  if (requery) {
+    monitor->requery_pending = true;
+  }
+}
+
+bool netlink_monitor_init(netlink_monitor_t *restrict monitor,
+                          const struct sockaddr_storage *restrict dest_addr,
+                          char *restrict error_msg, size_t error_size) {
+  if (monitor == NULL || dest_addr == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return false;
+  }
+
+  /* Until the kernel answers, the path counts as up. */
+  memset(monitor, 0, sizeof(*monitor));
+  monitor->family = dest_addr->ss_family;
+  monitor->route_known = true;
+  monitor->link_up = true;
+
+  monitor->sockfd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                           NETLINK_ROUTE);
+  if (monitor->sockfd < 0) {
+    snprintf(error_msg, error_size, "Failed to create netlink socket: %s",
+             strerror(errno));
+    return false;
+  }
+
+  struct sockaddr_nl local = {.nl_family = AF_NETLINK};
+  socklen_t local_len = sizeof(local);
+  if (bind(monitor->sockfd, (const struct sockaddr *)&local, sizeof(local)) !=
+          0 ||
+      getsockname(monitor->sockfd, (struct sockaddr *)&local, &local_len) !=
+          0) {
+    snprintf(error_msg, error_size, "Failed to bind netlink socket: %s",
+             strerror(errno));
+    netlink_monitor_destroy(monitor);
+    return false;
+  }
+  monitor->portid = local.nl_pid;
+
+  static const int groups[] = {RTNLGRP_LINK, RTNLGRP_IPV4_ROUTE,
+                               RTNLGRP_IPV6_ROUTE};
+  for (size_t i = 0; i < sizeof(groups) / sizeof(groups[0]); i++) {
+    if (setsockopt(monitor->sockfd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+                   &groups[i], sizeof(groups[i])) != 0) {
+      snprintf(error_msg, error_size,
+               "Failed to join netlink group %d: %s", groups[i],
+               strerror(errno));
+      netlink_monitor_destroy(monitor);
+      return false;
+    }
+  }
+
+  netlink_resolve(monitor, dest_addr, NULL, true);
+  monitor->target_reachable = netlink_evaluate(monitor);
+  return true;
+}
+
+void netlink_monitor_destroy(netlink_monitor_t *restrict monitor) {
+  if (monitor == NULL) {
+    return;
+  }
+
+  if (monitor->sockfd >= 0) {
+    close(monitor->sockfd);
+    monitor->sockfd = -1;
+  }
+}
+
+/* Called once per probe interval: re-sends a lookup that could not be sent
+ * or whose answer was lost, and re-checks a path the kernel reported down.
+ * The answer is picked up by netlink_monitor_process(). */
+void netlink_monitor_refresh(netlink_monitor_t *restrict monitor,
+                             const struct sockaddr_storage *restrict
+                                 dest_addr) {
+  if (monitor == NULL || dest_addr == NULL || monitor->sockfd < 0) {
+    return;
+  }
+  if (monitor->requery_pending || !monitor->target_reachable) {
+    (void)netlink_request_route(monitor, dest_addr);
+  }
+}
+
+void netlink_monitor_describe(const netlink_monitor_t *restrict monitor,
+                              char *restrict reason, size_t reason_size) {
+  if (monitor == NULL || reason == NULL || reason_size == 0) {
+    return;
+  }
+  netlink_describe(monitor, reason, reason_size);
+}
+
+netlink_event_t netlink_monitor_process(
+    netlink_monitor_t *restrict monitor,
+    const struct sockaddr_storage *restrict dest_addr,
+    const logger_t *restrict logger, char *restrict reason,
+    size_t reason_size) {
+  if (monitor == NULL || dest_addr == NULL || monitor->sockfd < 0) {
+    return NETLINK_EVENT_NONE;
+  }
+
+  bool requery = false;
+  netlink_drain(monitor, logger, &requery);
+  netlink_resolve(monitor, dest_addr, logger, requery);
+
+  bool reachable = netlink_evaluate(monitor);
+  if (reachable == monitor->target_reachable) {
+    return NETLINK_EVENT_NONE;
+  }
+
+  monitor->target_reachable = reachable;
+  if (reason != NULL && reason_size > 0) {
+    netlink_describe(monitor, reason, reason_size);
+  }
+  return reachable ? NETLINK_EVENT_REACHABLE : NETLINK_EVENT_UNREACHABLE;
+}
@@ -3,6 +3,7 @@
 
 #include <netinet/icmp6.h>
 #include <netinet/ip_icmp.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -11,12 +12,14 @@
 #include <stdckdint.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <time.h>
 
 #define OPENUPS_VERSION "1.3.1"
 #define OPENUPS_PROGRAM_NAME "openups"
 #define OPENUPS_MS_PER_SEC UINT64_C(1000)
+#define OPENUPS_US_PER_MS UINT64_C(1000)
 #define OPENUPS_MS_PER_MINUTE (UINT64_C(60) * OPENUPS_MS_PER_SEC)
 #define OPENUPS_SYSTEMD_MESSAGE_SIZE 256U
 #define OPENUPS_SYSTEMD_STATUS_SIZE 240U
@@ -24,6 +27,13 @@
 #define OPENUPS_LOG_BUFFER_SIZE 2048U
 #define OPENUPS_EXIT_SUCCESS 0
 #define OPENUPS_EXIT_FAILURE 1
+/* ICMP echo header, and the data bytes probes carry after it: 56 as in
+ * ping(8) by default, up to 65,507 (65,535 minus IPv4 and ICMP headers). */
+#define OPENUPS_PROBE_HEADER_LEN 8U
+#define OPENUPS_DEFAULT_PAYLOAD_SIZE 56
+#define OPENUPS_MAX_PAYLOAD_SIZE 65507
+/* Identifier + sequence at the start of every UDP request payload. */
+#define OPENUPS_UDP_PROBE_HEADER_LEN 4U
 
 /* Branch-prediction hints */
 #define OPENUPS_UNLIKELY(x) __builtin_expect(!!(x), 0)
@@ -38,9 +48,22 @@ typedef enum {
   LOG_LEVEL_DEBUG = 3 /* verbose: prints per-ping latency */
 } log_level_t;
 
+/* Clock and readiness wait under the monitor reactor.  The system backend
+ * is get_monotonic_ms() and poll(2); a simulator substitutes virtual time
+ * that jumps straight to its next event. */
+typedef struct reactor_io {
+  void *backend_ctx;
+  uint64_t (*now_ms)(void *backend_ctx);
+  int (*poll)(void *backend_ctx, struct pollfd *fds, nfds_t nfds,
+              int timeout_ms);
+} reactor_io_t;
+
 typedef struct {
   log_level_t level;
   bool enable_timestamp;
+  /* NULL: wall-clock timestamps; else seconds on this clock, always shown,
+   * so simulated runs log reproducibly */
+  const reactor_io_t *clock;
 } logger_t;
 
 typedef struct {
@@ -51,14 +74,111 @@ typedef struct {
   double min_latency; /* -1.0 sentinel: not yet recorded */
   double max_latency; /* -1.0 sentinel: not yet recorded */
   uint64_t start_time_ms;
+  /* Achieved send time minus scheduled send time */
+  uint64_t send_lag_samples;
+  uint64_t send_lag_total_ms;
+  uint64_t send_lag_max_ms;
 } metrics_t;
 
+/* What woke the reactor's poll; the first five follow the pollfd slots. */
+typedef enum {
+  REACTOR_WAKE_SIGNAL = 0,
+  REACTOR_WAKE_PROBE = 1,
+  REACTOR_WAKE_NETLINK = 2,
+  REACTOR_WAKE_PMTU = 3,
+  REACTOR_WAKE_HOPS = 4,
+  REACTOR_WAKE_TIMER = 5, /* poll timed out: a deadline came due */
+  REACTOR_WAKE_COUNT = 6,
+} reactor_wake_t;
+
+typedef enum {
+  REACTOR_HANDLER_DUE_WORK = 0, /* FSM tick, watchdog, timeouts, sends */
+  REACTOR_HANDLER_SIGNAL = 1,
+  REACTOR_HANDLER_RELOAD = 2,
+  REACTOR_HANDLER_NETLINK = 3,
+  REACTOR_HANDLER_PROBE = 4,
+  REACTOR_HANDLER_PMTU = 5,
+  REACTOR_HANDLER_HOPS = 6,
+  REACTOR_HANDLER_CHECKPOINT = 7,
+  REACTOR_HANDLER_COUNT = 8,
+} reactor_handler_t;
+
+/* Timer wakeups by how far past the poll deadline they returned: 0ms,
+ * then [2^(i-1), 2^i) ms, the last bucket open-ended. */
+#define OPENUPS_REACTOR_LATE_BUCKETS 8U
+
+/* getrusage(2) counters at the start of a statistics period. */
+typedef struct {
+  uint64_t user_us;
+  uint64_t system_us;
+  uint64_t voluntary_switches;
+  uint64_t involuntary_switches;
+  uint64_t minor_faults;
+  uint64_t major_faults;
+} reactor_usage_t;
+
+/* Always-on reactor self-instrumentation.  Counters run for the process's
+ * lifetime; only the resource usage is per statistics period. */
+typedef struct {
+  uint64_t iterations;
+  uint64_t wakeups[REACTOR_WAKE_COUNT];
+  uint64_t handler_runs[REACTOR_HANDLER_COUNT];
+  uint64_t handler_us[REACTOR_HANDLER_COUNT];
+  uint64_t late[OPENUPS_REACTOR_LATE_BUCKETS];
+  uint64_t late_max_ms;
+  /* Matched replies carrying a kernel receive time: how long each waited
+   * in the socket for the reactor, its share of detection latency */
+  uint64_t detections;
+  uint64_t detect_sum_us;
+  uint64_t detect_max_us;
+  uint64_t detect_last_us;
+  double detect_jitter_us; /* RFC 3550 interarrival jitter estimator */
+  uint64_t start_ms;
+  uint64_t period_start_ms;
+  reactor_usage_t usage; /* at period_start_ms */
+} reactor_stats_t;
+
 typedef enum {
   SHUTDOWN_MODE_DRY_RUN,
   SHUTDOWN_MODE_TRUE_OFF,
   SHUTDOWN_MODE_LOG_ONLY
 } shutdown_mode_t;
 
+/* Extra decision policies evaluated on every probe result next to the
+ * active one and only logged, never acted on (--shadow). */
+#define OPENUPS_MAX_SHADOW_POLICIES 8
+#define OPENUPS_SHADOW_MAX_WINDOW 64 /* one bit per result */
+
+/* Fires once threshold of the last window probe results failed; window ==
+ * threshold is the active policy's consecutive-failure rule.  delay and
+ * mode behave as --delay and --shutdown-mode do. */
+typedef struct {
+  int threshold;
+  int window;
+  int delay_minutes;
+  shutdown_mode_t mode;
+} shadow_policy_t;
+
+typedef enum {
+  SHADOW_EVENT_NONE = 0,
+  SHADOW_EVENT_FIRED = 1,     /* at the result's time */
+  SHADOW_EVENT_ARMED = 2,     /* countdown started, see deadline_ms */
+  SHADOW_EVENT_CANCELLED = 3, /* countdown cancelled by a success */
+} shadow_event_t;
+
+typedef struct {
+  uint64_t history;     /* bit 0: latest result, set = failed */
+  uint64_t deadline_ms; /* armed countdown, 0 = none */
+  uint64_t fired;
+  uint64_t last_fired_ms;
+} shadow_state_t;
+
+typedef enum {
+  PROBE_KIND_ICMP = 0, /* raw ICMP echo (default) */
+  PROBE_KIND_TCP = 1,  /* non-blocking TCP connect; SYN-ACK or RST = alive */
+  PROBE_KIND_UDP = 2   /* UDP request/response; reply or port-unreachable */
+} probe_kind_t;
+
 /* Target buffer: IPv6 max literal is 45 chars; 64 is ample. */
 typedef struct {
   /* Network */
@@ -66,6 +186,9 @@ typedef struct {
   int interval_sec;
   int fail_threshold;
   int timeout_ms;
+  probe_kind_t probe_kind;
+  int probe_port; /* 0 = unset; required for tcp/udp probes */
+  int payload_size; /* data bytes after the ICMP header (UDP: datagram) */
 
   /* Shutdown */
   shutdown_mode_t shutdown_mode;
@@ -76,12 +199,48 @@ typedef struct {
 
   /* Integration */
   bool enable_systemd;
+  bool enable_netlink; /* rtnetlink link/route watch for local failures */
+  bool enable_pmtu;    /* DF-set path MTU search alongside the probes */
+  bool enable_hops;    /* TTL sweep to localize the break when failures start */
+
+  /* KEY=VALUE file layered between environment and CLI; re-read on SIGHUP */
+  char config_path[256];
+
+  /* Crash-recovery checkpoint (empty = disabled), e.g. /run/openups/state */
+  char state_file[256];
+
+  /* Fleet mode: one IP literal per line (empty = single-target mode) */
+  char targets_file[256];
+  int workers; /* fleet reactor threads, 0 = one per allowed CPU */
+  bool packet_ring; /* fleet: TPACKET_V3 reply capture instead of recvmmsg */
+
+  /* One-shot sweep: targets file or "-" for stdin (empty = disabled) */
+  char sweep_file[256];
+  int sweep_rate; /* probes per second */
+
+  /* Shadow policies, single-target mode only */
+  shadow_policy_t shadows[OPENUPS_MAX_SHADOW_POLICIES];
+  int shadow_count;
+
+  /* Low-wakeup mode: watchdog kicks and status updates ride on a wakeup
+   * this many milliseconds early; also the kernel timer slack (0 = off) */
+  int timer_slack_ms;
+
+  /* Low-latency mode: busy-polled probe socket, locked and pre-faulted
+   * memory, optionally a pinned CPU and SCHED_FIFO; startup only */
+  bool low_latency;
+  int cpu;         /* -1 = not pinned */
+  int rt_priority; /* SCHED_FIFO priority, 0 = normal scheduling */
 } config_t;
 
 typedef struct {
   bool success;
   double latency_ms;
   char error_msg[256];
+  uint8_t reply_ttl; /* TTL / hop limit the ICMP reply arrived with, 0 if
+                        unknown */
+  uint64_t receive_ns; /* kernel receive time (CLOCK_REALTIME), 0 if
+                          unknown */
 } ping_result_t;
 
 typedef enum {
@@ -89,6 +248,8 @@ typedef enum {
   ICMP_RECEIVE_IGNORED = 0,
   ICMP_RECEIVE_MATCHED = 1,
   ICMP_RECEIVE_ERROR = 2,
+  ICMP_RECEIVE_UNREACHABLE = 3, /* probe answered negatively: counts as a
+                                   failed probe, not a runtime error */
 } icmp_receive_status_t;
 
 typedef enum {
@@ -102,10 +263,285 @@ typedef struct {
   int family;
   uint16_t sequence;
 
-  /* Send buffer (stack-allocated, zero-alloc model) */
-  uint8_t send_buf[256];
+  /* Caller-owned packet buffer, see icmp_pinger_set_send_buffer() */
+  uint8_t *send_buf;
+  size_t send_capacity;
 } icmp_pinger_t;
 
+/* An echo reply as seen on the wire, before it is matched to a probe. */
+typedef struct {
+  struct sockaddr_storage source;
+  uint16_t identifier;
+  uint16_t sequence;
+} icmp_echo_reply_t;
+
+#define OPENUPS_ICMP_RECEIVE_BATCH 32U
+
+/* Path MTU search: a size is declared too big after this many lost probes
+ * in a row (one loss may be congestion), and a converged MTU is searched
+ * upward again after this many successful re-verifications. */
+#define OPENUPS_PMTU_ATTEMPTS 3U
+#define OPENUPS_PMTU_RESEARCH_AFTER 16U
+
+/* Sizes are whole IP datagrams.  good is the largest size known to pass
+ * and bad the smallest known not to; a search bisects until they meet.
+ * Probes leave through a separate raw socket with DF set and the kernel's
+ * cached PMTU ignored (IP_PMTUDISC_PROBE), so a black hole that swallows
+ * large packets without any "fragmentation needed" shows up as loss at
+ * those sizes instead of being papered over. */
+typedef struct {
+  icmp_pinger_t pinger;
+  uint8_t *send_buf; /* owned, sized for ceiling */
+  uint32_t header_len; /* IP header: 20 or 40 */
+  uint32_t floor;      /* minimum MTU of the family, assumed to pass */
+  uint32_t ceiling;    /* egress route MTU when the socket was opened */
+  uint32_t good;
+  uint32_t bad;        /* ceiling + 1 while the top is untested */
+  uint32_t mtu;        /* last converged value, 0 before the first */
+  uint32_t probe_size; /* size of the probe last sent */
+  uint32_t losses;     /* consecutive losses at probe_size */
+  uint32_t verified;   /* re-verifications since the last search */
+  uint32_t drops;
+  bool searching;
+} pmtu_prober_t;
+
+typedef enum {
+  PMTU_PROBE_PASSED = 0,
+  PMTU_PROBE_LOST = 1,    /* no reply before the deadline */
+  PMTU_PROBE_TOO_BIG = 2, /* refused locally (EMSGSIZE): no retry */
+} pmtu_probe_result_t;
+
+typedef enum {
+  PMTU_EVENT_NONE = 0,
+  PMTU_EVENT_DISCOVERED = 1, /* first search converged */
+  PMTU_EVENT_RAISED = 2,
+  PMTU_EVENT_DROPPED = 3,
+} pmtu_event_t;
+
+/* Hop sweep: one echo per TTL 1..OPENUPS_HOP_MAX, all sent at once. */
+#define OPENUPS_HOP_MAX 30U
+
+typedef enum {
+  ICMP_HOP_ECHO_REPLY = 0,    /* the target itself answered */
+  ICMP_HOP_TIME_EXCEEDED = 1, /* a router on the way answered */
+  ICMP_HOP_UNREACHABLE = 2,   /* a router reported no way onward */
+} icmp_hop_kind_t;
+
+/* An ICMP message about one of our echoes: the reply itself, or an error
+ * quoting the request. */
+typedef struct {
+  struct sockaddr_storage source;
+  uint16_t identifier;
+  uint16_t sequence;
+  icmp_hop_kind_t kind;
+} icmp_hop_reply_t;
+
+/* When probes start failing, the target alone cannot say where the path
+ * broke.  A sweep sends TTL-limited echoes for every hop back to back from
+ * an unconnected raw socket and collects the Time Exceeded replies, so the
+ * hop map is complete after one round trip instead of one timeout per
+ * hop. */
+typedef struct {
+  icmp_pinger_t pinger;
+  uint8_t send_buf[OPENUPS_PROBE_HEADER_LEN];
+  uint16_t identifier;
+  uint16_t sequences[OPENUPS_HOP_MAX]; /* sequence sent with TTL i + 1 */
+  struct sockaddr_storage hops[OPENUPS_HOP_MAX]; /* responder per TTL */
+  uint64_t answered;   /* bit i: TTL i + 1 answered */
+  uint32_t max_ttl;    /* TTLs sent in the current sweep */
+  uint32_t reached;    /* TTL at which the target answered, 0 if none */
+  uint32_t unreachable; /* lowest TTL reported unreachable, 0 if none */
+  bool active;
+} hop_sweep_t;
+
+/* RFC 1071 checksum implementations.  All of them return the same value;
+ * the widest one the CPU supports is picked on first use. */
+typedef enum {
+  CHECKSUM_KERNEL_SCALAR = 0,
+  CHECKSUM_KERNEL_SSE2 = 1,
+  CHECKSUM_KERNEL_AVX2 = 2,
+  CHECKSUM_KERNEL_NEON = 3,
+  CHECKSUM_KERNEL_COUNT = 4,
+} checksum_kernel_t;
+
+/* Reply demultiplexing key: (source address, identifier, sequence).  IPv4
+ * addresses are stored v4-mapped; keys are compared bytewise, so reserved
+ * must stay zero. */
+typedef struct {
+  uint8_t addr[16];
+  uint16_t family;
+  uint16_t identifier;
+  uint16_t sequence;
+  uint16_t reserved;
+} icmp_reply_key_t;
+
+/* One TCP socket per probe: connect() is started by send and completed by
+ * the reactor when the socket turns writable, so the loop never blocks on a
+ * handshake. */
+typedef struct {
+  int sockfd; /* in-flight connection, -1 when idle */
+  int family;
+  int pending_error; /* connect() failure reported synchronously */
+  uint16_t sequence;
+  bool connecting;
+} tcp_prober_t;
+
+/* A connected datagram socket; the payload carries identifier + sequence so
+ * echo-style responders can be matched exactly. */
+typedef struct {
+  int sockfd;
+  int family;
+  int pending_error; /* path error from the last send, reported on receive */
+  uint16_t sequence;
+  uint8_t *send_buf; /* caller-owned, see udp_prober_set_send_buffer() */
+  size_t send_capacity;
+} udp_prober_t;
+
+/* Probe backend vtable: the reactor only talks to these entry points. */
+typedef struct {
+  void *backend_ctx;
+  probe_kind_t kind;
+  const char *label;       /* short protocol name for logs: "ICMP" */
+  const char *description; /* what one probe is: "ICMP echo" */
+  bool socket_errors_are_results; /* POLLERR/POLLHUP carry probe outcomes */
+  bool (*send)(void *backend_ctx,
+               const struct sockaddr_storage *dest_addr,
+               socklen_t dest_addr_len, uint16_t identifier, size_t packet_len,
+               char *error_msg, size_t error_size);
+  icmp_receive_status_t (*receive)(void *backend_ctx,
+                                   const struct sockaddr_storage *dest_addr,
+                                   uint16_t identifier,
+                                   uint16_t expected_sequence,
+                                   uint64_t send_time_ms, uint64_t now_ms,
+                                   ping_result_t *out_result);
+  uint16_t (*sequence)(const void *backend_ctx);
+  int (*poll_fd)(const void *backend_ctx);
+  short (*poll_events)(const void *backend_ctx);
+  void (*cancel)(void *backend_ctx);
+  void (*destroy)(void *backend_ctx);
+} probe_backend_t;
+
+/* rtnetlink watch on the egress path to the target: a vanished route or a
+ * carrier loss on the egress link is a local failure that no probe can
+ * cross, so it is reported without waiting for reply deadlines. */
+typedef struct {
+  int sockfd; /* multicast subscription; also carries RTM_GETROUTE/GETLINK */
+  int family;
+  int route_oif; /* egress ifindex of the current route, 0 if unknown */
+  int route_error; /* errno of the kernel's last no-route answer */
+  uint32_t portid;    /* our netlink address: tells query replies from events */
+  uint32_t query_seq;
+  uint32_t route_seq; /* outstanding RTM_GETROUTE, 0 if none */
+  bool route_known;   /* false only after the kernel answered "no route" */
+  bool link_up;
+  bool requery_pending; /* a lookup was not sent or its answer was lost */
+  bool target_reachable; /* last evaluated local path state */
+} netlink_monitor_t;
+
+typedef enum {
+  NETLINK_EVENT_NONE = 0,
+  NETLINK_EVENT_REACHABLE = 1,   /* local path restored */
+  NETLINK_EVENT_UNREACHABLE = 2, /* route lost or egress carrier down */
+} netlink_event_t;
+
+#define OPENUPS_STATE_MAGIC UINT32_C(0x4F505553) /* "OPUS" */
+#define OPENUPS_STATE_VERSION UINT32_C(1)
+
+/* Monitor checkpoint shared with the next process through a small mmap'd
+ * file.  Times are wall-clock because monotonic clocks do not survive a
+ * restart; generation is a seqlock counter that is odd while a write is in
+ * progress, so a crash mid-write leaves a record that is rejected. */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t generation;
+  int32_t consecutive_fails;
+  char target[64];
+  int32_t probe_kind;
+  int32_t probe_port;
+  uint64_t saved_realtime_ms;
+  uint64_t shutdown_deadline_realtime_ms; /* 0 = no countdown armed */
+  uint64_t metrics_start_realtime_ms;
+  uint64_t total_pings;
+  uint64_t successful_pings;
+  uint64_t failed_pings;
+  double total_latency;
+  double min_latency;
+  double max_latency;
+} state_checkpoint_t;
+
+typedef struct {
+  int fd;
+  state_checkpoint_t *record; /* MAP_SHARED view; NULL when disabled */
+} state_store_t;
+
+/* AF_PACKET socket with a TPACKET_V3 receive ring: the kernel writes
+ * filtered echo replies straight into shared blocks that are parsed in
+ * place and handed back one whole block at a time. */
+typedef struct {
+  int fd;
+  uint8_t *map;
+  size_t map_size;
+  uint32_t block_size;
+  uint32_t block_count;
+  uint32_t next_block;
+} packet_ring_t;
+
+/* rx_us is the kernel receive timestamp on the CLOCK_MONOTONIC scale. */
+typedef void (*packet_ring_reply_fn)(void *ctx,
+                                     const icmp_reply_key_t *restrict reply,
+                                     uint64_t rx_us);
+
+/* Token bucket in virtual-time (GCRA) form: a send is allowed once the
+ * clock reaches next_ns, and each send pushes next_ns one period further.
+ * Idle time banks at most burst_ns worth of tokens. */
+typedef struct {
+  uint64_t period_ns;
+  uint64_t burst_ns;
+  uint64_t next_ns;
+} pacer_t;
+
+/* One address or CIDR block from a target list, host bits cleared. */
+typedef struct {
+  uint8_t bytes[16]; /* network order; IPv4 uses the first four */
+  uint32_t line_no;
+  uint8_t family; /* AF_INET or AF_INET6 */
+  uint8_t prefix; /* 32 or 128 for a single address */
+} target_entry_t;
+
+/* Line iterator over a list held in memory.  Newlines are located one
+ * 64-byte block at a time with vector compares and consumed from the
+ * resulting bitmask, so short lines cost a bit scan, not a byte loop. */
+typedef struct {
+  const char *data;
+  size_t size;
+  size_t line_start;   /* offset of the next unread line */
+  size_t block;        /* offset of the block the masks describe */
+  uint64_t newlines;   /* unconsumed newline positions in that block */
+  uint64_t separators; /* blanks, CR, '#' and NUL in that block */
+  uint32_t line_no;    /* line of the last token returned */
+} target_scan_t;
+
+/* Read-only mapping of a target list file. */
+typedef struct {
+  const char *data;
+  size_t size;
+} target_map_t;
+
+typedef struct {
+  target_entry_t *entries; /* sorted by family, address, prefix; unique */
+  uint32_t count;
+  uint32_t duplicates; /* lines dropped as repeats of an earlier line */
+} target_list_t;
+
+/* Bump allocator over one mapping sized and faulted in at startup, so the
+ * steady state never touches malloc.  Nothing is freed individually. */
+typedef struct {
+  uint8_t *base;
+  size_t capacity;
+  size_t used;
+} arena_t;
+
 typedef struct {
   bool enabled;
   int sockfd;
@@ -120,6 +556,8 @@ typedef struct {
   bool (*ready)(void *backend_ctx);
   bool (*status)(void *backend_ctx, const char *status);
   bool (*stopping)(void *backend_ctx);
+  bool (*reloading)(void *backend_ctx);
+  bool (*store_fd)(void *backend_ctx, int fd, const char *name);
   bool (*watchdog)(void *backend_ctx);
   uint64_t (*watchdog_interval_ms)(const void *backend_ctx);
   void (*destroy)(void *backend_ctx);
@@ -127,19 +565,42 @@ typedef struct {
 
 typedef struct openups_context {
   volatile sig_atomic_t stop_flag;
+  volatile sig_atomic_t reload_flag;
   int consecutive_fails;
 
   uint16_t
       cached_pid; /* cached getpid() & 0xFFFF, avoids syscall in hot path */
+  uint64_t host_seed; /* first-probe phase, see pacer_phase_us() */
 
   config_t config;
   struct sockaddr_storage dest_addr;
   socklen_t dest_addr_len;
   logger_t logger;
   metrics_t metrics;
+  reactor_stats_t reactor;
   icmp_pinger_t pinger;
+  tcp_prober_t tcp_prober;
+  udp_prober_t udp_prober;
+  pmtu_prober_t pmtu; /* pinger.sockfd -1 unless --pmtu */
+  hop_sweep_t hops;   /* pinger.sockfd -1 unless --hops */
+  uint8_t reply_ttl;  /* TTL of the last ICMP reply, 0 if unknown */
+  uint32_t route_changes; /* reply TTL changes while healthy */
+  shadow_state_t shadows[OPENUPS_MAX_SHADOW_POLICIES];
+  uint8_t *send_buf; /* probe packet, header + config.payload_size */
+  size_t send_buf_size;
+  probe_backend_t probe;
+  reactor_io_t io;
+  netlink_monitor_t netlink;
+  state_store_t state_store;
+  /* fds handed back by the systemd fd store, -1 once consumed */
+  int inherited_icmp_fd;
+  int inherited_signal_fd;
   systemd_notifier_t systemd;
   runtime_services_t services;
+
+  /* Original command line, re-resolved on SIGHUP */
+  int argc;
+  char **argv;
 } openups_ctx_t;
 
 static_assert(sizeof(uint64_t) == 8, "uint64_t must be 8 bytes");
@@ -147,6 +608,8 @@ static_assert(sizeof(time_t) >= 4, "time_t must be at least 4 bytes");
 static_assert(sizeof(struct icmphdr) >= 8, "icmphdr must be at least 8 bytes");
 static_assert(sizeof(sig_atomic_t) >= sizeof(int),
               "sig_atomic_t must be at least int size");
+static_assert(sizeof(icmp_reply_key_t) == 24,
+              "icmp_reply_key_t is hashed as three 64-bit lanes");
 
 [[nodiscard]] char *get_timestamp_str(char *restrict buffer, size_t size);
 void logger_init(logger_t *restrict logger, log_level_t level,
@@ -160,6 +623,10 @@ void config_init_default(config_t *restrict config);
 [[nodiscard]] bool config_load_from_env(config_t *restrict config,
                                         char *restrict error_msg,
                                         size_t error_size);
+[[nodiscard]] bool config_load_from_file(config_t *restrict config,
+                                         const char *restrict path,
+                                         char *restrict error_msg,
+                                         size_t error_size);
 [[nodiscard]] bool config_load_from_cmdline(config_t *restrict config,
                                             int argc, char **restrict argv,
                                             bool *restrict exit_requested,
@@ -174,10 +641,21 @@ void config_init_default(config_t *restrict config);
 bool config_log_timestamps_enabled(const config_t *restrict config);
 void config_print(const config_t *restrict config,
                   const logger_t *restrict logger);
+bool checksum_kernel_supported(checksum_kernel_t kernel);
+const char *checksum_kernel_name(checksum_kernel_t kernel);
+checksum_kernel_t checksum_kernel_select(void);
+uint16_t checksum_compute(checksum_kernel_t kernel, const void *data,
+                          size_t len);
+uint16_t icmp_checksum(const void *data, size_t len);
 [[nodiscard]] bool icmp_pinger_init(icmp_pinger_t *restrict pinger, int family,
                                     char *restrict error_msg,
                                     size_t error_size);
+[[nodiscard]] bool icmp_pinger_adopt(icmp_pinger_t *restrict pinger, int fd,
+                                     int family, char *restrict error_msg,
+                                     size_t error_size);
 void icmp_pinger_destroy(icmp_pinger_t *restrict pinger);
+[[nodiscard]] bool icmp_pinger_enable_timestamps(
+    icmp_pinger_t *restrict pinger);
 [[nodiscard]] bool icmp_pinger_send_echo(
     icmp_pinger_t *restrict pinger,
     const struct sockaddr_storage *restrict dest_addr, socklen_t dest_addr_len,
@@ -188,6 +666,158 @@ icmp_receive_status_t icmp_pinger_receive_reply(
     const struct sockaddr_storage *restrict dest_addr, uint16_t identifier,
     uint16_t expected_sequence, uint64_t send_time_ms, uint64_t now_ms,
     ping_result_t *restrict out_result);
+int icmp_pinger_receive_batch(const icmp_pinger_t *restrict pinger,
+                              icmp_echo_reply_t *restrict replies,
+                              size_t max_replies, char *restrict error_msg,
+                              size_t error_size);
+[[nodiscard]] bool icmp_pinger_filter_identifier(
+    icmp_pinger_t *restrict pinger, uint16_t identifier);
+void icmp_reply_key_init(icmp_reply_key_t *restrict key,
+                         const struct sockaddr_storage *restrict addr,
+                         uint16_t identifier, uint16_t sequence);
+[[nodiscard]] bool icmp_parse_echo_packet(const uint8_t *restrict packet,
+                                          size_t length,
+                                          icmp_reply_key_t *restrict key);
+[[nodiscard]] bool icmp_pinger_discard_replies(icmp_pinger_t *restrict pinger);
+[[nodiscard]] bool icmp_pinger_filter_hops(icmp_pinger_t *restrict pinger,
+                                           uint16_t identifier);
+[[nodiscard]] bool icmp_pinger_set_ttl(icmp_pinger_t *restrict pinger,
+                                       int ttl);
+icmp_receive_status_t icmp_pinger_receive_hop(
+    const icmp_pinger_t *restrict pinger, icmp_hop_reply_t *restrict reply,
+    char *restrict error_msg, size_t error_size);
+[[nodiscard]] bool packet_ring_open(packet_ring_t *restrict ring,
+                                    uint16_t identifier,
+                                    char *restrict error_msg,
+                                    size_t error_size);
+void packet_ring_close(packet_ring_t *restrict ring);
+size_t packet_ring_drain(packet_ring_t *restrict ring,
+                         packet_ring_reply_fn on_reply, void *ctx);
+[[nodiscard]] bool tcp_prober_init(tcp_prober_t *restrict prober, int family,
+                                   char *restrict error_msg,
+                                   size_t error_size);
+void tcp_prober_destroy(tcp_prober_t *restrict prober);
+[[nodiscard]] bool tcp_prober_send(
+    tcp_prober_t *restrict prober,
+    const struct sockaddr_storage *restrict dest_addr, socklen_t dest_addr_len,
+    uint16_t identifier, size_t packet_len, char *restrict error_msg,
+    size_t error_size);
+icmp_receive_status_t tcp_prober_receive(
+    tcp_prober_t *restrict prober,
+    const struct sockaddr_storage *restrict dest_addr, uint16_t identifier,
+    uint16_t expected_sequence, uint64_t send_time_ms, uint64_t now_ms,
+    ping_result_t *restrict out_result);
+void tcp_prober_cancel(tcp_prober_t *restrict prober);
+[[nodiscard]] bool udp_prober_init(udp_prober_t *restrict prober, int family,
+                                   char *restrict error_msg,
+                                   size_t error_size);
+void udp_prober_destroy(udp_prober_t *restrict prober);
+[[nodiscard]] bool udp_prober_send(
+    udp_prober_t *restrict prober,
+    const struct sockaddr_storage *restrict dest_addr, socklen_t dest_addr_len,
+    uint16_t identifier, size_t packet_len, char *restrict error_msg,
+    size_t error_size);
+icmp_receive_status_t udp_prober_receive(
+    udp_prober_t *restrict prober,
+    const struct sockaddr_storage *restrict dest_addr, uint16_t identifier,
+    uint16_t expected_sequence, uint64_t send_time_ms, uint64_t now_ms,
+    ping_result_t *restrict out_result);
+[[nodiscard]] bool pmtu_prober_init(
+    pmtu_prober_t *restrict prober,
+    const struct sockaddr_storage *restrict dest_addr, socklen_t dest_addr_len,
+    char *restrict error_msg, size_t error_size);
+void pmtu_prober_destroy(pmtu_prober_t *restrict prober);
+void pmtu_prober_reset(pmtu_prober_t *restrict prober, uint32_t header_len,
+                       uint32_t floor, uint32_t ceiling);
+uint32_t pmtu_prober_next_size(const pmtu_prober_t *restrict prober);
+[[nodiscard]] bool pmtu_prober_send(
+    pmtu_prober_t *restrict prober,
+    const struct sockaddr_storage *restrict dest_addr, socklen_t dest_addr_len,
+    uint16_t identifier, bool *restrict too_big, char *restrict error_msg,
+    size_t error_size);
+pmtu_event_t pmtu_prober_record(pmtu_prober_t *restrict prober,
+                                pmtu_probe_result_t result,
+                                uint32_t *restrict previous_mtu);
+[[nodiscard]] bool hop_sweep_init(hop_sweep_t *restrict sweep, int family,
+                                  uint16_t identifier,
+                                  char *restrict error_msg, size_t error_size);
+void hop_sweep_destroy(hop_sweep_t *restrict sweep);
+[[nodiscard]] bool hop_sweep_start(
+    hop_sweep_t *restrict sweep,
+    const struct sockaddr_storage *restrict dest_addr, socklen_t dest_addr_len,
+    uint32_t max_ttl, char *restrict error_msg, size_t error_size);
+bool hop_sweep_record(hop_sweep_t *restrict sweep,
+                      const icmp_hop_reply_t *restrict reply);
+bool hop_sweep_complete(const hop_sweep_t *restrict sweep);
+uint32_t hop_sweep_last_hop(const hop_sweep_t *restrict sweep);
+void hop_sweep_describe(const hop_sweep_t *restrict sweep,
+                        char *restrict buffer, size_t size);
+[[nodiscard]] bool netlink_monitor_init(
+    netlink_monitor_t *restrict monitor,
+    const struct sockaddr_storage *restrict dest_addr,
+    char *restrict error_msg, size_t error_size);
+void netlink_monitor_destroy(netlink_monitor_t *restrict monitor);
+netlink_event_t netlink_monitor_process(
+    netlink_monitor_t *restrict monitor,
+    const struct sockaddr_storage *restrict dest_addr,
+    const logger_t *restrict logger, char *restrict reason,
+    size_t reason_size);
+void netlink_monitor_refresh(netlink_monitor_t *restrict monitor,
+                             const struct sockaddr_storage *restrict dest_addr);
+void netlink_monitor_describe(const netlink_monitor_t *restrict monitor,
+                              char *restrict reason, size_t reason_size);
+[[nodiscard]] bool state_store_open(state_store_t *restrict store,
+                                    const char *restrict path,
+                                    char *restrict error_msg,
+                                    size_t error_size);
+void state_store_close(state_store_t *restrict store);
+[[nodiscard]] bool state_store_read(const state_store_t *restrict store,
+                                    state_checkpoint_t *restrict out);
+void state_store_write(state_store_t *restrict store,
+                       const state_checkpoint_t *restrict checkpoint);
+[[nodiscard]] bool arena_init(arena_t *restrict arena, size_t capacity,
+                              char *restrict error_msg, size_t error_size);
+[[nodiscard]] void *arena_alloc(arena_t *restrict arena, size_t count,
+                                size_t size, size_t align);
+void arena_destroy(arena_t *restrict arena);
+[[nodiscard]] bool realtime_pin_cpu(int cpu, char *restrict error_msg,
+                                    size_t error_size);
+[[nodiscard]] bool realtime_set_fifo(int priority, char *restrict error_msg,
+                                     size_t error_size);
+[[nodiscard]] bool realtime_lock_memory(long *restrict locked_kb,
+                                        char *restrict error_msg,
+                                        size_t error_size);
+[[nodiscard]] bool realtime_busy_poll(int fd, int busy_poll_us,
+                                      char *restrict error_msg,
+                                      size_t error_size);
+int realtime_busy_poll_sysctl(void);
+uint64_t pacer_host_seed(void);
+uint64_t pacer_phase_us(uint64_t seed,
+                        const struct sockaddr_storage *restrict addr,
+                        uint64_t interval_us);
+[[nodiscard]] bool target_map_fd(target_map_t *restrict map, int fd,
+                                 const char *restrict path,
+                                 char *restrict error_msg, size_t error_size);
+void target_map_close(target_map_t *restrict map);
+void target_scan_init(target_scan_t *restrict scan, const char *data,
+                      size_t size);
+[[nodiscard]] bool target_scan_next(target_scan_t *restrict scan,
+                                    const char **restrict token,
+                                    size_t *restrict length);
+size_t target_line_token(const char *line, size_t length,
+                         const char **restrict token);
+[[nodiscard]] bool target_parse(const char *restrict text, size_t length,
+                                bool allow_prefix,
+                                target_entry_t *restrict out);
+void target_entry_address(const target_entry_t *restrict entry,
+                          struct sockaddr_storage *restrict addr,
+                          socklen_t *restrict addr_len);
+[[nodiscard]] bool target_list_load(target_list_t *restrict list,
+                                    const char *restrict path,
+                                    uint32_t max_entries,
+                                    char *restrict error_msg,
+                                    size_t error_size);
+void target_list_free(target_list_t *restrict list);
 [[nodiscard]] bool resolve_target(const char *restrict target,
                                   struct sockaddr_storage *restrict addr,
                                   socklen_t *restrict addr_len,
@@ -202,6 +832,11 @@ bool systemd_notifier_ready(systemd_notifier_t *restrict notifier);
 bool systemd_notifier_status(systemd_notifier_t *restrict notifier,
                              const char *restrict status);
 bool systemd_notifier_stopping(systemd_notifier_t *restrict notifier);
+bool systemd_notifier_reloading(systemd_notifier_t *restrict notifier);
+bool systemd_notifier_store_fd(systemd_notifier_t *restrict notifier, int fd,
+                               const char *restrict name);
+size_t systemd_listen_fds_take(const char *const *restrict names,
+                               int *restrict fds, size_t count);
 bool systemd_notifier_watchdog(systemd_notifier_t *restrict notifier);
 uint64_t systemd_notifier_watchdog_interval_ms(
     const systemd_notifier_t *restrict notifier);
@@ -223,6 +858,19 @@ static inline bool runtime_services_noop_stopping(void *backend_ctx) {
   return true;
 }
 
+static inline bool runtime_services_noop_reloading(void *backend_ctx) {
+  (void)backend_ctx;
+  return true;
+}
+
+static inline bool runtime_services_noop_store_fd(void *backend_ctx, int fd,
+                                                  const char *name) {
+  (void)backend_ctx;
+  (void)fd;
+  (void)name;
+  return false;
+}
+
 static inline bool runtime_services_noop_watchdog(void *backend_ctx) {
   (void)backend_ctx;
   return true;
@@ -249,6 +897,8 @@ static inline void runtime_services_set_null(
   services->ready = runtime_services_noop_ready;
   services->status = runtime_services_noop_status;
   services->stopping = runtime_services_noop_stopping;
+  services->reloading = runtime_services_noop_reloading;
+  services->store_fd = runtime_services_noop_store_fd;
   services->watchdog = runtime_services_noop_watchdog;
   services->watchdog_interval_ms = runtime_services_noop_watchdog_interval_ms;
   services->destroy = runtime_services_noop_destroy;
@@ -276,6 +926,9 @@ static inline void runtime_services_init(runtime_services_t *restrict services,
   services->ready = (bool (*)(void *))systemd_notifier_ready;
   services->status = (bool (*)(void *, const char *))systemd_notifier_status;
   services->stopping = (bool (*)(void *))systemd_notifier_stopping;
+  services->reloading = (bool (*)(void *))systemd_notifier_reloading;
+  services->store_fd =
+      (bool (*)(void *, int, const char *))systemd_notifier_store_fd;
   services->watchdog = (bool (*)(void *))systemd_notifier_watchdog;
   services->watchdog_interval_ms =
       (uint64_t(*)(const void *))systemd_notifier_watchdog_interval_ms;
@@ -344,6 +997,328 @@ static inline bool runtime_services_notify_stopping(
   return services != NULL && services->stopping(services->backend_ctx);
 }
 
+static inline bool runtime_services_notify_reloading(
+    runtime_services_t *restrict services) {
+  return services != NULL && services->reloading(services->backend_ctx);
+}
+
+static inline bool runtime_services_store_fd(
+    runtime_services_t *restrict services, int fd, const char *name) {
+  return services != NULL && services->store_fd(services->backend_ctx, fd, name);
+}
+
+/* Adds the worst-case footprint of one arena_alloc() call to *total;
+ * sizing passes mirror the allocation sequence with it. */
+static inline bool arena_layout_add(size_t *restrict total, size_t count,
+                                    size_t size, size_t align) {
+  size_t bytes;
+  return !ckd_mul(&bytes, count, size) && !ckd_add(&bytes, bytes, align) &&
+         !ckd_add(total, *total, bytes);
+}
+
+static inline void pacer_init(pacer_t *restrict pacer, uint64_t rate_per_sec,
+                              uint32_t burst, uint64_t now_us) {
+  pacer->period_ns =
+      rate_per_sec > 0 ? UINT64_C(1000000000) / rate_per_sec : 0;
+  pacer->burst_ns = pacer->period_ns * burst;
+  pacer->next_ns = now_us * UINT64_C(1000);
+}
+
+static inline bool pacer_take(pacer_t *restrict pacer, uint64_t now_us) {
+  uint64_t now_ns = now_us * UINT64_C(1000);
+  if (pacer->next_ns > now_ns) {
+    return false;
+  }
+  if (now_ns - pacer->next_ns > pacer->burst_ns) {
+    pacer->next_ns = now_ns - pacer->burst_ns; /* forgive older idle time */
+  }
+  pacer->next_ns += pacer->period_ns;
+  return true;
+}
+
+static inline uint64_t pacer_wait_us(const pacer_t *restrict pacer,
+                                     uint64_t now_us) {
+  uint64_t now_ns = now_us * UINT64_C(1000);
+  return pacer->next_ns > now_ns
+             ? (pacer->next_ns - now_ns + UINT64_C(999)) / UINT64_C(1000)
+             : 0;
+}
+
+static inline void shadow_fire(shadow_state_t *restrict state,
+                               uint64_t at_ms) {
+  state->history = 0;
+  state->deadline_ms = 0;
+  state->fired++;
+  state->last_fired_ms = at_ms;
+}
+
+/* Fires a countdown that elapsed before now_ms, as of its deadline.
+ * Checked ahead of each result, so no timer or wakeup is needed. */
+static inline bool shadow_expire(shadow_state_t *restrict state,
+                                 uint64_t now_ms) {
+  if (state->deadline_ms == 0 || now_ms < state->deadline_ms) {
+    return false;
+  }
+  shadow_fire(state, state->deadline_ms);
+  return true;
+}
+
+/* One probe result, O(1): a shift, a mask and a popcount. */
+static inline shadow_event_t shadow_observe(
+    const shadow_policy_t *restrict policy, shadow_state_t *restrict state,
+    bool failed, uint64_t now_ms) {
+  uint64_t mask = policy->window >= OPENUPS_SHADOW_MAX_WINDOW
+                      ? UINT64_MAX
+                      : (UINT64_C(1) << policy->window) - 1;
+  state->history = (state->history << 1 | (failed ? 1U : 0U)) & mask;
+  if (!failed) {
+    if (state->deadline_ms == 0) {
+      return SHADOW_EVENT_NONE;
+    }
+    state->deadline_ms = 0;
+    return SHADOW_EVENT_CANCELLED;
+  }
+  if (__builtin_popcountll(state->history) < policy->threshold) {
+    return SHADOW_EVENT_NONE;
+  }
+  if (policy->mode == SHUTDOWN_MODE_LOG_ONLY || policy->delay_minutes <= 0) {
+    shadow_fire(state, now_ms);
+    return SHADOW_EVENT_FIRED;
+  }
+  if (state->deadline_ms != 0) {
+    return SHADOW_EVENT_NONE;
+  }
+  uint64_t delay_ms = (uint64_t)policy->delay_minutes * OPENUPS_MS_PER_MINUTE;
+  if (ckd_add(&state->deadline_ms, now_ms, delay_ms)) {
+    state->deadline_ms = UINT64_MAX;
+  }
+  return SHADOW_EVENT_ARMED;
+}
+
+static inline bool icmp_reply_key_equal(const icmp_reply_key_t *restrict lhs,
+                                        const icmp_reply_key_t *restrict rhs) {
+  return memcmp(lhs, rhs, sizeof(*lhs)) == 0;
+}
+
+/* Three 64-bit lanes folded with multiply/xor-shift rounds (murmur3 fmix). */
+static inline uint32_t icmp_reply_key_hash(const icmp_reply_key_t *restrict key) {
+  uint64_t lanes[3];
+  memcpy(lanes, key, sizeof(lanes));
+  uint64_t hash = lanes[0] ^ (lanes[1] * UINT64_C(0x9E3779B97F4A7C15)) ^
+                  (lanes[2] * UINT64_C(0xC2B2AE3D27D4EB4F));
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xFF51AFD7ED558CCD);
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xC4CEB9FE1A85EC53);
+  hash ^= hash >> 33;
+  return (uint32_t)hash;
+}
+
+static inline uint16_t icmp_pinger_current_sequence(
+    const icmp_pinger_t *restrict pinger) {
+  return pinger->sequence;
+}
+
+/* Probes are built in caller-owned memory sized from --payload-size, so a
+ * 64 KiB echo never lives inside the pinger.  The payload pattern is
+ * written once here; each send only rewrites the header.  One buffer may
+ * serve several pingers of the same thread. */
+static inline void icmp_pinger_set_send_buffer(icmp_pinger_t *restrict pinger,
+                                               uint8_t *restrict buf,
+                                               size_t capacity) {
+  pinger->send_buf = buf;
+  pinger->send_capacity = capacity;
+  for (size_t i = OPENUPS_PROBE_HEADER_LEN; i < capacity; i++) {
+    buf[i] = (uint8_t)((i - OPENUPS_PROBE_HEADER_LEN) & 0xFFU);
+  }
+}
+
+static inline int icmp_pinger_poll_fd(const icmp_pinger_t *restrict pinger) {
+  return pinger->sockfd;
+}
+
+static inline short icmp_pinger_poll_events(
+    const icmp_pinger_t *restrict pinger) {
+  (void)pinger;
+  return POLLIN;
+}
+
+static inline void icmp_pinger_cancel(icmp_pinger_t *restrict pinger) {
+  (void)pinger;
+}
+
+static inline uint16_t tcp_prober_current_sequence(
+    const tcp_prober_t *restrict prober) {
+  return prober->sequence;
+}
+
+static inline int tcp_prober_poll_fd(const tcp_prober_t *restrict prober) {
+  return prober->connecting ? prober->sockfd : -1;
+}
+
+static inline short tcp_prober_poll_events(
+    const tcp_prober_t *restrict prober) {
+  (void)prober;
+  return POLLOUT;
+}
+
+static inline uint16_t udp_prober_current_sequence(
+    const udp_prober_t *restrict prober) {
+  return prober->sequence;
+}
+
+/* Same contract as icmp_pinger_set_send_buffer(); the datagram is the
+ * payload alone, identifier and sequence first. */
+static inline void udp_prober_set_send_buffer(udp_prober_t *restrict prober,
+                                              uint8_t *restrict buf,
+                                              size_t capacity) {
+  prober->send_buf = buf;
+  prober->send_capacity = capacity;
+  for (size_t i = OPENUPS_UDP_PROBE_HEADER_LEN; i < capacity; i++) {
+    buf[i] = (uint8_t)(i & 0xFFU);
+  }
+}
+
+static inline int udp_prober_poll_fd(const udp_prober_t *restrict prober) {
+  return prober->sockfd;
+}
+
+/* A pending send error has nothing to read: POLLOUT wakes the reactor at
+ * once so the receive path reports it. */
+static inline short udp_prober_poll_events(
+    const udp_prober_t *restrict prober) {
+  return prober->pending_error != 0 ? (short)(POLLIN | POLLOUT) : POLLIN;
+}
+
+static inline void udp_prober_cancel(udp_prober_t *restrict prober) {
+  prober->pending_error = 0;
+}
+
+static inline void probe_backend_init_icmp(probe_backend_t *restrict probe,
+                                           icmp_pinger_t *restrict pinger) {
+  if (probe == NULL) {
+    return;
+  }
+
+  probe->backend_ctx = pinger;
+  probe->kind = PROBE_KIND_ICMP;
+  probe->label = "ICMP";
+  probe->description = "ICMP echo";
+  probe->socket_errors_are_results = false;
+  probe->send = (bool (*)(void *, const struct sockaddr_storage *, socklen_t,
+                          uint16_t, size_t, char *, size_t))
+      icmp_pinger_send_echo;
+  probe->receive =
+      (icmp_receive_status_t(*)(void *, const struct sockaddr_storage *,
+                                uint16_t, uint16_t, uint64_t, uint64_t,
+                                ping_result_t *))icmp_pinger_receive_reply;
+  probe->sequence = (uint16_t(*)(const void *))icmp_pinger_current_sequence;
+  probe->poll_fd = (int (*)(const void *))icmp_pinger_poll_fd;
+  probe->poll_events = (short (*)(const void *))icmp_pinger_poll_events;
+  probe->cancel = (void (*)(void *))icmp_pinger_cancel;
+  probe->destroy = (void (*)(void *))icmp_pinger_destroy;
+}
+
+static inline void probe_backend_init_tcp(probe_backend_t *restrict probe,
+                                          tcp_prober_t *restrict prober) {
+  if (probe == NULL) {
+    return;
+  }
+
+  probe->backend_ctx = prober;
+  probe->kind = PROBE_KIND_TCP;
+  probe->label = "TCP";
+  probe->description = "TCP connect probe";
+  probe->socket_errors_are_results = true;
+  probe->send = (bool (*)(void *, const struct sockaddr_storage *, socklen_t,
+                          uint16_t, size_t, char *, size_t))tcp_prober_send;
+  probe->receive =
+      (icmp_receive_status_t(*)(void *, const struct sockaddr_storage *,
+                                uint16_t, uint16_t, uint64_t, uint64_t,
+                                ping_result_t *))tcp_prober_receive;
+  probe->sequence = (uint16_t(*)(const void *))tcp_prober_current_sequence;
+  probe->poll_fd = (int (*)(const void *))tcp_prober_poll_fd;
+  probe->poll_events = (short (*)(const void *))tcp_prober_poll_events;
+  probe->cancel = (void (*)(void *))tcp_prober_cancel;
+  probe->destroy = (void (*)(void *))tcp_prober_destroy;
+}
+
+static inline void probe_backend_init_udp(probe_backend_t *restrict probe,
+                                          udp_prober_t *restrict prober) {
+  if (probe == NULL) {
+    return;
+  }
+
+  probe->backend_ctx = prober;
+  probe->kind = PROBE_KIND_UDP;
+  probe->label = "UDP";
+  probe->description = "UDP request";
+  probe->socket_errors_are_results = true;
+  probe->send = (bool (*)(void *, const struct sockaddr_storage *, socklen_t,
+                          uint16_t, size_t, char *, size_t))udp_prober_send;
+  probe->receive =
+      (icmp_receive_status_t(*)(void *, const struct sockaddr_storage *,
+                                uint16_t, uint16_t, uint64_t, uint64_t,
+                                ping_result_t *))udp_prober_receive;
+  probe->sequence = (uint16_t(*)(const void *))udp_prober_current_sequence;
+  probe->poll_fd = (int (*)(const void *))udp_prober_poll_fd;
+  probe->poll_events = (short (*)(const void *))udp_prober_poll_events;
+  probe->cancel = (void (*)(void *))udp_prober_cancel;
+  probe->destroy = (void (*)(void *))udp_prober_destroy;
+}
+
+static inline void probe_backend_destroy(probe_backend_t *restrict probe) {
+  if (probe == NULL || probe->destroy == NULL) {
+    return;
+  }
+
+  probe->destroy(probe->backend_ctx);
+  probe->destroy = NULL;
+}
+
+static inline bool probe_backend_send(
+    probe_backend_t *restrict probe,
+    const struct sockaddr_storage *restrict dest_addr, socklen_t dest_addr_len,
+    uint16_t identifier, size_t packet_len, char *restrict error_msg,
+    size_t error_size) {
+  return probe != NULL &&
+         probe->send(probe->backend_ctx, dest_addr, dest_addr_len, identifier,
+                     packet_len, error_msg, error_size);
+}
+
+static inline icmp_receive_status_t probe_backend_receive(
+    probe_backend_t *restrict probe,
+    const struct sockaddr_storage *restrict dest_addr, uint16_t identifier,
+    uint16_t expected_sequence, uint64_t send_time_ms, uint64_t now_ms,
+    ping_result_t *restrict out_result) {
+  if (probe == NULL) {
+    return ICMP_RECEIVE_ERROR;
+  }
+
+  return probe->receive(probe->backend_ctx, dest_addr, identifier,
+                        expected_sequence, send_time_ms, now_ms, out_result);
+}
+
+static inline uint16_t probe_backend_sequence(
+    const probe_backend_t *restrict probe) {
+  return probe != NULL ? probe->sequence(probe->backend_ctx) : 0;
+}
+
+static inline int probe_backend_poll_fd(const probe_backend_t *restrict probe) {
+  return probe != NULL ? probe->poll_fd(probe->backend_ctx) : -1;
+}
+
+static inline short probe_backend_poll_events(
+    const probe_backend_t *restrict probe) {
+  return probe != NULL ? probe->poll_events(probe->backend_ctx) : 0;
+}
+
+static inline void probe_backend_cancel(probe_backend_t *restrict probe) {
+  if (probe != NULL) {
+    probe->cancel(probe->backend_ctx);
+  }
+}
+
 /* logger_error / logger_warn are marked cold since they fire rarely.
    The level check avoids any formatting cost when the level is filtered.
    NULL logger is silently ignored so callers need not guard every call. */
@@ -369,8 +1344,11 @@ const char *log_level_to_string(log_level_t level);
 void config_print_version(void);
 void config_print_usage(void);
 const char *shutdown_mode_to_string(shutdown_mode_t mode);
+const char *probe_kind_to_string(probe_kind_t kind);
 void log_shutdown_countdown(const logger_t *restrict logger,
                             shutdown_mode_t mode, int delay_minutes);
 uint64_t get_monotonic_ms(void);
+uint64_t get_monotonic_us(void);
+uint64_t get_realtime_ms(void);
 
 #endif // OPENUPS_H
@@ -0,0 +1,62 @@
+#include "openups.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PACER_FNV_OFFSET UINT64_C(0xCBF29CE484222325)
+#define PACER_FNV_PRIME UINT64_C(0x100000001B3)
+
+static uint64_t pacer_fnv1a(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * PACER_FNV_PRIME;
+  }
+  return hash;
+}
+
+static uint64_t pacer_fmix64(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xFF51AFD7ED558CCD);
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xC4CEB9FE1A85EC53);
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/* Identifies this host across restarts: the systemd machine ID, or the
+ * hostname where there is none.  Hosts sharing a target then land on
+ * different phases, while one host keeps its phase from boot to boot. */
+uint64_t pacer_host_seed(void) {
+  char identity[128] = {0};
+  FILE *file = fopen("/etc/machine-id", "re");
+  if (file != NULL) {
+    if (fgets(identity, sizeof(identity), file) == NULL) {
+      identity[0] = '\0';
+    }
+    fclose(file);
+  }
+  if (identity[0] == '\0' &&
+      gethostname(identity, sizeof(identity) - 1U) != 0) {
+    identity[0] = '\0';
+  }
+  return pacer_fnv1a(PACER_FNV_OFFSET, identity, strlen(identity));
+}
+
+/* Deterministic offset in [0, interval_us) for one target on this host. */
+uint64_t pacer_phase_us(uint64_t seed,
+                        const struct sockaddr_storage *restrict addr,
+                        uint64_t interval_us) {
+  if (addr == NULL || interval_us == 0) {
+    return 0;
+  }
+  uint64_t hash = seed;
+  if (addr->ss_family == AF_INET6) {
+    const struct sockaddr_in6 *v6 = (const struct sockaddr_in6 *)addr;
+    hash = pacer_fnv1a(hash, &v6->sin6_addr, sizeof(v6->sin6_addr));
+  } else {
+    const struct sockaddr_in *v4 = (const struct sockaddr_in *)addr;
+    hash = pacer_fnv1a(hash, &v4->sin_addr, sizeof(v4->sin_addr));
+  }
+  return pacer_fmix64(hash) % interval_us;
+}
@@ -0,0 +1,200 @@
+#include "openups.h"
+
+#include <errno.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* 8 x 64 KiB: at ~128 bytes per truncated frame a block holds ~500
+ * replies, and the whole ring stays well inside MemoryMax per worker. */
+#define PACKET_RING_BLOCK_SIZE (UINT32_C(1) << 16)
+#define PACKET_RING_BLOCK_COUNT 8U
+#define PACKET_RING_FRAME_SIZE 2048U
+/* A partially filled block is handed to user space after this long. */
+#define PACKET_RING_RETIRE_MS 2U
+/* Filter snap length: largest IPv4 header plus the echo header fits. */
+#define PACKET_RING_SNAPLEN 128U
+
+/* Accepts echo replies addressed to this host (not our own outgoing copies)
+ * whose identifier matches.  SOCK_DGRAM packet sockets run the filter on
+ * the network header, so offsets are IP-relative. */
+static bool packet_ring_attach_filter(int fd, uint16_t identifier) {
+  struct sock_filter filter[] = {
+      /* 0 */ BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+      /* 1 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_HOST, 0, 19),
+      /* 2 */ BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PROTOCOL),
+      /* 3 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 9),
+      /* IPv4: unfragmented ICMP, then type and id behind the header. */
+      /* 4 */ BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),
+      /* 5 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ICMP, 0, 15),
+      /* 6 */ BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6),
+      /* 7 */ BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 13, 0),
+      /* 8 */ BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),
+      /* 9 */ BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),
+      /* 10 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_ECHOREPLY, 0, 10),
+      /* 11 */ BPF_STMT(BPF_LD | BPF_H | BPF_IND, 4),
+      /* 12 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, identifier, 7, 8),
+      /* IPv6: ICMPv6 directly after the fixed header. */
+      /* 13 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IPV6, 0, 7),
+      /* 14 */ BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 6),
+      /* 15 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ICMPV6, 0, 5),
+      /* 16 */ BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 40),
+      /* 17 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_ECHO_REPLY, 0, 3),
+      /* 18 */ BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 44),
+      /* 19 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, identifier, 0, 1),
+      /* 20 */ BPF_STMT(BPF_RET | BPF_K, PACKET_RING_SNAPLEN),
+      /* 21 */ BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+  struct sock_fprog fprog = {
+      .len = (unsigned short)(sizeof(filter) / sizeof(filter[0])),
+      .filter = filter,
+  };
+  return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+                    sizeof(fprog)) == 0;
+}
+
+/* Filter, ring and mapping, in the order the kernel requires.  On failure
+ * *step names what went wrong and errno is preserved. */
+static bool packet_ring_setup(packet_ring_t *restrict ring, int fd,
+                              uint16_t identifier,
+                              const char **restrict step) {
+  int version = TPACKET_V3;
+  struct tpacket_req3 request = {
+      .tp_block_size = PACKET_RING_BLOCK_SIZE,
+      .tp_block_nr = PACKET_RING_BLOCK_COUNT,
+      .tp_frame_size = PACKET_RING_FRAME_SIZE,
+      .tp_frame_nr = PACKET_RING_BLOCK_SIZE / PACKET_RING_FRAME_SIZE *
+                     PACKET_RING_BLOCK_COUNT,
+      .tp_retire_blk_tov = PACKET_RING_RETIRE_MS,
+  };
+  *step = "attach filter";
+  if (!packet_ring_attach_filter(fd, identifier)) {
+    return false;
+  }
+  *step = "select TPACKET_V3";
+  if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version,
+                 sizeof(version)) != 0) {
+    return false;
+  }
+  *step = "set up receive ring";
+  if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &request,
+                 sizeof(request)) != 0) {
+    return false;
+  }
+  *step = "map receive ring";
+  size_t map_size = (size_t)PACKET_RING_BLOCK_SIZE * PACKET_RING_BLOCK_COUNT;
+  void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  ring->map = map;
+  ring->map_size = map_size;
+  ring->block_size = PACKET_RING_BLOCK_SIZE;
+  ring->block_count = PACKET_RING_BLOCK_COUNT;
+
+  *step = "bind packet socket";
+  struct sockaddr_ll address = {
+      .sll_family = AF_PACKET,
+      .sll_protocol = htons(ETH_P_ALL),
+  };
+  return bind(fd, (const struct sockaddr *)&address, sizeof(address)) == 0;
+}
+
+bool packet_ring_open(packet_ring_t *restrict ring, uint16_t identifier,
+                      char *restrict error_msg, size_t error_size) {
+  if (ring == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+
+  memset(ring, 0, sizeof(*ring));
+  /* Protocol 0 receives nothing until bind(), so no unfiltered packet can
+   * land in the ring while it is being set up. */
+  ring->fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (ring->fd < 0) {
+    snprintf(error_msg, error_size, "Failed to create packet socket: %s",
+             strerror(errno));
+    return false;
+  }
+
+  const char *step = "";
+  if (!packet_ring_setup(ring, ring->fd, identifier, &step)) {
+    snprintf(error_msg, error_size, "Failed to %s: %s", step,
+             strerror(errno));
+    packet_ring_close(ring);
+    return false;
+  }
+  return true;
+}
+
+void packet_ring_close(packet_ring_t *restrict ring) {
+  if (ring == NULL) {
+    return;
+  }
+
+  if (ring->map != NULL) {
+    munmap(ring->map, ring->map_size);
+  }
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+static uint64_t packet_ring_clock_us(clockid_t clock) {
+  struct timespec ts;
+  if (clock_gettime(clock, &ts) != 0) {
+    return 0;
+  }
+  return (uint64_t)ts.tv_sec * UINT64_C(1000000) +
+         (uint64_t)ts.tv_nsec / UINT64_C(1000);
+}
+
+/* Walks every block the kernel has retired, parses each frame where it
+ * lies, and returns the block to the kernel once all of its frames are
+ * consumed.  Returns the number of replies delivered. */
+size_t packet_ring_drain(packet_ring_t *restrict ring,
+                         packet_ring_reply_fn on_reply, void *ctx) {
+  if (ring == NULL || ring->map == NULL || on_reply == NULL) {
+    return 0;
+  }
+
+  /* Frames carry CLOCK_REALTIME stamps; one offset per drain maps them
+   * onto the monotonic scale the schedulers use. */
+  uint64_t realtime_us = packet_ring_clock_us(CLOCK_REALTIME);
+  uint64_t monotonic_us = get_monotonic_us();
+  size_t delivered = 0;
+  for (;;) {
+    struct tpacket_block_desc *block =
+        (struct tpacket_block_desc *)(ring->map + (size_t)ring->next_block *
+                                                      ring->block_size);
+    if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) &
+         TP_STATUS_USER) == 0) {
+      break;
+    }
+
+    const uint8_t *frame =
+        (const uint8_t *)block + block->hdr.bh1.offset_to_first_pkt;
+    for (uint32_t i = 0; i < block->hdr.bh1.num_pkts; i++) {
+      const struct tpacket3_hdr *header = (const struct tpacket3_hdr *)frame;
+      icmp_reply_key_t key;
+      if (icmp_parse_echo_packet(frame + header->tp_net, header->tp_snaplen,
+                                 &key)) {
+        uint64_t stamp_us = (uint64_t)header->tp_sec * UINT64_C(1000000) +
+                            header->tp_nsec / 1000U;
+        uint64_t age_us = realtime_us > stamp_us ? realtime_us - stamp_us : 0;
+        on_reply(ctx, &key, monotonic_us > age_us ? monotonic_us - age_us : 0);
+        delivered++;
+      }
+      frame += header->tp_next_offset;
+    }
+
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                     __ATOMIC_RELEASE);
+    ring->next_block = (ring->next_block + 1) % ring->block_count;
+  }
+  return delivered;
+}
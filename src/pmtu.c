@@ -0,0 +1,216 @@
+#include "openups.h"
+
+#include <errno.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Smallest MTU each family guarantees (RFC 791, RFC 8200), and the upper
+ * bound when the route does not report one. */
+#define PMTU_FLOOR_IPV4 68U
+#define PMTU_FLOOR_IPV6 1280U
+#define PMTU_DEFAULT_CEILING 1500U
+#define PMTU_MAX_DATAGRAM 65535U
+
+/* The search ends once no untested size is left between good and bad. */
+static pmtu_event_t pmtu_prober_settle(pmtu_prober_t *restrict prober) {
+  if (prober->bad > prober->good + 1U) {
+    return PMTU_EVENT_NONE;
+  }
+  uint32_t previous = prober->mtu;
+  prober->searching = false;
+  prober->mtu = prober->good;
+  prober->verified = 0;
+  if (previous == 0) {
+    return PMTU_EVENT_DISCOVERED;
+  }
+  if (prober->mtu < previous) {
+    prober->drops++;
+    return PMTU_EVENT_DROPPED;
+  }
+  return prober->mtu > previous ? PMTU_EVENT_RAISED : PMTU_EVENT_NONE;
+}
+
+void pmtu_prober_reset(pmtu_prober_t *restrict prober, uint32_t header_len,
+                       uint32_t floor, uint32_t ceiling) {
+  if (prober == NULL) {
+    return;
+  }
+  prober->header_len = header_len;
+  prober->floor = floor;
+  prober->ceiling = ceiling < floor ? floor : ceiling;
+  prober->good = floor;
+  prober->bad = prober->ceiling + 1U;
+  prober->mtu = 0;
+  prober->probe_size = 0;
+  prober->losses = 0;
+  prober->verified = 0;
+  prober->drops = 0;
+  prober->searching = true;
+  (void)pmtu_prober_settle(prober);
+}
+
+bool pmtu_prober_init(pmtu_prober_t *restrict prober,
+                      const struct sockaddr_storage *restrict dest_addr,
+                      socklen_t dest_addr_len, char *restrict error_msg,
+                      size_t error_size) {
+  if (prober == NULL || dest_addr == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return false;
+  }
+  memset(prober, 0, sizeof(*prober));
+  prober->pinger.sockfd = -1;
+
+  int family = dest_addr->ss_family;
+  if (!icmp_pinger_init(&prober->pinger, family, error_msg, error_size)) {
+    return false;
+  }
+
+  bool ipv6 = family == AF_INET6;
+  int level = ipv6 ? IPPROTO_IPV6 : IPPROTO_IP;
+  int mode = ipv6 ? IPV6_PMTUDISC_PROBE : IP_PMTUDISC_PROBE;
+  if (setsockopt(prober->pinger.sockfd, level,
+                 ipv6 ? IPV6_MTU_DISCOVER : IP_MTU_DISCOVER, &mode,
+                 sizeof(mode)) != 0) {
+    snprintf(error_msg, error_size, "Failed to set DF on path MTU socket: %s",
+             strerror(errno));
+    pmtu_prober_destroy(prober);
+    return false;
+  }
+  /* Connecting pins the route, whose MTU bounds the search, and limits
+   * delivery to replies from the target. */
+  if (connect(prober->pinger.sockfd, (const struct sockaddr *)dest_addr,
+              dest_addr_len) != 0) {
+    snprintf(error_msg, error_size, "Failed to connect path MTU socket: %s",
+             strerror(errno));
+    pmtu_prober_destroy(prober);
+    return false;
+  }
+
+  int route_mtu = 0;
+  socklen_t len = sizeof(route_mtu);
+  if (getsockopt(prober->pinger.sockfd, level, ipv6 ? IPV6_MTU : IP_MTU,
+                 &route_mtu, &len) != 0 ||
+      route_mtu <= 0) {
+    route_mtu = (int)PMTU_DEFAULT_CEILING;
+  }
+  uint32_t header_len =
+      ipv6 ? (uint32_t)sizeof(struct ip6_hdr) : (uint32_t)sizeof(struct ip);
+  uint32_t ceiling = (uint32_t)route_mtu > PMTU_MAX_DATAGRAM
+                         ? PMTU_MAX_DATAGRAM
+                         : (uint32_t)route_mtu;
+  pmtu_prober_reset(prober, header_len,
+                    ipv6 ? PMTU_FLOOR_IPV6 : PMTU_FLOOR_IPV4, ceiling);
+
+  size_t capacity = prober->ceiling - header_len;
+  prober->send_buf = malloc(capacity);
+  if (prober->send_buf == NULL) {
+    snprintf(error_msg, error_size,
+             "No memory for a %u-byte path MTU probe", prober->ceiling);
+    pmtu_prober_destroy(prober);
+    return false;
+  }
+  icmp_pinger_set_send_buffer(&prober->pinger, prober->send_buf, capacity);
+  return true;
+}
+
+void pmtu_prober_destroy(pmtu_prober_t *restrict prober) {
+  if (prober == NULL) {
+    return;
+  }
+  icmp_pinger_destroy(&prober->pinger);
+  prober->pinger.sockfd = -1;
+  free(prober->send_buf);
+  prober->send_buf = NULL;
+  prober->pinger.send_buf = NULL;
+  prober->pinger.send_capacity = 0;
+}
+
+/* Midpoint while searching, otherwise the converged MTU for
+ * re-verification. */
+uint32_t pmtu_prober_next_size(const pmtu_prober_t *restrict prober) {
+  if (prober == NULL) {
+    return 0;
+  }
+  if (!prober->searching) {
+    return prober->mtu;
+  }
+  return prober->good + (prober->bad - prober->good) / 2U;
+}
+
+/* *too_big reports a probe the kernel refused as larger than the egress
+ * link: a definite answer for the search, not a runtime error.  ENOBUFS is
+ * a probe dropped on the way out (IPv6 raw sockets report a veth peer's
+ * MTU drop this way); it is left to time out like any other loss. */
+bool pmtu_prober_send(pmtu_prober_t *restrict prober,
+                      const struct sockaddr_storage *restrict dest_addr,
+                      socklen_t dest_addr_len, uint16_t identifier,
+                      bool *restrict too_big, char *restrict error_msg,
+                      size_t error_size) {
+  if (prober == NULL || too_big == NULL) {
+    return false;
+  }
+  *too_big = false;
+  prober->probe_size = pmtu_prober_next_size(prober);
+  errno = 0;
+  if (icmp_pinger_send_echo(&prober->pinger, dest_addr, dest_addr_len,
+                            identifier,
+                            prober->probe_size - prober->header_len,
+                            error_msg, error_size)) {
+    return true;
+  }
+  if (errno == EMSGSIZE) {
+    *too_big = true;
+    return true;
+  }
+  return errno == ENOBUFS;
+}
+
+/* Applies the outcome of the probe last sent.  A loss is only believed
+ * after OPENUPS_PMTU_ATTEMPTS in a row at the same size; until then the
+ * size is simply retried.  A converged MTU that stops passing reopens the
+ * search below it, and one that keeps passing is searched upward again
+ * every OPENUPS_PMTU_RESEARCH_AFTER verifications, so a raised MTU is
+ * noticed too. */
+pmtu_event_t pmtu_prober_record(pmtu_prober_t *restrict prober,
+                                pmtu_probe_result_t result,
+                                uint32_t *restrict previous_mtu) {
+  if (prober == NULL || prober->probe_size == 0) {
+    return PMTU_EVENT_NONE;
+  }
+  if (previous_mtu != NULL) {
+    *previous_mtu = prober->mtu;
+  }
+  if (result == PMTU_PROBE_LOST &&
+      ++prober->losses < OPENUPS_PMTU_ATTEMPTS) {
+    return PMTU_EVENT_NONE;
+  }
+  prober->losses = 0;
+  uint32_t size = prober->probe_size;
+  bool passed = result == PMTU_PROBE_PASSED;
+
+  if (!prober->searching) {
+    if (passed) {
+      if (++prober->verified >= OPENUPS_PMTU_RESEARCH_AFTER &&
+          prober->mtu < prober->ceiling) {
+        prober->searching = true;
+        prober->good = prober->mtu;
+        prober->bad = prober->ceiling + 1U;
+        prober->verified = 0;
+      }
+      return PMTU_EVENT_NONE;
+    }
+    prober->searching = true;
+    prober->good = prober->floor;
+    prober->bad = size;
+  } else if (passed) {
+    if (size > prober->good) {
+      prober->good = size;
+    }
+  } else if (size < prober->bad) {
+    prober->bad = size;
+  }
+  return pmtu_prober_settle(prober);
+}
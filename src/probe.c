@@ -0,0 +1,390 @@
+#include "openups.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Sequence 0 is reserved as the "not waiting" sentinel in monitor state. */
+static uint16_t probe_next_sequence(uint16_t sequence) {
+  sequence = (uint16_t)(sequence + 1);
+  return sequence == 0 ? 1 : sequence;
+}
+
+static bool probe_validate_dest(int sockfd_family,
+                                const struct sockaddr_storage *restrict
+                                    dest_addr,
+                                char *restrict error_msg, size_t error_size) {
+  if (dest_addr == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+
+  if (dest_addr->ss_family != AF_INET && dest_addr->ss_family != AF_INET6) {
+    snprintf(error_msg, error_size, "Unsupported address family: %d",
+             dest_addr->ss_family);
+    return false;
+  }
+
+  if (dest_addr->ss_family != sockfd_family) {
+    snprintf(error_msg, error_size,
+             "Probe family mismatch (socket=%d, target=%d)", sockfd_family,
+             dest_addr->ss_family);
+    return false;
+  }
+
+  return true;
+}
+
+static void probe_set_latency(ping_result_t *restrict out_result,
+                              uint64_t send_time_ms, uint64_t now_ms) {
+  out_result->success = true;
+  /* Guard against impossible clock skew before recording latency. */
+  out_result->latency_ms =
+      (now_ms >= send_time_ms) ? (double)(now_ms - send_time_ms) : 0.0;
+  out_result->error_msg[0] = '\0';
+}
+
+static void probe_set_failure(ping_result_t *restrict out_result,
+                              const char *restrict what, int err) {
+  out_result->success = false;
+  out_result->latency_ms = -1.0;
+  snprintf(out_result->error_msg, sizeof(out_result->error_msg), "%s: %s",
+           what, strerror(err));
+}
+
+/* Errors meaning "the path to the peer is broken" rather than "our socket
+ * is broken"; they count as failed probes. */
+static bool probe_error_is_unreachable(int err) {
+  return err == EHOSTUNREACH || err == ENETUNREACH || err == ETIMEDOUT ||
+         err == EHOSTDOWN || err == ENETDOWN || err == ECONNRESET;
+}
+
+/* ---- TCP connect probe ---- */
+
+bool tcp_prober_init(tcp_prober_t *restrict prober, int family,
+                     char *restrict error_msg, size_t error_size) {
+  if (prober == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+
+  prober->sockfd = -1;
+  prober->family = family;
+  prober->pending_error = 0;
+  prober->sequence = 0;
+  prober->connecting = false;
+
+  if (family != AF_INET && family != AF_INET6) {
+    snprintf(error_msg, error_size, "Unsupported address family: %d", family);
+    return false;
+  }
+
+  return true;
+}
+
+void tcp_prober_cancel(tcp_prober_t *restrict prober) {
+  if (prober == NULL) {
+    return;
+  }
+
+  if (prober->sockfd >= 0) {
+    close(prober->sockfd);
+    prober->sockfd = -1;
+  }
+  prober->connecting = false;
+  prober->pending_error = 0;
+}
+
+void tcp_prober_destroy(tcp_prober_t *restrict prober) {
+  tcp_prober_cancel(prober);
+}
+
+bool tcp_prober_send(tcp_prober_t *restrict prober,
+                     const struct sockaddr_storage *restrict dest_addr,
+                     socklen_t dest_addr_len, uint16_t identifier,
+                     size_t packet_len, char *restrict error_msg,
+                     size_t error_size) {
+  (void)identifier;
+  (void)packet_len;
+  if (prober == NULL ||
+      !probe_validate_dest(prober->family, dest_addr, error_msg, error_size)) {
+    return false;
+  }
+
+  /* A previous attempt still in flight is abandoned, never reused. */
+  tcp_prober_cancel(prober);
+  prober->sequence = probe_next_sequence(prober->sequence);
+
+  prober->sockfd =
+      socket(prober->family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (prober->sockfd < 0) {
+    snprintf(error_msg, error_size, "Failed to create TCP socket: %s",
+             strerror(errno));
+    return false;
+  }
+
+  int rc;
+  do {
+    rc = connect(prober->sockfd, (const struct sockaddr *)dest_addr,
+                 dest_addr_len);
+  } while (rc < 0 && errno == EINTR);
+
+  if (rc == 0 || errno == EINPROGRESS) {
+    prober->connecting = true;
+    return true;
+  }
+
+  /* Synchronous refusal still leaves the socket pollable (POLLHUP), so the
+   * outcome is delivered through the reactor like an asynchronous one. */
+  if (errno == ECONNREFUSED || probe_error_is_unreachable(errno)) {
+    prober->pending_error = errno;
+    prober->connecting = true;
+    return true;
+  }
+
+  snprintf(error_msg, error_size, "Failed to start TCP connect: %s",
+           strerror(errno));
+  tcp_prober_cancel(prober);
+  return false;
+}
+
+icmp_receive_status_t tcp_prober_receive(
+    tcp_prober_t *restrict prober,
+    const struct sockaddr_storage *restrict dest_addr, uint16_t identifier,
+    uint16_t expected_sequence, uint64_t send_time_ms, uint64_t now_ms,
+    ping_result_t *restrict out_result) {
+  (void)dest_addr;
+  (void)identifier;
+  if (prober == NULL || out_result == NULL) {
+    return ICMP_RECEIVE_ERROR;
+  }
+
+  if (!prober->connecting || prober->sockfd < 0) {
+    return ICMP_RECEIVE_NO_MORE;
+  }
+
+  if (prober->sequence != expected_sequence) {
+    tcp_prober_cancel(prober);
+    return ICMP_RECEIVE_IGNORED;
+  }
+
+  int err = prober->pending_error;
+  if (err == 0) {
+    socklen_t err_len = sizeof(err);
+    if (getsockopt(prober->sockfd, SOL_SOCKET, SO_ERROR, &err, &err_len) !=
+        0) {
+      err = errno;
+      probe_set_failure(out_result, "getsockopt(SO_ERROR) failed", err);
+      tcp_prober_cancel(prober);
+      return ICMP_RECEIVE_ERROR;
+    }
+  }
+
+  if (err == 0) {
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    if (getpeername(prober->sockfd, (struct sockaddr *)&peer, &peer_len) !=
+        0) {
+      /* Spurious wakeup: handshake still in progress. */
+      return ICMP_RECEIVE_NO_MORE;
+    }
+    probe_set_latency(out_result, send_time_ms, now_ms);
+    tcp_prober_cancel(prober);
+    return ICMP_RECEIVE_MATCHED;
+  }
+
+  if (err == EINPROGRESS || err == EALREADY) {
+    return ICMP_RECEIVE_NO_MORE;
+  }
+
+  /* RST proves the peer's stack answered: the host is reachable even though
+   * nothing listens on the port. */
+  if (err == ECONNREFUSED) {
+    probe_set_latency(out_result, send_time_ms, now_ms);
+    tcp_prober_cancel(prober);
+    return ICMP_RECEIVE_MATCHED;
+  }
+
+  probe_set_failure(out_result, "TCP connect failed", err);
+  tcp_prober_cancel(prober);
+  return probe_error_is_unreachable(err) ? ICMP_RECEIVE_UNREACHABLE
+                                         : ICMP_RECEIVE_ERROR;
+}
+
+/* ---- UDP request/response probe ---- */
+
+/* Path errors from connect()/send(), including a prohibit route or a
+ * netfilter reject (EACCES/EPERM), fail this probe rather than the
+ * monitor; like the TCP backend's synchronous refusals they are delivered
+ * through the receive path. */
+static bool udp_send_error_is_result(int err) {
+  return probe_error_is_unreachable(err) || err == EACCES || err == EPERM ||
+         err == ECONNREFUSED;
+}
+
+bool udp_prober_init(udp_prober_t *restrict prober, int family,
+                     char *restrict error_msg, size_t error_size) {
+  if (prober == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+
+  prober->sockfd = -1;
+  prober->family = family;
+  prober->pending_error = 0;
+  prober->sequence = 0;
+  prober->send_buf = NULL;
+  prober->send_capacity = 0;
+
+  prober->sockfd =
+      socket(family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_UDP);
+  if (prober->sockfd < 0) {
+    snprintf(error_msg, error_size,
+             "Failed to create UDP socket (family=%d): %s", family,
+             strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+void udp_prober_destroy(udp_prober_t *restrict prober) {
+  if (prober == NULL) {
+    return;
+  }
+
+  if (prober->sockfd >= 0) {
+    close(prober->sockfd);
+    prober->sockfd = -1;
+  }
+}
+
+bool udp_prober_send(udp_prober_t *restrict prober,
+                     const struct sockaddr_storage *restrict dest_addr,
+                     socklen_t dest_addr_len, uint16_t identifier,
+                     size_t packet_len, char *restrict error_msg,
+                     size_t error_size) {
+  if (prober == NULL ||
+      !probe_validate_dest(prober->family, dest_addr, error_msg, error_size)) {
+    return false;
+  }
+
+  if (prober->sockfd < 0) {
+    snprintf(error_msg, error_size, "UDP socket is not initialized");
+    return false;
+  }
+
+  /* The datagram mirrors the ICMP echo payload size (packet minus header). */
+  size_t payload_len = packet_len > sizeof(struct icmphdr)
+                           ? packet_len - sizeof(struct icmphdr)
+                           : OPENUPS_UDP_PROBE_HEADER_LEN;
+  if (payload_len < OPENUPS_UDP_PROBE_HEADER_LEN ||
+      payload_len > prober->send_capacity) {
+    snprintf(error_msg, error_size, "Invalid UDP probe size: %zu",
+             payload_len);
+    return false;
+  }
+
+  prober->pending_error = 0;
+  prober->sequence = probe_next_sequence(prober->sequence);
+
+  /* connect() on a datagram socket is local-only: it pins the peer so only
+   * its replies (and its ICMP errors) are delivered to us. */
+  if (connect(prober->sockfd, (const struct sockaddr *)dest_addr,
+              dest_addr_len) != 0) {
+    if (udp_send_error_is_result(errno)) {
+      prober->pending_error = errno;
+      return true;
+    }
+    snprintf(error_msg, error_size, "Failed to connect UDP socket: %s",
+             strerror(errno));
+    return false;
+  }
+
+  uint16_t id_be = htons(identifier);
+  uint16_t seq_be = htons(prober->sequence);
+  memcpy(prober->send_buf, &id_be, sizeof(id_be));
+  memcpy(prober->send_buf + sizeof(id_be), &seq_be, sizeof(seq_be));
+
+  ssize_t sent =
+      send(prober->sockfd, prober->send_buf, payload_len, MSG_NOSIGNAL);
+  /* A port unreachable left over from an earlier probe fails this send
+   * without sending; reading it clears it, so send once more. */
+  if (sent < 0 && errno == ECONNREFUSED) {
+    sent = send(prober->sockfd, prober->send_buf, payload_len, MSG_NOSIGNAL);
+  }
+  if (sent < 0) {
+    if (udp_send_error_is_result(errno)) {
+      prober->pending_error = errno;
+      return true;
+    }
+    snprintf(error_msg, error_size, "Failed to send UDP probe: %s",
+             strerror(errno));
+    return false;
+  }
+  if ((size_t)sent != payload_len) {
+    snprintf(error_msg, error_size, "Short UDP send: %zd", sent);
+    return false;
+  }
+
+  return true;
+}
+
+icmp_receive_status_t udp_prober_receive(
+    udp_prober_t *restrict prober,
+    const struct sockaddr_storage *restrict dest_addr, uint16_t identifier,
+    uint16_t expected_sequence, uint64_t send_time_ms, uint64_t now_ms,
+    ping_result_t *restrict out_result) {
+  (void)dest_addr;
+  if (prober == NULL || out_result == NULL) {
+    return ICMP_RECEIVE_ERROR;
+  }
+
+  if (prober->pending_error != 0) {
+    int err = prober->pending_error;
+    prober->pending_error = 0;
+    if (expected_sequence == 0) {
+      return ICMP_RECEIVE_IGNORED;
+    }
+    if (err == ECONNREFUSED) {
+      probe_set_latency(out_result, send_time_ms, now_ms);
+      return ICMP_RECEIVE_MATCHED;
+    }
+    probe_set_failure(out_result, "UDP send failed", err);
+    return ICMP_RECEIVE_UNREACHABLE;
+  }
+
+  uint8_t recv_buf[512] __attribute__((aligned(16)));
+  ssize_t received = recv(prober->sockfd, recv_buf, sizeof(recv_buf), 0);
+  if (received < 0) {
+    int err = errno;
+    if (err == EAGAIN || err == EWOULDBLOCK || err == EINTR) {
+      return ICMP_RECEIVE_NO_MORE;
+    }
+    if (expected_sequence == 0) {
+      return ICMP_RECEIVE_IGNORED;
+    }
+    /* Port unreachable comes from the peer itself: the host is up. */
+    if (err == ECONNREFUSED) {
+      probe_set_latency(out_result, send_time_ms, now_ms);
+      return ICMP_RECEIVE_MATCHED;
+    }
+    probe_set_failure(out_result, "UDP receive failed", err);
+    return probe_error_is_unreachable(err) ? ICMP_RECEIVE_UNREACHABLE
+                                           : ICMP_RECEIVE_ERROR;
+  }
+
+  /* Echo-style responders return our header: only a stale echo of an older
+   * sequence is ignored; any other response from the peer counts. */
+  if ((size_t)received >= OPENUPS_UDP_PROBE_HEADER_LEN) {
+    uint16_t id_be;
+    uint16_t seq_be;
+    memcpy(&id_be, recv_buf, sizeof(id_be));
+    memcpy(&seq_be, recv_buf + sizeof(id_be), sizeof(seq_be));
+    if (ntohs(id_be) == identifier && ntohs(seq_be) != expected_sequence) {
+      return ICMP_RECEIVE_IGNORED;
+    }
+  }
+
+  probe_set_latency(out_result, send_time_ms, now_ms);
+  return ICMP_RECEIVE_MATCHED;
+}
@@ -0,0 +1,122 @@
+#define _GNU_SOURCE /* sched_setaffinity, SCHED_RESET_ON_FORK */
+#include "openups.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Stack touched before locking, so the reactor's deepest path (handlers,
+ * logging, shutdown) never grows the stack through a page fault. */
+#define REALTIME_PREFAULT_STACK_BYTES (256U * 1024U)
+#define REALTIME_PREFAULT_STRIDE 1024U
+
+bool realtime_pin_cpu(int cpu, char *restrict error_msg, size_t error_size) {
+  if (error_msg == NULL || error_size == 0 || cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    snprintf(error_msg, error_size, "Failed to pin to CPU %d: %s", cpu,
+             strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/* SCHED_RESET_ON_FORK: a shutdown command spawned from the reactor runs
+ * with normal scheduling. */
+bool realtime_set_fifo(int priority, char *restrict error_msg,
+                       size_t error_size) {
+  if (error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  struct sched_param param = {.sched_priority = priority};
+  if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
+    snprintf(error_msg, error_size,
+             "Failed to set SCHED_FIFO priority %d: %s (needs "
+             "CAP_SYS_NICE and RestrictRealtime=false)",
+             priority, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+__attribute__((noinline)) static void realtime_prefault_stack(void) {
+  volatile uint8_t stack[REALTIME_PREFAULT_STACK_BYTES];
+  for (size_t i = 0; i < sizeof(stack); i += REALTIME_PREFAULT_STRIDE) {
+    stack[i] = 0;
+  }
+}
+
+/* Locked bytes as the kernel counts them (VmLck), -1 when unreadable. */
+static long realtime_locked_kb(void) {
+  FILE *file = fopen("/proc/self/status", "re");
+  if (file == NULL) {
+    return -1;
+  }
+  char line[128];
+  long locked_kb = -1;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "VmLck: %ld kB", &locked_kb) == 1) {
+      break;
+    }
+  }
+  fclose(file);
+  return locked_kb;
+}
+
+/* Faults in the stack, then locks every current mapping (which populates
+ * the heap, buffers and sockets' user memory) and every future one, so
+ * the reactor never waits on a page fault or on swap. */
+bool realtime_lock_memory(long *restrict locked_kb, char *restrict error_msg,
+                          size_t error_size) {
+  if (locked_kb == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  realtime_prefault_stack();
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    snprintf(error_msg, error_size,
+             "Failed to lock memory: %s (needs CAP_IPC_LOCK or a "
+             "LimitMEMLOCK= covering the process)",
+             strerror(errno));
+    return false;
+  }
+  *locked_kb = realtime_locked_kb();
+  return true;
+}
+
+/* Reads on fd spin on the device queue for up to busy_poll_us before
+ * sleeping.  Raising it above net.core.busy_read needs CAP_NET_ADMIN. */
+bool realtime_busy_poll(int fd, int busy_poll_us, char *restrict error_msg,
+                        size_t error_size) {
+  if (error_msg == NULL || error_size == 0 || fd < 0) {
+    return false;
+  }
+  if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us,
+                 sizeof(busy_poll_us)) != 0) {
+    snprintf(error_msg, error_size,
+             "Failed to enable busy polling: %s (needs CAP_NET_ADMIN)",
+             strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/* net.core.busy_poll: poll() only spins on busy-polling sockets when it is
+ * nonzero.  -1 when unreadable. */
+int realtime_busy_poll_sysctl(void) {
+  FILE *file = fopen("/proc/sys/net/core/busy_poll", "re");
+  if (file == NULL) {
+    return -1;
+  }
+  int usec = -1;
+  if (fscanf(file, "%d", &usec) != 1) {
+    usec = -1;
+  }
+  fclose(file);
+  return usec;
+}
@@ -0,0 +1,824 @@
+#include "replay.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/icmp6.h>
+#include <netinet/ip_icmp.h>
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REPLAY_PCAP_MAGIC_US UINT32_C(0xA1B2C3D4)
+#define REPLAY_PCAP_MAGIC_NS UINT32_C(0xA1B23C4D)
+#define REPLAY_PCAP_HEADER 24U
+#define REPLAY_PCAP_RECORD 16U
+#define REPLAY_PCAPNG_SHB UINT32_C(0x0A0D0D0A)
+#define REPLAY_PCAPNG_BOM UINT32_C(0x1A2B3C4D)
+#define REPLAY_PCAPNG_IDB 1U
+#define REPLAY_PCAPNG_OPB 2U /* obsolete packet block */
+#define REPLAY_PCAPNG_EPB 6U
+#define REPLAY_PCAPNG_BLOCK_MIN 12U
+#define REPLAY_PCAPNG_SHB_MIN 28U
+#define REPLAY_PCAPNG_PACKET_FIELDS 20U
+#define REPLAY_PCAPNG_IDB_FIELDS 8U
+#define REPLAY_OPT_END 0U
+#define REPLAY_OPT_TSRESOL 9U
+#define REPLAY_TSRESOL_US 6U
+#define REPLAY_TSRESOL_NS 9U
+#define REPLAY_TSRESOL_BINARY 0x80U
+/* Larger than any snap length in use; beyond it the length field is
+ * corrupt rather than the packet big. */
+#define REPLAY_MAX_CAPLEN (UINT32_C(1) << 24)
+#define REPLAY_NS_PER_SEC UINT64_C(1000000000)
+#define REPLAY_NS_PER_US UINT64_C(1000)
+
+/* Link types (tcpdump.org/linktypes.html) whose network layer is found. */
+#define REPLAY_LINK_NULL 0U
+#define REPLAY_LINK_ETHERNET 1U
+#define REPLAY_LINK_RAW 101U
+#define REPLAY_LINK_LOOP 108U
+#define REPLAY_LINK_SLL 113U
+#define REPLAY_LINK_IPV4 228U
+#define REPLAY_LINK_IPV6 229U
+#define REPLAY_LINK_SLL2 276U
+#define REPLAY_ETHERTYPE_IPV4 0x0800U
+#define REPLAY_ETHERTYPE_IPV6 0x86DDU
+#define REPLAY_ETHERTYPE_VLAN 0x8100U
+#define REPLAY_ETHERTYPE_QINQ 0x88A8U
+#define REPLAY_MAX_VLAN_TAGS 2U
+
+/* Longest prefix the echo parser reads: a 60-byte IPv4 header (or the
+ * 40-byte IPv6 one) and the 8-byte echo header. */
+#define REPLAY_PARSE_BYTES 68U
+/* Requests awaiting their reply while a history loads; older ones past
+ * the window stay unanswered. */
+#define REPLAY_HISTORY_PENDING 4096U
+#define REPLAY_HISTORY_INITIAL 1024U
+
+/* ---- Byte order ---- */
+
+static inline uint16_t replay_u16(const uint8_t *restrict bytes,
+                                  bool swapped) {
+  uint16_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return swapped ? __builtin_bswap16(value) : value;
+}
+
+static inline uint32_t replay_u32(const uint8_t *restrict bytes,
+                                  bool swapped) {
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return swapped ? __builtin_bswap32(value) : value;
+}
+
+static inline uint16_t replay_be16(const uint8_t *restrict bytes) {
+  return (uint16_t)((unsigned)bytes[0] << 8 | bytes[1]);
+}
+
+/* ---- Records ---- */
+
+static bool replay_link_supported(uint32_t linktype) {
+  switch (linktype) {
+  case REPLAY_LINK_NULL:
+  case REPLAY_LINK_ETHERNET:
+  case REPLAY_LINK_RAW:
+  case REPLAY_LINK_LOOP:
+  case REPLAY_LINK_SLL:
+  case REPLAY_LINK_IPV4:
+  case REPLAY_LINK_IPV6:
+  case REPLAY_LINK_SLL2:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* if_tsresol: 10^-n seconds, or 2^-n with the top bit set. */
+static bool replay_tsresol_valid(uint8_t tsresol) {
+  uint8_t exponent = tsresol & (uint8_t)~REPLAY_TSRESOL_BINARY;
+  return (tsresol & REPLAY_TSRESOL_BINARY) != 0 ? exponent < 64
+                                                 : exponent <= 19;
+}
+
+static uint64_t replay_ts_ns(uint64_t ts, uint8_t tsresol) {
+  if (tsresol == REPLAY_TSRESOL_NS) {
+    return ts;
+  }
+  if (tsresol == REPLAY_TSRESOL_US) {
+    return ts * REPLAY_NS_PER_US;
+  }
+  unsigned exponent = tsresol & ~REPLAY_TSRESOL_BINARY;
+  if ((tsresol & REPLAY_TSRESOL_BINARY) != 0) {
+    /* Seconds apart so the fraction times 10^9 stays within 64 bits. */
+    uint64_t seconds = ts >> exponent;
+    uint64_t fraction = ts - (seconds << exponent);
+    unsigned shift = exponent;
+    if (shift > 30) {
+      fraction >>= shift - 30;
+      shift = 30;
+    }
+    return seconds * REPLAY_NS_PER_SEC +
+           ((fraction * REPLAY_NS_PER_SEC) >> shift);
+  }
+  for (unsigned i = exponent; i < REPLAY_TSRESOL_NS; i++) {
+    ts *= 10;
+  }
+  for (unsigned i = REPLAY_TSRESOL_NS; i < exponent; i++) {
+    ts /= 10;
+  }
+  return ts;
+}
+
+/* Strips the link layer; NULL when the frame carries no IPv4 or IPv6. */
+static const uint8_t *replay_network_layer(uint32_t linktype,
+                                           const uint8_t *restrict frame,
+                                           size_t *restrict length) {
+  size_t offset = 0;
+  uint16_t ethertype = REPLAY_ETHERTYPE_IPV4;
+  switch (linktype) {
+  case REPLAY_LINK_RAW:
+  case REPLAY_LINK_IPV4:
+  case REPLAY_LINK_IPV6:
+    break;
+  case REPLAY_LINK_NULL:
+  case REPLAY_LINK_LOOP:
+    offset = 4;
+    break;
+  case REPLAY_LINK_ETHERNET:
+    offset = 12;
+    for (unsigned tags = 0;; tags++) {
+      if (*length < offset + 2) {
+        return NULL;
+      }
+      ethertype = replay_be16(frame + offset);
+      offset += 2;
+      if ((ethertype != REPLAY_ETHERTYPE_VLAN &&
+           ethertype != REPLAY_ETHERTYPE_QINQ) ||
+          tags == REPLAY_MAX_VLAN_TAGS) {
+        break;
+      }
+      offset += 2; /* tag control */
+    }
+    break;
+  case REPLAY_LINK_SLL:
+    if (*length < 16) {
+      return NULL;
+    }
+    ethertype = replay_be16(frame + 14);
+    offset = 16;
+    break;
+  case REPLAY_LINK_SLL2:
+    if (*length < 20) {
+      return NULL;
+    }
+    ethertype = replay_be16(frame);
+    offset = 20;
+    break;
+  default:
+    return NULL;
+  }
+  if ((ethertype != REPLAY_ETHERTYPE_IPV4 &&
+       ethertype != REPLAY_ETHERTYPE_IPV6) ||
+      *length <= offset) {
+    return NULL;
+  }
+  unsigned version = frame[offset] >> 4;
+  if (version != 4 && version != 6) {
+    return NULL;
+  }
+  *length -= offset;
+  return frame + offset;
+}
+
+static replay_next_t replay_next_pcap(const replay_capture_t *restrict capture,
+                                      replay_cursor_t *restrict cursor,
+                                      replay_packet_t *restrict packet) {
+  size_t remaining = capture->size - cursor->offset;
+  if (remaining < REPLAY_PCAP_RECORD) {
+    return REPLAY_NEXT_END;
+  }
+  const uint8_t *record = capture->data + cursor->offset;
+  uint32_t caplen = replay_u32(record + 8, cursor->swapped);
+  if (caplen > REPLAY_MAX_CAPLEN) {
+    return REPLAY_NEXT_ERROR;
+  }
+  if (caplen > remaining - REPLAY_PCAP_RECORD) {
+    return REPLAY_NEXT_END;
+  }
+  packet->offset = cursor->offset;
+  uint64_t seconds = replay_u32(record, cursor->swapped);
+  uint64_t fraction = replay_u32(record + 4, cursor->swapped);
+  packet->ts_ns = seconds * REPLAY_NS_PER_SEC +
+                  replay_ts_ns(fraction, cursor->ifaces[0].tsresol);
+  packet->length = caplen;
+  packet->ip = replay_network_layer(cursor->ifaces[0].linktype,
+                                    record + REPLAY_PCAP_RECORD,
+                                    &packet->length);
+  cursor->offset += REPLAY_PCAP_RECORD + caplen;
+  return REPLAY_NEXT_PACKET;
+}
+
+static bool replay_pcapng_idb(replay_cursor_t *restrict cursor,
+                              const uint8_t *restrict body, size_t body_len) {
+  if (body_len < REPLAY_PCAPNG_IDB_FIELDS) {
+    return false;
+  }
+  replay_iface_t iface = {
+      .linktype = replay_u16(body, cursor->swapped),
+      .tsresol = REPLAY_TSRESOL_US,
+  };
+  size_t offset = REPLAY_PCAPNG_IDB_FIELDS;
+  while (offset + 4 <= body_len) {
+    uint16_t code = replay_u16(body + offset, cursor->swapped);
+    uint16_t length = replay_u16(body + offset + 2, cursor->swapped);
+    offset += 4;
+    if (code == REPLAY_OPT_END || length > body_len - offset) {
+      break;
+    }
+    if (code == REPLAY_OPT_TSRESOL && length >= 1) {
+      iface.tsresol = body[offset];
+      if (!replay_tsresol_valid(iface.tsresol)) {
+        return false;
+      }
+    }
+    offset += ((size_t)length + 3) & ~(size_t)3;
+  }
+  /* Packets on interfaces past the table are skipped. */
+  if (cursor->iface_count < OPENUPS_REPLAY_MAX_IFACES) {
+    cursor->ifaces[cursor->iface_count] = iface;
+  }
+  cursor->iface_count++;
+  return true;
+}
+
+static replay_next_t replay_next_pcapng(
+    const replay_capture_t *restrict capture, replay_cursor_t *restrict cursor,
+    replay_packet_t *restrict packet) {
+  for (;;) {
+    size_t remaining = capture->size - cursor->offset;
+    if (remaining < REPLAY_PCAPNG_BLOCK_MIN) {
+      return REPLAY_NEXT_END;
+    }
+    const uint8_t *block = capture->data + cursor->offset;
+    /* The section header's type reads the same in either byte order; its
+     * byte-order magic sets the order for the rest of the section. */
+    uint32_t type = replay_u32(block, cursor->swapped);
+    if (type == REPLAY_PCAPNG_SHB) {
+      if (remaining < REPLAY_PCAPNG_SHB_MIN) {
+        return REPLAY_NEXT_END;
+      }
+      uint32_t bom = replay_u32(block + 8, false);
+      if (bom != REPLAY_PCAPNG_BOM &&
+          __builtin_bswap32(bom) != REPLAY_PCAPNG_BOM) {
+        return REPLAY_NEXT_ERROR;
+      }
+      cursor->swapped = bom != REPLAY_PCAPNG_BOM;
+      cursor->iface_count = 0;
+    }
+    uint32_t block_len = replay_u32(block + 4, cursor->swapped);
+    if (block_len < REPLAY_PCAPNG_BLOCK_MIN || block_len % 4 != 0) {
+      return REPLAY_NEXT_ERROR;
+    }
+    if (block_len > remaining) {
+      return REPLAY_NEXT_END;
+    }
+    const uint8_t *body = block + 8;
+    size_t body_len = block_len - REPLAY_PCAPNG_BLOCK_MIN;
+    packet->offset = cursor->offset;
+    cursor->offset += block_len;
+
+    if (type == REPLAY_PCAPNG_IDB) {
+      if (!replay_pcapng_idb(cursor, body, body_len)) {
+        return REPLAY_NEXT_ERROR;
+      }
+      continue;
+    }
+    if (type != REPLAY_PCAPNG_EPB && type != REPLAY_PCAPNG_OPB) {
+      continue;
+    }
+    if (body_len < REPLAY_PCAPNG_PACKET_FIELDS) {
+      return REPLAY_NEXT_ERROR;
+    }
+    uint32_t caplen = replay_u32(body + 12, cursor->swapped);
+    if (caplen > body_len - REPLAY_PCAPNG_PACKET_FIELDS) {
+      return REPLAY_NEXT_ERROR;
+    }
+    uint32_t iface = type == REPLAY_PCAPNG_EPB
+                         ? replay_u32(body, cursor->swapped)
+                         : replay_u16(body, cursor->swapped);
+    if (iface >= cursor->iface_count || iface >= OPENUPS_REPLAY_MAX_IFACES) {
+      continue;
+    }
+    uint64_t ts = (uint64_t)replay_u32(body + 4, cursor->swapped) << 32 |
+                  replay_u32(body + 8, cursor->swapped);
+    packet->ts_ns = replay_ts_ns(ts, cursor->ifaces[iface].tsresol);
+    packet->length = caplen;
+    packet->ip =
+        replay_network_layer(cursor->ifaces[iface].linktype,
+                             body + REPLAY_PCAPNG_PACKET_FIELDS,
+                             &packet->length);
+    return REPLAY_NEXT_PACKET;
+  }
+}
+
+/* ---- Capture ---- */
+
+bool replay_capture_open(replay_capture_t *restrict capture,
+                         const char *restrict path, char *restrict error_msg,
+                         size_t error_size) {
+  if (capture == NULL || path == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return false;
+  }
+  memset(capture, 0, sizeof(*capture));
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    snprintf(error_msg, error_size, "Cannot open capture %s: %s", path,
+             strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    snprintf(error_msg, error_size, "Cannot stat capture %s: %s", path,
+             strerror(errno));
+    close(fd);
+    return false;
+  }
+  if (!S_ISREG(st.st_mode) || st.st_size < (off_t)sizeof(uint32_t)) {
+    snprintf(error_msg, error_size, "%s is not a pcap or pcapng capture",
+             path);
+    close(fd);
+    return false;
+  }
+  /* Unlike target lists, captures can be many GiB: no MAP_POPULATE, but
+   * sequential read-ahead, with pages behind the cursor reclaimable. */
+  void *data =
+      mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    snprintf(error_msg, error_size, "Cannot map capture %s: %s", path,
+             strerror(errno));
+    return false;
+  }
+  (void)madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+  capture->data = data;
+  capture->size = (size_t)st.st_size;
+
+  uint32_t magic = replay_u32(capture->data, false);
+  bool swapped = false;
+  if (magic != REPLAY_PCAP_MAGIC_US && magic != REPLAY_PCAP_MAGIC_NS &&
+      magic != REPLAY_PCAPNG_SHB) {
+    magic = __builtin_bswap32(magic);
+    swapped = true;
+  }
+  if (magic == REPLAY_PCAPNG_SHB) {
+    capture->format = REPLAY_FORMAT_PCAPNG;
+    return true;
+  }
+  if (magic != REPLAY_PCAP_MAGIC_US && magic != REPLAY_PCAP_MAGIC_NS) {
+    snprintf(error_msg, error_size, "%s is not a pcap or pcapng capture",
+             path);
+    replay_capture_close(capture);
+    return false;
+  }
+  if (capture->size < REPLAY_PCAP_HEADER) {
+    snprintf(error_msg, error_size, "Capture %s: truncated file header",
+             path);
+    replay_capture_close(capture);
+    return false;
+  }
+  /* The top bits of the link type field describe the FCS, if any. */
+  uint32_t linktype = replay_u32(capture->data + 20, swapped) & 0xFFFFU;
+  if (!replay_link_supported(linktype)) {
+    snprintf(error_msg, error_size,
+             "Capture %s: link type %u is not supported", path, linktype);
+    replay_capture_close(capture);
+    return false;
+  }
+  capture->format = REPLAY_FORMAT_PCAP;
+  capture->start.offset = REPLAY_PCAP_HEADER;
+  capture->start.swapped = swapped;
+  capture->start.iface_count = 1;
+  capture->start.ifaces[0] = (replay_iface_t){
+      .linktype = linktype,
+      .tsresol = magic == REPLAY_PCAP_MAGIC_NS ? REPLAY_TSRESOL_NS
+                                               : REPLAY_TSRESOL_US,
+  };
+  return true;
+}
+
+void replay_capture_close(replay_capture_t *restrict capture) {
+  if (capture == NULL) {
+    return;
+  }
+  if (capture->data != NULL) {
+    munmap((void *)capture->data, capture->size);
+  }
+  capture->data = NULL;
+  capture->size = 0;
+}
+
+/* Advances cursor to the next captured packet.  Other blocks (section and
+ * interface headers, statistics) are consumed on the way. */
+replay_next_t replay_capture_next(const replay_capture_t *restrict capture,
+                                  replay_cursor_t *restrict cursor,
+                                  replay_packet_t *restrict packet) {
+  if (capture == NULL || cursor == NULL || packet == NULL ||
+      capture->data == NULL || cursor->offset >= capture->size) {
+    return REPLAY_NEXT_END;
+  }
+  if (capture->format == REPLAY_FORMAT_PCAP) {
+    return replay_next_pcap(capture, cursor, packet);
+  }
+  return replay_next_pcapng(capture, cursor, packet);
+}
+
+/* ---- Probe oracle ---- */
+
+/* Requests are matched on their destination here; replies go through the
+ * receive path's parser, from an aligned copy since the frame sits
+ * wherever the capture put it. */
+replay_icmp_t replay_classify(const replay_packet_t *restrict packet,
+                              const icmp_reply_key_t *restrict target,
+                              icmp_reply_key_t *restrict key) {
+  const uint8_t *ip = packet->ip;
+  size_t length = packet->length;
+  if (ip == NULL) {
+    return REPLAY_ICMP_NONE;
+  }
+  size_t header_len = 0;
+  const uint8_t *destination = NULL;
+  const uint8_t *target_addr = target->addr;
+  size_t addr_len = sizeof(target->addr);
+  uint8_t request_type = ICMP6_ECHO_REQUEST;
+  uint8_t reply_type = ICMP6_ECHO_REPLY;
+  if (target->family == AF_INET) {
+    if (ip[0] >> 4 != 4 || length < 20 || ip[9] != IPPROTO_ICMP) {
+      return REPLAY_ICMP_NONE;
+    }
+    header_len = (size_t)(ip[0] & 0x0F) * 4;
+    destination = ip + 16;
+    target_addr = target->addr + 12;
+    addr_len = 4;
+    request_type = ICMP_ECHO;
+    reply_type = ICMP_ECHOREPLY;
+  } else {
+    if (ip[0] >> 4 != 6 || length < 40 || ip[6] != IPPROTO_ICMPV6) {
+      return REPLAY_ICMP_NONE;
+    }
+    header_len = 40;
+    destination = ip + 24;
+  }
+  if (header_len < 20 || length < header_len + 8) {
+    return REPLAY_ICMP_NONE;
+  }
+
+  uint8_t type = ip[header_len];
+  if (type == request_type) {
+    if (memcmp(destination, target_addr, addr_len) != 0) {
+      return REPLAY_ICMP_NONE;
+    }
+    *key = *target;
+    key->identifier = replay_be16(ip + header_len + 4);
+    key->sequence = replay_be16(ip + header_len + 6);
+    return REPLAY_ICMP_REQUEST;
+  }
+  if (type != reply_type) {
+    return REPLAY_ICMP_NONE;
+  }
+  alignas(16) uint8_t buffer[REPLAY_PARSE_BYTES];
+  size_t copy = length < sizeof(buffer) ? length : sizeof(buffer);
+  memcpy(buffer, ip, copy);
+  if (!icmp_parse_echo_packet(buffer, copy, key) ||
+      key->family != target->family ||
+      memcmp(key->addr, target->addr, sizeof(key->addr)) != 0) {
+    return REPLAY_ICMP_NONE;
+  }
+  return REPLAY_ICMP_REPLY;
+}
+
+static void replay_set_request(replay_t *restrict replay,
+                               const icmp_reply_key_t *restrict key,
+                               size_t offset, uint64_t ts_ns,
+                               const replay_cursor_t *restrict after) {
+  if (replay->have_request && replay->request_offset == offset) {
+    return;
+  }
+  replay->have_request = true;
+  replay->resolved = false;
+  replay->request = *key;
+  replay->request_offset = offset;
+  replay->request_ns = ts_ns;
+  replay->after_request = *after;
+}
+
+/* Before the first captured request: take the first one at all. */
+static bool replay_find_first_request(replay_t *restrict replay) {
+  replay_cursor_t cursor = replay->cursor;
+  replay_packet_t packet;
+  icmp_reply_key_t key;
+  while (replay_capture_next(&replay->capture, &cursor, &packet) ==
+         REPLAY_NEXT_PACKET) {
+    if (replay_classify(&packet, &replay->target, &key) ==
+        REPLAY_ICMP_REQUEST) {
+      replay_set_request(replay, &key, packet.offset, packet.ts_ns,
+                         &cursor);
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Looks for the request's reply up to timeout_ns after it. */
+static void replay_resolve(replay_t *restrict replay, uint64_t timeout_ns) {
+  replay_cursor_t cursor = replay->after_request;
+  replay_packet_t packet;
+  icmp_reply_key_t key;
+  uint64_t deadline_ns = replay->request_ns + timeout_ns;
+  if (deadline_ns < replay->request_ns) {
+    deadline_ns = UINT64_MAX;
+  }
+  replay->resolved = true;
+  replay->answered = false;
+  while (replay_capture_next(&replay->capture, &cursor, &packet) ==
+             REPLAY_NEXT_PACKET &&
+         packet.ts_ns <= deadline_ns) {
+    if (replay_classify(&packet, &replay->target, &key) ==
+            REPLAY_ICMP_REPLY &&
+        icmp_reply_key_equal(&key, &replay->request)) {
+      replay->answered = true;
+      replay->rtt_ns = packet.ts_ns > replay->request_ns
+                           ? packet.ts_ns - replay->request_ns
+                           : 0;
+      return;
+    }
+  }
+}
+
+bool replay_open(replay_t *restrict replay, const char *restrict path,
+                 char *restrict error_msg, size_t error_size) {
+  if (replay == NULL) {
+    return false;
+  }
+  memset(replay, 0, sizeof(*replay));
+  if (!replay_capture_open(&replay->capture, path, error_msg, error_size)) {
+    return false;
+  }
+  replay->cursor = replay->capture.start;
+  replay_cursor_t cursor = replay->cursor;
+  replay_packet_t packet;
+  replay_next_t status =
+      replay_capture_next(&replay->capture, &cursor, &packet);
+  if (status != REPLAY_NEXT_PACKET) {
+    snprintf(error_msg, error_size, "Capture %s %s", path,
+             status == REPLAY_NEXT_END ? "holds no packets"
+                                       : "is malformed at its first block");
+    replay_close(replay);
+    return false;
+  }
+  replay->start_ns = packet.ts_ns;
+  return true;
+}
+
+void replay_close(replay_t *restrict replay) {
+  if (replay == NULL) {
+    return;
+  }
+  replay_capture_close(&replay->capture);
+}
+
+/* The probe at at_us (virtual, from the first packet) gets the fate of the
+ * latest captured request to target at or before it.  REPLAY_END once the
+ * capture holds nothing later than the probe, or no request at all. */
+replay_outcome_t replay_probe(replay_t *restrict replay,
+                              const struct sockaddr_storage *restrict target,
+                              uint64_t at_us, uint64_t timeout_us,
+                              uint64_t *restrict rtt_us) {
+  if (replay == NULL || target == NULL || rtt_us == NULL) {
+    return REPLAY_END;
+  }
+  icmp_reply_key_t target_key;
+  icmp_reply_key_init(&target_key, target, 0, 0);
+  if (!replay->have_target ||
+      !icmp_reply_key_equal(&target_key, &replay->target)) {
+    replay->target = target_key;
+    replay->have_target = true;
+    replay->have_request = false;
+  }
+
+  uint64_t at_ns = UINT64_MAX;
+  uint64_t timeout_ns = UINT64_MAX;
+  if (!ckd_mul(&at_ns, at_us, REPLAY_NS_PER_US) &&
+      ckd_add(&at_ns, at_ns, replay->start_ns)) {
+    at_ns = UINT64_MAX;
+  }
+  if (ckd_mul(&timeout_ns, timeout_us, REPLAY_NS_PER_US)) {
+    timeout_ns = UINT64_MAX;
+  }
+
+  /* The hot loop: every captured packet passes here exactly once.  A
+   * packet later than the probe is stepped back over: only the offset
+   * moves for packet records. */
+  replay_packet_t packet;
+  icmp_reply_key_t key;
+  replay_next_t status = REPLAY_NEXT_END;
+  bool later = false;
+  for (;;) {
+    size_t offset = replay->cursor.offset;
+    status = replay_capture_next(&replay->capture, &replay->cursor, &packet);
+    if (status != REPLAY_NEXT_PACKET) {
+      if (status == REPLAY_NEXT_ERROR && !replay->malformed) {
+        replay->malformed = true;
+        replay->error_offset = offset;
+      }
+      break;
+    }
+    if (packet.ts_ns > at_ns) {
+      replay->cursor.offset = packet.offset;
+      later = true;
+      break;
+    }
+    replay->stats.packets++;
+    replay_icmp_t kind = replay_classify(&packet, &replay->target, &key);
+    if (kind == REPLAY_ICMP_REQUEST) {
+      replay->stats.requests++;
+      replay_set_request(replay, &key, packet.offset, packet.ts_ns,
+                         &replay->cursor);
+    } else if (kind == REPLAY_ICMP_REPLY) {
+      replay->stats.replies++;
+    }
+  }
+  if (!later || (!replay->have_request && !replay_find_first_request(replay))) {
+    return REPLAY_END;
+  }
+
+  if (!replay->resolved) {
+    replay_resolve(replay, timeout_ns);
+  }
+  replay->stats.probes++;
+  if (!replay->answered) {
+    return REPLAY_LOST;
+  }
+  replay->stats.answered++;
+  *rtt_us = replay->rtt_ns / REPLAY_NS_PER_US;
+  return REPLAY_ANSWERED;
+}
+
+/* ---- History ---- */
+
+typedef struct {
+  size_t index;
+  uint16_t identifier;
+  uint16_t sequence;
+} replay_pending_t;
+
+static bool replay_history_append(replay_history_t *restrict history,
+                                  uint64_t at_ns) {
+  if (history->count == history->capacity) {
+    size_t capacity = history->capacity == 0 ? REPLAY_HISTORY_INITIAL
+                                             : history->capacity * 2;
+    replay_request_t *grown =
+        realloc(history->requests, capacity * sizeof(*grown));
+    if (grown == NULL) {
+      return false;
+    }
+    history->requests = grown;
+    history->capacity = capacity;
+  }
+  history->requests[history->count++] = (replay_request_t){
+      .at_ns = at_ns,
+      .rtt_ns = OPENUPS_REPLAY_NO_REPLY,
+  };
+  return true;
+}
+
+/* One pass over the capture: requests to target in order, each matched to
+ * the first reply with its identifier and sequence within window_ns. */
+bool replay_history_load(replay_history_t *restrict history,
+                         const char *restrict path,
+                         const struct sockaddr_storage *restrict target,
+                         uint64_t window_ns, char *restrict error_msg,
+                         size_t error_size) {
+  if (history == NULL || target == NULL) {
+    return false;
+  }
+  memset(history, 0, sizeof(*history));
+  replay_capture_t capture;
+  if (!replay_capture_open(&capture, path, error_msg, error_size)) {
+    return false;
+  }
+  icmp_reply_key_t target_key;
+  icmp_reply_key_init(&target_key, target, 0, 0);
+
+  replay_pending_t pending[REPLAY_HISTORY_PENDING];
+  size_t oldest = 0;
+  size_t pending_count = 0;
+  replay_cursor_t cursor = capture.start;
+  replay_packet_t packet;
+  icmp_reply_key_t key;
+  replay_next_t status = REPLAY_NEXT_END;
+  bool ok = true;
+  while (ok && (status = replay_capture_next(&capture, &cursor, &packet)) ==
+                   REPLAY_NEXT_PACKET) {
+    if (history->packets++ == 0) {
+      history->start_ns = packet.ts_ns;
+    }
+    uint64_t at_ns = packet.ts_ns > history->start_ns
+                         ? packet.ts_ns - history->start_ns
+                         : 0;
+    history->end_ns = at_ns > history->end_ns ? at_ns : history->end_ns;
+    while (pending_count > 0 &&
+           history->requests[pending[oldest].index].at_ns <
+               (at_ns > window_ns ? at_ns - window_ns : 0)) {
+      oldest = (oldest + 1) % REPLAY_HISTORY_PENDING;
+      pending_count--;
+    }
+
+    replay_icmp_t kind = replay_classify(&packet, &target_key, &key);
+    if (kind == REPLAY_ICMP_REQUEST) {
+      ok = replay_history_append(history, at_ns);
+      if (pending_count == REPLAY_HISTORY_PENDING) {
+        oldest = (oldest + 1) % REPLAY_HISTORY_PENDING;
+        pending_count--;
+      }
+      pending[(oldest + pending_count) % REPLAY_HISTORY_PENDING] =
+          (replay_pending_t){
+              .index = history->count - 1,
+              .identifier = key.identifier,
+              .sequence = key.sequence,
+          };
+      pending_count++;
+    } else if (kind == REPLAY_ICMP_REPLY) {
+      history->replies++;
+      /* Newest first: the reply is almost always to the last request. */
+      for (size_t i = pending_count; i > 0; i--) {
+        const replay_pending_t *entry =
+            &pending[(oldest + i - 1) % REPLAY_HISTORY_PENDING];
+        replay_request_t *request = &history->requests[entry->index];
+        if (entry->identifier == key.identifier &&
+            entry->sequence == key.sequence &&
+            request->rtt_ns == OPENUPS_REPLAY_NO_REPLY) {
+          request->rtt_ns =
+              at_ns > request->at_ns ? at_ns - request->at_ns : 0;
+          break;
+        }
+      }
+    }
+  }
+  replay_capture_close(&capture);
+  history->malformed = status == REPLAY_NEXT_ERROR;
+  if (!ok) {
+    snprintf(error_msg, error_size, "Out of memory loading %s", path);
+    replay_history_free(history);
+    return false;
+  }
+  if (history->packets == 0) {
+    snprintf(error_msg, error_size, "Capture %s holds no packets", path);
+    return false;
+  }
+  return true;
+}
+
+void replay_history_free(replay_history_t *restrict history) {
+  if (history == NULL) {
+    return;
+  }
+  free(history->requests);
+  history->requests = NULL;
+  history->count = 0;
+  history->capacity = 0;
+}
+
+/* replay_probe() over a loaded history.  *next is the caller's cursor:
+ * the first request later than the previous probe, 0 to start. */
+replay_outcome_t replay_history_probe(const replay_history_t *restrict history,
+                                      size_t *restrict next, uint64_t at_us,
+                                      uint64_t timeout_us,
+                                      uint64_t *restrict rtt_us) {
+  if (history == NULL || next == NULL || rtt_us == NULL ||
+      history->count == 0) {
+    return REPLAY_END;
+  }
+  uint64_t at_ns = UINT64_MAX;
+  if (ckd_mul(&at_ns, at_us, REPLAY_NS_PER_US) || at_ns >= history->end_ns) {
+    return REPLAY_END;
+  }
+  while (*next < history->count && history->requests[*next].at_ns <= at_ns) {
+    (*next)++;
+  }
+  const replay_request_t *request =
+      &history->requests[*next > 0 ? *next - 1 : 0];
+  uint64_t timeout_ns = UINT64_MAX;
+  if (ckd_mul(&timeout_ns, timeout_us, REPLAY_NS_PER_US)) {
+    timeout_ns = UINT64_MAX;
+  }
+  if (request->rtt_ns == OPENUPS_REPLAY_NO_REPLY ||
+      request->rtt_ns > timeout_ns) {
+    return REPLAY_LOST;
+  }
+  *rtt_us = request->rtt_ns / REPLAY_NS_PER_US;
+  return REPLAY_ANSWERED;
+}
@@ -0,0 +1,150 @@
+#ifndef OPENUPS_REPLAY_H
+#define OPENUPS_REPLAY_H
+
+#include "openups.h"
+
+/* pcapng interfaces remembered per section; packets on later ones are
+ * skipped. */
+#define OPENUPS_REPLAY_MAX_IFACES 16U
+
+typedef enum {
+  REPLAY_FORMAT_PCAP = 0,
+  REPLAY_FORMAT_PCAPNG = 1,
+} replay_format_t;
+
+/* Link type and timestamp resolution of one capture interface. */
+typedef struct {
+  uint32_t linktype;
+  uint8_t tsresol; /* pcapng if_tsresol: 10^-n, or 2^-n with the top bit */
+} replay_iface_t;
+
+/* Read position in a capture.  Copies are independent, so a lookahead
+ * scan never moves the main cursor. */
+typedef struct {
+  size_t offset;
+  bool swapped; /* the current section's byte order differs from ours */
+  uint32_t iface_count;
+  replay_iface_t ifaces[OPENUPS_REPLAY_MAX_IFACES];
+} replay_cursor_t;
+
+/* One captured frame, its network layer located (NULL when not IP). */
+typedef struct {
+  size_t offset; /* start of its record */
+  uint64_t ts_ns;
+  const uint8_t *ip;
+  size_t length; /* captured bytes from the network layer on */
+} replay_packet_t;
+
+typedef enum {
+  REPLAY_NEXT_ERROR = -1,
+  REPLAY_NEXT_END = 0, /* also a record cut short by the end of the file */
+  REPLAY_NEXT_PACKET = 1,
+} replay_next_t;
+
+/* A capture file mapped read-only and read front to back. */
+typedef struct {
+  const uint8_t *data;
+  size_t size;
+  replay_format_t format;
+  replay_cursor_t start; /* first record */
+} replay_capture_t;
+
+typedef enum {
+  REPLAY_ICMP_NONE = 0,
+  REPLAY_ICMP_REQUEST = 1, /* echo request to the target */
+  REPLAY_ICMP_REPLY = 2,   /* echo reply from the target */
+} replay_icmp_t;
+
+typedef enum {
+  REPLAY_LOST = 0,
+  REPLAY_ANSWERED = 1,
+  REPLAY_END = 2, /* the probe is past the last captured request */
+} replay_outcome_t;
+
+typedef struct {
+  uint64_t packets;  /* records the main cursor passed */
+  uint64_t requests; /* echo requests to the target */
+  uint64_t replies;  /* echo replies from the target */
+  uint64_t probes;   /* probes answered from the capture */
+  uint64_t answered;
+} replay_stats_t;
+
+/* Answers each probe at virtual time t (0 = first captured packet) with
+ * the fate of the latest captured echo request to the same target at or
+ * before t: answered when its reply (same identifier and sequence, parsed
+ * by icmp_parse_echo_packet) arrived within the probe timeout, with the
+ * captured round-trip time.  Probing at a different interval than the
+ * capture samples the path state the capture recorded. */
+typedef struct {
+  replay_capture_t capture;
+  replay_cursor_t cursor; /* first record later than the last probe */
+  uint64_t start_ns;
+  icmp_reply_key_t target; /* identifier and sequence unused */
+  bool have_target;
+  bool have_request;
+  bool resolved; /* request's fate known: answered and rtt_ns */
+  bool answered;
+  icmp_reply_key_t request;
+  size_t request_offset;
+  uint64_t request_ns;
+  uint64_t rtt_ns;
+  replay_cursor_t after_request;
+  bool malformed; /* stopped at a corrupt record at error_offset */
+  size_t error_offset;
+  replay_stats_t stats;
+} replay_t;
+
+[[nodiscard]] bool replay_capture_open(replay_capture_t *restrict capture,
+                                       const char *restrict path,
+                                       char *restrict error_msg,
+                                       size_t error_size);
+void replay_capture_close(replay_capture_t *restrict capture);
+replay_next_t replay_capture_next(const replay_capture_t *restrict capture,
+                                  replay_cursor_t *restrict cursor,
+                                  replay_packet_t *restrict packet);
+
+/* The target's echo requests in a capture, each with the round-trip time
+ * of its reply, for evaluating many configurations against one capture
+ * without reading it again. */
+#define OPENUPS_REPLAY_NO_REPLY UINT64_MAX
+
+typedef struct {
+  uint64_t at_ns;  /* from the first captured packet */
+  uint64_t rtt_ns; /* OPENUPS_REPLAY_NO_REPLY: none within the window */
+} replay_request_t;
+
+typedef struct {
+  replay_request_t *requests;
+  size_t count;
+  size_t capacity;
+  uint64_t start_ns; /* first captured packet */
+  uint64_t end_ns;   /* last one, from start_ns */
+  uint64_t packets;
+  uint64_t replies;
+  bool malformed;
+} replay_history_t;
+
+replay_icmp_t replay_classify(const replay_packet_t *restrict packet,
+                              const icmp_reply_key_t *restrict target,
+                              icmp_reply_key_t *restrict key);
+
+[[nodiscard]] bool replay_open(replay_t *restrict replay,
+                               const char *restrict path,
+                               char *restrict error_msg, size_t error_size);
+void replay_close(replay_t *restrict replay);
+replay_outcome_t replay_probe(replay_t *restrict replay,
+                              const struct sockaddr_storage *restrict target,
+                              uint64_t at_us, uint64_t timeout_us,
+                              uint64_t *restrict rtt_us);
+
+[[nodiscard]] bool replay_history_load(
+    replay_history_t *restrict history, const char *restrict path,
+    const struct sockaddr_storage *restrict target, uint64_t window_ns,
+    char *restrict error_msg, size_t error_size);
+void replay_history_free(replay_history_t *restrict history);
+replay_outcome_t replay_history_probe(const replay_history_t *restrict history,
+                                      size_t *restrict next, uint64_t at_us,
+                                      uint64_t timeout_us,
+                                      uint64_t *restrict rtt_us);
+
+#endif // OPENUPS_REPLAY_H
@@ -0,0 +1,344 @@
+#include "sim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Sequence 0 is the reactor's "not waiting" sentinel. */
+static uint16_t sim_next_sequence(uint16_t sequence) {
+  sequence = (uint16_t)(sequence + 1);
+  return sequence == 0 ? 1 : sequence;
+}
+
+static void sim_apply_script(sim_t *restrict sim) {
+  const netem_script_t *script = sim->script;
+  while (script != NULL && sim->next_step < script->count &&
+         script->steps[sim->next_step].at_us <= sim->now_us) {
+    netem_model_set(&sim->model, &script->steps[sim->next_step].impair);
+    logger_debug(&sim->ctx->logger, "Sim: script step %zu applied",
+                 sim->next_step + 1);
+    sim->next_step++;
+  }
+}
+
+/* ---- Clock and poll ---- */
+
+static uint64_t sim_now_ms(void *backend_ctx) {
+  const sim_t *sim = backend_ctx;
+  return sim->now_us / OPENUPS_US_PER_MS;
+}
+
+static int sim_poll(void *backend_ctx, struct pollfd *fds, nfds_t nfds,
+                    int timeout_ms) {
+  sim_t *sim = backend_ctx;
+  sim->stats.ticks++;
+  if (sim->now_us >= sim->end_us) {
+    sim->stats.exhausted = true;
+    sim->ctx->stop_flag = 1;
+    return 0;
+  }
+  /* The reactor computed timeout_ms against the millisecond clock. */
+  uint64_t wake_us = sim->end_us;
+  if (timeout_ms >= 0) {
+    uint64_t timeout_us =
+        (sim->now_us / OPENUPS_US_PER_MS + (uint64_t)timeout_ms) *
+        OPENUPS_US_PER_MS;
+    wake_us = timeout_us < wake_us ? timeout_us : wake_us;
+  }
+  wake_us = sim->reply_us < wake_us ? sim->reply_us : wake_us;
+  if (wake_us > sim->now_us) {
+    sim->now_us = wake_us;
+  }
+  int ready = 0;
+  for (nfds_t i = 0; i < nfds; i++) {
+    fds[i].revents = 0;
+    if (fds[i].fd == OPENUPS_SIM_PROBE_FD && sim->reply_us <= sim->now_us &&
+        (fds[i].events & POLLIN) != 0) {
+      fds[i].revents = POLLIN;
+      ready++;
+    }
+  }
+  return ready;
+}
+
+/* ---- Probe backend ---- */
+
+/* The captured request's fate, with its round-trip time; past the end of
+ * the capture nothing more is known and the run stops. */
+static bool sim_send_replay(sim_t *restrict sim,
+                            const struct sockaddr_storage *restrict dest_addr) {
+  uint64_t timeout_us =
+      (uint64_t)sim->ctx->config.timeout_ms * OPENUPS_US_PER_MS;
+  uint64_t rtt_us = 0;
+  replay_outcome_t outcome =
+      sim->history != NULL
+          ? replay_history_probe(sim->history, &sim->history_next,
+                                 sim->now_us, timeout_us, &rtt_us)
+          : replay_probe(sim->replay, dest_addr, sim->now_us, timeout_us,
+                         &rtt_us);
+  sim->reply_us = UINT64_MAX;
+  if (outcome == REPLAY_END) {
+    sim->end_us = sim->now_us;
+    return true;
+  }
+  sim->stats.probes++;
+  if (outcome == REPLAY_ANSWERED) {
+    sim->reply_us = sim->now_us + rtt_us;
+  }
+  return true;
+}
+
+static bool sim_send(void *backend_ctx,
+                     const struct sockaddr_storage *dest_addr,
+                     socklen_t dest_addr_len, uint16_t identifier,
+                     size_t packet_len, char *error_msg, size_t error_size) {
+  (void)dest_addr_len;
+  (void)identifier;
+  (void)packet_len;
+  (void)error_msg;
+  (void)error_size;
+  sim_t *sim = backend_ctx;
+  sim_apply_script(sim);
+  sim->sequence = sim_next_sequence(sim->sequence);
+  sim->send_us = sim->now_us;
+  if (sim->replay != NULL || sim->history != NULL) {
+    return sim_send_replay(sim, dest_addr);
+  }
+  sim->stats.probes++;
+  netem_fate_t fate = netem_model_decide(&sim->model);
+  if (fate.copies == 0) {
+    sim->reply_us = UINT64_MAX;
+    return true;
+  }
+  /* Only the first copy can match: the reactor stops waiting after it. */
+  uint64_t delay_us = fate.delay_us[0];
+  if (fate.copies == 2 && fate.delay_us[1] < delay_us) {
+    delay_us = fate.delay_us[1];
+  }
+  sim->reply_us = sim->now_us + delay_us;
+  return true;
+}
+
+static icmp_receive_status_t sim_receive(
+    void *backend_ctx, const struct sockaddr_storage *dest_addr,
+    uint16_t identifier, uint16_t expected_sequence, uint64_t send_time_ms,
+    uint64_t now_ms, ping_result_t *out_result) {
+  (void)dest_addr;
+  (void)identifier;
+  (void)send_time_ms;
+  (void)now_ms;
+  sim_t *sim = backend_ctx;
+  if (sim->reply_us > sim->now_us) {
+    return ICMP_RECEIVE_NO_MORE;
+  }
+  sim->reply_us = UINT64_MAX;
+  sim->stats.replies++;
+  if (expected_sequence != sim->sequence) {
+    return ICMP_RECEIVE_IGNORED;
+  }
+  /* Exact, unlike the millisecond reactor clock. */
+  out_result->success = true;
+  out_result->latency_ms =
+      (double)(sim->now_us - sim->send_us) / (double)OPENUPS_US_PER_MS;
+  out_result->error_msg[0] = '\0';
+  out_result->reply_ttl = 0;
+  return ICMP_RECEIVE_MATCHED;
+}
+
+static uint16_t sim_sequence(const void *backend_ctx) {
+  const sim_t *sim = backend_ctx;
+  return sim->sequence;
+}
+
+static int sim_poll_fd(const void *backend_ctx) {
+  (void)backend_ctx;
+  return OPENUPS_SIM_PROBE_FD;
+}
+
+static short sim_poll_events(const void *backend_ctx) {
+  (void)backend_ctx;
+  return POLLIN;
+}
+
+static void sim_cancel(void *backend_ctx) {
+  sim_t *sim = backend_ctx;
+  sim->reply_us = UINT64_MAX;
+}
+
+static void sim_destroy(void *backend_ctx) { (void)backend_ctx; }
+
+/* ---- systemd ---- */
+
+static bool sim_notify(void *backend_ctx) {
+  (void)backend_ctx;
+  return true;
+}
+
+static bool sim_notify_status(void *backend_ctx, const char *status) {
+  (void)status;
+  sim_t *sim = backend_ctx;
+  sim->stats.status_updates++;
+  return true;
+}
+
+static bool sim_store_fd(void *backend_ctx, int fd, const char *name) {
+  (void)backend_ctx;
+  (void)fd;
+  (void)name;
+  return true;
+}
+
+static bool sim_watchdog(void *backend_ctx) {
+  sim_t *sim = backend_ctx;
+  sim->stats.watchdog_kicks++;
+  return true;
+}
+
+/* WATCHDOG_USEC / 2, as systemd_notifier_watchdog_interval_ms(). */
+static uint64_t sim_watchdog_interval_ms(const void *backend_ctx) {
+  const sim_t *sim = backend_ctx;
+  return sim->watchdog_ms / 2 > 0 ? sim->watchdog_ms / 2 : 1;
+}
+
+static void sim_services_destroy(void *backend_ctx) { (void)backend_ctx; }
+
+/* ---- Public API ---- */
+
+void sim_init(sim_t *restrict sim, const sim_options_t *restrict options) {
+  if (sim == NULL || options == NULL) {
+    return;
+  }
+  memset(sim, 0, sizeof(*sim));
+  netem_model_init(&sim->model, &options->impair, options->seed);
+  sim->script = options->script;
+  sim->replay = options->replay;
+  sim->history = options->history;
+  sim->reply_us = UINT64_MAX;
+  sim->watchdog_ms = options->watchdog_ms;
+  uint64_t end_ms = UINT64_MAX;
+  if (ckd_add(&end_ms, options->start_ms, options->duration_ms) ||
+      ckd_mul(&sim->end_us, end_ms, OPENUPS_US_PER_MS)) {
+    sim->end_us = UINT64_MAX;
+  }
+  if (ckd_mul(&sim->now_us, options->start_ms, OPENUPS_US_PER_MS)) {
+    sim->now_us = sim->end_us;
+  }
+}
+
+void sim_io(sim_t *restrict sim, reactor_io_t *restrict io) {
+  if (sim == NULL || io == NULL) {
+    return;
+  }
+  *io = (reactor_io_t){
+      .backend_ctx = sim,
+      .now_ms = sim_now_ms,
+      .poll = sim_poll,
+  };
+}
+
+/* Labels follow the configured kind so traces read like production. */
+void sim_probe(sim_t *restrict sim, probe_kind_t kind,
+               probe_backend_t *restrict probe) {
+  if (sim == NULL || probe == NULL) {
+    return;
+  }
+  memset(probe, 0, sizeof(*probe));
+  probe->kind = kind;
+  switch (kind) {
+  case PROBE_KIND_TCP:
+    probe->label = "TCP";
+    probe->description = "TCP connect probe";
+    break;
+  case PROBE_KIND_UDP:
+    probe->label = "UDP";
+    probe->description = "UDP request";
+    break;
+  case PROBE_KIND_ICMP:
+  default:
+    probe->label = "ICMP";
+    probe->description = "ICMP echo";
+    break;
+  }
+  probe->backend_ctx = sim;
+  probe->socket_errors_are_results = false;
+  probe->send = sim_send;
+  probe->receive = sim_receive;
+  probe->sequence = sim_sequence;
+  probe->poll_fd = sim_poll_fd;
+  probe->poll_events = sim_poll_events;
+  probe->cancel = sim_cancel;
+  probe->destroy = sim_destroy;
+}
+
+/* systemd as seen by the reactor, with a watchdog of sim->watchdog_ms. */
+void sim_services(sim_t *restrict sim, runtime_services_t *restrict services) {
+  if (sim == NULL || services == NULL) {
+    return;
+  }
+  *services = (runtime_services_t){
+      .backend_ctx = sim,
+      .enabled = true,
+      .ready = sim_notify,
+      .status = sim_notify_status,
+      .stopping = sim_notify,
+      .reloading = sim_notify,
+      .store_fd = sim_store_fd,
+      .watchdog = sim_watchdog,
+      .watchdog_interval_ms = sim_watchdog_interval_ms,
+      .destroy = sim_services_destroy,
+  };
+}
+
+/* Runs the single-target reactor against the simulator.  Features that
+ * need real sockets or a real host (systemd, route watch, path MTU, hop
+ * sweeps, checkpoints, low-latency mode) are switched off, and true-off
+ * becomes dry-run; options->watchdog_ms stands in for systemd with
+ * sim_services().  Returns the reactor's exit code, or
+ * OPENUPS_SIM_EXIT_SETUP. */
+int sim_run(const sim_options_t *restrict options,
+            const config_t *restrict config, sim_stats_t *restrict stats,
+            char *restrict error_msg, size_t error_size) {
+  if (options == NULL || config == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return OPENUPS_SIM_EXIT_SETUP;
+  }
+  config_t sim_config = *config;
+  sim_config.enable_systemd = false;
+  sim_config.enable_netlink = false;
+  sim_config.enable_pmtu = false;
+  sim_config.enable_hops = false;
+  sim_config.state_file[0] = '\0';
+  sim_config.low_latency = false;
+  sim_config.cpu = -1;
+  sim_config.rt_priority = 0;
+  if (sim_config.shutdown_mode == SHUTDOWN_MODE_TRUE_OFF) {
+    sim_config.shutdown_mode = SHUTDOWN_MODE_DRY_RUN;
+  }
+
+  sim_t sim;
+  openups_ctx_t ctx;
+  sim_init(&sim, options);
+  reactor_io_t io;
+  probe_backend_t probe;
+  sim_io(&sim, &io);
+  sim_probe(&sim, sim_config.probe_kind, &probe);
+  sim.ctx = &ctx;
+  if (!openups_ctx_init_io(&ctx, &sim_config, &io, &probe, error_msg,
+                           error_size)) {
+    openups_ctx_destroy(&ctx);
+    return OPENUPS_SIM_EXIT_SETUP;
+  }
+  ctx.host_seed = options->seed;
+  if (options->watchdog_ms > 0) {
+    sim_services(&sim, &ctx.services);
+  }
+
+  uint64_t start_us = get_monotonic_us();
+  int exit_code = openups_reactor_run(&ctx);
+  if (stats != NULL) {
+    *stats = sim.stats;
+    stats->virtual_ms = sim.now_us / OPENUPS_US_PER_MS;
+    stats->wall_us = get_monotonic_us() - start_us;
+  }
+  openups_ctx_destroy(&ctx);
+  return exit_code;
+}
@@ -0,0 +1,68 @@
+#ifndef OPENUPS_SIM_H
+#define OPENUPS_SIM_H
+
+#include "monitor.h"
+#include "netem.h"
+#include "replay.h"
+
+#include <limits.h>
+
+/* Stands in for the probe socket; only the simulated poll ever sees it. */
+#define OPENUPS_SIM_PROBE_FD INT_MAX
+#define OPENUPS_SIM_EXIT_SETUP 125
+
+typedef struct {
+  uint64_t ticks;   /* reactor iterations, one simulated poll each */
+  uint64_t probes;  /* probes sent */
+  uint64_t replies; /* replies delivered */
+  uint64_t virtual_ms;
+  uint64_t wall_us;
+  uint64_t watchdog_kicks; /* with sim_options_t.watchdog_ms */
+  uint64_t status_updates;
+  bool exhausted; /* ran to the end rather than shutting down */
+} sim_stats_t;
+
+typedef struct {
+  netem_impair_t impair;
+  const netem_script_t *script; /* NULL: impair holds for the whole run */
+  uint64_t seed;                /* loss/delay draws and the probe phase */
+  uint64_t start_ms; /* virtual time of the first tick */
+  uint64_t duration_ms;
+  /* Non-NULL: fates come from a capture, not impair. */
+  replay_t *replay;
+  const replay_history_t *history;
+  /* Emulated systemd WatchdogSec, 0 = no systemd: notifications are
+   * counted in sim_stats_t instead of sent. */
+  uint64_t watchdog_ms;
+} sim_options_t;
+
+/* The reactor's clock, poll and probe backend in virtual time: each poll
+ * jumps to the earliest of its timeout, the pending reply and the end of
+ * the run, so the FSM sees the same inputs on every run with one seed. */
+typedef struct {
+  openups_ctx_t *ctx;
+  netem_model_t model;
+  const netem_script_t *script;
+  replay_t *replay;
+  const replay_history_t *history;
+  size_t history_next;
+  size_t next_step;
+  uint64_t now_us;
+  uint64_t end_us;
+  uint64_t send_us;
+  uint64_t reply_us; /* UINT64_MAX: nothing in flight */
+  uint64_t watchdog_ms;
+  uint16_t sequence;
+  sim_stats_t stats;
+} sim_t;
+
+void sim_init(sim_t *restrict sim, const sim_options_t *restrict options);
+void sim_io(sim_t *restrict sim, reactor_io_t *restrict io);
+void sim_probe(sim_t *restrict sim, probe_kind_t kind,
+               probe_backend_t *restrict probe);
+void sim_services(sim_t *restrict sim, runtime_services_t *restrict services);
+int sim_run(const sim_options_t *restrict options,
+            const config_t *restrict config, sim_stats_t *restrict stats,
+            char *restrict error_msg, size_t error_size);
+
+#endif // OPENUPS_SIM_H
@@ -0,0 +1,113 @@
+#include "openups.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool state_store_open(state_store_t *restrict store, const char *restrict path,
+                      char *restrict error_msg, size_t error_size) {
+  if (store == NULL || path == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+
+  store->fd = -1;
+  store->record = NULL;
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+  if (fd < 0) {
+    snprintf(error_msg, error_size, "Failed to open state file %s: %s", path,
+             strerror(errno));
+    return false;
+  }
+
+  /* A record of the wrong size is from another build: start it over. */
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      ((size_t)st.st_size != sizeof(state_checkpoint_t) &&
+       (ftruncate(fd, 0) != 0 ||
+        ftruncate(fd, (off_t)sizeof(state_checkpoint_t)) != 0))) {
+    snprintf(error_msg, error_size, "Failed to size state file %s: %s", path,
+             strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(NULL, sizeof(state_checkpoint_t),
+                       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    snprintf(error_msg, error_size, "Failed to map state file %s: %s", path,
+             strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  store->fd = fd;
+  store->record = (state_checkpoint_t *)mapping;
+  return true;
+}
+
+void state_store_close(state_store_t *restrict store) {
+  if (store == NULL) {
+    return;
+  }
+
+  if (store->record != NULL) {
+    (void)munmap(store->record, sizeof(state_checkpoint_t));
+    store->record = NULL;
+  }
+  if (store->fd >= 0) {
+    close(store->fd);
+    store->fd = -1;
+  }
+}
+
+bool state_store_read(const state_store_t *restrict store,
+                      state_checkpoint_t *restrict out) {
+  if (store == NULL || store->record == NULL || out == NULL) {
+    return false;
+  }
+
+  uint32_t before =
+      __atomic_load_n(&store->record->generation, __ATOMIC_ACQUIRE);
+  if ((before & 1U) != 0 || before == 0) {
+    return false;
+  }
+  memcpy(out, store->record, sizeof(*out));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  uint32_t after =
+      __atomic_load_n(&store->record->generation, __ATOMIC_RELAXED);
+  return before == after && out->magic == OPENUPS_STATE_MAGIC &&
+         out->version == OPENUPS_STATE_VERSION &&
+         memchr(out->target, '\0', sizeof(out->target)) != NULL;
+}
+
+void state_store_write(state_store_t *restrict store,
+                       const state_checkpoint_t *restrict checkpoint) {
+  if (store == NULL || store->record == NULL || checkpoint == NULL) {
+    return;
+  }
+
+  uint32_t generation =
+      __atomic_load_n(&store->record->generation, __ATOMIC_RELAXED);
+  if ((generation & 1U) != 0) {
+    generation++; /* previous writer died mid-update */
+  }
+
+  uint32_t committed = generation + 2U;
+  if (committed == 0) {
+    committed = 2U; /* 0 means "never written" */
+  }
+
+  state_checkpoint_t record = *checkpoint;
+  record.magic = OPENUPS_STATE_MAGIC;
+  record.version = OPENUPS_STATE_VERSION;
+  record.generation = generation + 1U;
+  __atomic_store_n(&store->record->generation, generation + 1U,
+                   __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(store->record, &record, sizeof(record));
+  __atomic_store_n(&store->record->generation, committed, __ATOMIC_RELEASE);
+}
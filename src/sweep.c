@@ -0,0 +1,612 @@
+#define _GNU_SOURCE /* ppoll */
+#include "sweep.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SWEEP_RECV_BUFFER_BYTES (4 * 1024 * 1024)
+/* Sends allowed back-to-back to catch up after a stall; beyond that the
+ * lost time is forgiven rather than turned into a burst. */
+#define SWEEP_BURST 16U
+#define SWEEP_IDLE_WAIT_US UINT64_C(1000000)
+#define SWEEP_NS_PER_US UINT64_C(1000)
+#define SWEEP_US_PER_MS UINT64_C(1000)
+#define SWEEP_US_PER_SEC UINT64_C(1000000)
+
+/* ---- Target source ---- */
+
+/* A regular file (or stdin redirected from one) is mapped; anything else
+ * is read through stdio.  Takes ownership of fd. */
+static bool sweep_source_attach(sweep_source_t *restrict source, int fd,
+                                char *restrict error_msg, size_t error_size) {
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    bool mapped =
+        target_map_fd(&source->map, fd, source->path, error_msg, error_size);
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    if (mapped) {
+      target_scan_init(&source->scan, source->map.data, source->map.size);
+    }
+    return mapped;
+  }
+  source->file = fd == STDIN_FILENO ? stdin : fdopen(fd, "r");
+  if (source->file == NULL) {
+    snprintf(error_msg, error_size, "Cannot open targets file %s: %s",
+             source->path, strerror(errno));
+    close(fd);
+    return false;
+  }
+  return true;
+}
+
+bool sweep_source_open(sweep_source_t *restrict source,
+                       const char *restrict path, char *restrict error_msg,
+                       size_t error_size) {
+  if (source == NULL || path == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  memset(source, 0, sizeof(*source));
+  if (strcmp(path, "-") == 0) {
+    source->path = "<stdin>";
+    return sweep_source_attach(source, STDIN_FILENO, error_msg, error_size);
+  }
+  source->path = path;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    snprintf(error_msg, error_size, "Cannot open targets file %s: %s", path,
+             strerror(errno));
+    return false;
+  }
+  return sweep_source_attach(source, fd, error_msg, error_size);
+}
+
+void sweep_source_close(sweep_source_t *restrict source) {
+  if (source == NULL) {
+    return;
+  }
+  if (source->file != NULL && source->file != stdin) {
+    fclose(source->file);
+  }
+  source->file = NULL;
+  target_map_close(&source->map);
+  target_scan_init(&source->scan, NULL, 0);
+}
+
+static uint32_t sweep_load_be32(const uint8_t *bytes) {
+  return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 |
+         (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+static void sweep_store_be32(uint8_t *bytes, uint32_t value) {
+  bytes[0] = (uint8_t)(value >> 24);
+  bytes[1] = (uint8_t)(value >> 16);
+  bytes[2] = (uint8_t)(value >> 8);
+  bytes[3] = (uint8_t)value;
+}
+
+/* Host bits are already cleared by the parser; IPv4 blocks larger than a
+ * /31 skip their network and broadcast addresses. */
+static bool sweep_source_begin_block(sweep_source_t *restrict source,
+                                     const target_entry_t *restrict block) {
+  unsigned bits = block->family == AF_INET6 ? 128U : 32U;
+  unsigned host_bits = bits - block->prefix;
+  if (host_bits > OPENUPS_SWEEP_MAX_BLOCK_BITS) {
+    return false;
+  }
+  memcpy(source->base, block->bytes, sizeof(source->base));
+  source->family = block->family;
+  source->next = 0;
+  source->end = UINT32_C(1) << host_bits;
+  if (block->family == AF_INET && host_bits >= 2) {
+    source->next = 1;
+    source->end -= 1;
+  }
+  return true;
+}
+
+/* Next non-blank token from the mapping or from stdio. */
+static sweep_source_status_t sweep_source_token(
+    sweep_source_t *restrict source, const char **restrict token,
+    size_t *restrict length, char *restrict error_msg, size_t error_size) {
+  if (source->file == NULL) {
+    if (!target_scan_next(&source->scan, token, length)) {
+      return SWEEP_SOURCE_END;
+    }
+    source->line_no = (int)source->scan.line_no;
+    return SWEEP_SOURCE_TARGET;
+  }
+  for (;;) {
+    if (fgets(source->line, sizeof(source->line), source->file) == NULL) {
+      if (ferror(source->file)) {
+        snprintf(error_msg, error_size, "Failed to read %s", source->path);
+        return SWEEP_SOURCE_ERROR;
+      }
+      return SWEEP_SOURCE_END;
+    }
+    source->line_no++;
+    size_t line_length = strlen(source->line);
+    if (line_length > 0 && source->line[line_length - 1] != '\n' &&
+        !feof(source->file)) {
+      snprintf(error_msg, error_size, "%s:%d: line too long", source->path,
+               source->line_no);
+      return SWEEP_SOURCE_ERROR;
+    }
+    *length = target_line_token(source->line, line_length, token);
+    if (*length > 0) {
+      return SWEEP_SOURCE_TARGET;
+    }
+  }
+}
+
+static void sweep_source_emit(sweep_source_t *restrict source,
+                              fleet_target_t *restrict out) {
+  memset(out, 0, sizeof(*out));
+  uint8_t bytes[16];
+  memcpy(bytes, source->base, sizeof(bytes));
+  size_t length = source->family == AF_INET6 ? 16U : 4U;
+  uint8_t *low = bytes + length - 4U;
+  sweep_store_be32(low, sweep_load_be32(low) + source->next);
+  source->next++;
+
+  if (source->family == AF_INET6) {
+    struct sockaddr_in6 *addr = (struct sockaddr_in6 *)&out->addr;
+    addr->sin6_family = AF_INET6;
+    memcpy(&addr->sin6_addr, bytes, length);
+    out->addr_len = sizeof(*addr);
+  } else {
+    struct sockaddr_in *addr = (struct sockaddr_in *)&out->addr;
+    addr->sin_family = AF_INET;
+    memcpy(&addr->sin_addr, bytes, length);
+    out->addr_len = sizeof(*addr);
+  }
+  (void)inet_ntop(source->family, bytes, out->name, sizeof(out->name));
+}
+
+/* Same line format as fleet_targets_load(), plus CIDR blocks. */
+sweep_source_status_t sweep_source_next(sweep_source_t *restrict source,
+                                        fleet_target_t *restrict out,
+                                        char *restrict error_msg,
+                                        size_t error_size) {
+  if (source == NULL || out == NULL || error_msg == NULL || error_size == 0) {
+    return SWEEP_SOURCE_ERROR;
+  }
+
+  while (source->next >= source->end) {
+    const char *token = NULL;
+    size_t length = 0;
+    sweep_source_status_t status =
+        sweep_source_token(source, &token, &length, error_msg, error_size);
+    if (status != SWEEP_SOURCE_TARGET) {
+      return status;
+    }
+
+    int shown = length >= sizeof(out->name) ? (int)sizeof(out->name) - 1
+                                            : (int)length;
+    target_entry_t entry;
+    bool parsed = target_parse(token, length, true, &entry);
+    if (memchr(token, '/', length) != NULL) {
+      if (!parsed || !sweep_source_begin_block(source, &entry)) {
+        snprintf(error_msg, error_size,
+                 "%s:%d: invalid block %.*s (prefix must leave at most %u "
+                 "host bits)",
+                 source->path, source->line_no, shown, token,
+                 OPENUPS_SWEEP_MAX_BLOCK_BITS);
+        return SWEEP_SOURCE_ERROR;
+      }
+      continue;
+    }
+
+    if (!parsed) {
+      snprintf(error_msg, error_size, "%s:%d: invalid target %.*s",
+               source->path, source->line_no, shown, token);
+      return SWEEP_SOURCE_ERROR;
+    }
+    memset(out, 0, sizeof(*out));
+    target_entry_address(&entry, &out->addr, &out->addr_len);
+    memcpy(out->name, token, length);
+    return SWEEP_SOURCE_TARGET;
+  }
+
+  sweep_source_emit(source, out);
+  return SWEEP_SOURCE_TARGET;
+}
+
+/* ---- Sweep engine ---- */
+
+/* Every probe shares one timeout, so deadlines expire in send order and
+ * the in-flight window is a plain FIFO: head is the oldest probe. */
+typedef struct {
+  uint64_t sent_us;
+  uint64_t deadline_us;
+  icmp_reply_key_t key;
+  bool pending;
+  fleet_target_t target;
+} sweep_probe_t;
+
+typedef struct {
+  const config_t *config;
+  FILE *out;
+  sweep_summary_t *summary;
+  logger_t logger;
+  uint16_t identifier;
+  icmp_pinger_t pinger4;
+  icmp_pinger_t pinger6;
+  uint8_t *send_buf; /* probe packet shared by both pingers */
+  size_t send_capacity;
+  sweep_probe_t *window;
+  uint32_t mask;
+  uint64_t head;
+  uint64_t tail;
+  fleet_reply_map_t replies;
+  arena_t arena;
+} sweep_t;
+
+typedef enum {
+  SWEEP_SEND_OK = 0,
+  SWEEP_SEND_DEFERRED = 1, /* socket buffer full: retry the same target */
+  SWEEP_SEND_FATAL = 2,
+} sweep_send_status_t;
+
+/* Enough slots for every probe sent within one timeout at the target rate,
+ * rounded up to a power of two for masking. */
+static uint32_t sweep_window_capacity(const config_t *restrict config) {
+  uint64_t wanted = (uint64_t)config->sweep_rate *
+                        (uint64_t)config->timeout_ms /
+                        OPENUPS_MS_PER_SEC +
+                    SWEEP_BURST;
+  uint32_t capacity = 16;
+  while (capacity < wanted && capacity < OPENUPS_SWEEP_MAX_IN_FLIGHT) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+static bool sweep_init(sweep_t *restrict sweep,
+                       const config_t *restrict config, FILE *out,
+                       sweep_summary_t *restrict summary,
+                       char *restrict error_msg, size_t error_size) {
+  memset(sweep, 0, sizeof(*sweep));
+  sweep->config = config;
+  sweep->out = out;
+  sweep->summary = summary;
+  sweep->pinger4.sockfd = -1;
+  sweep->pinger6.sockfd = -1;
+  sweep->identifier = (uint16_t)getpid();
+  logger_init(&sweep->logger, config->log_level,
+              config_log_timestamps_enabled(config));
+
+  uint32_t capacity = sweep_window_capacity(config);
+  sweep->send_capacity =
+      OPENUPS_PROBE_HEADER_LEN + (size_t)config->payload_size;
+  size_t total = 0;
+  if (!arena_layout_add(&total, capacity, sizeof(sweep_probe_t),
+                        alignof(sweep_probe_t)) ||
+      !fleet_reply_map_layout(&total, capacity) ||
+      !arena_layout_add(&total, sweep->send_capacity, 1,
+                        alignof(max_align_t))) {
+    snprintf(error_msg, error_size, "Sweep window too large");
+    return false;
+  }
+  if (!arena_init(&sweep->arena, total, error_msg, error_size)) {
+    return false;
+  }
+  sweep->window = arena_alloc(&sweep->arena, capacity, sizeof(sweep_probe_t),
+                              alignof(sweep_probe_t));
+  bool replies_ok =
+      fleet_reply_map_init(&sweep->replies, &sweep->arena, capacity);
+  sweep->send_buf = arena_alloc(&sweep->arena, sweep->send_capacity, 1,
+                                alignof(max_align_t));
+  if (sweep->window == NULL || !replies_ok || sweep->send_buf == NULL) {
+    snprintf(error_msg, error_size, "Sweep arena exhausted");
+    return false;
+  }
+  sweep->mask = capacity - 1U;
+  return true;
+}
+
+static void sweep_destroy(sweep_t *restrict sweep) {
+  icmp_pinger_destroy(&sweep->pinger4);
+  icmp_pinger_destroy(&sweep->pinger6);
+  arena_destroy(&sweep->arena);
+}
+
+/* Sockets are opened on first use, so an IPv4-only list never needs an
+ * IPv6 raw socket. */
+static bool sweep_open_pinger(sweep_t *restrict sweep,
+                              icmp_pinger_t *restrict pinger, int family,
+                              char *restrict error_msg, size_t error_size) {
+  if (!icmp_pinger_init(pinger, family, error_msg, error_size)) {
+    return false;
+  }
+  icmp_pinger_set_send_buffer(pinger, sweep->send_buf, sweep->send_capacity);
+  if (!icmp_pinger_filter_identifier(pinger, sweep->identifier)) {
+    logger_warn(&sweep->logger, "Sweep: identifier filter not attached");
+  }
+  int size = SWEEP_RECV_BUFFER_BYTES;
+  if (setsockopt(pinger->sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+                 sizeof(size)) != 0) {
+    (void)setsockopt(pinger->sockfd, SOL_SOCKET, SO_RCVBUF, &size,
+                     sizeof(size));
+  }
+  return true;
+}
+
+static void sweep_report_unreachable(sweep_t *restrict sweep,
+                                     const fleet_target_t *restrict target) {
+  sweep->summary->unreachable++;
+  fprintf(sweep->out, "%s is unreachable\n", target->name);
+}
+
+static sweep_send_status_t sweep_send(sweep_t *restrict sweep,
+                                      const fleet_target_t *restrict target,
+                                      uint64_t now_us,
+                                      char *restrict error_msg,
+                                      size_t error_size) {
+  int family = target->addr.ss_family;
+  icmp_pinger_t *pinger =
+      family == AF_INET6 ? &sweep->pinger6 : &sweep->pinger4;
+  if (pinger->sockfd < 0 &&
+      !sweep_open_pinger(sweep, pinger, family, error_msg, error_size)) {
+    return SWEEP_SEND_FATAL;
+  }
+
+  char send_error[128];
+  /* Only sendto() sets errno; a stale EAGAIN from sweep_receive() must not
+   * turn a validation failure into an endless deferral. */
+  errno = 0;
+  if (!icmp_pinger_send_echo(pinger, &target->addr, target->addr_len,
+                             sweep->identifier, sweep->send_capacity,
+                             send_error, sizeof(send_error))) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+      return SWEEP_SEND_DEFERRED;
+    }
+    /* Unroutable targets fail immediately, like an expired deadline. */
+    logger_debug(&sweep->logger, "Sweep: %s: %s", target->name, send_error);
+    sweep->summary->send_errors++;
+    sweep_report_unreachable(sweep, target);
+    return SWEEP_SEND_OK;
+  }
+
+  uint32_t slot = (uint32_t)(sweep->tail & sweep->mask);
+  sweep_probe_t *probe = &sweep->window[slot];
+  probe->sent_us = now_us;
+  probe->deadline_us =
+      now_us + (uint64_t)sweep->config->timeout_ms * SWEEP_US_PER_MS;
+  probe->target = *target;
+  icmp_reply_key_init(&probe->key, &target->addr, sweep->identifier,
+                      icmp_pinger_current_sequence(pinger));
+  /* Sized for the whole window, so only a duplicate key can be refused;
+   * that probe then simply expires. */
+  probe->pending = fleet_reply_map_insert(&sweep->replies, &probe->key, slot);
+  if (!probe->pending) {
+    sweep_report_unreachable(sweep, target);
+  }
+  sweep->tail++;
+  return SWEEP_SEND_OK;
+}
+
+static void sweep_receive(sweep_t *restrict sweep,
+                          const icmp_pinger_t *restrict pinger) {
+  if (pinger->sockfd < 0) {
+    return;
+  }
+  icmp_echo_reply_t replies[OPENUPS_ICMP_RECEIVE_BATCH];
+  char error_msg[128];
+  int count;
+  do {
+    count = icmp_pinger_receive_batch(pinger, replies,
+                                      OPENUPS_ICMP_RECEIVE_BATCH, error_msg,
+                                      sizeof(error_msg));
+    uint64_t now_us = get_monotonic_us();
+    for (int i = 0; i < count; i++) {
+      icmp_reply_key_t key;
+      uint32_t slot;
+      icmp_reply_key_init(&key, &replies[i].source, replies[i].identifier,
+                          replies[i].sequence);
+      if (!fleet_reply_map_take(&sweep->replies, &key, &slot)) {
+        continue; /* late, duplicate or foreign */
+      }
+      sweep_probe_t *probe = &sweep->window[slot];
+      probe->pending = false;
+      sweep->summary->alive++;
+      fprintf(sweep->out, "%s is alive (%.2f ms)\n", probe->target.name,
+              (double)(now_us - probe->sent_us) / (double)SWEEP_US_PER_MS);
+    }
+  } while (count == (int)OPENUPS_ICMP_RECEIVE_BATCH);
+  if (count < 0) {
+    logger_warn(&sweep->logger, "Sweep: %s", error_msg);
+  }
+}
+
+/* Pops answered probes and reports those whose deadline has passed. */
+static void sweep_expire(sweep_t *restrict sweep, uint64_t now_us) {
+  while (sweep->head != sweep->tail) {
+    sweep_probe_t *probe = &sweep->window[sweep->head & sweep->mask];
+    if (probe->pending) {
+      if (probe->deadline_us > now_us) {
+        return;
+      }
+      uint32_t slot;
+      (void)fleet_reply_map_take(&sweep->replies, &probe->key, &slot);
+      probe->pending = false;
+      sweep_report_unreachable(sweep, &probe->target);
+    }
+    sweep->head++;
+  }
+}
+
+bool sweep_run(const config_t *restrict config,
+               sweep_source_t *restrict source, FILE *out, int stop_fd,
+               sweep_summary_t *restrict summary, char *restrict error_msg,
+               size_t error_size) {
+  if (config == NULL || config->sweep_rate <= 0 || source == NULL ||
+      out == NULL || summary == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  memset(summary, 0, sizeof(*summary));
+  sweep_t sweep;
+  if (!sweep_init(&sweep, config, out, summary, error_msg, error_size)) {
+    sweep_destroy(&sweep);
+    return false;
+  }
+
+  uint64_t capacity = (uint64_t)sweep.mask + 1U;
+  uint64_t start_us = get_monotonic_us();
+  pacer_t pacer;
+  pacer_init(&pacer, (uint64_t)config->sweep_rate, SWEEP_BURST, start_us);
+  fleet_target_t held;
+  bool have_held = false;
+  bool source_done = false;
+  bool ok = true;
+  while (ok) {
+    uint64_t now_us = get_monotonic_us();
+    while (!source_done && pacer_wait_us(&pacer, now_us) == 0 &&
+           sweep.tail - sweep.head < capacity) {
+      if (!have_held) {
+        sweep_source_status_t status =
+            sweep_source_next(source, &held, error_msg, error_size);
+        if (status == SWEEP_SOURCE_END) {
+          source_done = true;
+          break;
+        }
+        if (status == SWEEP_SOURCE_ERROR) {
+          ok = false;
+          break;
+        }
+        have_held = true;
+        summary->targets++;
+      }
+      sweep_send_status_t sent =
+          sweep_send(&sweep, &held, now_us, error_msg, error_size);
+      if (sent == SWEEP_SEND_FATAL) {
+        ok = false;
+        break;
+      }
+      /* A deferred send still spends its token: the retry backs off by
+       * one period instead of spinning on a full socket buffer. */
+      (void)pacer_take(&pacer, now_us);
+      if (sent == SWEEP_SEND_DEFERRED) {
+        break;
+      }
+      have_held = false;
+    }
+    if (!ok) {
+      break;
+    }
+
+    sweep_receive(&sweep, &sweep.pinger4);
+    sweep_receive(&sweep, &sweep.pinger6);
+    now_us = get_monotonic_us();
+    sweep_expire(&sweep, now_us);
+    if (source_done && sweep.head == sweep.tail) {
+      break;
+    }
+    (void)fflush(out);
+
+    uint64_t wait_us = SWEEP_IDLE_WAIT_US;
+    if (!source_done && sweep.tail - sweep.head < capacity) {
+      wait_us = pacer_wait_us(&pacer, now_us);
+    }
+    if (sweep.head != sweep.tail) {
+      uint64_t deadline_us = sweep.window[sweep.head & sweep.mask].deadline_us;
+      uint64_t until_us = deadline_us > now_us ? deadline_us - now_us : 0;
+      wait_us = until_us < wait_us ? until_us : wait_us;
+    }
+    struct pollfd fds[3] = {
+        {.fd = sweep.pinger4.sockfd, .events = POLLIN},
+        {.fd = sweep.pinger6.sockfd, .events = POLLIN},
+        {.fd = stop_fd, .events = POLLIN},
+    };
+    struct timespec timeout = {
+        .tv_sec = (time_t)(wait_us / SWEEP_US_PER_SEC),
+        .tv_nsec = (long)(wait_us % SWEEP_US_PER_SEC * SWEEP_NS_PER_US),
+    };
+    if (ppoll(fds, 3, &timeout, NULL) < 0 && errno != EINTR) {
+      snprintf(error_msg, error_size, "ppoll failed: %s", strerror(errno));
+      ok = false;
+      break;
+    }
+    if ((fds[2].revents & POLLIN) != 0) {
+      summary->interrupted = true;
+      break;
+    }
+  }
+
+  (void)fflush(out);
+  summary->elapsed_us = get_monotonic_us() - start_us;
+  sweep_destroy(&sweep);
+  return ok;
+}
+
+/* One-shot entry point: results on stdout, summary through the logger.
+ * Exits 0 only when every target answered. */
+int openups_sweep_run(const config_t *restrict config) {
+  if (config == NULL) {
+    return OPENUPS_EXIT_FAILURE;
+  }
+  char error_msg[256];
+  logger_t logger;
+  logger_init(&logger, config->log_level,
+              config_log_timestamps_enabled(config));
+
+  sweep_source_t source;
+  if (!sweep_source_open(&source, config->sweep_file, error_msg,
+                         sizeof(error_msg))) {
+    logger_error(&logger, "OpenUPS failed: %s", error_msg);
+    return OPENUPS_EXIT_FAILURE;
+  }
+
+  sigset_t mask;
+  sigset_t previous_mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  if (sigprocmask(SIG_BLOCK, &mask, &previous_mask) != 0) {
+    sweep_source_close(&source);
+    logger_error(&logger, "sigprocmask failed");
+    return OPENUPS_EXIT_FAILURE;
+  }
+  int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signal_fd < 0) {
+    sweep_source_close(&source);
+    logger_error(&logger, "signalfd failed: %s", strerror(errno));
+    (void)sigprocmask(SIG_SETMASK, &previous_mask, NULL);
+    return OPENUPS_EXIT_FAILURE;
+  }
+
+  /* Results are flushed once per reactor turn, not per line. */
+  static char out_buffer[64 * 1024];
+  (void)setvbuf(stdout, out_buffer, _IOFBF, sizeof(out_buffer));
+
+  sweep_summary_t summary;
+  bool ok = sweep_run(config, &source, stdout, signal_fd, &summary, error_msg,
+                      sizeof(error_msg));
+  if (!ok) {
+    logger_error(&logger, "OpenUPS failed: %s", error_msg);
+  }
+  double seconds = (double)summary.elapsed_us / (double)SWEEP_US_PER_SEC;
+  logger_info(&logger,
+              "Sweep %s: %" PRIu64 " targets, %" PRIu64 " alive, %" PRIu64
+              " unreachable (%" PRIu64 " send errors) in %.2fs",
+              summary.interrupted ? "interrupted" : "finished", summary.targets,
+              summary.alive, summary.unreachable, summary.send_errors,
+              seconds);
+
+  sweep_source_close(&source);
+  close(signal_fd);
+  (void)sigprocmask(SIG_SETMASK, &previous_mask, NULL);
+  return ok && !summary.interrupted && summary.alive == summary.targets
+             ? OPENUPS_EXIT_SUCCESS
+             : OPENUPS_EXIT_FAILURE;
+}
@@ -0,0 +1,57 @@
+#ifndef OPENUPS_SWEEP_H
+#define OPENUPS_SWEEP_H
+
+#include "fleet.h"
+
+/* Probes awaiting a reply or their deadline; bounds memory for any list. */
+#define OPENUPS_SWEEP_MAX_IN_FLIGHT 65536U
+/* Largest block one CIDR line may expand to (/8 or /104). */
+#define OPENUPS_SWEEP_MAX_BLOCK_BITS 24U
+
+/* Streaming target reader: one line at a time, CIDR blocks expanded
+ * lazily, so memory does not grow with the length of the list.  Regular
+ * files are mapped and scanned in place; pipes go through stdio. */
+typedef struct {
+  FILE *file;       /* pipes and terminals, NULL when mapped */
+  target_map_t map; /* regular files, including a redirected stdin */
+  target_scan_t scan;
+  char line[256];   /* stdio line buffer */
+  const char *path;
+  int line_no;
+  int family;        /* of the block being expanded */
+  uint8_t base[16];  /* network address of that block */
+  uint32_t next;     /* host offset of the next address */
+  uint32_t end;      /* one past the last host offset */
+} sweep_source_t;
+
+typedef enum {
+  SWEEP_SOURCE_ERROR = -1,
+  SWEEP_SOURCE_END = 0,
+  SWEEP_SOURCE_TARGET = 1,
+} sweep_source_status_t;
+
+typedef struct {
+  uint64_t targets;
+  uint64_t alive;
+  uint64_t unreachable; /* includes send_errors */
+  uint64_t send_errors;
+  uint64_t elapsed_us;
+  bool interrupted;
+} sweep_summary_t;
+
+[[nodiscard]] bool sweep_source_open(sweep_source_t *restrict source,
+                                     const char *restrict path,
+                                     char *restrict error_msg,
+                                     size_t error_size);
+sweep_source_status_t sweep_source_next(sweep_source_t *restrict source,
+                                        fleet_target_t *restrict out,
+                                        char *restrict error_msg,
+                                        size_t error_size);
+void sweep_source_close(sweep_source_t *restrict source);
+[[nodiscard]] bool sweep_run(const config_t *restrict config,
+                             sweep_source_t *restrict source, FILE *out,
+                             int stop_fd, sweep_summary_t *restrict summary,
+                             char *restrict error_msg, size_t error_size);
+int openups_sweep_run(const config_t *restrict config);
+
+#endif // OPENUPS_SWEEP_H
@@ -1,6 +1,8 @@
 #include "openups.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +11,7 @@
 
 #define OPENUPS_NOTIFY_RETRY_COUNT 3
 #define OPENUPS_NOTIFY_RETRY_NS 10000000L
+#define OPENUPS_LISTEN_FDS_START 3
 
 static bool parse_uint64_value(const char *restrict value,
                                uint64_t *restrict out_value) {
@@ -115,6 +118,45 @@ static bool send_notify(systemd_notifier_t *restrict notifier,
   return false;
 }
 
+static bool send_notify_with_fd(systemd_notifier_t *restrict notifier,
+                                const char *restrict message, int fd) {
+  if (notifier == NULL || message == NULL || !notifier->enabled || fd < 0) {
+    return false;
+  }
+
+  struct iovec iov = {.iov_base = (void *)message, .iov_len = strlen(message)};
+  union {
+    struct cmsghdr header;
+    uint8_t buffer[CMSG_SPACE(sizeof(int))];
+  } control;
+  memset(&control, 0, sizeof(control));
+  struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control.buffer,
+      .msg_controllen = sizeof(control.buffer),
+  };
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  ssize_t sent;
+  do {
+    sent = sendmsg(notifier->sockfd, &msg, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  return sent >= 0;
+}
+
+/* systemd >= 254 exports the store size; older managers only reject
+ * FDSTORE=1 in the journal, so an absent variable is not a veto. */
+static bool fd_store_available(void) {
+  const char *fdstore = getenv("FDSTORE");
+  uint64_t size = 0;
+  return fdstore == NULL || (parse_uint64_value(fdstore, &size) && size > 0);
+}
+
 void systemd_notifier_init(systemd_notifier_t *restrict notifier) {
   if (notifier == NULL) {
     return;
@@ -219,6 +261,94 @@ bool systemd_notifier_stopping(systemd_notifier_t *restrict notifier) {
   return send_notify(notifier, "STOPPING=1");
 }
 
+/* RELOADING=1 must carry the monotonic timestamp (systemd >= 253 checks it);
+ * READY=1 afterwards ends the reload. */
+bool systemd_notifier_reloading(systemd_notifier_t *restrict notifier) {
+  uint64_t now_ms = get_monotonic_ms();
+  if (now_ms == UINT64_MAX) {
+    return send_notify(notifier, "RELOADING=1");
+  }
+  char message[OPENUPS_SYSTEMD_MESSAGE_SIZE];
+  snprintf(message, sizeof(message), "RELOADING=1\nMONOTONIC_USEC=%" PRIu64,
+           now_ms * UINT64_C(1000));
+  return send_notify(notifier, message);
+}
+
+/* Replaces any fd previously stored under the same name, so a reload that
+ * rebuilt a socket does not leave the stale one in the store. */
+bool systemd_notifier_store_fd(systemd_notifier_t *restrict notifier, int fd,
+                               const char *restrict name) {
+  if (notifier == NULL || !notifier->enabled || fd < 0 || name == NULL ||
+      !fd_store_available()) {
+    return false;
+  }
+
+  char message[OPENUPS_SYSTEMD_MESSAGE_SIZE];
+  snprintf(message, sizeof(message), "FDSTOREREMOVE=1\nFDNAME=%s", name);
+  (void)send_notify(notifier, message);
+  snprintf(message, sizeof(message), "FDSTORE=1\nFDNAME=%s", name);
+  return send_notify_with_fd(notifier, message, fd);
+}
+
+/* Claims the fds passed via LISTEN_FDS/LISTEN_FDNAMES (sd_listen_fds
+ * protocol): fds[i] receives the fd stored as names[i], or -1.  Inherited
+ * fds nobody asked for are closed and the variables are unset so the
+ * handover happens exactly once.  Returns the number of fds claimed. */
+size_t systemd_listen_fds_take(const char *const *restrict names,
+                               int *restrict fds, size_t count) {
+  if (names == NULL || fds == NULL) {
+    return 0;
+  }
+  for (size_t i = 0; i < count; i++) {
+    fds[i] = -1;
+  }
+
+  const char *pid_str = getenv("LISTEN_PID");
+  const char *count_str = getenv("LISTEN_FDS");
+  const char *fd_names = getenv("LISTEN_FDNAMES");
+  uint64_t pid = 0;
+  uint64_t listen_count = 0;
+  size_t claimed = 0;
+  if (pid_str != NULL && count_str != NULL &&
+      parse_uint64_value(pid_str, &pid) && pid == (uint64_t)getpid() &&
+      parse_uint64_value(count_str, &listen_count) &&
+      listen_count <= (uint64_t)(INT32_MAX - OPENUPS_LISTEN_FDS_START)) {
+    const char *cursor = fd_names;
+    for (uint64_t index = 0; index < listen_count; index++) {
+      int fd = OPENUPS_LISTEN_FDS_START + (int)index;
+      const char *separator = cursor != NULL ? strchr(cursor, ':') : NULL;
+      size_t entry_len = 0;
+      if (cursor != NULL) {
+        entry_len =
+            separator != NULL ? (size_t)(separator - cursor) : strlen(cursor);
+      }
+
+      bool wanted = false;
+      for (size_t i = 0; i < count && cursor != NULL; i++) {
+        if (fds[i] < 0 && names[i] != NULL &&
+            strlen(names[i]) == entry_len &&
+            memcmp(cursor, names[i], entry_len) == 0) {
+          fds[i] = fd;
+          wanted = true;
+          claimed++;
+          break;
+        }
+      }
+      if (wanted) {
+        (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+      } else {
+        close(fd);
+      }
+      cursor = separator != NULL ? separator + 1 : NULL;
+    }
+  }
+
+  unsetenv("LISTEN_PID");
+  unsetenv("LISTEN_FDS");
+  unsetenv("LISTEN_FDNAMES");
+  return claimed;
+}
+
 bool systemd_notifier_watchdog(systemd_notifier_t *restrict notifier) {
   if (OPENUPS_UNLIKELY(notifier == NULL || !notifier->enabled ||
                        notifier->watchdog_usec == 0)) {
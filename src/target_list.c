@@ -0,0 +1,768 @@
+#include "openups.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define TARGET_SCAN_BLOCK 64U
+/* Longest token quoted back in an error message. */
+#define TARGET_ERROR_TOKEN 64
+
+/* ---- Mapping ---- */
+
+bool target_map_fd(target_map_t *restrict map, int fd,
+                   const char *restrict path, char *restrict error_msg,
+                   size_t error_size) {
+  if (map == NULL || path == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  map->data = NULL;
+  map->size = 0;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    snprintf(error_msg, error_size, "Cannot stat targets file %s: %s", path,
+             strerror(errno));
+    return false;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    snprintf(error_msg, error_size, "Targets file %s is not a regular file",
+             path);
+    return false;
+  }
+  if (st.st_size == 0) {
+    return true;
+  }
+
+  /* The whole list is read front to back exactly once: fault it in with
+   * one read-ahead instead of a page fault every 4 KiB. */
+  void *data = mmap(NULL, (size_t)st.st_size, PROT_READ,
+                    MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  if (data == MAP_FAILED) {
+    snprintf(error_msg, error_size, "Cannot map targets file %s: %s", path,
+             strerror(errno));
+    return false;
+  }
+  map->data = data;
+  map->size = (size_t)st.st_size;
+  return true;
+}
+
+void target_map_close(target_map_t *restrict map) {
+  if (map == NULL) {
+    return;
+  }
+  if (map->data != NULL) {
+    munmap((void *)map->data, map->size);
+  }
+  map->data = NULL;
+  map->size = 0;
+}
+
+/* ---- Line scanner ---- */
+
+/* Classifies one 64-byte block: bit i of *newlines is set when block[i] is
+ * a newline, and of *separators when it ends or precedes a token (blank,
+ * CR, '#' or NUL).  block holds 64 readable bytes. */
+static void target_block_classify(const char *block, uint64_t *newlines,
+                                  uint64_t *separators) {
+#if defined(__AVX2__)
+  *newlines = 0;
+  *separators = 0;
+  for (unsigned half = 0; half < 2; half++) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(block + 32U * half));
+    __m256i newline = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+    __m256i separator = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#'))),
+            _mm256_cmpeq_epi8(v, _mm256_setzero_si256())));
+    *newlines |= (uint64_t)(uint32_t)_mm256_movemask_epi8(newline)
+                 << (32U * half);
+    *separators |= (uint64_t)(uint32_t)_mm256_movemask_epi8(separator)
+                   << (32U * half);
+  }
+#elif defined(__SSE2__)
+  *newlines = 0;
+  *separators = 0;
+  for (unsigned i = 0; i < 4; i++) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(block + 16U * i));
+    __m128i newline = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+    __m128i separator = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('#'))),
+                     _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+    *newlines |= (uint64_t)(uint16_t)_mm_movemask_epi8(newline) << (16U * i);
+    *separators |= (uint64_t)(uint16_t)_mm_movemask_epi8(separator)
+                   << (16U * i);
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  /* No movemask on NEON: weight each matching lane by its bit, then fold
+   * the four vectors with pairwise adds into one 64-bit mask. */
+  static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                      1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x16_t bits = vld1q_u8(weights);
+  uint8x16_t newline[4];
+  uint8x16_t separator[4];
+  for (unsigned i = 0; i < 4; i++) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)block + 16U * i);
+    newline[i] = vandq_u8(vceqq_u8(v, vdupq_n_u8('\n')), bits);
+    separator[i] = vandq_u8(
+        vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+                          vceqq_u8(v, vdupq_n_u8('\t'))),
+                 vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('\r')),
+                                   vceqq_u8(v, vdupq_n_u8('#'))),
+                          vceqzq_u8(v))),
+        bits);
+  }
+  uint8x16_t sum = vpaddq_u8(vpaddq_u8(newline[0], newline[1]),
+                             vpaddq_u8(newline[2], newline[3]));
+  *newlines = vgetq_lane_u64(vreinterpretq_u64_u8(vpaddq_u8(sum, sum)), 0);
+  sum = vpaddq_u8(vpaddq_u8(separator[0], separator[1]),
+                  vpaddq_u8(separator[2], separator[3]));
+  *separators = vgetq_lane_u64(vreinterpretq_u64_u8(vpaddq_u8(sum, sum)), 0);
+#else
+  *newlines = 0;
+  *separators = 0;
+  for (unsigned i = 0; i < TARGET_SCAN_BLOCK; i++) {
+    char c = block[i];
+    *newlines |= (uint64_t)(c == '\n') << i;
+    *separators |= (uint64_t)(c == ' ' || c == '\t' || c == '\r' ||
+                              c == '#' || c == '\0')
+                   << i;
+  }
+#endif
+}
+
+/* The final partial block is copied out, NUL-padded, so the vector loads
+ * never read past the end of the mapping. */
+static void target_block_scan(const char *block, size_t available,
+                              uint64_t *newlines, uint64_t *separators) {
+  if (available >= TARGET_SCAN_BLOCK) {
+    target_block_classify(block, newlines, separators);
+    return;
+  }
+  char tail[TARGET_SCAN_BLOCK] = {0};
+  memcpy(tail, block, available);
+  target_block_classify(tail, newlines, separators);
+}
+
+void target_scan_init(target_scan_t *restrict scan, const char *data,
+                      size_t size) {
+  if (scan == NULL) {
+    return;
+  }
+  scan->data = data;
+  scan->size = data != NULL ? size : 0;
+  scan->line_start = 0;
+  scan->block = 0;
+  scan->line_no = 0;
+  scan->newlines = 0;
+  scan->separators = 0;
+  if (scan->size > 0) {
+    target_block_scan(data, scan->size, &scan->newlines, &scan->separators);
+  }
+}
+
+/* Next line without its newline; false once the data is exhausted.
+ * *plain is set when the line sits inside one block and holds no
+ * separator, i.e. the whole line is the token. */
+static bool target_scan_line(target_scan_t *restrict scan,
+                             const char **restrict line,
+                             size_t *restrict length, bool *restrict plain) {
+  if (scan->line_start >= scan->size) {
+    return false;
+  }
+  size_t end;
+  for (;;) {
+    if (scan->newlines != 0) {
+      end = scan->block + (size_t)__builtin_ctzll(scan->newlines);
+      scan->newlines &= scan->newlines - 1;
+      break;
+    }
+    if (scan->size - scan->block <= TARGET_SCAN_BLOCK) {
+      end = scan->size; /* last line has no newline */
+      break;
+    }
+    scan->block += TARGET_SCAN_BLOCK;
+    target_block_scan(scan->data + scan->block, scan->size - scan->block,
+                      &scan->newlines, &scan->separators);
+  }
+  *line = scan->data + scan->line_start;
+  *length = end - scan->line_start;
+  *plain = false;
+  if (scan->line_start >= scan->block && *length > 0 &&
+      *length < TARGET_SCAN_BLOCK) {
+    size_t offset = scan->line_start - scan->block;
+    uint64_t span = ((UINT64_C(1) << *length) - 1U) << offset;
+    *plain = (scan->separators & span) == 0;
+  }
+  scan->line_start = end + 1;
+  scan->line_no++;
+  return true;
+}
+
+/* Skips blank and comment-only lines; scan->line_no is the token's line. */
+bool target_scan_next(target_scan_t *restrict scan,
+                      const char **restrict token, size_t *restrict length) {
+  if (scan == NULL || token == NULL || length == NULL) {
+    return false;
+  }
+  const char *line;
+  size_t line_length;
+  bool plain;
+  while (target_scan_line(scan, &line, &line_length, &plain)) {
+    if (plain) {
+      *token = line;
+      *length = line_length;
+      return true;
+    }
+    size_t token_length = target_line_token(line, line_length, token);
+    if (token_length > 0) {
+      *length = token_length;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Leading blanks are skipped; the token ends at a blank, CR, newline or
+ * '#'.  Returns its length, 0 for a blank or comment line. */
+size_t target_line_token(const char *line, size_t length,
+                         const char **restrict token) {
+  size_t start = 0;
+  while (start < length && (line[start] == ' ' || line[start] == '\t')) {
+    start++;
+  }
+  size_t end = start;
+  while (end < length) {
+    char c = line[end];
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#' ||
+        c == '\0') {
+      break;
+    }
+    end++;
+  }
+  *token = line + start;
+  return end - start;
+}
+
+/* ---- Address parser ---- */
+
+/* Bit i is set for each zero byte i of word; exact, unlike the classic
+ * has-zero test whose borrows flag neighbours. */
+static uint32_t target_zero_bytes(uint64_t word) {
+  const uint64_t low7 = UINT64_C(0x7F7F7F7F7F7F7F7F);
+  uint64_t zero = ~(((word & low7) + low7) | word | low7);
+  return (uint32_t)(((zero >> 7) * UINT64_C(0x0102040810204080)) >> 56);
+}
+
+/* Bit i is set for each byte i of word in '0'..'9'. */
+static uint32_t target_digit_bytes(uint64_t word) {
+  const uint64_t high = UINT64_C(0x8080808080808080);
+  uint64_t low = word & ~high;
+  uint64_t digit = ((low | high) - UINT64_C(0x3030303030303030)) &
+                   ((UINT64_C(0x3939393939393939) | high) - low) & ~word &
+                   high;
+  return (uint32_t)(((digit >> 7) * UINT64_C(0x0102040810204080)) >> 56);
+}
+
+static uint64_t target_load64(const char *text) {
+  uint64_t word;
+  memcpy(&word, text, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  return word;
+}
+
+/* Octet text[end - len, end) with len already known to be 1..3.  Digit
+ * weights and positions come from comparisons, not branches, because len
+ * is as random as the address. */
+static bool target_octet(const char *text, size_t end, size_t len,
+                         uint8_t *restrict out) {
+  size_t two = len >= 2U;
+  size_t three = len >= 3U;
+  unsigned ones = (unsigned)(unsigned char)text[end - 1U] - '0';
+  unsigned tens = (unsigned)(unsigned char)text[end - 1U - two] - '0';
+  unsigned hundreds =
+      (unsigned)(unsigned char)text[end - 1U - 2U * three] - '0';
+  unsigned value = ones + tens * 10U * (unsigned)two +
+                   hundreds * 100U * (unsigned)three;
+  *out = (uint8_t)value;
+  return (value <= 255U) & !(two & (text[end - len] == '0'));
+}
+
+/* Dotted quad with inet_pton() rules: exactly four decimal octets, no
+ * leading zeros.  Dots and digits are classified as bitmasks over two
+ * 8-byte words (SWAR), so there is no data-dependent branch per digit:
+ * random addresses would otherwise mispredict at most octet boundaries. */
+static bool target_parse_ipv4(const char *text, size_t length,
+                              uint8_t out[static 4]) {
+  if (length < 7U || length > 15U) {
+    return false;
+  }
+  /* Overlapping in-bounds loads: bytes 0..7 and 8..length-1. */
+  uint64_t low;
+  uint64_t high = 0;
+  if (length >= 8U) {
+    low = target_load64(text);
+    if (length > 8U) {
+      high = target_load64(text + length - 8U) >> (8U * (16U - length));
+    }
+  } else {
+    uint32_t head;
+    uint32_t tail;
+    memcpy(&head, text, sizeof(head));
+    memcpy(&tail, text + 3, sizeof(tail));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    head = __builtin_bswap32(head);
+    tail = __builtin_bswap32(tail);
+#endif
+    low = head | (uint64_t)tail << 24;
+  }
+
+  const uint64_t dot_bytes = UINT64_C(0x2E2E2E2E2E2E2E2E);
+  uint32_t valid = (UINT32_C(1) << length) - 1U;
+  uint32_t dots = (target_zero_bytes(low ^ dot_bytes) |
+                   target_zero_bytes(high ^ dot_bytes) << 8) &
+                  valid;
+  uint32_t digits =
+      target_digit_bytes(low) | target_digit_bytes(high) << 8;
+  if ((dots | digits) != valid || __builtin_popcount(dots) != 3) {
+    return false;
+  }
+  size_t first = (size_t)__builtin_ctz(dots);
+  dots &= dots - 1U;
+  size_t second = (size_t)__builtin_ctz(dots);
+  dots &= dots - 1U;
+  size_t third = (size_t)__builtin_ctz(dots);
+  size_t lengths[4] = {first, second - first - 1U, third - second - 1U,
+                       length - third - 1U};
+  if (lengths[0] - 1U >= 3U || lengths[1] - 1U >= 3U ||
+      lengths[2] - 1U >= 3U || lengths[3] - 1U >= 3U) {
+    return false;
+  }
+  return target_octet(text, first, lengths[0], &out[0]) &
+         target_octet(text, second, lengths[1], &out[1]) &
+         target_octet(text, third, lengths[2], &out[2]) &
+         target_octet(text, length, lengths[3], &out[3]);
+}
+
+/* Hex digit value plus one; 0 for any other byte. */
+static const uint8_t target_hex_digit[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,  ['5'] = 6,
+    ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10, ['a'] = 11, ['b'] = 12,
+    ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16, ['A'] = 11, ['B'] = 12,
+    ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+/* RFC 4291 text form with inet_pton() rules: at most four hex digits per
+ * group, one "::" standing for at least one zero group, and an optional
+ * trailing dotted quad. */
+static bool target_parse_ipv6(const char *text, size_t length,
+                              uint8_t out[static 16]) {
+  uint8_t bytes[16] = {0};
+  size_t used = 0;
+  size_t gap = SIZE_MAX; /* where "::" was seen */
+  size_t group_start = 0;
+  unsigned value = 0;
+  unsigned digits = 0;
+  size_t i = 0;
+  if (length > 0 && text[0] == ':') {
+    if (length < 2 || text[1] != ':') {
+      return false;
+    }
+    i = 1;
+  }
+  for (; i < length; i++) {
+    char c = text[i];
+    int nibble = target_hex_digit[(unsigned char)c] - 1;
+    if (nibble >= 0) {
+      if (digits == 4) {
+        return false;
+      }
+      value = value << 4 | (unsigned)nibble;
+      digits++;
+    } else if (c == ':') {
+      group_start = i + 1;
+      if (digits == 0) {
+        if (gap != SIZE_MAX) {
+          return false;
+        }
+        gap = used;
+        continue;
+      }
+      if (i + 1 == length || used + 2 > sizeof(bytes)) {
+        return false;
+      }
+      bytes[used++] = (uint8_t)(value >> 8);
+      bytes[used++] = (uint8_t)value;
+      value = 0;
+      digits = 0;
+    } else if (c == '.' && used + 4 <= sizeof(bytes) &&
+               target_parse_ipv4(text + group_start, length - group_start,
+                                 bytes + used)) {
+      used += 4;
+      digits = 0;
+      break;
+    } else {
+      return false;
+    }
+  }
+  if (digits > 0) {
+    if (used + 2 > sizeof(bytes)) {
+      return false;
+    }
+    bytes[used++] = (uint8_t)(value >> 8);
+    bytes[used++] = (uint8_t)value;
+  }
+  if (gap != SIZE_MAX) {
+    if (used == sizeof(bytes)) {
+      return false;
+    }
+    size_t tail = used - gap;
+    memmove(bytes + sizeof(bytes) - tail, bytes + gap, tail);
+    memset(bytes + gap, 0, sizeof(bytes) - tail - gap);
+    used = sizeof(bytes);
+  }
+  if (used != sizeof(bytes)) {
+    return false;
+  }
+  memcpy(out, bytes, sizeof(bytes));
+  return true;
+}
+
+/* "addr" or, when allow_prefix, "addr/prefix".  The family follows from
+ * the presence of ':'; host bits below the prefix are cleared. */
+bool target_parse(const char *restrict text, size_t length, bool allow_prefix,
+                  target_entry_t *restrict out) {
+  if (text == NULL || out == NULL) {
+    return false;
+  }
+  memset(out, 0, sizeof(*out));
+
+  /* One pass finds both the family and the prefix separator; tokens are
+   * too short for memchr() to pay for its call. */
+  size_t address_length = 0;
+  bool ipv6 = false;
+  while (address_length < length && text[address_length] != '/') {
+    ipv6 |= text[address_length] == ':';
+    address_length++;
+  }
+  const char *slash = address_length < length ? text + address_length : NULL;
+  if (slash != NULL && !allow_prefix) {
+    return false;
+  }
+  unsigned bits = ipv6 ? 128U : 32U;
+  if (ipv6 ? !target_parse_ipv6(text, address_length, out->bytes)
+           : !target_parse_ipv4(text, address_length, out->bytes)) {
+    return false;
+  }
+  out->family = ipv6 ? AF_INET6 : AF_INET;
+  out->prefix = (uint8_t)bits;
+  if (slash == NULL) {
+    return true;
+  }
+
+  size_t digits = length - address_length - 1;
+  if (digits == 0 || digits > 3) {
+    return false;
+  }
+  unsigned prefix = 0;
+  for (size_t i = 0; i < digits; i++) {
+    char c = slash[1 + i];
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    prefix = prefix * 10U + (unsigned)(c - '0');
+  }
+  if (prefix > bits) {
+    return false;
+  }
+  out->prefix = (uint8_t)prefix;
+  size_t keep = prefix / 8U;
+  if (prefix % 8U != 0) {
+    out->bytes[keep] &= (uint8_t)(0xFFU << (8U - prefix % 8U));
+    keep++;
+  }
+  memset(out->bytes + keep, 0, bits / 8U - keep);
+  return true;
+}
+
+void target_entry_address(const target_entry_t *restrict entry,
+                          struct sockaddr_storage *restrict addr,
+                          socklen_t *restrict addr_len) {
+  if (entry == NULL || addr == NULL || addr_len == NULL) {
+    return;
+  }
+  memset(addr, 0, sizeof(*addr));
+  if (entry->family == AF_INET6) {
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)addr;
+    addr6->sin6_family = AF_INET6;
+    memcpy(&addr6->sin6_addr, entry->bytes, sizeof(addr6->sin6_addr));
+    *addr_len = sizeof(*addr6);
+  } else {
+    struct sockaddr_in *addr4 = (struct sockaddr_in *)addr;
+    addr4->sin_family = AF_INET;
+    memcpy(&addr4->sin_addr, entry->bytes, sizeof(addr4->sin_addr));
+    *addr_len = sizeof(*addr4);
+  }
+}
+
+/* ---- Sorted, de-duplicated list ---- */
+
+/* Stable LSD radix sort of 64-bit keys on bytes [first, last), one byte per
+ * pass.  A pass whose byte is the same in every key is skipped. */
+static uint64_t *target_radix_keys(uint64_t *keys, uint64_t *scratch,
+                                   uint32_t n, unsigned first,
+                                   unsigned last) {
+  uint32_t histogram[8][256];
+  memset(histogram, 0, sizeof(histogram));
+  for (uint32_t i = 0; i < n; i++) {
+    for (unsigned digit = first; digit < last; digit++) {
+      histogram[digit][(keys[i] >> (8U * digit)) & 0xFFU]++;
+    }
+  }
+  for (unsigned digit = first; digit < last; digit++) {
+    uint32_t *bucket = histogram[digit];
+    if (bucket[(keys[0] >> (8U * digit)) & 0xFFU] == n) {
+      continue;
+    }
+    uint32_t offset = 0;
+    for (unsigned b = 0; b < 256U; b++) {
+      uint32_t size = bucket[b];
+      bucket[b] = offset;
+      offset += size;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      scratch[bucket[(keys[i] >> (8U * digit)) & 0xFFU]++] = keys[i];
+    }
+    uint64_t *swap = keys;
+    keys = scratch;
+    scratch = swap;
+  }
+  return keys;
+}
+
+/* Same for IPv6 entries, keyed on address bytes 15..0. */
+static target_entry_t *target_radix_entries(target_entry_t *entries,
+                                            target_entry_t *scratch,
+                                            uint32_t n) {
+  uint32_t histogram[16][256];
+  memset(histogram, 0, sizeof(histogram));
+  for (uint32_t i = 0; i < n; i++) {
+    for (unsigned b = 0; b < 16U; b++) {
+      histogram[b][entries[i].bytes[b]]++;
+    }
+  }
+  for (unsigned b = 16U; b-- > 0;) {
+    uint32_t *bucket = histogram[b];
+    if (bucket[entries[0].bytes[b]] == n) {
+      continue;
+    }
+    uint32_t offset = 0;
+    for (unsigned v = 0; v < 256U; v++) {
+      uint32_t size = bucket[v];
+      bucket[v] = offset;
+      offset += size;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      scratch[bucket[entries[i].bytes[b]]++] = entries[i];
+    }
+    target_entry_t *swap = entries;
+    entries = scratch;
+    scratch = swap;
+  }
+  return entries;
+}
+
+/* Sorts plain addresses (IPv4 first) and drops repeats.  Radix sorts are
+ * linear in the list and stable, so among equal addresses file order is
+ * kept and the first line is the one that survives.  IPv4 addresses are
+ * sorted as packed address:line keys, 8 bytes instead of a whole entry. */
+static bool target_sort_unique(target_entry_t *restrict entries,
+                               uint32_t *restrict count,
+                               uint32_t *restrict duplicates) {
+  uint32_t n = *count;
+  uint32_t n4 = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    n4 += entries[i].family == AF_INET;
+  }
+  uint32_t n6 = n - n4;
+  uint64_t *keys = malloc(((size_t)n4 * 2U + 1U) * sizeof(*keys));
+  target_entry_t *scratch = malloc(((size_t)n6 + 1U) * sizeof(*scratch));
+  if (keys == NULL || scratch == NULL) {
+    free(keys);
+    free(scratch);
+    return false;
+  }
+
+  /* Split: IPv4 into keys, IPv6 compacted to the front of entries. */
+  uint32_t k4 = 0;
+  uint32_t k6 = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const target_entry_t *entry = &entries[i];
+    if (entry->family == AF_INET) {
+      uint32_t address = (uint32_t)entry->bytes[0] << 24 |
+                         (uint32_t)entry->bytes[1] << 16 |
+                         (uint32_t)entry->bytes[2] << 8 | entry->bytes[3];
+      keys[k4++] = (uint64_t)address << 32 | entry->line_no;
+    } else {
+      entries[k6++] = *entry;
+    }
+  }
+
+  uint32_t u6 = 0;
+  if (n6 > 0) {
+    const target_entry_t *sorted = target_radix_entries(entries, scratch, n6);
+    for (uint32_t i = 0; i < n6; i++) {
+      if (u6 == 0 || memcmp(entries[u6 - 1].bytes, sorted[i].bytes,
+                            sizeof(sorted[i].bytes)) != 0) {
+        entries[u6++] = sorted[i];
+      }
+    }
+  }
+  uint32_t u4 = 0;
+  uint64_t *sorted = keys;
+  if (n4 > 0) {
+    sorted = target_radix_keys(keys, keys + n4, n4, 4, 8);
+    for (uint32_t i = 0; i < n4; i++) {
+      if (u4 == 0 || sorted[i] >> 32 != sorted[u4 - 1] >> 32) {
+        sorted[u4++] = sorted[i];
+      }
+    }
+  }
+
+  /* IPv6 moves up behind the IPv4 run, which is then unpacked in front. */
+  memmove(entries + u4, entries, (size_t)u6 * sizeof(*entries));
+  for (uint32_t i = 0; i < u4; i++) {
+    target_entry_t *entry = &entries[i];
+    uint32_t address = (uint32_t)(sorted[i] >> 32);
+    memset(entry, 0, sizeof(*entry));
+    entry->bytes[0] = (uint8_t)(address >> 24);
+    entry->bytes[1] = (uint8_t)(address >> 16);
+    entry->bytes[2] = (uint8_t)(address >> 8);
+    entry->bytes[3] = (uint8_t)address;
+    entry->line_no = (uint32_t)sorted[i];
+    entry->family = AF_INET;
+    entry->prefix = 32;
+  }
+  free(scratch);
+  free(keys);
+  *duplicates = n - u4 - u6;
+  *count = u4 + u6;
+  return true;
+}
+
+static size_t target_count_newlines(const char *data, size_t size) {
+  size_t count = 0;
+  for (size_t block = 0; block < size; block += TARGET_SCAN_BLOCK) {
+    uint64_t newlines;
+    uint64_t separators;
+    target_block_scan(data + block, size - block, &newlines, &separators);
+    count += (size_t)__builtin_popcountll(newlines);
+  }
+  return count;
+}
+
+/* Loads a list of plain IPv4/IPv6 literals (one per line, '#' comments)
+ * into a sorted array without duplicates.  max_entries bounds the result
+ * after de-duplication. */
+bool target_list_load(target_list_t *restrict list, const char *restrict path,
+                      uint32_t max_entries, char *restrict error_msg,
+                      size_t error_size) {
+  if (list == NULL || path == NULL || error_msg == NULL || error_size == 0) {
+    return false;
+  }
+  memset(list, 0, sizeof(*list));
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    snprintf(error_msg, error_size, "Cannot open targets file %s: %s", path,
+             strerror(errno));
+    return false;
+  }
+  target_map_t map;
+  bool mapped = target_map_fd(&map, fd, path, error_msg, error_size);
+  close(fd);
+  if (!mapped) {
+    return false;
+  }
+
+  /* One vector pass over the newlines sizes the array exactly. */
+  size_t lines = target_count_newlines(map.data, map.size) + 1U;
+  target_entry_t *entries = NULL;
+  if (lines >= UINT32_MAX) {
+    snprintf(error_msg, error_size, "%s: too many lines", path);
+    target_map_close(&map);
+    return false;
+  }
+  entries = malloc(lines * sizeof(*entries));
+  if (entries == NULL) {
+    snprintf(error_msg, error_size, "Out of memory loading %s", path);
+    target_map_close(&map);
+    return false;
+  }
+
+  target_scan_t scan;
+  target_scan_init(&scan, map.data, map.size);
+  uint32_t count = 0;
+  const char *token;
+  size_t length;
+  bool ok = true;
+  while (target_scan_next(&scan, &token, &length)) {
+    if (!target_parse(token, length, false, &entries[count])) {
+      int shown = length > TARGET_ERROR_TOKEN ? TARGET_ERROR_TOKEN
+                                              : (int)length;
+      snprintf(error_msg, error_size, "%s:%u: invalid target %.*s", path,
+               scan.line_no, shown, token);
+      ok = false;
+      break;
+    }
+    entries[count++].line_no = scan.line_no;
+  }
+  target_map_close(&map);
+
+  uint32_t duplicates = 0;
+  if (ok && !target_sort_unique(entries, &count, &duplicates)) {
+    snprintf(error_msg, error_size, "Out of memory loading %s", path);
+    ok = false;
+  }
+  if (ok && count > max_entries) {
+    snprintf(error_msg, error_size, "%s: more than %u targets", path,
+             max_entries);
+    ok = false;
+  }
+  if (!ok) {
+    free(entries);
+    return false;
+  }
+  list->entries = entries;
+  list->count = count;
+  list->duplicates = duplicates;
+  return true;
+}
+
+void target_list_free(target_list_t *restrict list) {
+  if (list == NULL) {
+    return;
+  }
+  free(list->entries);
+  memset(list, 0, sizeof(*list));
+}
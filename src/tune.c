@@ -0,0 +1,325 @@
+#include "tune.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TUNE_NS_PER_MS UINT64_C(1000000)
+#define TUNE_P99 0.99
+
+/* ---- Grid ---- */
+
+static bool tune_parse_int(const char *restrict text, char **restrict end,
+                           int *restrict out) {
+  errno = 0;
+  long value = strtol(text, end, 10);
+  if (*end == text || errno != 0 || value < 0 || value > INT_MAX) {
+    return false;
+  }
+  *out = (int)value;
+  return true;
+}
+
+/* Comma-separated values and inclusive ranges: "3,5,8-10". */
+bool tune_values_parse(tune_values_t *restrict values,
+                       const char *restrict text, char *restrict error_msg,
+                       size_t error_size) {
+  if (values == NULL || text == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return false;
+  }
+  values->count = 0;
+  const char *cursor = text;
+  for (;;) {
+    char *end = NULL;
+    int first = 0;
+    int last = 0;
+    if (!tune_parse_int(cursor, &end, &first)) {
+      snprintf(error_msg, error_size, "Invalid value list '%s'", text);
+      return false;
+    }
+    last = first;
+    if (*end == '-' && (!tune_parse_int(end + 1, &end, &last) ||
+                        last < first)) {
+      snprintf(error_msg, error_size, "Invalid range in '%s'", text);
+      return false;
+    }
+    for (int value = first; value <= last; value++) {
+      if (values->count == OPENUPS_TUNE_MAX_VALUES) {
+        snprintf(error_msg, error_size, "More than %u values in '%s'",
+                 OPENUPS_TUNE_MAX_VALUES, text);
+        return false;
+      }
+      values->values[values->count++] = value;
+    }
+    if (*end == '\0') {
+      return true;
+    }
+    if (*end != ',') {
+      snprintf(error_msg, error_size, "Invalid value list '%s'", text);
+      return false;
+    }
+    cursor = end + 1;
+  }
+}
+
+size_t tune_grid_size(const tune_grid_t *restrict grid) {
+  size_t size = 1;
+  for (size_t axis = 0; axis < TUNE_AXIS_COUNT; axis++) {
+    if (grid->axes[axis].count > 0) {
+      size *= grid->axes[axis].count;
+    }
+  }
+  return size;
+}
+
+static int tune_base_param(const config_t *restrict base, tune_axis_t axis) {
+  switch (axis) {
+  case TUNE_AXIS_THRESHOLD:
+    return base->fail_threshold;
+  case TUNE_AXIS_INTERVAL:
+    return base->interval_sec;
+  case TUNE_AXIS_TIMEOUT:
+    return base->timeout_ms;
+  case TUNE_AXIS_DELAY:
+  case TUNE_AXIS_COUNT:
+  default:
+    return base->delay_minutes;
+  }
+}
+
+/* Fills results[tune_grid_size(grid)] with the grid's points, the last
+ * axis varying fastest. */
+void tune_grid_expand(const tune_grid_t *restrict grid,
+                      const config_t *restrict base,
+                      tune_result_t *restrict results) {
+  if (grid == NULL || base == NULL || results == NULL) {
+    return;
+  }
+  size_t count = tune_grid_size(grid);
+  for (size_t i = 0; i < count; i++) {
+    memset(&results[i], 0, sizeof(results[i]));
+    size_t rest = i;
+    for (size_t axis = TUNE_AXIS_COUNT; axis-- > 0;) {
+      const tune_values_t *values = &grid->axes[axis];
+      if (values->count == 0) {
+        results[i].params[axis] = tune_base_param(base, (tune_axis_t)axis);
+        continue;
+      }
+      results[i].params[axis] = values->values[rest % values->count];
+      rest /= values->count;
+    }
+  }
+}
+
+/* ---- Ground truth ---- */
+
+bool tune_outages_find(const replay_history_t *restrict history,
+                       uint64_t min_outage_ms, tune_outage_t **restrict outages,
+                       size_t *restrict count) {
+  if (history == NULL || outages == NULL || count == NULL) {
+    return false;
+  }
+  *outages = NULL;
+  *count = 0;
+  size_t capacity = 0;
+  size_t i = 0;
+  while (i < history->count) {
+    if (history->requests[i].rtt_ns != OPENUPS_REPLAY_NO_REPLY) {
+      i++;
+      continue;
+    }
+    uint64_t start_ns = history->requests[i].at_ns;
+    while (i < history->count &&
+           history->requests[i].rtt_ns == OPENUPS_REPLAY_NO_REPLY) {
+      i++;
+    }
+    uint64_t end_ns =
+        i < history->count ? history->requests[i].at_ns : history->end_ns;
+    if ((end_ns - start_ns) / TUNE_NS_PER_MS < min_outage_ms) {
+      continue;
+    }
+    if (*count == capacity) {
+      capacity = capacity == 0 ? 16 : capacity * 2;
+      tune_outage_t *grown = realloc(*outages, capacity * sizeof(*grown));
+      if (grown == NULL) {
+        free(*outages);
+        *outages = NULL;
+        *count = 0;
+        return false;
+      }
+      *outages = grown;
+    }
+    (*outages)[(*count)++] = (tune_outage_t){
+        .start_ms = start_ns / TUNE_NS_PER_MS,
+        .end_ms = end_ns / TUNE_NS_PER_MS,
+    };
+  }
+  return true;
+}
+
+/* ---- Evaluation ---- */
+
+static int tune_compare_double(const void *lhs, const void *rhs) {
+  double a = *(const double *)lhs;
+  double b = *(const double *)rhs;
+  return (a > b) - (a < b);
+}
+
+static void tune_result_fail(tune_result_t *restrict result,
+                             const char *restrict error_msg) {
+  result->valid = false;
+  snprintf(result->error_msg, sizeof(result->error_msg), "%s", error_msg);
+}
+
+/* Runs the production reactor (dry-run, silent) over the history,
+ * restarting it after every shutdown, and scores the shutdowns against
+ * the outages. */
+void tune_evaluate(const tune_input_t *restrict input,
+                   tune_result_t *restrict result) {
+  if (input == NULL || result == NULL) {
+    return;
+  }
+  config_t config = input->base;
+  config.fail_threshold = result->params[TUNE_AXIS_THRESHOLD];
+  config.interval_sec = result->params[TUNE_AXIS_INTERVAL];
+  config.timeout_ms = result->params[TUNE_AXIS_TIMEOUT];
+  config.delay_minutes = result->params[TUNE_AXIS_DELAY];
+  config.shutdown_mode = SHUTDOWN_MODE_DRY_RUN;
+  config.log_level = LOG_LEVEL_SILENT;
+  char error_msg[256];
+  if (!config_validate(&config, error_msg, sizeof(error_msg))) {
+    tune_result_fail(result, error_msg);
+    return;
+  }
+
+  double *latencies = NULL;
+  if (input->outage_count > 0) {
+    latencies = malloc(input->outage_count * sizeof(*latencies));
+    if (latencies == NULL) {
+      tune_result_fail(result, "Out of memory");
+      return;
+    }
+  }
+  result->valid = true;
+  size_t outage = 0;
+  sim_options_t options = {
+      .seed = input->seed,
+      .duration_ms = UINT64_MAX,
+      .history = input->history,
+  };
+  netem_impair_init(&options.impair);
+  for (;;) {
+    sim_stats_t stats = {0};
+    int exit_code =
+        sim_run(&options, &config, &stats, error_msg, sizeof(error_msg));
+    if (exit_code != 0) {
+      if (exit_code != OPENUPS_SIM_EXIT_SETUP) {
+        snprintf(error_msg, sizeof(error_msg), "Reactor exited with %d",
+                 exit_code);
+      }
+      tune_result_fail(result, error_msg);
+      break;
+    }
+    if (stats.exhausted) {
+      break;
+    }
+    uint64_t at_ms = stats.virtual_ms;
+    while (outage < input->outage_count &&
+           input->outages[outage].end_ms <= at_ms) {
+      outage++;
+    }
+    if (outage < input->outage_count &&
+        input->outages[outage].start_ms <= at_ms) {
+      latencies[result->detected++] =
+          (double)(at_ms - input->outages[outage].start_ms) /
+          (double)OPENUPS_MS_PER_SEC;
+      options.start_ms = input->outages[outage].end_ms;
+      outage++;
+    } else {
+      /* The restarted monitor's first probe is an interval later at the
+       * earliest, which also guarantees progress. */
+      result->false_shutdowns++;
+      options.start_ms =
+          at_ms + (uint64_t)config.interval_sec * OPENUPS_MS_PER_SEC;
+    }
+  }
+  result->missed = (uint32_t)input->outage_count - result->detected;
+
+  if (result->detected > 0) {
+    double sum = 0.0;
+    for (uint32_t i = 0; i < result->detected; i++) {
+      sum += latencies[i];
+    }
+    result->mean_latency_s = sum / result->detected;
+    qsort(latencies, result->detected, sizeof(*latencies),
+          tune_compare_double);
+    /* Nearest rank. */
+    size_t rank = (size_t)((double)result->detected * TUNE_P99 + 0.999999);
+    result->p99_latency_s = latencies[rank > 0 ? rank - 1 : 0];
+  }
+  free(latencies);
+}
+
+typedef struct {
+  const tune_input_t *input;
+  tune_result_t *results;
+  size_t count;
+  atomic_size_t next;
+} tune_queue_t;
+
+static void *tune_worker_main(void *arg) {
+  tune_queue_t *queue = arg;
+  for (;;) {
+    size_t i = atomic_fetch_add_explicit(&queue->next, 1,
+                                         memory_order_relaxed);
+    if (i >= queue->count) {
+      return NULL;
+    }
+    tune_evaluate(queue->input, &queue->results[i]);
+  }
+}
+
+/* Evaluates every point on jobs threads (the caller's included); points
+ * are independent, so threads take the next one as they finish. */
+bool tune_run(const tune_input_t *restrict input,
+              tune_result_t *restrict results, size_t count, unsigned jobs,
+              char *restrict error_msg, size_t error_size) {
+  if (input == NULL || results == NULL || error_msg == NULL ||
+      error_size == 0) {
+    return false;
+  }
+  tune_queue_t queue = {
+      .input = input,
+      .results = results,
+      .count = count,
+  };
+  atomic_init(&queue.next, 0);
+  if (jobs == 0) {
+    jobs = 1;
+  }
+  if (jobs > count) {
+    jobs = count > 0 ? (unsigned)count : 1;
+  }
+  pthread_t *threads = calloc(jobs, sizeof(*threads));
+  if (threads == NULL) {
+    snprintf(error_msg, error_size, "Out of memory");
+    return false;
+  }
+  /* Fewer threads than asked for still finish the grid. */
+  unsigned started = 0;
+  while (started + 1 < jobs &&
+         pthread_create(&threads[started], NULL, tune_worker_main, &queue) ==
+             0) {
+    started++;
+  }
+  (void)tune_worker_main(&queue);
+  for (unsigned i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  return true;
+}
@@ -0,0 +1,74 @@
+#ifndef OPENUPS_TUNE_H
+#define OPENUPS_TUNE_H
+
+#include "sim.h"
+
+#define OPENUPS_TUNE_MAX_VALUES 64U /* per grid axis */
+
+typedef enum {
+  TUNE_AXIS_THRESHOLD = 0, /* --threshold */
+  TUNE_AXIS_INTERVAL = 1,  /* --interval, seconds */
+  TUNE_AXIS_TIMEOUT = 2,   /* --timeout, milliseconds */
+  TUNE_AXIS_DELAY = 3,     /* --delay, minutes */
+  TUNE_AXIS_COUNT = 4,
+} tune_axis_t;
+
+/* An empty axis keeps the base configuration's value. */
+typedef struct {
+  int values[OPENUPS_TUNE_MAX_VALUES];
+  size_t count;
+} tune_values_t;
+
+typedef struct {
+  tune_values_t axes[TUNE_AXIS_COUNT];
+} tune_grid_t;
+
+/* A run of lost requests lasting at least the minimum outage: from the
+ * first lost request to the next answered one (or the end). */
+typedef struct {
+  uint64_t start_ms;
+  uint64_t end_ms;
+} tune_outage_t;
+
+typedef struct {
+  const replay_history_t *history;
+  const tune_outage_t *outages;
+  size_t outage_count;
+  config_t base;
+  uint64_t seed;
+} tune_input_t;
+
+/* One grid point.  A shutdown inside an outage detects it (latency from
+ * the outage's start) and monitoring resumes when it ends; any other
+ * shutdown is false and monitoring resumes at once. */
+typedef struct {
+  int params[TUNE_AXIS_COUNT];
+  bool valid; /* false: error_msg says why the point was skipped */
+  char error_msg[128];
+  uint32_t false_shutdowns;
+  uint32_t detected;
+  uint32_t missed;
+  double mean_latency_s;
+  double p99_latency_s;
+} tune_result_t;
+
+[[nodiscard]] bool tune_values_parse(tune_values_t *restrict values,
+                                     const char *restrict text,
+                                     char *restrict error_msg,
+                                     size_t error_size);
+size_t tune_grid_size(const tune_grid_t *restrict grid);
+void tune_grid_expand(const tune_grid_t *restrict grid,
+                      const config_t *restrict base,
+                      tune_result_t *restrict results);
+[[nodiscard]] bool tune_outages_find(const replay_history_t *restrict history,
+                                     uint64_t min_outage_ms,
+                                     tune_outage_t **restrict outages,
+                                     size_t *restrict count);
+void tune_evaluate(const tune_input_t *restrict input,
+                   tune_result_t *restrict result);
+[[nodiscard]] bool tune_run(const tune_input_t *restrict input,
+                            tune_result_t *restrict results, size_t count,
+                            unsigned jobs, char *restrict error_msg,
+                            size_t error_size);
+
+#endif // OPENUPS_TUNE_H
@@ -0,0 +1,128 @@
+#ifndef OPENUPS_USDT_H
+#define OPENUPS_USDT_H
+
+/* USDT (user-level statically defined tracing) probes, provider "openups".
+ * Tracers attach by probe name from the ELF notes instead of by symbol,
+ * which LTO and -fvisibility=hidden make unreliable:
+ *
+ *   bpftrace -e 'usdt:bin/openups:openups:echo_reply { @ = hist(arg3); }'
+ *
+ * A probe compiles to one nop and a .note.stapsdt record naming the
+ * registers or stack slots that already hold its arguments, so an
+ * unattached probe costs a nop.  <sys/sdt.h> builds them when it is
+ * installed; otherwise the same note format is emitted here on x86-64 and
+ * AArch64.  -DOPENUPS_NO_USDT (make USDT=0) and other targets compile them
+ * out.  Arguments must be integers: pass pointers as uintptr_t. */
+
+#include <stdint.h>
+
+#define OPENUPS_USDT_NARG(...)                                                 \
+  OPENUPS_USDT_NARG_(__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define OPENUPS_USDT_NARG_(_1, _2, _3, _4, _5, _6, n, ...) n
+#define OPENUPS_USDT_CAT(a, b) OPENUPS_USDT_CAT_(a, b)
+#define OPENUPS_USDT_CAT_(a, b) a##b
+
+/* OPENUPS_USDT(name, arg1, ..., argN), 1 <= N <= 6. */
+#define OPENUPS_USDT(name, ...)                                                \
+  OPENUPS_USDT_CAT(OPENUPS_USDT, OPENUPS_USDT_NARG(__VA_ARGS__))               \
+  (name, __VA_ARGS__)
+
+#if defined(OPENUPS_NO_USDT)
+#define OPENUPS_USDT_ENABLED 0
+#elif __has_include(<sys/sdt.h>)
+#define OPENUPS_USDT_ENABLED 1
+#include <sys/sdt.h>
+#define OPENUPS_USDT1(n, a) DTRACE_PROBE1(openups, n, a)
+#define OPENUPS_USDT2(n, a, b) DTRACE_PROBE2(openups, n, a, b)
+#define OPENUPS_USDT3(n, a, b, c) DTRACE_PROBE3(openups, n, a, b, c)
+#define OPENUPS_USDT4(n, a, b, c, d) DTRACE_PROBE4(openups, n, a, b, c, d)
+#define OPENUPS_USDT5(n, a, b, c, d, e) DTRACE_PROBE5(openups, n, a, b, c, d, e)
+#define OPENUPS_USDT6(n, a, b, c, d, e, f)                                     \
+  DTRACE_PROBE6(openups, n, a, b, c, d, e, f)
+#elif (defined(__x86_64__) || defined(__aarch64__)) && defined(__GNUC__)
+#define OPENUPS_USDT_ENABLED 1
+
+/* The stapsdt v3 note: probe address, the .stapsdt.base anchor tracers
+ * use to adjust for prelink, no semaphore, provider, name and arguments.
+ * Argument i is "size@operand", size negative when signed; %n prints the
+ * operand constant negated, hence the inverted sign below. */
+#define OPENUPS_USDT_NOTE(name, args)                                          \
+  "990: nop\n"                                                                 \
+  ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                \
+  ".balign 4\n"                                                                \
+  ".4byte 992f-991f, 994f-993f, 3\n"                                           \
+  "991: .asciz \"stapsdt\"\n"                                                  \
+  "992: .balign 4\n"                                                           \
+  "993: .8byte 990b\n"                                                         \
+  ".8byte _.stapsdt.base\n"                                                    \
+  ".8byte 0\n"                                                                 \
+  ".asciz \"openups\"\n"                                                       \
+  ".asciz \"" name "\"\n"                                                      \
+  ".asciz \"" args "\"\n"                                                      \
+  "994: .balign 4\n"                                                           \
+  ".popsection\n"                                                              \
+  ".ifndef _.stapsdt.base\n"                                                   \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"      \
+  ".weak _.stapsdt.base\n"                                                     \
+  ".hidden _.stapsdt.base\n"                                                   \
+  "_.stapsdt.base: .space 1\n"                                                 \
+  ".size _.stapsdt.base, 1\n"                                                  \
+  ".popsection\n"                                                              \
+  ".endif\n"
+
+#define OPENUPS_USDT_FMT(i) "%n[s" #i "]@%[a" #i "]"
+#define OPENUPS_USDT_ARG(i, x)                                                 \
+  [s##i] "n"((((__typeof__(x))-1 < 1) ? 1 : -1) * (int)sizeof(x)),            \
+      [a##i] "nor"(x)
+
+#define OPENUPS_USDT1(n, a)                                                    \
+  __asm__ __volatile__(OPENUPS_USDT_NOTE(#n, OPENUPS_USDT_FMT(0))             \
+                       : : OPENUPS_USDT_ARG(0, a))
+#define OPENUPS_USDT2(n, a, b)                                                 \
+  __asm__ __volatile__(                                                        \
+      OPENUPS_USDT_NOTE(#n, OPENUPS_USDT_FMT(0) " " OPENUPS_USDT_FMT(1))      \
+      : : OPENUPS_USDT_ARG(0, a), OPENUPS_USDT_ARG(1, b))
+#define OPENUPS_USDT3(n, a, b, c)                                              \
+  __asm__ __volatile__(                                                        \
+      OPENUPS_USDT_NOTE(#n, OPENUPS_USDT_FMT(0) " " OPENUPS_USDT_FMT(1) " "   \
+                                OPENUPS_USDT_FMT(2))                           \
+      : : OPENUPS_USDT_ARG(0, a), OPENUPS_USDT_ARG(1, b),                      \
+        OPENUPS_USDT_ARG(2, c))
+#define OPENUPS_USDT4(n, a, b, c, d)                                           \
+  __asm__ __volatile__(                                                        \
+      OPENUPS_USDT_NOTE(#n, OPENUPS_USDT_FMT(0) " " OPENUPS_USDT_FMT(1) " "   \
+                                OPENUPS_USDT_FMT(2) " " OPENUPS_USDT_FMT(3))   \
+      : : OPENUPS_USDT_ARG(0, a), OPENUPS_USDT_ARG(1, b),                      \
+        OPENUPS_USDT_ARG(2, c), OPENUPS_USDT_ARG(3, d))
+#define OPENUPS_USDT5(n, a, b, c, d, e)                                        \
+  __asm__ __volatile__(                                                        \
+      OPENUPS_USDT_NOTE(#n, OPENUPS_USDT_FMT(0) " " OPENUPS_USDT_FMT(1) " "   \
+                                OPENUPS_USDT_FMT(2) " " OPENUPS_USDT_FMT(3)    \
+                                    " " OPENUPS_USDT_FMT(4))                   \
+      : : OPENUPS_USDT_ARG(0, a), OPENUPS_USDT_ARG(1, b),                      \
+        OPENUPS_USDT_ARG(2, c), OPENUPS_USDT_ARG(3, d),                        \
+        OPENUPS_USDT_ARG(4, e))
+#define OPENUPS_USDT6(n, a, b, c, d, e, f)                                     \
+  __asm__ __volatile__(                                                        \
+      OPENUPS_USDT_NOTE(#n, OPENUPS_USDT_FMT(0) " " OPENUPS_USDT_FMT(1) " "   \
+                                OPENUPS_USDT_FMT(2) " " OPENUPS_USDT_FMT(3)    \
+                                    " " OPENUPS_USDT_FMT(4) " "                \
+                                        OPENUPS_USDT_FMT(5))                   \
+      : : OPENUPS_USDT_ARG(0, a), OPENUPS_USDT_ARG(1, b),                      \
+        OPENUPS_USDT_ARG(2, c), OPENUPS_USDT_ARG(3, d),                        \
+        OPENUPS_USDT_ARG(4, e), OPENUPS_USDT_ARG(5, f))
+#else
+#define OPENUPS_USDT_ENABLED 0
+#endif
+
+#if !OPENUPS_USDT_ENABLED
+/* Arguments are not evaluated. */
+#define OPENUPS_USDT1(n, a) ((void)0)
+#define OPENUPS_USDT2(n, a, b) ((void)0)
+#define OPENUPS_USDT3(n, a, b, c) ((void)0)
+#define OPENUPS_USDT4(n, a, b, c, d) ((void)0)
+#define OPENUPS_USDT5(n, a, b, c, d, e) ((void)0)
+#define OPENUPS_USDT6(n, a, b, c, d, e, f) ((void)0)
+#endif
+
+#endif // OPENUPS_USDT_H
@@ -0,0 +1,164 @@
+/* openups-netem: a network to benchmark against.  Answers ICMP echo for
+ * 198.18.0.0/15 and 2001:2::/48 from a TUN device in a private network
+ * namespace, with scriptable delay, loss, duplication and reordering, and
+ * runs the given command inside that namespace.
+ *
+ * Usage: openups-netem [options] [-- command [args...]]
+ * Exit:  the command's status; 125 when the emulator itself fails. */
+
+#include "netem.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdlib.h>
+
+static void netem_usage(void) {
+  printf("Usage: openups-netem [options] [-- command [args...]]\n\n");
+  printf("Answers ICMP echo for %s/%u and %s/%u on a TUN device in a\n",
+         OPENUPS_NETEM_ADDR4, OPENUPS_NETEM_PREFIX4, OPENUPS_NETEM_ADDR6,
+         OPENUPS_NETEM_PREFIX6);
+  printf("private network namespace and runs command there (without one,\n");
+  printf("until SIGINT/SIGTERM).\n\n");
+  printf("Impairments:\n");
+  printf("  -d, --delay <spec>      MS | uniform:MIN,MAX | normal:MEAN,SD "
+         "(default: 0)\n");
+  printf("  -l, --loss <spec>       none | PCT | gilbert:ENTER_PCT,LEAVE_PCT\n");
+  printf("                          gilbert: bursts of 100/LEAVE_PCT requests "
+         "on average\n");
+  printf("  -u, --duplicate <pct>   Send a second, independently delayed "
+         "reply\n");
+  printf("  -r, --reorder <pct,ms>  Hold replies back ms longer so later ones "
+         "overtake\n");
+  printf("  -s, --script <file>     Lines of 'SECONDS key=value...' (keys as "
+         "above),\n");
+  printf("                          applied from that time after start; "
+         "settings\n");
+  printf("                          carry over from the options and earlier "
+         "lines\n\n");
+  printf("Emulator:\n");
+  printf("  -S, --seed <n>          Random seed; the same seed gives the same "
+         "fates (default: 1)\n");
+  printf("  -q, --queue <n>         Replies held at once (default: %u, max: "
+         "%u)\n",
+         OPENUPS_NETEM_DEFAULT_QUEUE, OPENUPS_NETEM_MAX_QUEUE);
+  printf("  -v, --verbose           Log script steps\n");
+  printf("  -Q, --quiet             Log warnings and errors only\n");
+  printf("  -h, --help              Show this help\n\n");
+  printf("Example:\n");
+  printf("  openups-netem --delay normal:20,5 --loss gilbert:1,25 -- \\\n");
+  printf("      openups --target 198.18.0.2 --interval 1 --systemd=false\n");
+}
+
+static bool netem_parse_u64(const char *restrict text, uint64_t max,
+                            uint64_t *restrict out) {
+  char *end = NULL;
+  errno = 0;
+  unsigned long long value = strtoull(text, &end, 10);
+  if (end == text || *end != '\0' || errno != 0 || text[0] == '-' ||
+      value > max) {
+    return false;
+  }
+  *out = (uint64_t)value;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+      {"delay", required_argument, 0, 'd'},
+      {"loss", required_argument, 0, 'l'},
+      {"duplicate", required_argument, 0, 'u'},
+      {"reorder", required_argument, 0, 'r'},
+      {"script", required_argument, 0, 's'},
+      {"seed", required_argument, 0, 'S'},
+      {"queue", required_argument, 0, 'q'},
+      {"verbose", no_argument, 0, 'v'},
+      {"quiet", no_argument, 0, 'Q'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0},
+  };
+  netem_options_t options = {
+      .seed = 1,
+      .queue = OPENUPS_NETEM_DEFAULT_QUEUE,
+      .log_level = LOG_LEVEL_INFO,
+  };
+  netem_impair_init(&options.impair);
+  const char *script_path = NULL;
+  char error_msg[256] = "";
+  bool ok = true;
+
+  int option = 0;
+  /* '+': options end at the command, which keeps its own. */
+  while (ok && (option = getopt_long(argc, argv, "+d:l:u:r:s:S:q:vQh",
+                                     long_options, NULL)) != -1) {
+    const char *key = NULL;
+    uint64_t number = 0;
+    switch (option) {
+    case 'd':
+      key = "delay";
+      break;
+    case 'l':
+      key = "loss";
+      break;
+    case 'u':
+      key = "duplicate";
+      break;
+    case 'r':
+      key = "reorder";
+      break;
+    case 's':
+      script_path = optarg;
+      break;
+    case 'S':
+      ok = netem_parse_u64(optarg, UINT64_MAX, &options.seed);
+      if (!ok) {
+        snprintf(error_msg, sizeof(error_msg), "Invalid seed '%s'", optarg);
+      }
+      break;
+    case 'q':
+      ok = netem_parse_u64(optarg, OPENUPS_NETEM_MAX_QUEUE, &number) &&
+           number > 0;
+      options.queue = (uint32_t)number;
+      if (!ok) {
+        snprintf(error_msg, sizeof(error_msg),
+                 "Invalid queue '%s' (1-%u)", optarg,
+                 OPENUPS_NETEM_MAX_QUEUE);
+      }
+      break;
+    case 'v':
+      options.log_level = LOG_LEVEL_DEBUG;
+      break;
+    case 'Q':
+      options.log_level = LOG_LEVEL_WARN;
+      break;
+    case 'h':
+      netem_usage();
+      return 0;
+    default:
+      snprintf(error_msg, sizeof(error_msg),
+               "Invalid option (see --help)");
+      ok = false;
+      break;
+    }
+    if (key != NULL) {
+      char setting[256];
+      snprintf(setting, sizeof(setting), "%s=%s", key, optarg);
+      ok = netem_impair_set(&options.impair, setting, error_msg,
+                            sizeof(error_msg));
+    }
+  }
+
+  static netem_script_t script;
+  if (ok && script_path != NULL) {
+    ok = netem_script_load(&script, &options.impair, script_path, error_msg,
+                           sizeof(error_msg));
+    options.script = &script;
+  }
+  if (!ok) {
+    logger_write(LOG_LEVEL_ERROR, false, "openups-netem: %s", error_msg);
+    return 125;
+  }
+  if (optind < argc) {
+    options.command = &argv[optind];
+  }
+  return netem_run(&options);
+}
@@ -0,0 +1,202 @@
+/* openups-sim: the monitor reactor in virtual time.  Runs the given openups
+ * command line against a simulated target whose delay and loss follow the
+ * same settings and scripts as openups-netem, jumping from event to event,
+ * so a week of monitoring takes milliseconds and the log (on stderr, with
+ * virtual timestamps) is identical on every run with the same seed.
+ *
+ * Usage: openups-sim [options] -- openups-options...
+ * Exit:  the reactor's exit code; 125 when the simulation cannot start. */
+
+#include "sim.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+static void sim_usage(void) {
+  printf("Usage: openups-sim [options] -- openups-options...\n\n");
+  printf("Runs the single-target monitor against a simulated target in "
+         "virtual time\n");
+  printf("and prints its log with virtual timestamps (seconds since "
+         "start).\n\n");
+  printf("Simulation:\n");
+  printf("  -t, --duration <time>   Virtual run time: N[s|m|h|d] "
+         "(default: 1d)\n");
+  printf("  -S, --seed <n>          Random seed for draws and probe phase "
+         "(default: 1)\n");
+  printf("  -w, --watchdog <time>   Emulate systemd with this WatchdogSec: "
+         "watchdog kicks\n");
+  printf("                          and status updates are counted, not "
+         "sent\n");
+  printf("  -h, --help              Show this help\n\n");
+  printf("Target (as openups-netem):\n");
+  printf("  -d, --delay <spec>      MS | uniform:MIN,MAX | normal:MEAN,SD\n");
+  printf("  -l, --loss <spec>       none | PCT | gilbert:ENTER_PCT,LEAVE_PCT\n");
+  printf("  -u, --duplicate <pct>   Send a second, independently delayed "
+         "reply\n");
+  printf("  -r, --reorder <pct,ms>  Hold replies back ms longer\n");
+  printf("  -s, --script <file>     Lines of 'SECONDS key=value...' applied "
+         "in virtual time\n\n");
+  printf("Route watch, --pmtu, --hops, --state-file and --low-latency are "
+         "off, and so\n");
+  printf("is systemd without --watchdog; true-off runs as dry-run.  A summary "
+         "with the\n");
+  printf("per-tick reactor cost goes to stdout.\n\n");
+  printf("Example:\n");
+  printf("  openups-sim --duration 7d --script outages.txt -- \\\n");
+  printf("      --target 192.0.2.1 --interval 10 --shutdown-mode log-only\n");
+}
+
+/* N with an optional s, m, h or d suffix, in milliseconds. */
+static bool sim_parse_duration(const char *restrict text,
+                               uint64_t *restrict out_ms) {
+  char *end = NULL;
+  errno = 0;
+  unsigned long long value = strtoull(text, &end, 10);
+  if (end == text || errno != 0 || text[0] == '-') {
+    return false;
+  }
+  uint64_t scale_ms = OPENUPS_MS_PER_SEC;
+  if (*end == 'm') {
+    scale_ms = OPENUPS_MS_PER_MINUTE;
+    end++;
+  } else if (*end == 'h') {
+    scale_ms = UINT64_C(60) * OPENUPS_MS_PER_MINUTE;
+    end++;
+  } else if (*end == 'd') {
+    scale_ms = UINT64_C(24) * UINT64_C(60) * OPENUPS_MS_PER_MINUTE;
+    end++;
+  } else if (*end == 's') {
+    end++;
+  }
+  return *end == '\0' && value > 0 &&
+         !ckd_mul(out_ms, (uint64_t)value, scale_ms);
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+      {"duration", required_argument, 0, 't'},
+      {"seed", required_argument, 0, 'S'},
+      {"delay", required_argument, 0, 'd'},
+      {"loss", required_argument, 0, 'l'},
+      {"duplicate", required_argument, 0, 'u'},
+      {"reorder", required_argument, 0, 'r'},
+      {"script", required_argument, 0, 's'},
+      {"watchdog", required_argument, 0, 'w'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0},
+  };
+  sim_options_t options = {
+      .seed = 1,
+      .duration_ms = UINT64_C(24) * UINT64_C(60) * OPENUPS_MS_PER_MINUTE,
+  };
+  netem_impair_init(&options.impair);
+  const char *script_path = NULL;
+  char error_msg[256] = "";
+  bool ok = true;
+
+  int option = 0;
+  /* '+': options end at the openups command line. */
+  while (ok && (option = getopt_long(argc, argv, "+t:S:d:l:u:r:s:w:h",
+                                     long_options, NULL)) != -1) {
+    const char *key = NULL;
+    char *end = NULL;
+    switch (option) {
+    case 't':
+      ok = sim_parse_duration(optarg, &options.duration_ms);
+      if (!ok) {
+        snprintf(error_msg, sizeof(error_msg), "Invalid duration '%s'",
+                 optarg);
+      }
+      break;
+    case 'S':
+      errno = 0;
+      options.seed = strtoull(optarg, &end, 10);
+      ok = end != optarg && *end == '\0' && errno == 0 && optarg[0] != '-';
+      if (!ok) {
+        snprintf(error_msg, sizeof(error_msg), "Invalid seed '%s'", optarg);
+      }
+      break;
+    case 'd':
+      key = "delay";
+      break;
+    case 'l':
+      key = "loss";
+      break;
+    case 'u':
+      key = "duplicate";
+      break;
+    case 'r':
+      key = "reorder";
+      break;
+    case 's':
+      script_path = optarg;
+      break;
+    case 'w':
+      ok = sim_parse_duration(optarg, &options.watchdog_ms);
+      if (!ok) {
+        snprintf(error_msg, sizeof(error_msg), "Invalid watchdog '%s'",
+                 optarg);
+      }
+      break;
+    case 'h':
+      sim_usage();
+      return 0;
+    default:
+      snprintf(error_msg, sizeof(error_msg), "Invalid option (see --help)");
+      ok = false;
+      break;
+    }
+    if (key != NULL) {
+      char setting[256];
+      snprintf(setting, sizeof(setting), "%s=%s", key, optarg);
+      ok = netem_impair_set(&options.impair, setting, error_msg,
+                            sizeof(error_msg));
+    }
+  }
+
+  static netem_script_t script;
+  if (ok && script_path != NULL) {
+    ok = netem_script_load(&script, &options.impair, script_path, error_msg,
+                           sizeof(error_msg));
+    options.script = &script;
+  }
+  /* config_resolve() parses from argv[1]: the "--" stands in for argv[0]. */
+  config_t config;
+  bool exit_requested = false;
+  if (ok) {
+    ok = config_resolve(&config, argc - optind + 1, &argv[optind - 1],
+                        &exit_requested, error_msg, sizeof(error_msg));
+  }
+  if (!ok) {
+    logger_write(LOG_LEVEL_ERROR, false, "openups-sim: %s", error_msg);
+    return OPENUPS_SIM_EXIT_SETUP;
+  }
+  if (exit_requested) {
+    return 0;
+  }
+
+  sim_stats_t stats = {0};
+  int exit_code = sim_run(&options, &config, &stats, error_msg,
+                          sizeof(error_msg));
+  if (exit_code == OPENUPS_SIM_EXIT_SETUP) {
+    logger_write(LOG_LEVEL_ERROR, false, "openups-sim: %s", error_msg);
+    return exit_code;
+  }
+  double wall_s = (double)stats.wall_us / 1e6;
+  printf("Simulated %" PRIu64 ".%03" PRIu64 "s in %.3fs: %" PRIu64
+         " ticks (%.0f ns/tick), %" PRIu64 " probes, %" PRIu64
+         " replies, exit %d\n",
+         stats.virtual_ms / OPENUPS_MS_PER_SEC,
+         stats.virtual_ms % OPENUPS_MS_PER_SEC, wall_s, stats.ticks,
+         stats.ticks > 0 ? (double)stats.wall_us * 1e3 / (double)stats.ticks
+                         : 0.0,
+         stats.probes, stats.replies, exit_code);
+  if (options.watchdog_ms > 0) {
+    printf("systemd: %" PRIu64 " watchdog kicks, %" PRIu64
+           " status updates\n",
+           stats.watchdog_kicks, stats.status_updates);
+  }
+  return exit_code;
+}
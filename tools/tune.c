@@ -0,0 +1,257 @@
+/* openups-tune: scores a grid of --threshold, --interval, --timeout and
+ * --delay values against a packet capture.  Every combination runs the
+ * production reactor in virtual time over the capture's echo history (see
+ * openups-replay), in parallel across cores, and is reported with its
+ * false shutdowns, missed outages and detection latency.
+ *
+ * Usage: openups-tune [options] capture -- openups-options...
+ * Exit:  0, or 125 when the grid cannot be evaluated. */
+
+#include "tune.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TUNE_DEFAULT_MIN_OUTAGE_S 60U
+#define TUNE_DEFAULT_WINDOW_MS 10000U
+
+static void tune_usage(void) {
+  printf("Usage: openups-tune [options] capture -- openups-options...\n\n");
+  printf("Evaluates every combination of the given values against a pcap "
+         "or pcapng\n");
+  printf("capture: the monitor runs in dry-run over the capture's echo "
+         "requests to\n");
+  printf("--target and restarts after each shutdown.  Values are lists and "
+         "ranges,\n");
+  printf("e.g. 3,5,8-10; an axis left out keeps the openups option's "
+         "value.\n\n");
+  printf("Grid:\n");
+  printf("  -t, --threshold <list>  Consecutive failures\n");
+  printf("  -i, --interval <list>   Probe interval, seconds\n");
+  printf("  -T, --timeout <list>    Probe timeout, milliseconds\n");
+  printf("  -D, --delay <list>      Shutdown delay, minutes\n\n");
+  printf("Scoring:\n");
+  printf("  -m, --min-outage <s>    Lost requests spanning this long are an "
+         "outage\n");
+  printf("                          (default: %u); shutdowns outside one are "
+         "false\n",
+         TUNE_DEFAULT_MIN_OUTAGE_S);
+  printf("  -W, --window <ms>       Replies later than this count as lost "
+         "(default: %u)\n",
+         TUNE_DEFAULT_WINDOW_MS);
+  printf("  -j, --jobs <n>          Threads (default: online CPUs)\n");
+  printf("  -S, --seed <n>          Probe phase (default: 1)\n");
+  printf("  -h, --help              Show this help\n\n");
+  printf("Example:\n");
+  printf("  openups-tune -t 2-6 -i 5,10,30 -T 1000,2000 -D 0,1 uplink.pcap "
+         "-- \\\n");
+  printf("      --target 192.0.2.1\n");
+}
+
+static bool tune_parse_u64(const char *restrict text,
+                           uint64_t *restrict out) {
+  char *end = NULL;
+  errno = 0;
+  unsigned long long value = strtoull(text, &end, 10);
+  if (end == text || *end != '\0' || errno != 0 || text[0] == '-') {
+    return false;
+  }
+  *out = (uint64_t)value;
+  return true;
+}
+
+static void tune_print(const tune_result_t *restrict results, size_t count) {
+  printf("threshold interval timeout delay  false missed detected   mean_s "
+         "   p99_s\n");
+  for (size_t i = 0; i < count; i++) {
+    const tune_result_t *result = &results[i];
+    printf("%9d %8d %7d %5d ", result->params[TUNE_AXIS_THRESHOLD],
+           result->params[TUNE_AXIS_INTERVAL],
+           result->params[TUNE_AXIS_TIMEOUT],
+           result->params[TUNE_AXIS_DELAY]);
+    if (!result->valid) {
+      printf(" skipped: %s\n", result->error_msg);
+    } else if (result->detected == 0) {
+      printf("%6" PRIu32 " %6" PRIu32 " %8" PRIu32 " %8s %8s\n",
+             result->false_shutdowns, result->missed, result->detected, "-",
+             "-");
+    } else {
+      printf("%6" PRIu32 " %6" PRIu32 " %8" PRIu32 " %8.1f %8.1f\n",
+             result->false_shutdowns, result->missed, result->detected,
+             result->mean_latency_s, result->p99_latency_s);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+      {"threshold", required_argument, 0, 't'},
+      {"interval", required_argument, 0, 'i'},
+      {"timeout", required_argument, 0, 'T'},
+      {"delay", required_argument, 0, 'D'},
+      {"min-outage", required_argument, 0, 'm'},
+      {"window", required_argument, 0, 'W'},
+      {"jobs", required_argument, 0, 'j'},
+      {"seed", required_argument, 0, 'S'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0},
+  };
+  static tune_grid_t grid;
+  uint64_t min_outage_s = TUNE_DEFAULT_MIN_OUTAGE_S;
+  uint64_t window_ms = TUNE_DEFAULT_WINDOW_MS;
+  uint64_t jobs = 0;
+  uint64_t seed = 1;
+  char error_msg[256] = "";
+  bool ok = true;
+
+  int option = 0;
+  /* '+': options end at the capture. */
+  while (ok && (option = getopt_long(argc, argv, "+t:i:T:D:m:W:j:S:h",
+                                     long_options, NULL)) != -1) {
+    tune_values_t *values = NULL;
+    uint64_t *number = NULL;
+    switch (option) {
+    case 't':
+      values = &grid.axes[TUNE_AXIS_THRESHOLD];
+      break;
+    case 'i':
+      values = &grid.axes[TUNE_AXIS_INTERVAL];
+      break;
+    case 'T':
+      values = &grid.axes[TUNE_AXIS_TIMEOUT];
+      break;
+    case 'D':
+      values = &grid.axes[TUNE_AXIS_DELAY];
+      break;
+    case 'm':
+      number = &min_outage_s;
+      break;
+    case 'W':
+      number = &window_ms;
+      break;
+    case 'j':
+      number = &jobs;
+      break;
+    case 'S':
+      number = &seed;
+      break;
+    case 'h':
+      tune_usage();
+      return 0;
+    default:
+      snprintf(error_msg, sizeof(error_msg), "Invalid option (see --help)");
+      ok = false;
+      break;
+    }
+    if (values != NULL) {
+      ok = tune_values_parse(values, optarg, error_msg, sizeof(error_msg));
+    }
+    if (number != NULL && !tune_parse_u64(optarg, number)) {
+      snprintf(error_msg, sizeof(error_msg), "Invalid number '%s'", optarg);
+      ok = false;
+    }
+  }
+  if (ok && (optind + 1 >= argc || strcmp(argv[optind + 1], "--") != 0)) {
+    snprintf(error_msg, sizeof(error_msg),
+             "Expected: capture -- openups-options (see --help)");
+    ok = false;
+  }
+
+  /* config_resolve() parses from argv[1]: the "--" stands in for argv[0]. */
+  const char *capture_path = ok ? argv[optind] : NULL;
+  tune_input_t input = {.seed = seed};
+  bool exit_requested = false;
+  if (ok) {
+    ok = config_resolve(&input.base, argc - optind - 1, &argv[optind + 1],
+                        &exit_requested, error_msg, sizeof(error_msg));
+  }
+  if (ok && exit_requested) {
+    return 0;
+  }
+  struct sockaddr_storage target;
+  socklen_t target_len = 0;
+  if (ok) {
+    ok = resolve_target(input.base.target, &target, &target_len, error_msg,
+                        sizeof(error_msg));
+  }
+
+  replay_history_t history = {0};
+  uint64_t load_start_us = get_monotonic_us();
+  if (ok) {
+    ok = replay_history_load(&history, capture_path, &target,
+                             window_ms * UINT64_C(1000000), error_msg,
+                             sizeof(error_msg));
+  }
+  uint64_t load_us = get_monotonic_us() - load_start_us;
+  tune_outage_t *outages = NULL;
+  if (ok && !tune_outages_find(&history, min_outage_s * OPENUPS_MS_PER_SEC,
+                               &outages, &input.outage_count)) {
+    snprintf(error_msg, sizeof(error_msg), "Out of memory");
+    ok = false;
+  }
+  size_t count = tune_grid_size(&grid);
+  tune_result_t *results = ok ? calloc(count, sizeof(*results)) : NULL;
+  if (ok && results == NULL) {
+    snprintf(error_msg, sizeof(error_msg), "Out of memory");
+    ok = false;
+  }
+  if (!ok) {
+    logger_write(LOG_LEVEL_ERROR, false, "openups-tune: %s", error_msg);
+    replay_history_free(&history);
+    free(outages);
+    return OPENUPS_SIM_EXIT_SETUP;
+  }
+  if (history.malformed) {
+    logger_write(LOG_LEVEL_WARN, false,
+                 "openups-tune: malformed record; history ends there");
+  }
+  if (history.count == 0) {
+    logger_write(LOG_LEVEL_WARN, false,
+                 "openups-tune: no echo requests to %s in the capture",
+                 input.base.target);
+  }
+
+  char start[32] = "";
+  time_t start_s = (time_t)(history.start_ns / UINT64_C(1000000000));
+  struct tm start_tm;
+  if (gmtime_r(&start_s, &start_tm) != NULL) {
+    strftime(start, sizeof(start), "%Y-%m-%d %H:%M:%S", &start_tm);
+  }
+  printf("History: %zu requests, %" PRIu64 " replies in %" PRIu64
+         " packets (%.3fs), %.3fs from %s UTC; %zu outages of %" PRIu64
+         "s or more\n",
+         history.count, history.replies, history.packets,
+         (double)load_us / 1e6, (double)history.end_ns / 1e9, start,
+         input.outage_count, min_outage_s);
+
+  input.history = &history;
+  input.outages = outages;
+  tune_grid_expand(&grid, &input.base, results);
+  if (jobs == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = online > 0 ? (uint64_t)online : 1;
+  }
+  if (jobs > count) {
+    jobs = count;
+  }
+  uint64_t run_start_us = get_monotonic_us();
+  ok = tune_run(&input, results, count, (unsigned)jobs, error_msg,
+                sizeof(error_msg));
+  uint64_t run_us = get_monotonic_us() - run_start_us;
+  if (ok) {
+    tune_print(results, count);
+    printf("Evaluated %zu combinations in %.3fs on %" PRIu64 " thread%s\n",
+           count, (double)run_us / 1e6, jobs, jobs == 1 ? "" : "s");
+  } else {
+    logger_write(LOG_LEVEL_ERROR, false, "openups-tune: %s", error_msg);
+  }
+  free(results);
+  free(outages);
+  replay_history_free(&history);
+  return ok ? 0 : OPENUPS_SIM_EXIT_SETUP;
+}